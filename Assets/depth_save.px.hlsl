@@ -1,6 +1,5 @@
 struct PixelInput
 {
-    float3 color : COLOR;
     float4 position : SV_Position;
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
@@ -1,6 +1,5 @@
 struct PixelInput
 {
-    float3 color : COLOR;
     float4 position : SV_Position;
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
@@ -11,14 +10,57 @@ struct PixelOutput
     float4 attachment0 : SV_Target0;
 };
 
+cbuffer material : register(b1)
+{
+    float3 diffuse;
+};
+
+//layout shared with vt_feedback.px.hlsl and VirtualTextureConstants
+cbuffer virtualTexture : register(b2)
+{
+    float2 virtualSize;
+    float2 pageCount;
+    float2 atlasSize;
+    float pageSize;
+    float pageBorder;
+    float maxMip;
+    float feedbackMipBias;
+};
+
 Texture2D g_texture : register(t1);
+Texture2D<uint> g_pageTable : register(t2);
+Texture2D g_physicalPages : register(t3);
 SamplerState s1 : register(s0);
 
+float4 SampleVirtualTexture(float2 uv)
+{
+    float2 texel = uv * virtualSize;
+    float2 dx = ddx(texel);
+    float2 dy = ddy(texel);
+    uint mip = (uint)clamp(0.5f * log2(max(dot(dx, dx), dot(dy, dy))), 0.0f, maxMip);
+
+    //the page table falls back to the closest resident ancestor, so the entry says which mip
+    //is actually there
+    uv = saturate(uv);
+    uint2 page = min((uint2)(uv * pageCount), (uint2)pageCount - 1) >> mip;
+    uint entry = g_pageTable.Load(int3(page, mip));
+    if ((entry >> 24) == 0)
+        return float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    uint2 physicalPage = uint2(entry & 0xFF, (entry >> 8) & 0xFF);
+    uint residentMip = (entry >> 16) & 0xFF;
+    float2 residentPages = max((float2)((uint2)pageCount >> residentMip), 1.0f);
+    float2 inPage = frac(uv * residentPages);
+    float2 atlasTexel = physicalPage * (pageSize + 2.0f * pageBorder) + pageBorder + inPage * pageSize;
+    return g_physicalPages.SampleLevel(s1, atlasTexel / atlasSize, 0);
+}
+
 PixelOutput main(PixelInput pixelInput)
 {
     PixelOutput output;
     output.attachment0 = g_texture.Sample(s1, pixelInput.uv) * 0.00001;
-    output.attachment0 += float4(pixelInput.color, 1.0);
+    output.attachment0 += SampleVirtualTexture(pixelInput.uv) * 0.00001;
+    output.attachment0 += float4(diffuse, 1.0);
     //output.attachment0 = float4(1.0f, 1.0f, 1.0f, 1.0f);
 
     //output.attachment0 = float4(pixelInput.normal + float3(0.5f), 1.0f);
@@ -13,13 +13,11 @@ struct VertexInput
 {
     float3 inPos : POSITION;
     float3 inNormal : NORMAL;
-    float3 inColor : COLOR;
     float2 inUV : TEXCOORD;
 };
 
 struct VertexOutput
 {
-    float3 color : COLOR;
     float4 position : SV_Position;
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
@@ -27,7 +25,6 @@ struct VertexOutput
 
 VertexOutput main(VertexInput vertexInput)
 {
-    float3 inColor = vertexInput.inColor;
     float3 inPos = vertexInput.inPos;
     float4 position = mul(float4(inPos, 1.0f), mvp);
 
@@ -35,7 +32,6 @@ VertexOutput main(VertexInput vertexInput)
     output.position = position;
     output.uv = vertexInput.inUV;
     //output.position = float4(inPos, 1.0f);
-    output.color = inColor;
     output.normal = vertexInput.inNormal;
     return output;
 }
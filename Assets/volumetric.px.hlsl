@@ -1,3 +1,23 @@
+//quality knobs, overridden per permutation with -D by ShaderCompiler
+#ifndef MARCH_STEPS
+#define MARCH_STEPS 250
+#endif
+#ifndef FBM_OCTAVES
+#define FBM_OCTAVES 8
+#endif
+#ifndef MIN_STEP_SIZE
+#define MIN_STEP_SIZE 0.05
+#endif
+#ifndef STEP_SIZE_SCALE
+#define STEP_SIZE_SCALE 0.02 //steps grow with the distance marched so far
+#endif
+#ifndef SCREEN_WIDTH
+#define SCREEN_WIDTH 800
+#endif
+#ifndef SCREEN_HEIGHT
+#define SCREEN_HEIGHT 600
+#endif
+
 cbuffer cb : register(b0)
 {
     row_major float4x4 mvp : packoffset(c0);
@@ -8,7 +28,6 @@ cbuffer cb : register(b0)
 
 struct PixelInput
 {
-    float3 color : COLOR;
     float4 position : SV_Position;
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
@@ -19,8 +38,17 @@ struct PixelOutput
     float4 attachment0 : SV_Target0;
 };
 
+#ifdef BINDLESS
+//ResourceDescriptorHeap indices of the depth targets, set by the pipeline as root constants
+cbuffer bindless : register(b1)
+{
+    uint backCulled;
+    uint frontCulled;
+};
+#else
 Texture2D <float> backCulled : register(t0);
 Texture2D <float> frontCulled : register(t1);
+#endif
 SamplerState s1 : register(s0);
 
 float3 WorldPosFromDepth(float depth, float2 uv) {
@@ -62,7 +90,7 @@ float valueNoise(float3 p)
 float fbm(float3 p)
 {
     float3 q = p - float3(0.5, 0.0, 0.0) * time;
-	int numOctaves = 8;
+	int numOctaves = FBM_OCTAVES;
     float weight = 0.7;
     float ret = 0.0;
     
@@ -87,7 +115,7 @@ float4 volumetricMarch(float3 enter, float3 exit)
     float minDistance = length(eye - enter);
     float maxDistance = length(eye - exit);
     
-    for (int i = 0; i < 250; i++)
+    for (int i = 0; i < MARCH_STEPS; i++)
     {
         float3 p = ro + depth * rd;
         float curDist = length(p - ro);
@@ -110,7 +138,7 @@ float4 volumetricMarch(float3 enter, float3 exit)
             color += c * (1.0 - color.a);
         }
         
-        depth += max(0.05, 0.02 * depth);
+        depth += max(MIN_STEP_SIZE, STEP_SIZE_SCALE * depth);
     }
     
     return float4(clamp(color.rgb, 0.0, 1.0), color.a);
@@ -120,12 +148,19 @@ float4 volumetricMarch(float3 enter, float3 exit)
 
 PixelOutput main(PixelInput pixelInput)
 {
-    float2 uv = pixelInput.position.xy/float2(800, 600);
+    float2 uv = pixelInput.position.xy/float2(SCREEN_WIDTH, SCREEN_HEIGHT);
     int2 uvi = int2(floor(uv.x), floor(uv.y));
-    //float exitDepth = frontCulled.Sample(s1, uv); //maybe better in some cases
-    //float enterDepth = backCulled.Sample(s1, uv);
-    float exitDepth = frontCulled.Load(int3(floor(pixelInput.position.x), floor(pixelInput.position.y), 0));
-    float enterDepth = backCulled.Load(int3(floor(pixelInput.position.x), floor(pixelInput.position.y), 0));
+#ifdef BINDLESS
+    Texture2D<float> frontCulledTexture = ResourceDescriptorHeap[frontCulled];
+    Texture2D<float> backCulledTexture = ResourceDescriptorHeap[backCulled];
+#else
+    Texture2D<float> frontCulledTexture = frontCulled;
+    Texture2D<float> backCulledTexture = backCulled;
+#endif
+    //float exitDepth = frontCulledTexture.Sample(s1, uv); //maybe better in some cases
+    //float enterDepth = backCulledTexture.Sample(s1, uv);
+    float exitDepth = frontCulledTexture.Load(int3(floor(pixelInput.position.x), floor(pixelInput.position.y), 0));
+    float enterDepth = backCulledTexture.Load(int3(floor(pixelInput.position.x), floor(pixelInput.position.y), 0));
     float3 worldPosEnter = WorldPosFromDepth(enterDepth, uv);
     float3 worldPosExit = WorldPosFromDepth(exitDepth, uv);
     PixelOutput output;
@@ -0,0 +1,34 @@
+//layout shared with triangle.px.hlsl and VirtualTextureConstants
+cbuffer virtualTexture : register(b2)
+{
+    float2 virtualSize;
+    float2 pageCount;
+    float2 atlasSize;
+    float pageSize;
+    float pageBorder;
+    float maxMip;
+    float feedbackMipBias;
+};
+
+struct PixelInput
+{
+    float4 position : SV_Position;
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD;
+};
+
+//writes the page and mip the main pass will want for this texel, packed like PackPage with
+//the valid bit set. The target is smaller than the screen, feedbackMipBias removes the extra
+//mips the larger derivatives would add
+uint main(PixelInput pixelInput) : SV_Target0
+{
+    float2 texel = pixelInput.uv * virtualSize;
+    float2 dx = ddx(texel);
+    float2 dy = ddy(texel);
+    float mip = 0.5f * log2(max(dot(dx, dx), dot(dy, dy))) + feedbackMipBias;
+    uint clampedMip = (uint)clamp(mip, 0.0f, maxMip);
+
+    float2 uv = saturate(pixelInput.uv);
+    uint2 page = min((uint2)(uv * pageCount), (uint2)pageCount - 1) >> clampedMip;
+    return 0x80000000u | (clampedMip << 24) | (page.y << 12) | page.x;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+//32 bit fnv-1a, constexpr so names written as literals can be hashed by the compiler
+constexpr uint32_t HashBindingName(const char* name)
+{
+	uint32_t hash = 0x811C9DC5u;
+	for(; *name; name++)
+	{
+		hash ^= static_cast<uint8_t>(*name);
+		hash *= 0x01000193u;
+	}
+	return hash;
+}
+
+//name of a cbuffer or texture in a shader. Binding through it avoids building a std::string,
+//the hash is computed at compile time when the BindingName itself is constexpr:
+//	static constexpr BindingName SceneConstants = "cb";
+struct BindingName
+{
+	constexpr BindingName(const char* name) : Name(name), Hash(HashBindingName(name)) {}
+
+	const char* Name;
+	uint32_t Hash;
+};
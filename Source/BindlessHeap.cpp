@@ -0,0 +1,111 @@
+#include "BindlessHeap.h"
+
+#include <iostream>
+
+BindlessHeap::~BindlessHeap()
+{
+	if(Active == this)
+		Active = nullptr;
+	if(Heap)
+		Heap->Release();
+}
+
+void BindlessHeap::Initialize(ID3D12Device* device, uint32_t capacity, uint32_t transientCapacity)
+{
+	Device = device;
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = capacity;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&Heap)));
+	Heap->SetName(L"Bindless Descriptor Heap");
+
+	DescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	Indices.Reset(capacity - transientCapacity);
+	Transient.Reset(capacity - transientCapacity, transientCapacity);
+}
+
+uint32_t BindlessHeap::RegisterTexture(ID3D12Device* device, ID3D12Resource* texture)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = texture->GetDesc().Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = texture->GetDesc().MipLevels;
+	return RegisterView(device, texture, srvDesc);
+}
+
+uint32_t BindlessHeap::RegisterView(ID3D12Device* device, ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC& viewDesc)
+{
+	uint32_t index = Indices.Allocate();
+	if(index == DescriptorIndexAllocator::InvalidIndex)
+	{
+		std::cout << "bindless heap is full" << std::endl;
+		return index;
+	}
+	device->CreateShaderResourceView(resource, &viewDesc, GetCpuHandle(index));
+	return index;
+}
+
+void BindlessHeap::Release(uint32_t index, uint32_t count)
+{
+	if(!Indices.Free(index, count))
+	{
+		std::cout << "releasing bindless descriptors that were not allocated" << std::endl;
+	}
+}
+
+void BindlessHeap::ReleaseAfterFrame(uint32_t index, uint32_t count)
+{
+	CurrentFrameReleases.push_back({ 0, index, count });
+}
+
+void BindlessHeap::FinishFrame(uint64_t fenceValue)
+{
+	Transient.FinishFrame(fenceValue);
+	ReportedTransientFull = false;
+	for(DeferredRelease& release : CurrentFrameReleases)
+	{
+		release.FenceValue = fenceValue;
+		DeferredReleases.push_back(release);
+	}
+	CurrentFrameReleases.clear();
+}
+
+void BindlessHeap::Reclaim(uint64_t completedFenceValue)
+{
+	Transient.Reclaim(completedFenceValue);
+	while(!DeferredReleases.empty() && DeferredReleases.front().FenceValue <= completedFenceValue)
+	{
+		Release(DeferredReleases.front().Index, DeferredReleases.front().Count);
+		DeferredReleases.pop_front();
+	}
+}
+
+uint32_t BindlessHeap::CopyTransient(D3D12_CPU_DESCRIPTOR_HANDLE source, uint32_t count)
+{
+	uint32_t index = Transient.Allocate(count);
+	if(index == DescriptorRing::InvalidIndex)
+	{
+		if(!ReportedTransientFull)
+			std::cout << "bindless frame ring is full, skipping the draws that need it this frame" << std::endl;
+		ReportedTransientFull = true;
+		return index;
+	}
+	Device->CopyDescriptorsSimple(count, GetCpuHandle(index), source, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	return index;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE BindlessHeap::GetCpuHandle(uint32_t index) const
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle = Heap->GetCPUDescriptorHandleForHeapStart();
+	handle.ptr += SIZE_T(index) * DescriptorSize;
+	return handle;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE BindlessHeap::GetGpuHandle(uint32_t index) const
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE handle = Heap->GetGPUDescriptorHandleForHeapStart();
+	handle.ptr += UINT64(index) * DescriptorSize;
+	return handle;
+}
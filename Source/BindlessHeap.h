@@ -0,0 +1,70 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "DescriptorIndexAllocator.h"
+#include "DescriptorRing.h"
+
+//the one shader visible CBV_SRV_UAV heap every pipeline draws with, so command lists never switch
+//heaps. Textures registered here keep their index and descriptor until released, so frames in
+//flight always read what they were recorded with, and shaders compiled with the BINDLESS define
+//reach them through ResourceDescriptorHeap[index]. The end of the heap is a DescriptorRing that
+//pipelines still using descriptor tables copy their tables into every frame
+class BindlessHeap
+{
+public:
+	BindlessHeap() = default;
+	BindlessHeap(const BindlessHeap&) = delete;
+	BindlessHeap& operator=(const BindlessHeap&) = delete;
+	~BindlessHeap();
+
+	//the last transientCapacity descriptors form the frame ring, the rest is persistent
+	void Initialize(ID3D12Device* device, uint32_t capacity, uint32_t transientCapacity);
+
+	//writes a view of the whole 2d texture, InvalidIndex when the heap is full
+	uint32_t RegisterTexture(ID3D12Device* device, ID3D12Resource* texture);
+	uint32_t RegisterView(ID3D12Device* device, ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC& viewDesc);
+
+	//frees a registered texture. The gpu has to be done with the descriptors
+	void Release(uint32_t index, uint32_t count = 1);
+	//frees the descriptors once the frame being recorded has finished on the gpu, for ones the
+	//frames in flight may still read
+	void ReleaseAfterFrame(uint32_t index, uint32_t count = 1);
+
+	//copies count descriptors from a cpu only heap into the frame ring and returns the first index,
+	//valid until the frame serial changes. InvalidIndex when the frames in flight fill the ring,
+	//which is reported once per frame
+	uint32_t CopyTransient(D3D12_CPU_DESCRIPTOR_HANDLE source, uint32_t count);
+	//call once per frame with the fence value signaled after its command lists
+	void FinishFrame(uint64_t fenceValue);
+	//call before recording a frame with the fence's completed value
+	void Reclaim(uint64_t completedFenceValue);
+	uint64_t GetFrameSerial() const { return Transient.GetFrameSerial(); }
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(uint32_t index) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(uint32_t index) const;
+	uint32_t GetAllocatedCount() const { return Indices.GetAllocatedCount(); }
+	uint32_t GetCapacity() const { return Indices.GetCapacity(); }
+
+	ID3D12DescriptorHeap* Heap = nullptr;
+
+	//when set, pipelines copy their descriptor tables into its frame ring and register bindless textures here
+	inline static BindlessHeap* Active = nullptr;
+
+private:
+	struct DeferredRelease
+	{
+		uint64_t FenceValue;
+		uint32_t Index;
+		uint32_t Count;
+	};
+
+	ID3D12Device* Device = nullptr;
+	DescriptorIndexAllocator Indices;
+	DescriptorRing Transient;
+	bool ReportedTransientFull = false;
+	std::vector<DeferredRelease> CurrentFrameReleases; //fence value is filled in by FinishFrame
+	std::deque<DeferredRelease> DeferredReleases; //oldest first
+	uint32_t DescriptorSize = 0;
+};
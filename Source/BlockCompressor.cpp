@@ -0,0 +1,641 @@
+#include "BlockCompressor.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+	constexpr int RefineIterations = 3;
+	//bc7 4 bit index interpolation weights out of 64
+	constexpr int Bc7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+	//bc1 palette entry positions along c0 -> c1
+	constexpr float Bc1Weights[4] = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+
+	struct Block
+	{
+		float Pixels[16][4];
+	};
+
+	void LoadBlock(const MipLevel& level, uint32_t blockX, uint32_t blockY, Block& block)
+	{
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t x = std::min(blockX * 4 + (i & 3), level.Width - 1);
+			uint32_t y = std::min(blockY * 4 + (i >> 2), level.Height - 1);
+			const uint8_t* p = &level.Pixels[(size_t(y) * level.Width + x) * 4];
+			for(uint32_t c = 0; c < 4; c++)
+			{
+				block.Pixels[i][c] = p[c];
+			}
+		}
+	}
+
+	//mean and dominant direction of the first channelCount channels via power iteration
+	void PrincipalAxis(const Block& block, uint32_t channelCount, float mean[4], float axis[4])
+	{
+		float low[4] = {255.f, 255.f, 255.f, 255.f};
+		float high[4] = {0.f, 0.f, 0.f, 0.f};
+		for(uint32_t c = 0; c < 4; c++)
+		{
+			mean[c] = 0.f;
+			axis[c] = 0.f;
+		}
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			for(uint32_t c = 0; c < channelCount; c++)
+			{
+				mean[c] += block.Pixels[i][c] / 16.f;
+				low[c] = std::min(low[c], block.Pixels[i][c]);
+				high[c] = std::max(high[c], block.Pixels[i][c]);
+			}
+		}
+
+		float covariance[4][4] = {};
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			for(uint32_t a = 0; a < channelCount; a++)
+			{
+				for(uint32_t b = 0; b < channelCount; b++)
+				{
+					covariance[a][b] += (block.Pixels[i][a] - mean[a]) * (block.Pixels[i][b] - mean[b]);
+				}
+			}
+		}
+
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			axis[c] = high[c] - low[c];
+		}
+		for(int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.f;
+			for(uint32_t a = 0; a < channelCount; a++)
+			{
+				for(uint32_t b = 0; b < channelCount; b++)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length = std::max(length, std::abs(next[a]));
+			}
+			if(length == 0.f)
+			{
+				break;
+			}
+			for(uint32_t c = 0; c < channelCount; c++)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+	}
+
+	//endpoints at the extreme projections of the block onto its principal axis
+	void InitialEndpoints(const Block& block, uint32_t channelCount, float e0[4], float e1[4])
+	{
+		float mean[4];
+		float axis[4];
+		PrincipalAxis(block, channelCount, mean, axis);
+
+		float axisLength = 0.f;
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			axisLength += axis[c] * axis[c];
+		}
+		float tMin = 0.f;
+		float tMax = 0.f;
+		if(axisLength > 0.f)
+		{
+			tMin = std::numeric_limits<float>::max();
+			tMax = -tMin;
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				float t = 0.f;
+				for(uint32_t c = 0; c < channelCount; c++)
+				{
+					t += (block.Pixels[i][c] - mean[c]) * axis[c];
+				}
+				tMin = std::min(tMin, t / axisLength);
+				tMax = std::max(tMax, t / axisLength);
+			}
+		}
+		for(uint32_t c = 0; c < 4; c++)
+		{
+			e0[c] = std::min(255.f, std::max(0.f, mean[c] + axis[c] * tMax));
+			e1[c] = std::min(255.f, std::max(0.f, mean[c] + axis[c] * tMin));
+		}
+	}
+
+	//least squares endpoints for fixed indices, weights are the position of each texel along e0 -> e1
+	bool RefineEndpoints(const Block& block, uint32_t channelCount, const float weights[16], float e0[4], float e1[4])
+	{
+		float a = 0.f;
+		float b = 0.f;
+		float c = 0.f;
+		float rhs0[4] = {};
+		float rhs1[4] = {};
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			float w = weights[i];
+			a += (1.f - w) * (1.f - w);
+			b += (1.f - w) * w;
+			c += w * w;
+			for(uint32_t k = 0; k < channelCount; k++)
+			{
+				rhs0[k] += (1.f - w) * block.Pixels[i][k];
+				rhs1[k] += w * block.Pixels[i][k];
+			}
+		}
+		float determinant = a * c - b * b;
+		if(std::abs(determinant) < 1e-6f)
+		{
+			return false;
+		}
+		for(uint32_t k = 0; k < channelCount; k++)
+		{
+			e0[k] = std::min(255.f, std::max(0.f, (c * rhs0[k] - b * rhs1[k]) / determinant));
+			e1[k] = std::min(255.f, std::max(0.f, (a * rhs1[k] - b * rhs0[k]) / determinant));
+		}
+		return true;
+	}
+
+	//picks the nearest palette entry for every texel, returns the summed squared error
+	float SelectIndices(const Block& block, uint32_t channelCount, const float palette[][4], uint32_t paletteSize, uint8_t indices[16])
+	{
+		float total = 0.f;
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			float best = std::numeric_limits<float>::max();
+			for(uint32_t p = 0; p < paletteSize; p++)
+			{
+				float error = 0.f;
+				for(uint32_t c = 0; c < channelCount; c++)
+				{
+					float d = block.Pixels[i][c] - palette[p][c];
+					error += d * d;
+				}
+				if(error < best)
+				{
+					best = error;
+					indices[i] = uint8_t(p);
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	//bit packing helpers, bits are stored lsb first like every bc format
+	void WriteBits(uint8_t* data, uint32_t& offset, uint32_t value, uint32_t count)
+	{
+		for(uint32_t i = 0; i < count; i++, offset++)
+		{
+			data[offset >> 3] |= uint8_t(((value >> i) & 1) << (offset & 7));
+		}
+	}
+
+	uint32_t ReadBits(const uint8_t* data, uint32_t& offset, uint32_t count)
+	{
+		uint32_t value = 0;
+		for(uint32_t i = 0; i < count; i++, offset++)
+		{
+			value |= uint32_t((data[offset >> 3] >> (offset & 7)) & 1) << i;
+		}
+		return value;
+	}
+
+	uint16_t To565(const float color[4])
+	{
+		uint32_t r = uint32_t(color[0] * 31.f / 255.f + 0.5f);
+		uint32_t g = uint32_t(color[1] * 63.f / 255.f + 0.5f);
+		uint32_t b = uint32_t(color[2] * 31.f / 255.f + 0.5f);
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void From565(uint16_t value, float color[4])
+	{
+		uint32_t r = (value >> 11) & 31;
+		uint32_t g = (value >> 5) & 63;
+		uint32_t b = value & 31;
+		color[0] = float((r << 3) | (r >> 2));
+		color[1] = float((g << 2) | (g >> 4));
+		color[2] = float((b << 3) | (b >> 2));
+		color[3] = 255.f;
+	}
+
+	void Bc1Palette(uint16_t c0, uint16_t c1, float palette[4][4])
+	{
+		From565(c0, palette[0]);
+		From565(c1, palette[1]);
+		for(uint32_t c = 0; c < 4; c++)
+		{
+			if(c0 > c1)
+			{
+				palette[2][c] = std::floor((2.f * palette[0][c] + palette[1][c]) / 3.f);
+				palette[3][c] = std::floor((palette[0][c] + 2.f * palette[1][c]) / 3.f);
+			}
+			else
+			{
+				palette[2][c] = std::floor((palette[0][c] + palette[1][c]) / 2.f);
+				palette[3][c] = 0.f;
+			}
+		}
+	}
+
+	void EncodeColorBlock(const Block& block, uint8_t* out)
+	{
+		float e0[4];
+		float e1[4];
+		InitialEndpoints(block, 3, e0, e1);
+
+		uint16_t bestC0 = 0;
+		uint16_t bestC1 = 0;
+		uint8_t bestIndices[16] = {};
+		float bestError = std::numeric_limits<float>::max();
+		for(int iteration = 0; iteration < RefineIterations; iteration++)
+		{
+			uint16_t c0 = To565(e0);
+			uint16_t c1 = To565(e1);
+			//the palette is always evaluated in four color mode, the swap below preserves it
+			float palette[4][4];
+			Bc1Palette(std::max(c0, c1), std::min(c0, c1), palette);
+			if(c0 < c1)
+			{
+				std::swap(palette[0], palette[1]);
+				std::swap(palette[2], palette[3]);
+			}
+
+			uint8_t indices[16];
+			float error = SelectIndices(block, 3, palette, c0 == c1 ? 1 : 4, indices);
+			if(error < bestError)
+			{
+				bestError = error;
+				bestC0 = c0;
+				bestC1 = c1;
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+
+			float weights[16];
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				weights[i] = Bc1Weights[indices[i]];
+			}
+			if(error == 0.f || !RefineEndpoints(block, 3, weights, e0, e1))
+			{
+				break;
+			}
+		}
+
+		//four color mode needs c0 > c1, equal endpoints only ever use index 0
+		if(bestC0 < bestC1)
+		{
+			std::swap(bestC0, bestC1);
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				bestIndices[i] ^= 1;
+			}
+		}
+
+		uint32_t bitOffset = 0;
+		WriteBits(out, bitOffset, bestC0, 16);
+		WriteBits(out, bitOffset, bestC1, 16);
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			WriteBits(out, bitOffset, bestIndices[i], 2);
+		}
+	}
+
+	void AlphaPalette(uint32_t a0, uint32_t a1, float palette[8][4])
+	{
+		palette[0][0] = float(a0);
+		palette[1][0] = float(a1);
+		if(a0 > a1)
+		{
+			for(uint32_t i = 2; i < 8; i++)
+			{
+				palette[i][0] = float(((8 - i) * a0 + (i - 1) * a1) / 7);
+			}
+		}
+		else
+		{
+			for(uint32_t i = 2; i < 6; i++)
+			{
+				palette[i][0] = float(((6 - i) * a0 + (i - 1) * a1) / 5);
+			}
+			palette[6][0] = 0.f;
+			palette[7][0] = 255.f;
+		}
+	}
+
+	void EncodeAlphaBlock(const Block& block, uint8_t* out)
+	{
+		Block alpha;
+		uint32_t a0 = 0;
+		uint32_t a1 = 255;
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			alpha.Pixels[i][0] = block.Pixels[i][3];
+			a0 = std::max(a0, uint32_t(block.Pixels[i][3]));
+			a1 = std::min(a1, uint32_t(block.Pixels[i][3]));
+		}
+
+		uint8_t indices[16] = {};
+		if(a0 > a1)
+		{
+			float palette[8][4];
+			AlphaPalette(a0, a1, palette);
+			SelectIndices(alpha, 1, palette, 8, indices);
+		}
+
+		uint32_t bitOffset = 0;
+		WriteBits(out, bitOffset, a0, 8);
+		WriteBits(out, bitOffset, a1, 8);
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			WriteBits(out, bitOffset, indices[i], 3);
+		}
+	}
+
+	void Mode6Palette(const int e0[4], const int e1[4], float palette[16][4])
+	{
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			for(uint32_t c = 0; c < 4; c++)
+			{
+				palette[i][c] = float(((64 - Bc7Weights4[i]) * e0[c] + Bc7Weights4[i] * e1[c] + 32) >> 6);
+			}
+		}
+	}
+
+	//bc7 mode 6: one subset, 7 bit rgba endpoints with a shared lsb each, 4 bit indices
+	void EncodeBc7Block(const Block& block, uint8_t* out)
+	{
+		float e0[4];
+		float e1[4];
+		InitialEndpoints(block, 4, e0, e1);
+
+		int bestQ[2][4] = {};
+		int bestP[2] = {};
+		uint8_t bestIndices[16] = {};
+		float bestError = std::numeric_limits<float>::max();
+		for(int iteration = 0; iteration < RefineIterations; iteration++)
+		{
+			float iterationError = std::numeric_limits<float>::max();
+			uint8_t iterationIndices[16];
+			for(int p0 = 0; p0 < 2; p0++)
+			{
+				for(int p1 = 0; p1 < 2; p1++)
+				{
+					int q[2][4];
+					int endpoint[2][4];
+					for(uint32_t c = 0; c < 4; c++)
+					{
+						q[0][c] = std::min(127, std::max(0, int(std::lround((e0[c] - p0) / 2.f))));
+						q[1][c] = std::min(127, std::max(0, int(std::lround((e1[c] - p1) / 2.f))));
+						endpoint[0][c] = (q[0][c] << 1) | p0;
+						endpoint[1][c] = (q[1][c] << 1) | p1;
+					}
+
+					float palette[16][4];
+					Mode6Palette(endpoint[0], endpoint[1], palette);
+					uint8_t indices[16];
+					float error = SelectIndices(block, 4, palette, 16, indices);
+					if(error < iterationError)
+					{
+						iterationError = error;
+						memcpy(iterationIndices, indices, sizeof(indices));
+					}
+					if(error < bestError)
+					{
+						bestError = error;
+						memcpy(bestQ, q, sizeof(q));
+						bestP[0] = p0;
+						bestP[1] = p1;
+						memcpy(bestIndices, indices, sizeof(indices));
+					}
+				}
+			}
+
+			float weights[16];
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				weights[i] = Bc7Weights4[iterationIndices[i]] / 64.f;
+			}
+			if(bestError == 0.f || !RefineEndpoints(block, 4, weights, e0, e1))
+			{
+				break;
+			}
+		}
+
+		//the first index is stored without its msb, flip the endpoints so it is zero
+		if(bestIndices[0] & 8)
+		{
+			std::swap(bestQ[0], bestQ[1]);
+			std::swap(bestP[0], bestP[1]);
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				bestIndices[i] = uint8_t(15 - bestIndices[i]);
+			}
+		}
+
+		uint32_t bitOffset = 0;
+		WriteBits(out, bitOffset, 1 << 6, 7);
+		for(uint32_t c = 0; c < 4; c++)
+		{
+			WriteBits(out, bitOffset, bestQ[0][c], 7);
+			WriteBits(out, bitOffset, bestQ[1][c], 7);
+		}
+		WriteBits(out, bitOffset, bestP[0], 1);
+		WriteBits(out, bitOffset, bestP[1], 1);
+		WriteBits(out, bitOffset, bestIndices[0], 3);
+		for(uint32_t i = 1; i < 16; i++)
+		{
+			WriteBits(out, bitOffset, bestIndices[i], 4);
+		}
+	}
+
+	void DecodeBlock(const uint8_t* data, TextureCompression compression, uint8_t pixels[16][4])
+	{
+		uint32_t bitOffset = 0;
+		if(compression == TextureCompression::BC7)
+		{
+			memset(pixels, 0, 64);
+			if((data[0] & 0x7F) != 0x40)
+			{
+				return;
+			}
+			bitOffset = 7;
+			int e[2][4];
+			for(uint32_t c = 0; c < 4; c++)
+			{
+				e[0][c] = int(ReadBits(data, bitOffset, 7)) << 1;
+				e[1][c] = int(ReadBits(data, bitOffset, 7)) << 1;
+			}
+			int p0 = int(ReadBits(data, bitOffset, 1));
+			int p1 = int(ReadBits(data, bitOffset, 1));
+			for(uint32_t c = 0; c < 4; c++)
+			{
+				e[0][c] |= p0;
+				e[1][c] |= p1;
+			}
+			float palette[16][4];
+			Mode6Palette(e[0], e[1], palette);
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t index = ReadBits(data, bitOffset, i == 0 ? 3 : 4);
+				for(uint32_t c = 0; c < 4; c++)
+				{
+					pixels[i][c] = uint8_t(palette[index][c]);
+				}
+			}
+			return;
+		}
+
+		uint8_t alpha[16];
+		std::fill(alpha, alpha + 16, uint8_t(255));
+		if(compression == TextureCompression::BC3)
+		{
+			uint32_t a0 = ReadBits(data, bitOffset, 8);
+			uint32_t a1 = ReadBits(data, bitOffset, 8);
+			float palette[8][4];
+			AlphaPalette(a0, a1, palette);
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				alpha[i] = uint8_t(palette[ReadBits(data, bitOffset, 3)][0]);
+			}
+		}
+
+		uint16_t c0 = uint16_t(ReadBits(data, bitOffset, 16));
+		uint16_t c1 = uint16_t(ReadBits(data, bitOffset, 16));
+		float palette[4][4];
+		Bc1Palette(c0, c1, palette);
+		for(uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t index = ReadBits(data, bitOffset, 2);
+			for(uint32_t c = 0; c < 3; c++)
+			{
+				pixels[i][c] = uint8_t(palette[index][c]);
+			}
+			pixels[i][3] = alpha[i];
+		}
+	}
+}
+
+uint32_t GetBlockBytes(TextureCompression compression)
+{
+	return compression == TextureCompression::BC1 ? 8 : 16;
+}
+
+void CompressLevel(const MipLevel& level, TextureCompression compression, CompressedLevel& out)
+{
+	uint32_t blockBytes = GetBlockBytes(compression);
+	uint32_t blocksX = (level.Width + 3) / 4;
+	out.Width = level.Width;
+	out.Height = level.Height;
+	out.RowPitch = blocksX * blockBytes;
+	out.RowCount = (level.Height + 3) / 4;
+	out.Blocks.assign(size_t(out.RowPitch) * out.RowCount, 0);
+
+	ParallelFor(out.RowCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		Block block;
+		for(uint32_t blockY = begin; blockY < end; blockY++)
+		{
+			uint8_t* row = &out.Blocks[size_t(blockY) * out.RowPitch];
+			for(uint32_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				LoadBlock(level, blockX, blockY, block);
+				uint8_t* data = row + blockX * blockBytes;
+				if(compression == TextureCompression::BC7)
+				{
+					EncodeBc7Block(block, data);
+				}
+				else if(compression == TextureCompression::BC3)
+				{
+					EncodeAlphaBlock(block, data);
+					EncodeColorBlock(block, data + 8);
+				}
+				else
+				{
+					EncodeColorBlock(block, data);
+				}
+			}
+		}
+	});
+}
+
+void DecompressLevel(const CompressedLevel& level, TextureCompression compression, MipLevel& out)
+{
+	uint32_t blockBytes = GetBlockBytes(compression);
+	out.Width = level.Width;
+	out.Height = level.Height;
+	out.Pixels.resize(size_t(level.Width) * level.Height * 4);
+
+	for(uint32_t blockY = 0; blockY < level.RowCount; blockY++)
+	{
+		for(uint32_t blockX = 0; blockX < level.RowPitch / blockBytes; blockX++)
+		{
+			uint8_t pixels[16][4];
+			DecodeBlock(&level.Blocks[size_t(blockY) * level.RowPitch + blockX * blockBytes], compression, pixels);
+			for(uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = blockX * 4 + (i & 3);
+				uint32_t y = blockY * 4 + (i >> 2);
+				if(x < level.Width && y < level.Height)
+				{
+					memcpy(&out.Pixels[(size_t(y) * level.Width + x) * 4], pixels[i], 4);
+				}
+			}
+		}
+	}
+}
+
+double ComputePsnr(const MipLevel& reference, const MipLevel& image, uint32_t channelCount)
+{
+	double squaredError = 0.0;
+	size_t texelCount = size_t(reference.Width) * reference.Height;
+	for(size_t i = 0; i < texelCount; i++)
+	{
+		for(uint32_t c = 0; c < channelCount; c++)
+		{
+			double d = double(reference.Pixels[i * 4 + c]) - double(image.Pixels[i * 4 + c]);
+			squaredError += d * d;
+		}
+	}
+	double meanSquaredError = squaredError / (double(texelCount) * channelCount);
+	if(meanSquaredError == 0.0)
+	{
+		return std::numeric_limits<double>::infinity();
+	}
+	return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+void BenchmarkBlockCompression(const MipLevel& level)
+{
+	const int iterations = 3;
+	const std::pair<TextureCompression, const char*> formats[] = {
+		{TextureCompression::BC1, "BC1"}, {TextureCompression::BC3, "BC3"}, {TextureCompression::BC7, "BC7"}};
+
+	CompressedLevel compressed;
+	MipLevel decoded;
+	for(const auto& format : formats)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for(int i = 0; i < iterations; i++)
+		{
+			CompressLevel(level, format.first, compressed);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		double rate = double(level.Width) * level.Height * iterations / elapsed.count() / 1e6;
+
+		DecompressLevel(compressed, format.first, decoded);
+		uint32_t channelCount = format.first == TextureCompression::BC1 ? 3 : 4;
+		std::cout << "Block compression " << format.second << ": " << level.Width << "x" << level.Height << ", "
+		          << rate << " MPix/s, PSNR " << ComputePsnr(level, decoded, channelCount) << " dB" << std::endl;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "MipGenerator.h"
+
+#include <cstdint>
+#include <vector>
+
+enum class TextureCompression
+{
+	None,
+	BC1, //rgb, 4 bits per texel, fast
+	BC3, //bc1 color plus interpolated alpha, 8 bits per texel, fast
+	BC7, //rgba, 8 bits per texel, slower but much higher quality
+};
+
+struct CompressedLevel
+{
+	uint32_t Width; //in texels
+	uint32_t Height;
+	uint32_t RowPitch; //bytes per row of 4x4 blocks
+	uint32_t RowCount; //rows of blocks
+	std::vector<uint8_t> Blocks;
+};
+
+uint32_t GetBlockBytes(TextureCompression compression);
+
+//encodes an rgba8 level, partial edge blocks repeat the last row/column. Rows of blocks are
+//spread over all cores
+void CompressLevel(const MipLevel& level, TextureCompression compression, CompressedLevel& out);
+
+//decodes blocks written by CompressLevel back to rgba8 (bc7 only understands mode 6)
+void DecompressLevel(const CompressedLevel& level, TextureCompression compression, MipLevel& out);
+
+//peak signal to noise ratio in dB over the first channelCount channels
+double ComputePsnr(const MipLevel& reference, const MipLevel& image, uint32_t channelCount);
+
+//encodes the level with every format and prints MPix/s and PSNR
+void BenchmarkBlockCompression(const MipLevel& level);
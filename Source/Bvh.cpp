@@ -0,0 +1,503 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <xmmintrin.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace
+{
+	constexpr uint32_t BinCount = 16;
+	constexpr uint32_t MaxLeafSize = 8;
+	//subtrees above this many triangles build their left half on another thread
+	constexpr uint32_t ParallelBuildThreshold = 16 * 1024;
+	constexpr float TraversalCost = 1.f;
+	constexpr float IntersectionCost = 1.f;
+	//traversal pops one wide node and pushes at most 4 children, so every level adds at most 3 entries
+	constexpr uint32_t TraversalStackSize = 64;
+	//inner binary nodes stay above this depth, so no wide node is deeper and the traversal stack always fits
+	constexpr uint32_t MaxBuildDepth = (TraversalStackSize - 1) / 3 + 1;
+
+	struct Bounds
+	{
+		glm::vec3 Min = glm::vec3(FLT_MAX);
+		glm::vec3 Max = glm::vec3(-FLT_MAX);
+
+		void Grow(const glm::vec3& point)
+		{
+			Min = glm::min(Min, point);
+			Max = glm::max(Max, point);
+		}
+
+		void Grow(const Bounds& other)
+		{
+			Min = glm::min(Min, other.Min);
+			Max = glm::max(Max, other.Max);
+		}
+
+		float HalfArea() const
+		{
+			glm::vec3 extent = glm::max(Max - Min, glm::vec3(0.f));
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	struct BuildNode
+	{
+		Bounds Box;
+		std::unique_ptr<BuildNode> Children[2];
+		uint32_t First = 0;
+		uint32_t Count = 0; //non zero for leaves
+	};
+
+	struct BuildContext
+	{
+		std::vector<Bounds> TriangleBounds;
+		std::vector<glm::vec3> Centroids;
+		std::vector<uint32_t> Order;
+	};
+
+	std::unique_ptr<BuildNode> BuildRecursive(BuildContext& context, uint32_t first, uint32_t count, uint32_t depth)
+	{
+		auto node = std::make_unique<BuildNode>();
+		Bounds centroidBounds;
+		for(uint32_t i = first; i < first + count; i++)
+		{
+			node->Box.Grow(context.TriangleBounds[context.Order[i]]);
+			centroidBounds.Grow(context.Centroids[context.Order[i]]);
+		}
+
+		auto makeLeaf = [&]()
+		{
+			node->First = first;
+			node->Count = count;
+			return std::move(node);
+		};
+
+		if(count <= 2 || depth >= MaxBuildDepth)
+			return makeLeaf();
+
+		//binned sah over all three axes
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		glm::vec3 extent = centroidBounds.Max - centroidBounds.Min;
+		for(int axis = 0; axis < 3; axis++)
+		{
+			if(extent[axis] <= 0.f)
+				continue;
+
+			Bounds bins[BinCount];
+			uint32_t binCounts[BinCount] = {};
+			float scale = BinCount / extent[axis];
+			for(uint32_t i = first; i < first + count; i++)
+			{
+				uint32_t triangle = context.Order[i];
+				uint32_t bin = std::min(BinCount - 1, static_cast<uint32_t>((context.Centroids[triangle][axis] - centroidBounds.Min[axis]) * scale));
+				bins[bin].Grow(context.TriangleBounds[triangle]);
+				binCounts[bin]++;
+			}
+
+			//sweep from the right to get the area and count of every right side
+			float rightArea[BinCount];
+			uint32_t rightCount[BinCount];
+			Bounds right;
+			uint32_t rightTotal = 0;
+			for(uint32_t bin = BinCount - 1; bin > 0; bin--)
+			{
+				right.Grow(bins[bin]);
+				rightTotal += binCounts[bin];
+				rightArea[bin] = right.HalfArea();
+				rightCount[bin] = rightTotal;
+			}
+
+			Bounds left;
+			uint32_t leftTotal = 0;
+			for(uint32_t split = 1; split < BinCount; split++)
+			{
+				left.Grow(bins[split - 1]);
+				leftTotal += binCounts[split - 1];
+				if(leftTotal == 0 || rightCount[split] == 0)
+					continue;
+
+				float cost = left.HalfArea() * leftTotal + rightArea[split] * rightCount[split];
+				if(cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		float leafCost = IntersectionCost * count;
+		float splitCost = TraversalCost + IntersectionCost * bestCost / node->Box.HalfArea();
+		if(bestAxis < 0 || (splitCost >= leafCost && count <= MaxLeafSize))
+		{
+			if(count <= MaxLeafSize)
+				return makeLeaf();
+
+			//all centroids coincide, fall back to a median split so leaves stay small
+			bestAxis = -1;
+		}
+		//skewed meshes can peel a few triangles off per level, close to the depth limit only median
+		//splits still get the remaining triangles down to small leaves
+		if(static_cast<uint64_t>(count) > static_cast<uint64_t>(MaxLeafSize) << (MaxBuildDepth - depth))
+		{
+			bestAxis = -1;
+		}
+
+		uint32_t middle;
+		if(bestAxis >= 0)
+		{
+			float scale = BinCount / extent[bestAxis];
+			auto it = std::partition(context.Order.begin() + first, context.Order.begin() + first + count, [&](uint32_t triangle)
+			{
+				uint32_t bin = std::min(BinCount - 1, static_cast<uint32_t>((context.Centroids[triangle][bestAxis] - centroidBounds.Min[bestAxis]) * scale));
+				return bin < bestSplit;
+			});
+			middle = static_cast<uint32_t>(it - context.Order.begin());
+		}
+		else
+		{
+			//median along the widest centroid axis, coincident centroids just get halved
+			middle = first + count / 2;
+			int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+			if(extent[axis] > 0.f)
+			{
+				std::nth_element(context.Order.begin() + first, context.Order.begin() + middle, context.Order.begin() + first + count, [&](uint32_t a, uint32_t b)
+				{
+					return context.Centroids[a][axis] < context.Centroids[b][axis];
+				});
+			}
+		}
+
+		uint32_t leftCount = middle - first;
+		if(count >= ParallelBuildThreshold && depth < 8)
+		{
+			auto leftFuture = std::async(std::launch::async, BuildRecursive, std::ref(context), first, leftCount, depth + 1);
+			node->Children[1] = BuildRecursive(context, middle, count - leftCount, depth + 1);
+			node->Children[0] = leftFuture.get();
+		}
+		else
+		{
+			node->Children[0] = BuildRecursive(context, first, leftCount, depth + 1);
+			node->Children[1] = BuildRecursive(context, middle, count - leftCount, depth + 1);
+		}
+		return node;
+	}
+
+	//pulls grandchildren up into the wide node, opening the largest inner child first
+	int32_t Flatten(const BuildNode* node, std::vector<BvhNode4>& nodes, uint32_t depth, uint32_t& outMaxDepth)
+	{
+		outMaxDepth = std::max(outMaxDepth, depth);
+		std::vector<const BuildNode*> children;
+		if(node->Count > 0)
+		{
+			children.push_back(node);
+		}
+		else
+		{
+			children = { node->Children[0].get(), node->Children[1].get() };
+			while(children.size() < 4)
+			{
+				int largest = -1;
+				for(int i = 0; i < static_cast<int>(children.size()); i++)
+				{
+					if(children[i]->Count == 0 && (largest < 0 || children[i]->Box.HalfArea() > children[largest]->Box.HalfArea()))
+						largest = i;
+				}
+				if(largest < 0)
+					break;
+
+				const BuildNode* opened = children[largest];
+				children[largest] = opened->Children[0].get();
+				children.push_back(opened->Children[1].get());
+			}
+		}
+
+		int32_t index = static_cast<int32_t>(nodes.size());
+		nodes.emplace_back();
+		for(int i = 0; i < 4; i++)
+		{
+			BvhNode4& wide = nodes[index];
+			if(i >= static_cast<int>(children.size()))
+			{
+				//empty slots get inverted boxes that no ray can enter
+				wide.MinX[i] = wide.MinY[i] = wide.MinZ[i] = FLT_MAX;
+				wide.MaxX[i] = wide.MaxY[i] = wide.MaxZ[i] = -FLT_MAX;
+				wide.Child[i] = -1;
+				wide.Count[i] = 0;
+				continue;
+			}
+
+			const BuildNode* child = children[i];
+			wide.MinX[i] = child->Box.Min.x;
+			wide.MinY[i] = child->Box.Min.y;
+			wide.MinZ[i] = child->Box.Min.z;
+			wide.MaxX[i] = child->Box.Max.x;
+			wide.MaxY[i] = child->Box.Max.y;
+			wide.MaxZ[i] = child->Box.Max.z;
+			if(child->Count > 0)
+			{
+				wide.Child[i] = static_cast<int32_t>(child->First);
+				wide.Count[i] = child->Count;
+			}
+			else
+			{
+				//the recursion can reallocate the node array, do not hold on to the reference
+				int32_t childIndex = Flatten(child, nodes, depth + 1, outMaxDepth);
+				nodes[index].Child[i] = childIndex;
+				nodes[index].Count[i] = 0;
+			}
+		}
+		return index;
+	}
+
+	bool IntersectTriangle(const Bvh::Triangle& triangle, const Ray& ray, float maxDistance, BvhHit& outHit)
+	{
+		//Moller-Trumbore
+		glm::vec3 p = glm::cross(ray.Direction, triangle.Edge2);
+		float determinant = glm::dot(triangle.Edge1, p);
+		if(std::abs(determinant) < 1e-12f)
+			return false;
+
+		float inverseDeterminant = 1.f / determinant;
+		glm::vec3 t = ray.Origin - triangle.V0;
+		float u = glm::dot(t, p) * inverseDeterminant;
+		if(u < 0.f || u > 1.f)
+			return false;
+
+		glm::vec3 q = glm::cross(t, triangle.Edge1);
+		float v = glm::dot(ray.Direction, q) * inverseDeterminant;
+		if(v < 0.f || u + v > 1.f)
+			return false;
+
+		float distance = glm::dot(triangle.Edge2, q) * inverseDeterminant;
+		if(distance <= 0.f || distance >= maxDistance)
+			return false;
+
+		outHit.Distance = distance;
+		outHit.U = u;
+		outHit.V = v;
+		outHit.Triangle = triangle.Index;
+		return true;
+	}
+}
+
+void Bvh::Build(const Mesh& mesh)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const MeshLod& lod = mesh._lods[0];
+	const uint32_t triangleCount = lod.IndexCount / 3;
+	const uint32_t* indices = &mesh._indices[lod.IndexOffset];
+
+	BuildContext context;
+	context.TriangleBounds.resize(triangleCount);
+	context.Centroids.resize(triangleCount);
+	context.Order.resize(triangleCount);
+	for(uint32_t t = 0; t < triangleCount; t++)
+	{
+		for(int k = 0; k < 3; k++)
+		{
+			context.TriangleBounds[t].Grow(mesh._vertices[indices[t * 3 + k]].position);
+		}
+		context.Centroids[t] = (context.TriangleBounds[t].Min + context.TriangleBounds[t].Max) * 0.5f;
+		context.Order[t] = t;
+	}
+
+	Nodes.clear();
+	Triangles.clear();
+	Depth = 0;
+	if(triangleCount == 0)
+		return;
+
+	std::unique_ptr<BuildNode> root = BuildRecursive(context, 0, triangleCount, 0);
+	Nodes.reserve(triangleCount / 2);
+	Flatten(root.get(), Nodes, 1, Depth);
+	if(3 * (Depth - 1) + 1 > TraversalStackSize)
+	{
+		//the depth limit rules this out, but a tree the stack cannot hold must never be traversed
+		std::cout << "bvh is " << Depth << " levels deep, too deep for the traversal stack" << std::endl;
+		Nodes.clear();
+		Depth = 0;
+		return;
+	}
+
+	//leaves reference triangles in build order
+	Triangles.resize(triangleCount);
+	for(uint32_t i = 0; i < triangleCount; i++)
+	{
+		uint32_t t = context.Order[i];
+		const glm::vec3& a = mesh._vertices[indices[t * 3 + 0]].position;
+		const glm::vec3& b = mesh._vertices[indices[t * 3 + 1]].position;
+		const glm::vec3& c = mesh._vertices[indices[t * 3 + 2]].position;
+		Triangles[i] = { a, b - a, c - a, t };
+	}
+
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	BuildMilliseconds = elapsed.count();
+}
+
+template<bool AnyHit>
+bool Bvh::Traverse(const Ray& ray, BvhHit& outHit) const
+{
+	if(Nodes.empty())
+		return false;
+
+	const __m128 originX = _mm_set1_ps(ray.Origin.x);
+	const __m128 originY = _mm_set1_ps(ray.Origin.y);
+	const __m128 originZ = _mm_set1_ps(ray.Origin.z);
+	const __m128 inverseX = _mm_set1_ps(1.f / ray.Direction.x);
+	const __m128 inverseY = _mm_set1_ps(1.f / ray.Direction.y);
+	const __m128 inverseZ = _mm_set1_ps(1.f / ray.Direction.z);
+
+	float closest = ray.MaxDistance;
+	bool hit = false;
+
+	int32_t stack[TraversalStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while(stackSize > 0)
+	{
+		const BvhNode4& node = Nodes[stack[--stackSize]];
+
+		//slab test against the four child boxes
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinX), originX), inverseX);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxX), originX), inverseX);
+		__m128 tNear = _mm_min_ps(t0, t1);
+		__m128 tFar = _mm_max_ps(t0, t1);
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinY), originY), inverseY);
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxY), originY), inverseY);
+		tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+		tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinZ), originZ), inverseZ);
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxZ), originZ), inverseZ);
+		tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+		tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+		tNear = _mm_max_ps(tNear, _mm_setzero_ps());
+		tFar = _mm_min_ps(tFar, _mm_set1_ps(closest));
+
+		int mask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+		if(!mask)
+			continue;
+
+		alignas(16) float nearDistances[4];
+		_mm_store_ps(nearDistances, tNear);
+
+		//leaves are intersected right away, inner children are pushed far to near
+		int32_t innerChildren[4];
+		float innerDistances[4];
+		int innerCount = 0;
+		for(int i = 0; i < 4; i++)
+		{
+			if(!(mask & (1 << i)) || node.Child[i] < 0)
+				continue;
+
+			if(node.Count[i] == 0)
+			{
+				int slot = innerCount++;
+				while(slot > 0 && innerDistances[slot - 1] < nearDistances[i])
+				{
+					innerChildren[slot] = innerChildren[slot - 1];
+					innerDistances[slot] = innerDistances[slot - 1];
+					slot--;
+				}
+				innerChildren[slot] = node.Child[i];
+				innerDistances[slot] = nearDistances[i];
+				continue;
+			}
+
+			for(uint32_t t = node.Child[i]; t < node.Child[i] + node.Count[i]; t++)
+			{
+				if(IntersectTriangle(Triangles[t], ray, closest, outHit))
+				{
+					if constexpr (AnyHit)
+						return true;
+
+					closest = outHit.Distance;
+					hit = true;
+				}
+			}
+		}
+
+		for(int i = 0; i < innerCount; i++)
+		{
+			stack[stackSize++] = innerChildren[i];
+		}
+	}
+
+	return hit;
+}
+
+bool Bvh::Intersect(const Ray& ray, BvhHit& outHit) const
+{
+	return Traverse<false>(ray, outHit);
+}
+
+bool Bvh::Occluded(const Ray& ray) const
+{
+	BvhHit hit;
+	return Traverse<true>(ray, hit);
+}
+
+void BenchmarkBvh(const Bvh& bvh, const glm::vec3& eye, const glm::vec3& eyeDir, const glm::vec3& up,
+                  float fovY, uint32_t width, uint32_t height)
+{
+	glm::vec3 forward = glm::normalize(eyeDir);
+	glm::vec3 right = glm::normalize(glm::cross(forward, up));
+	glm::vec3 cameraUp = glm::cross(right, forward);
+	float tanHalfFov = std::tan(fovY * 0.5f);
+	float aspect = float(width) / height;
+
+	auto castRows = [&](uint32_t firstRow, uint32_t rowStep, uint32_t& outHits)
+	{
+		BvhHit hit;
+		for(uint32_t y = firstRow; y < height; y += rowStep)
+		{
+			for(uint32_t x = 0; x < width; x++)
+			{
+				float px = ((x + 0.5f) / width * 2.f - 1.f) * tanHalfFov * aspect;
+				float py = (1.f - (y + 0.5f) / height * 2.f) * tanHalfFov;
+				Ray ray;
+				ray.Origin = eye;
+				ray.Direction = glm::normalize(forward + right * px + cameraUp * py);
+				outHits += bvh.Intersect(ray, hit);
+			}
+		}
+	};
+
+	const double rayCount = double(width) * height;
+
+	uint32_t hits = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	castRows(0, 1, hits);
+	std::chrono::duration<double> singleThreaded = std::chrono::high_resolution_clock::now() - start;
+
+	uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> threads(threadCount);
+	std::vector<uint32_t> threadHits(threadCount, 0);
+	start = std::chrono::high_resolution_clock::now();
+	for(uint32_t i = 0; i < threadCount; i++)
+	{
+		threads[i] = std::thread(castRows, i, threadCount, std::ref(threadHits[i]));
+	}
+	for(auto& thread : threads)
+	{
+		thread.join();
+	}
+	std::chrono::duration<double> multiThreaded = std::chrono::high_resolution_clock::now() - start;
+
+	std::cout << "BVH: " << bvh.Triangles.size() << " triangles, " << bvh.Nodes.size() << " nodes, built in " << bvh.BuildMilliseconds << " ms" << std::endl;
+	std::cout << "BVH primary rays: " << width << "x" << height << ", " << 100.0 * hits / rayCount << "% hit, "
+	          << rayCount / singleThreaded.count() * 1e-6 << " Mrays/s on 1 thread, "
+	          << rayCount / multiThreaded.count() * 1e-6 << " Mrays/s on " << threadCount << " threads" << std::endl;
+}
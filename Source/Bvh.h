@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cfloat>
+#include <glm/vec3.hpp>
+#include "Mesh.h"
+
+struct Ray
+{
+	glm::vec3 Origin;
+	glm::vec3 Direction;
+	float MaxDistance = FLT_MAX;
+};
+
+struct BvhHit
+{
+	float Distance;
+	float U, V; //barycentrics of the hit on the triangle
+	uint32_t Triangle; //index of the triangle in the full detail lod of the mesh
+};
+
+//4 wide node, children are stored as separate component arrays so a ray tests all of them at once
+struct alignas(16) BvhNode4
+{
+	float MinX[4], MinY[4], MinZ[4];
+	float MaxX[4], MaxY[4], MaxZ[4];
+	//inner child: node index with a zero count, leaf: first triangle and the triangle count, empty: -1
+	int32_t Child[4];
+	uint32_t Count[4];
+};
+
+//bounding volume hierarchy over the full detail triangles of a mesh for cpu ray queries
+class Bvh
+{
+public:
+	//binned sah build, large subtrees are built on separate threads
+	void Build(const Mesh& mesh);
+
+	//closest hit along the ray
+	bool Intersect(const Ray& ray, BvhHit& outHit) const;
+	//any hit along the ray, for occlusion tests
+	bool Occluded(const Ray& ray) const;
+
+	struct Triangle
+	{
+		glm::vec3 V0;
+		glm::vec3 Edge1;
+		glm::vec3 Edge2;
+		uint32_t Index;
+	};
+
+	std::vector<BvhNode4> Nodes;
+	std::vector<Triangle> Triangles;
+	//wide node levels from the root to the deepest leaf, bounds the traversal stack
+	uint32_t Depth = 0;
+
+	float BuildMilliseconds = 0.f;
+
+private:
+	template<bool AnyHit>
+	bool Traverse(const Ray& ray, BvhHit& outHit) const;
+};
+
+//casts one primary ray per pixel from the camera and prints the single and multi threaded ray throughput
+void BenchmarkBvh(const Bvh& bvh, const glm::vec3& eye, const glm::vec3& eyeDir, const glm::vec3& up,
+                  float fovY, uint32_t width, uint32_t height);
@@ -0,0 +1,174 @@
+#include "CommandRecorder.h"
+
+#include <algorithm>
+
+void CommandRecorder::Reset()
+{
+	PipelineState = nullptr;
+	RootSignature = nullptr;
+	DescriptorHeap = nullptr;
+	ForgetRootArguments();
+	TopologyKnown = false;
+	VertexBufferKnown.clear();
+	VertexBuffers.clear();
+	IndexBufferKnown = false;
+}
+
+bool CommandRecorder::Issue(bool redundant)
+{
+	if(redundant)
+	{
+		Stats.Elided++;
+		return false;
+	}
+	Stats.Issued++;
+	return true;
+}
+
+CommandRecorder::RootArgument& CommandRecorder::GetRootArgument(uint32_t rootIndex)
+{
+	if(rootIndex >= RootArguments.size())
+	{
+		RootArguments.resize(rootIndex + 1);
+	}
+	return RootArguments[rootIndex];
+}
+
+void CommandRecorder::ForgetRootArguments()
+{
+	for(RootArgument& argument : RootArguments)
+	{
+		argument.Type = RootArgumentType::Unknown;
+		argument.KnownConstants = 0;
+	}
+}
+
+void CommandRecorder::SetPipelineState(ID3D12PipelineState* pipelineState)
+{
+	if(Issue(pipelineState == PipelineState))
+	{
+		Sink->SetPipelineState(pipelineState);
+		PipelineState = pipelineState;
+	}
+}
+
+void CommandRecorder::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+{
+	if(Issue(rootSignature == RootSignature))
+	{
+		Sink->SetGraphicsRootSignature(rootSignature);
+		RootSignature = rootSignature;
+		ForgetRootArguments();
+	}
+}
+
+void CommandRecorder::SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+	if(Issue(heap == DescriptorHeap))
+	{
+		Sink->SetDescriptorHeap(heap);
+		DescriptorHeap = heap;
+		//tables point into the old heap
+		for(RootArgument& argument : RootArguments)
+		{
+			if(argument.Type == RootArgumentType::DescriptorTable)
+				argument.Type = RootArgumentType::Unknown;
+		}
+	}
+}
+
+void CommandRecorder::SetGraphicsRootDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+	RootArgument& argument = GetRootArgument(rootIndex);
+	if(Issue(argument.Type == RootArgumentType::DescriptorTable && argument.Value == baseDescriptor.ptr))
+	{
+		Sink->SetGraphicsRootDescriptorTable(rootIndex, baseDescriptor);
+		argument.Type = RootArgumentType::DescriptorTable;
+		argument.Value = baseDescriptor.ptr;
+	}
+}
+
+void CommandRecorder::SetGraphicsRootConstantBufferView(uint32_t rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	RootArgument& argument = GetRootArgument(rootIndex);
+	if(Issue(argument.Type == RootArgumentType::ConstantBufferView && argument.Value == address))
+	{
+		Sink->SetGraphicsRootConstantBufferView(rootIndex, address);
+		argument.Type = RootArgumentType::ConstantBufferView;
+		argument.Value = address;
+	}
+}
+
+void CommandRecorder::SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset)
+{
+	RootArgument& argument = GetRootArgument(rootIndex);
+	if(argument.Type != RootArgumentType::Constants)
+	{
+		argument.Type = RootArgumentType::Constants;
+		argument.KnownConstants = 0;
+	}
+	if(argument.Constants.size() < offset + count)
+	{
+		argument.Constants.resize(offset + count);
+	}
+
+	//a root signature holds at most 64 values, so one bit each is enough
+	uint64_t mask = count >= 64 ? ~0ull : ((1ull << count) - 1) << offset;
+	const uint32_t* values = static_cast<const uint32_t*>(data);
+	bool redundant = (argument.KnownConstants & mask) == mask;
+	for(uint32_t i = 0; redundant && i < count; i++)
+	{
+		redundant = argument.Constants[offset + i] == values[i];
+	}
+	if(Issue(redundant))
+	{
+		Sink->SetGraphicsRoot32BitConstants(rootIndex, count, data, offset);
+		std::copy(values, values + count, argument.Constants.begin() + offset);
+		argument.KnownConstants |= mask;
+	}
+}
+
+void CommandRecorder::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+	if(Issue(TopologyKnown && topology == Topology))
+	{
+		Sink->IASetPrimitiveTopology(topology);
+		Topology = topology;
+		TopologyKnown = true;
+	}
+}
+
+void CommandRecorder::IASetVertexBuffer(uint32_t slot, const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	if(slot >= VertexBuffers.size())
+	{
+		VertexBuffers.resize(slot + 1);
+		VertexBufferKnown.resize(slot + 1, false);
+	}
+	const D3D12_VERTEX_BUFFER_VIEW& bound = VertexBuffers[slot];
+	bool redundant = VertexBufferKnown[slot] && bound.BufferLocation == view.BufferLocation &&
+	                 bound.SizeInBytes == view.SizeInBytes && bound.StrideInBytes == view.StrideInBytes;
+	if(Issue(redundant))
+	{
+		Sink->IASetVertexBuffer(slot, view);
+		VertexBuffers[slot] = view;
+		VertexBufferKnown[slot] = true;
+	}
+}
+
+void CommandRecorder::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	bool redundant = IndexBufferKnown && IndexBuffer.BufferLocation == view.BufferLocation &&
+	                 IndexBuffer.SizeInBytes == view.SizeInBytes && IndexBuffer.Format == view.Format;
+	if(Issue(redundant))
+	{
+		Sink->IASetIndexBuffer(view);
+		IndexBuffer = view;
+		IndexBufferKnown = true;
+	}
+}
+
+void CommandRecorder::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	Sink->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//receives the recorder's calls, the d3d12 implementation forwards them to a graphics command list
+//while tests can just log them
+class CommandListSink
+{
+public:
+	virtual ~CommandListSink() = default;
+
+	virtual void SetPipelineState(ID3D12PipelineState* pipelineState) = 0;
+	virtual void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) = 0;
+	virtual void SetDescriptorHeap(ID3D12DescriptorHeap* heap) = 0;
+	virtual void SetGraphicsRootDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) = 0;
+	virtual void SetGraphicsRootConstantBufferView(uint32_t rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+	virtual void SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset) = 0;
+	virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) = 0;
+	virtual void IASetVertexBuffer(uint32_t slot, const D3D12_VERTEX_BUFFER_VIEW& view) = 0;
+	virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) = 0;
+	virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) = 0;
+};
+
+struct CommandRecorderStats
+{
+	uint32_t Issued = 0; //state calls passed on to the sink
+	uint32_t Elided = 0; //state calls that matched what was already bound
+};
+
+//shadows the pipeline state, root arguments and input assembler bindings of one command list and
+//drops calls that would set what is already bound. Setting a different root signature forgets
+//the root arguments and a different descriptor heap forgets the tables, like d3d12 does. Draws
+//always go through
+class CommandRecorder
+{
+public:
+	explicit CommandRecorder(CommandListSink* sink) : Sink(sink) {}
+
+	//forgets the shadowed state, call after resetting the command list or when state was set on
+	//the list without going through the recorder. Stats keep counting
+	void Reset();
+
+	void SetPipelineState(ID3D12PipelineState* pipelineState);
+	void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature);
+	void SetDescriptorHeap(ID3D12DescriptorHeap* heap);
+	void SetGraphicsRootDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor);
+	void SetGraphicsRootConstantBufferView(uint32_t rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address);
+	//elided only when every value was set before with the same root signature and is unchanged
+	void SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset);
+	void SetGraphicsRoot32BitConstant(uint32_t rootIndex, uint32_t value, uint32_t offset) { SetGraphicsRoot32BitConstants(rootIndex, 1, &value, offset); }
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+	void IASetVertexBuffer(uint32_t slot, const D3D12_VERTEX_BUFFER_VIEW& view);
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view);
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+
+	const CommandRecorderStats& GetStats() const { return Stats; }
+	void ResetStats() { Stats = {}; }
+
+private:
+	enum class RootArgumentType : uint8_t
+	{
+		Unknown,
+		DescriptorTable,
+		ConstantBufferView,
+		Constants,
+	};
+
+	struct RootArgument
+	{
+		RootArgumentType Type = RootArgumentType::Unknown;
+		uint64_t Value = 0; //gpu descriptor handle or virtual address
+		uint64_t KnownConstants = 0; //bit per 32 bit value set since the root signature
+		std::vector<uint32_t> Constants;
+	};
+
+	//counts the call, true when it has to go to the sink
+	bool Issue(bool redundant);
+	RootArgument& GetRootArgument(uint32_t rootIndex);
+	void ForgetRootArguments();
+
+	CommandListSink* Sink;
+	CommandRecorderStats Stats;
+
+	ID3D12PipelineState* PipelineState = nullptr;
+	ID3D12RootSignature* RootSignature = nullptr;
+	ID3D12DescriptorHeap* DescriptorHeap = nullptr;
+	std::vector<RootArgument> RootArguments;
+	bool TopologyKnown = false;
+	D3D12_PRIMITIVE_TOPOLOGY Topology = {};
+	std::vector<bool> VertexBufferKnown;
+	std::vector<D3D12_VERTEX_BUFFER_VIEW> VertexBuffers;
+	bool IndexBufferKnown = false;
+	D3D12_INDEX_BUFFER_VIEW IndexBuffer = {};
+};
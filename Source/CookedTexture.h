@@ -0,0 +1,36 @@
+#pragma once
+
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+
+#include <cstdint>
+
+//.ctex layout: header, one CookedSubresource per mip, then the payload at DataOffset.
+//The payload is byte for byte what GetCopyableFootprints expects in an upload buffer
+//(256 byte row pitch, 512 byte subresource placement) so loading is one memcpy.
+constexpr uint32_t CookedTextureMagic = 0x58455443; //"CTEX"
+constexpr uint32_t CookedTextureVersion = 1;
+
+struct CookedTextureHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t MipLevels;
+	uint32_t Format; //DXGI_FORMAT
+	//settings the payload was cooked with, a mismatch makes the file stale
+	uint32_t MipFilter;
+	uint32_t Compression;
+	uint64_t DataOffset;
+	uint64_t DataSize;
+};
+
+struct CookedSubresource
+{
+	uint64_t Offset; //from the start of the payload
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t RowPitch;
+	uint32_t RowCount;
+};
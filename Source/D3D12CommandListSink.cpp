@@ -0,0 +1,52 @@
+#include "D3D12CommandListSink.h"
+
+void D3D12CommandListSink::SetPipelineState(ID3D12PipelineState* pipelineState)
+{
+	CommandList->SetPipelineState(pipelineState);
+}
+
+void D3D12CommandListSink::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+{
+	CommandList->SetGraphicsRootSignature(rootSignature);
+}
+
+void D3D12CommandListSink::SetDescriptorHeap(ID3D12DescriptorHeap* heap)
+{
+	ID3D12DescriptorHeap* heaps[] = { heap };
+	CommandList->SetDescriptorHeaps(_countof(heaps), heaps);
+}
+
+void D3D12CommandListSink::SetGraphicsRootDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+	CommandList->SetGraphicsRootDescriptorTable(rootIndex, baseDescriptor);
+}
+
+void D3D12CommandListSink::SetGraphicsRootConstantBufferView(uint32_t rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	CommandList->SetGraphicsRootConstantBufferView(rootIndex, address);
+}
+
+void D3D12CommandListSink::SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset)
+{
+	CommandList->SetGraphicsRoot32BitConstants(rootIndex, count, data, offset);
+}
+
+void D3D12CommandListSink::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+	CommandList->IASetPrimitiveTopology(topology);
+}
+
+void D3D12CommandListSink::IASetVertexBuffer(uint32_t slot, const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	CommandList->IASetVertexBuffers(slot, 1, &view);
+}
+
+void D3D12CommandListSink::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	CommandList->IASetIndexBuffer(&view);
+}
+
+void D3D12CommandListSink::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	CommandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
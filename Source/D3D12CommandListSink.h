@@ -0,0 +1,23 @@
+#pragma once
+
+#include "CommandRecorder.h"
+
+//forwards the recorder's calls to a graphics command list
+class D3D12CommandListSink : public CommandListSink
+{
+public:
+	explicit D3D12CommandListSink(ID3D12GraphicsCommandList* commandList) : CommandList(commandList) {}
+
+	void SetPipelineState(ID3D12PipelineState* pipelineState) override;
+	void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) override;
+	void SetDescriptorHeap(ID3D12DescriptorHeap* heap) override;
+	void SetGraphicsRootDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override;
+	void SetGraphicsRootConstantBufferView(uint32_t rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address) override;
+	void SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset) override;
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override;
+	void IASetVertexBuffer(uint32_t slot, const D3D12_VERTEX_BUFFER_VIEW& view) override;
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) override;
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+
+	ID3D12GraphicsCommandList* CommandList;
+};
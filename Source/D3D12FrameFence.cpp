@@ -0,0 +1,42 @@
+#include "D3D12FrameFence.h"
+
+D3D12FrameFence::D3D12FrameFence(ID3D12Device* device, ID3D12CommandQueue* commandQueue)
+	: CommandQueue(commandQueue)
+{
+	ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&Fence)));
+	FenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if(FenceEvent == nullptr)
+	{
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
+}
+
+D3D12FrameFence::~D3D12FrameFence()
+{
+	if(Fence->GetCompletedValue() < FenceValue)
+	{
+		Wait(FenceValue);
+	}
+	CloseHandle(FenceEvent);
+	Fence->Release();
+}
+
+uint64_t D3D12FrameFence::Signal()
+{
+	ThrowIfFailed(CommandQueue->Signal(Fence, ++FenceValue));
+	return FenceValue;
+}
+
+uint64_t D3D12FrameFence::GetCompletedValue()
+{
+	return Fence->GetCompletedValue();
+}
+
+void D3D12FrameFence::Wait(uint64_t fenceValue)
+{
+	if(Fence->GetCompletedValue() < fenceValue)
+	{
+		ThrowIfFailed(Fence->SetEventOnCompletion(fenceValue, FenceEvent));
+		WaitForSingleObject(FenceEvent, INFINITE);
+	}
+}
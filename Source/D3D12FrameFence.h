@@ -0,0 +1,23 @@
+#pragma once
+
+#include "FrameScheduler.h"
+
+//signals a fence on the queue the frames are submitted to
+class D3D12FrameFence : public FrameFence
+{
+public:
+	D3D12FrameFence(ID3D12Device* device, ID3D12CommandQueue* commandQueue);
+	D3D12FrameFence(const D3D12FrameFence&) = delete;
+	D3D12FrameFence& operator=(const D3D12FrameFence&) = delete;
+	~D3D12FrameFence() override;
+
+	uint64_t Signal() override;
+	uint64_t GetCompletedValue() override;
+	void Wait(uint64_t fenceValue) override;
+
+private:
+	ID3D12CommandQueue* CommandQueue;
+	ID3D12Fence* Fence = nullptr;
+	HANDLE FenceEvent;
+	uint64_t FenceValue = 0; //the fence starts at 0, the first frame signals 1
+};
@@ -0,0 +1,148 @@
+#include "D3D12TextureUploadSink.h"
+
+D3D12TextureUploadSink::D3D12TextureUploadSink(ID3D12Device* device, ID3D12CommandQueue* commandQueue)
+	: Device(device), CommandQueue(commandQueue)
+{
+	ThrowIfFailed(Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&Fence)));
+	FenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+}
+
+D3D12TextureUploadSink::~D3D12TextureUploadSink()
+{
+	if(Fence->GetCompletedValue() < FenceValue)
+	{
+		ThrowIfFailed(Fence->SetEventOnCompletion(FenceValue, FenceEvent));
+		WaitForSingleObject(FenceEvent, INFINITE);
+	}
+	CloseHandle(FenceEvent);
+
+	for(auto& allocator : SubmittedAllocators)
+	{
+		allocator.second->Release();
+	}
+	if(RecordingAllocator)
+	{
+		RecordingAllocator->Release();
+	}
+	if(CommandList)
+	{
+		CommandList->Release();
+	}
+	for(auto& texture : Textures)
+	{
+		texture.second->Release();
+	}
+	if(StagingBuffer)
+	{
+		StagingBuffer->Release();
+	}
+	Fence->Release();
+}
+
+uint8_t* D3D12TextureUploadSink::MapStaging(uint64_t size)
+{
+	ThrowIfFailed(Device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&StagingBuffer)));
+	StagingBuffer->SetName(L"Texture Streaming Staging Ring");
+
+	void* data;
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(StagingBuffer->Map(0, &readRange, &data));
+	return static_cast<uint8_t*>(data);
+}
+
+void D3D12TextureUploadSink::CreateTexture(uint32_t textureId, const DecodedTexture& texture)
+{
+	ID3D12Resource* resource;
+	ThrowIfFailed(Device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT(texture.Format), texture.Width, texture.Height, 1, UINT16(texture.Mips.size())),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&resource)));
+	resource->SetName(L"Streamed Texture");
+	Textures[textureId] = resource;
+}
+
+void D3D12TextureUploadSink::BeginRecording()
+{
+	if(RecordingAllocator)
+	{
+		return;
+	}
+
+	//reuse the oldest allocator once the gpu is done with it
+	if(!SubmittedAllocators.empty() && SubmittedAllocators.front().first <= Fence->GetCompletedValue())
+	{
+		RecordingAllocator = SubmittedAllocators.front().second;
+		SubmittedAllocators.pop_front();
+		ThrowIfFailed(RecordingAllocator->Reset());
+	}
+	else
+	{
+		ThrowIfFailed(Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&RecordingAllocator)));
+	}
+
+	if(CommandList)
+	{
+		ThrowIfFailed(CommandList->Reset(RecordingAllocator, nullptr));
+	}
+	else
+	{
+		ThrowIfFailed(Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, RecordingAllocator, nullptr, IID_PPV_ARGS(&CommandList)));
+	}
+}
+
+void D3D12TextureUploadSink::CopyMip(uint32_t textureId, uint32_t mip, const StreamedMip& layout, uint64_t stagingOffset, uint32_t rowPitch)
+{
+	BeginRecording();
+
+	ID3D12Resource* texture = Textures[textureId];
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+	footprint.Offset = stagingOffset;
+	footprint.Footprint.Format = texture->GetDesc().Format;
+	footprint.Footprint.Width = layout.Width;
+	footprint.Footprint.Height = layout.Height;
+	footprint.Footprint.Depth = 1;
+	footprint.Footprint.RowPitch = rowPitch;
+
+	CD3DX12_TEXTURE_COPY_LOCATION destination(texture, mip);
+	CD3DX12_TEXTURE_COPY_LOCATION source(StagingBuffer, footprint);
+	CommandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+	CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE, mip));
+}
+
+uint64_t D3D12TextureUploadSink::Submit()
+{
+	if(RecordingAllocator)
+	{
+		ThrowIfFailed(CommandList->Close());
+		ID3D12CommandList* ppCommandLists[] = {CommandList};
+		CommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	}
+
+	ThrowIfFailed(CommandQueue->Signal(Fence, ++FenceValue));
+	if(RecordingAllocator)
+	{
+		SubmittedAllocators.push_back({FenceValue, RecordingAllocator});
+		RecordingAllocator = nullptr;
+	}
+	return FenceValue;
+}
+
+uint64_t D3D12TextureUploadSink::GetCompletedFenceValue()
+{
+	return Fence->GetCompletedValue();
+}
+
+ID3D12Resource* D3D12TextureUploadSink::GetResource(uint32_t textureId) const
+{
+	auto texture = Textures.find(textureId);
+	return texture == Textures.end() ? nullptr : texture->second;
+}
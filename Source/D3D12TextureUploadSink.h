@@ -0,0 +1,39 @@
+#pragma once
+
+#include "TextureStreamer.h"
+
+#include <map>
+
+//records streamed mip copies on the direct queue, every copied mip is moved to the shader
+//resource state on its own so sampling the resident mips never waits on the rest
+class D3D12TextureUploadSink : public TextureUploadSink
+{
+public:
+	D3D12TextureUploadSink(ID3D12Device* device, ID3D12CommandQueue* commandQueue);
+	//waits for outstanding copies before releasing the staging buffer and textures
+	~D3D12TextureUploadSink() override;
+
+	uint8_t* MapStaging(uint64_t size) override;
+	void CreateTexture(uint32_t textureId, const DecodedTexture& texture) override;
+	void CopyMip(uint32_t textureId, uint32_t mip, const StreamedMip& layout, uint64_t stagingOffset, uint32_t rowPitch) override;
+	uint64_t Submit() override;
+	uint64_t GetCompletedFenceValue() override;
+
+	ID3D12Resource* GetResource(uint32_t textureId) const;
+
+private:
+	void BeginRecording();
+
+	ID3D12Device* Device;
+	ID3D12CommandQueue* CommandQueue;
+	ID3D12Resource* StagingBuffer = nullptr;
+	ID3D12Fence* Fence;
+	HANDLE FenceEvent;
+	uint64_t FenceValue = 0;
+
+	ID3D12GraphicsCommandList* CommandList = nullptr;
+	ID3D12CommandAllocator* RecordingAllocator = nullptr;
+	std::deque<std::pair<uint64_t, ID3D12CommandAllocator*>> SubmittedAllocators;
+
+	std::map<uint32_t, ID3D12Resource*> Textures;
+};
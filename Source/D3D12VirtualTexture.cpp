@@ -0,0 +1,282 @@
+#include "D3D12VirtualTexture.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+D3D12VirtualTexture::~D3D12VirtualTexture()
+{
+	ID3D12Resource* resources[] = {PageTable, PhysicalPages, UploadBuffer, FeedbackTarget, FeedbackDepth};
+	for(ID3D12Resource* resource : resources)
+	{
+		if(resource)
+		{
+			resource->Release();
+		}
+	}
+	for(ID3D12Resource* readback : FeedbackReadbacks)
+	{
+		readback->Release();
+	}
+	if(FeedbackRtvHeap)
+	{
+		FeedbackRtvHeap->Release();
+	}
+	if(FeedbackDsvHeap)
+	{
+		FeedbackDsvHeap->Release();
+	}
+}
+
+bool D3D12VirtualTexture::Initialize(ID3D12Device* device, LPCWSTR pageFilename, uint32_t screenWidth, uint32_t feedbackWidth, uint32_t feedbackHeight,
+                                     uint32_t framesInFlight, uint32_t physicalPagesX, uint32_t physicalPagesY, uint32_t maxUploadsPerFrame)
+{
+	if(!PageFile.Open(pageFilename) || PageFile.Size < sizeof(VirtualTextureFileHeader))
+	{
+		PageFile.Close();
+		std::wcout << L"Virtual texture page file not found " << pageFilename << std::endl;
+		return false;
+	}
+
+	VirtualTextureFileHeader header;
+	memcpy(&header, PageFile.Data, sizeof(header));
+	VirtualTextureLayout layout = VirtualTextureLayout::Create(header.Width, header.Height, header.PageSize, header.Border);
+	if(header.Magic != VirtualTextureMagic || header.Version != VirtualTextureVersion || !layout.IsValid() ||
+	   PageFile.Size < sizeof(header) + uint64_t(layout.GetPageCount()) * layout.GetPageBytes())
+	{
+		//unmapped so the caller can cook the file again
+		PageFile.Close();
+		std::wcout << L"Virtual texture page file is stale " << pageFilename << std::endl;
+		return false;
+	}
+
+	Cache = std::make_unique<VirtualTexture>(layout, physicalPagesX, physicalPagesY, maxUploadsPerFrame);
+
+	uint32_t physicalPageSize = layout.GetPhysicalPageSize();
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, physicalPagesX * physicalPageSize, physicalPagesY * physicalPageSize, 1, 1),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&PhysicalPages)));
+	PhysicalPages->SetName(L"Virtual Texture Physical Pages");
+
+	D3D12_RESOURCE_DESC pageTableDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_UINT, layout.PagesX, layout.PagesY, 1, UINT16(layout.MipCount));
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&pageTableDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&PageTable)));
+	PageTable->SetName(L"Virtual Texture Page Table");
+
+	//one slot per page the cache may upload in a frame followed by the whole page table, repeated
+	//for every frame in flight. A frame slot is only rewritten once the frame that used it finished
+	PageUploadRowPitch = (physicalPageSize * 4 + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+	PageUploadSize = (uint64_t(PageUploadRowPitch) * physicalPageSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~uint64_t(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+	PageTableUploadOffset = PageUploadSize * maxUploadsPerFrame;
+	PageTableFootprints.resize(layout.MipCount);
+	UINT64 pageTableUploadSize;
+	device->GetCopyableFootprints(&pageTableDesc, 0, layout.MipCount, PageTableUploadOffset, PageTableFootprints.data(), nullptr, nullptr, &pageTableUploadSize);
+	UploadFrameSize = (PageTableUploadOffset + pageTableUploadSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~uint64_t(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(UploadFrameSize * framesInFlight),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&UploadBuffer)));
+	UploadBuffer->SetName(L"Virtual Texture Upload Buffer");
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(UploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&UploadData)));
+
+	//feedback target, cleared to 0 which is never a valid request
+	D3D12_CLEAR_VALUE feedbackClear = {};
+	feedbackClear.Format = DXGI_FORMAT_R32_UINT;
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_UINT, feedbackWidth, feedbackHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET),
+		D3D12_RESOURCE_STATE_COPY_SOURCE,
+		&feedbackClear,
+		IID_PPV_ARGS(&FeedbackTarget)));
+	FeedbackTarget->SetName(L"Virtual Texture Feedback");
+
+	D3D12_CLEAR_VALUE depthClear = {};
+	depthClear.Format = DXGI_FORMAT_D32_FLOAT;
+	depthClear.DepthStencil.Depth = 1.0f;
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, feedbackWidth, feedbackHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL),
+		D3D12_RESOURCE_STATE_DEPTH_WRITE,
+		&depthClear,
+		IID_PPV_ARGS(&FeedbackDepth)));
+	FeedbackDepth->SetName(L"Virtual Texture Feedback Depth");
+
+	D3D12_RESOURCE_DESC feedbackDesc = FeedbackTarget->GetDesc();
+	UINT64 readbackSize;
+	device->GetCopyableFootprints(&feedbackDesc, 0, 1, 0, &FeedbackFootprint, nullptr, nullptr, &readbackSize);
+	FeedbackReadbacks.resize(framesInFlight);
+	for(ID3D12Resource*& readback : FeedbackReadbacks)
+	{
+		ThrowIfFailed(device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(readbackSize),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&readback)));
+		readback->SetName(L"Virtual Texture Feedback Readback");
+	}
+	FeedbackPending.assign(framesInFlight, false);
+	FeedbackEntries.resize(size_t(feedbackWidth) * feedbackHeight);
+
+	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+	rtvHeapDesc.NumDescriptors = 1;
+	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+	ThrowIfFailed(device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&FeedbackRtvHeap)));
+	device->CreateRenderTargetView(FeedbackTarget, nullptr, FeedbackRtvHeap->GetCPUDescriptorHandleForHeapStart());
+
+	D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
+	dsvHeapDesc.NumDescriptors = 1;
+	dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+	ThrowIfFailed(device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&FeedbackDsvHeap)));
+	device->CreateDepthStencilView(FeedbackDepth, nullptr, FeedbackDsvHeap->GetCPUDescriptorHandleForHeapStart());
+
+	FeedbackViewport = {0.0f, 0.0f, float(feedbackWidth), float(feedbackHeight), 0.0f, 1.0f};
+	FeedbackScissor = {0, 0, LONG(feedbackWidth), LONG(feedbackHeight)};
+
+	VirtualTextureConstants& constants = Constants;
+	constants.VirtualSize[0] = float(layout.Width);
+	constants.VirtualSize[1] = float(layout.Height);
+	constants.PageCount[0] = float(layout.PagesX);
+	constants.PageCount[1] = float(layout.PagesY);
+	constants.AtlasSize[0] = float(physicalPagesX * physicalPageSize);
+	constants.AtlasSize[1] = float(physicalPagesY * physicalPageSize);
+	constants.PageSize = float(layout.PageSize);
+	constants.PageBorder = float(layout.Border);
+	constants.MaxMip = float(layout.MipCount - 1);
+	constants.FeedbackMipBias = -std::log2(float(screenWidth) / float(feedbackWidth));
+	return true;
+}
+
+void D3D12VirtualTexture::Update(ID3D12GraphicsCommandList* commandList, uint32_t frameSlot)
+{
+	const VirtualTextureLayout& layout = Cache->GetLayout();
+	const std::vector<PageLoad>* loads = nullptr;
+	ID3D12Resource* feedbackReadback = FeedbackReadbacks[frameSlot];
+	if(FeedbackPending[frameSlot])
+	{
+		uint8_t* mapped;
+		CD3DX12_RANGE readRange(0, FeedbackFootprint.Footprint.RowPitch * FeedbackFootprint.Footprint.Height);
+		ThrowIfFailed(feedbackReadback->Map(0, &readRange, reinterpret_cast<void**>(&mapped)));
+		uint32_t feedbackWidth = FeedbackFootprint.Footprint.Width;
+		for(uint32_t y = 0; y < FeedbackFootprint.Footprint.Height; y++)
+		{
+			memcpy(&FeedbackEntries[size_t(y) * feedbackWidth], mapped + size_t(y) * FeedbackFootprint.Footprint.RowPitch, feedbackWidth * 4);
+		}
+		CD3DX12_RANGE writeRange(0, 0);
+		feedbackReadback->Unmap(0, &writeRange);
+		FeedbackPending[frameSlot] = false;
+
+		loads = &Cache->ProcessFeedback(FeedbackEntries.data(), FeedbackEntries.size());
+	}
+
+	bool hasLoads = loads && !loads->empty();
+	bool copyPageTable = Cache->IsPageTableDirty();
+	if(!hasLoads && !copyPageTable && !InCopyState)
+	{
+		return;
+	}
+
+	D3D12_RESOURCE_BARRIER toCopy[] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(PhysicalPages, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+		CD3DX12_RESOURCE_BARRIER::Transition(PageTable, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+	};
+	if(!InCopyState)
+	{
+		commandList->ResourceBarrier(_countof(toCopy), toCopy);
+	}
+
+	uint64_t uploadBase = UploadFrameSize * frameSlot;
+	uint32_t physicalPageSize = layout.GetPhysicalPageSize();
+	for(size_t i = 0; hasLoads && i < loads->size(); i++)
+	{
+		const PageLoad& load = (*loads)[i];
+		const uint8_t* page = PageFile.Data + sizeof(VirtualTextureFileHeader) + uint64_t(layout.GetPageIndex(load.Page)) * layout.GetPageBytes();
+		uint8_t* upload = UploadData + uploadBase + PageUploadSize * i;
+		for(uint32_t y = 0; y < physicalPageSize; y++)
+		{
+			memcpy(upload + size_t(y) * PageUploadRowPitch, page + size_t(y) * physicalPageSize * 4, physicalPageSize * 4);
+		}
+
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+		footprint.Offset = uploadBase + PageUploadSize * i;
+		footprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		footprint.Footprint.Width = physicalPageSize;
+		footprint.Footprint.Height = physicalPageSize;
+		footprint.Footprint.Depth = 1;
+		footprint.Footprint.RowPitch = PageUploadRowPitch;
+
+		uint32_t slotX = load.Slot % Cache->GetPhysicalPagesX();
+		uint32_t slotY = load.Slot / Cache->GetPhysicalPagesX();
+		CD3DX12_TEXTURE_COPY_LOCATION destination(PhysicalPages, 0);
+		CD3DX12_TEXTURE_COPY_LOCATION source(UploadBuffer, footprint);
+		commandList->CopyTextureRegion(&destination, slotX * physicalPageSize, slotY * physicalPageSize, 0, &source, nullptr);
+	}
+
+	if(copyPageTable)
+	{
+		for(uint32_t mip = 0; mip < layout.MipCount; mip++)
+		{
+			const std::vector<uint32_t>& table = Cache->GetPageTable(mip);
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = PageTableFootprints[mip];
+			footprint.Offset += uploadBase;
+			uint32_t pagesWide = layout.GetPagesWide(mip);
+			for(uint32_t y = 0; y < layout.GetPagesHigh(mip); y++)
+			{
+				memcpy(UploadData + footprint.Offset + size_t(y) * footprint.Footprint.RowPitch, &table[size_t(y) * pagesWide], pagesWide * 4);
+			}
+
+			CD3DX12_TEXTURE_COPY_LOCATION destination(PageTable, mip);
+			CD3DX12_TEXTURE_COPY_LOCATION source(UploadBuffer, footprint);
+			commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+		}
+		Cache->ClearPageTableDirty();
+	}
+
+	D3D12_RESOURCE_BARRIER toShader[] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(PhysicalPages, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(PageTable, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
+	};
+	commandList->ResourceBarrier(_countof(toShader), toShader);
+	InCopyState = false;
+}
+
+void D3D12VirtualTexture::BeginFeedback(ID3D12GraphicsCommandList* commandList)
+{
+	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(FeedbackTarget, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET));
+
+	D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = FeedbackRtvHeap->GetCPUDescriptorHandleForHeapStart();
+	D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = FeedbackDsvHeap->GetCPUDescriptorHandleForHeapStart();
+	const float clearColor[] = {0.0f, 0.0f, 0.0f, 0.0f};
+	commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+	commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+	commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+	commandList->RSSetViewports(1, &FeedbackViewport);
+	commandList->RSSetScissorRects(1, &FeedbackScissor);
+}
+
+void D3D12VirtualTexture::EndFeedback(ID3D12GraphicsCommandList* commandList, uint32_t frameSlot)
+{
+	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(FeedbackTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+	CD3DX12_TEXTURE_COPY_LOCATION destination(FeedbackReadbacks[frameSlot], FeedbackFootprint);
+	CD3DX12_TEXTURE_COPY_LOCATION source(FeedbackTarget, 0);
+	commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+	FeedbackPending[frameSlot] = true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "VirtualTexture.h"
+
+#include <memory>
+
+//matches the virtualTexture cbuffer in triangle.px.hlsl and vt_feedback.px.hlsl
+struct VirtualTextureConstants
+{
+	float VirtualSize[2];
+	float PageCount[2];
+	float AtlasSize[2];
+	float PageSize;
+	float PageBorder;
+	float MaxMip;
+	float FeedbackMipBias;
+};
+
+//gpu side of a virtual texture. Pages are read from a memory mapped page file into a physical
+//atlas, the page table is an R32_UINT texture with one mip per virtual mip and the feedback
+//pass renders page requests into a small R32_UINT target. Upload space and feedback readbacks
+//exist once per frame in flight, the feedback is read back when its frame slot comes around again
+class D3D12VirtualTexture
+{
+public:
+	D3D12VirtualTexture() = default;
+	D3D12VirtualTexture(const D3D12VirtualTexture&) = delete;
+	D3D12VirtualTexture& operator=(const D3D12VirtualTexture&) = delete;
+	~D3D12VirtualTexture();
+
+	//returns false when the page file is missing or was written with a different version, the
+	//file is not kept open in that case. screenWidth only sets the mip bias of the smaller
+	//feedback target
+	bool Initialize(ID3D12Device* device, LPCWSTR pageFilename, uint32_t screenWidth, uint32_t feedbackWidth, uint32_t feedbackHeight,
+	                uint32_t framesInFlight, uint32_t physicalPagesX = 16, uint32_t physicalPagesY = 16, uint32_t maxUploadsPerFrame = 16);
+
+	//frameSlot is below framesInFlight and the frame that last used it has to be finished on the
+	//gpu. Processes the feedback that frame rendered and records the copies of the requested pages
+	//and of the changed page table into commandList
+	void Update(ID3D12GraphicsCommandList* commandList, uint32_t frameSlot);
+	//binds and clears the feedback target together with its own depth buffer and viewport
+	void BeginFeedback(ID3D12GraphicsCommandList* commandList);
+	//records the copy of the feedback target into the frame slot's readback buffer
+	void EndFeedback(ID3D12GraphicsCommandList* commandList, uint32_t frameSlot);
+
+	void ReportStats() const { Cache->ReportStats(); }
+
+	ID3D12Resource* PageTable = nullptr;
+	ID3D12Resource* PhysicalPages = nullptr;
+	VirtualTextureConstants Constants; //small enough to be set as root constants
+
+private:
+	MappedFile PageFile;
+	std::unique_ptr<VirtualTexture> Cache;
+
+	ID3D12Resource* UploadBuffer = nullptr;
+	uint8_t* UploadData = nullptr;
+	uint32_t PageUploadRowPitch = 0;
+	uint64_t PageUploadSize = 0;
+	uint64_t PageTableUploadOffset = 0;
+	uint64_t UploadFrameSize = 0; //stride of the frame slots in the upload buffer
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> PageTableFootprints; //offsets within a frame slot
+	bool InCopyState = true; //both textures are created as copy destinations
+
+	ID3D12Resource* FeedbackTarget = nullptr;
+	ID3D12Resource* FeedbackDepth = nullptr;
+	std::vector<ID3D12Resource*> FeedbackReadbacks;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT FeedbackFootprint = {};
+	ID3D12DescriptorHeap* FeedbackRtvHeap = nullptr;
+	ID3D12DescriptorHeap* FeedbackDsvHeap = nullptr;
+	D3D12_VIEWPORT FeedbackViewport = {};
+	D3D12_RECT FeedbackScissor = {};
+	std::vector<bool> FeedbackPending;
+	std::vector<uint32_t> FeedbackEntries;
+};
@@ -0,0 +1,39 @@
+#include "DeferredReleaseQueue.h"
+
+DeferredReleaseQueue::~DeferredReleaseQueue()
+{
+	if(Active == this)
+		Active = nullptr;
+	for(DeferredRelease& release : DeferredReleases)
+	{
+		release.Object->Release();
+	}
+	for(IUnknown* object : CurrentFrameReleases)
+	{
+		object->Release();
+	}
+}
+
+void DeferredReleaseQueue::ReleaseAfterFrame(IUnknown* object)
+{
+	if(object)
+		CurrentFrameReleases.push_back(object);
+}
+
+void DeferredReleaseQueue::FinishFrame(uint64_t fenceValue)
+{
+	for(IUnknown* object : CurrentFrameReleases)
+	{
+		DeferredReleases.push_back({ fenceValue, object });
+	}
+	CurrentFrameReleases.clear();
+}
+
+void DeferredReleaseQueue::Reclaim(uint64_t completedFenceValue)
+{
+	while(!DeferredReleases.empty() && DeferredReleases.front().FenceValue <= completedFenceValue)
+	{
+		DeferredReleases.front().Object->Release();
+		DeferredReleases.pop_front();
+	}
+}
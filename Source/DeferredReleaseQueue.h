@@ -0,0 +1,38 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+//holds d3d objects the frames in flight may still use until the fence of the frame that replaced
+//them completed, the way BindlessHeap holds back released descriptors
+class DeferredReleaseQueue
+{
+public:
+	DeferredReleaseQueue() = default;
+	DeferredReleaseQueue(const DeferredReleaseQueue&) = delete;
+	DeferredReleaseQueue& operator=(const DeferredReleaseQueue&) = delete;
+	//releases what is still queued, the gpu has to be idle by then
+	~DeferredReleaseQueue();
+
+	//takes over the caller's reference and drops it once the frame being recorded has finished on the gpu
+	void ReleaseAfterFrame(IUnknown* object);
+
+	//call once per frame with the fence value signaled after its command lists
+	void FinishFrame(uint64_t fenceValue);
+	//call before recording a frame with the fence's completed value
+	void Reclaim(uint64_t completedFenceValue);
+	size_t GetPendingCount() const { return CurrentFrameReleases.size() + DeferredReleases.size(); }
+
+	//when set, Pipeline::Rebuild queues the objects it replaced here instead of releasing them right away
+	inline static DeferredReleaseQueue* Active = nullptr;
+
+private:
+	struct DeferredRelease
+	{
+		uint64_t FenceValue;
+		IUnknown* Object;
+	};
+
+	std::vector<IUnknown*> CurrentFrameReleases; //tagged with a fence value by FinishFrame
+	std::deque<DeferredRelease> DeferredReleases; //oldest first
+};
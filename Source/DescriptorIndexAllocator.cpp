@@ -0,0 +1,73 @@
+#include "DescriptorIndexAllocator.h"
+
+#include <iterator>
+
+void DescriptorIndexAllocator::Reset(uint32_t capacity)
+{
+	Capacity = capacity;
+	AllocatedCount = 0;
+	FreeRanges.clear();
+	AllocatedRanges.clear();
+	if(capacity > 0)
+	{
+		FreeRanges[0] = capacity;
+	}
+}
+
+uint32_t DescriptorIndexAllocator::Allocate(uint32_t count)
+{
+	if(count == 0)
+	{
+		return InvalidIndex;
+	}
+
+	for(auto range = FreeRanges.begin(); range != FreeRanges.end(); ++range)
+	{
+		if(range->second < count)
+		{
+			continue;
+		}
+
+		uint32_t index = range->first;
+		uint32_t remaining = range->second - count;
+		FreeRanges.erase(range);
+		if(remaining > 0)
+		{
+			FreeRanges[index + count] = remaining;
+		}
+		AllocatedRanges[index] = count;
+		AllocatedCount += count;
+		return index;
+	}
+	return InvalidIndex;
+}
+
+bool DescriptorIndexAllocator::Free(uint32_t index, uint32_t count)
+{
+	auto allocated = AllocatedRanges.find(index);
+	if(allocated == AllocatedRanges.end() || allocated->second != count)
+	{
+		return false;
+	}
+	AllocatedRanges.erase(allocated);
+	AllocatedCount -= count;
+
+	//merge with the free run after it and the one before it
+	auto next = FreeRanges.lower_bound(index);
+	if(next != FreeRanges.end() && next->first == index + count)
+	{
+		count += next->second;
+		next = FreeRanges.erase(next);
+	}
+	if(next != FreeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if(previous->first + previous->second == index)
+		{
+			previous->second += count;
+			return true;
+		}
+	}
+	FreeRanges.emplace_hint(next, index, count);
+	return true;
+}
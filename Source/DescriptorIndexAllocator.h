@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+//hands out runs of indices into a descriptor heap of fixed capacity. Freed runs are merged with
+//their free neighbours, so tables of different sizes can come and go without fragmenting the
+//heap for good. Knows nothing about d3d, the heap owning the descriptors sits on top of it
+class DescriptorIndexAllocator
+{
+public:
+	static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+	explicit DescriptorIndexAllocator(uint32_t capacity = 0) { Reset(capacity); }
+
+	//forgets every allocation
+	void Reset(uint32_t capacity);
+
+	//first index of count consecutive free indices, the lowest such run is used. InvalidIndex when
+	//count is 0 or no run is long enough
+	uint32_t Allocate(uint32_t count = 1);
+	//returns false and changes nothing unless index and count are exactly a run returned by Allocate
+	bool Free(uint32_t index, uint32_t count = 1);
+
+	uint32_t GetCapacity() const { return Capacity; }
+	uint32_t GetAllocatedCount() const { return AllocatedCount; }
+	uint32_t GetFreeRangeCount() const { return static_cast<uint32_t>(FreeRanges.size()); }
+
+private:
+	uint32_t Capacity = 0;
+	uint32_t AllocatedCount = 0;
+	std::map<uint32_t, uint32_t> FreeRanges; //first index -> count, two free runs never touch
+	std::map<uint32_t, uint32_t> AllocatedRanges; //first index -> count, lets Free reject bad runs
+};
@@ -0,0 +1,129 @@
+#include "DescriptorRing.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "DescriptorIndexAllocator.h"
+
+void DescriptorRing::Reset(uint32_t base, uint32_t capacity)
+{
+	Base = base;
+	Capacity = capacity;
+	Head = 0;
+	UsedCount = 0;
+	CurrentFrameCount = 0;
+	Frames.clear();
+}
+
+uint32_t DescriptorRing::Allocate(uint32_t count)
+{
+	if(count == 0 || UsedCount + count > Capacity)
+	{
+		return InvalidIndex;
+	}
+
+	if(Head + count > Capacity)
+	{
+		//the free run from Head to the end is too short, give it to this frame and start over at 0
+		uint32_t skipped = Capacity - Head;
+		if(UsedCount + skipped + count > Capacity)
+		{
+			return InvalidIndex;
+		}
+		UsedCount += skipped;
+		CurrentFrameCount += skipped;
+		Head = 0;
+	}
+
+	uint32_t index = Head;
+	Head = Head + count == Capacity ? 0 : Head + count;
+	UsedCount += count;
+	CurrentFrameCount += count;
+	return Base + index;
+}
+
+void DescriptorRing::FinishFrame(uint64_t fenceValue)
+{
+	if(CurrentFrameCount > 0)
+	{
+		Frames.push_back({ fenceValue, CurrentFrameCount });
+	}
+	CurrentFrameCount = 0;
+	FrameSerial++;
+}
+
+void DescriptorRing::Reclaim(uint64_t completedFenceValue)
+{
+	while(!Frames.empty() && Frames.front().FenceValue <= completedFenceValue)
+	{
+		UsedCount -= Frames.front().Count;
+		Frames.pop_front();
+	}
+	if(UsedCount == 0)
+	{
+		Head = 0;
+	}
+}
+
+void BenchmarkDescriptorAllocators()
+{
+	const uint32_t frames = 10000;
+	const uint32_t allocationsPerFrame = 64;
+	const uint32_t framesInFlight = 3;
+
+	//every frame copies a few tables of 1 to 4 descriptors, the gpu finishes frames framesInFlight late
+	DescriptorRing ring(0, 4096);
+	uint32_t failedRing = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for(uint32_t frame = 1; frame <= frames; frame++)
+	{
+		if(frame > framesInFlight)
+		{
+			ring.Reclaim(frame - framesInFlight);
+		}
+		for(uint32_t i = 0; i < allocationsPerFrame; i++)
+		{
+			failedRing += ring.Allocate(1 + (i & 3)) == DescriptorRing::InvalidIndex;
+		}
+		ring.FinishFrame(frame);
+	}
+	std::chrono::duration<double, std::nano> ringTime = std::chrono::high_resolution_clock::now() - start;
+
+	//persistent textures come and go, freed ones only after their frame completed
+	DescriptorIndexAllocator pool(4096);
+	std::vector<std::vector<uint32_t>> pendingFrees(framesInFlight + 1);
+	std::vector<uint32_t> live;
+	uint32_t failedPool = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for(uint32_t frame = 1; frame <= frames; frame++)
+	{
+		std::vector<uint32_t>& completed = pendingFrees[frame % pendingFrees.size()];
+		for(uint32_t index : completed)
+		{
+			pool.Free(index);
+		}
+		completed.clear();
+		for(uint32_t i = 0; i < allocationsPerFrame; i++)
+		{
+			uint32_t index = pool.Allocate();
+			if(index == DescriptorIndexAllocator::InvalidIndex)
+			{
+				failedPool++;
+				continue;
+			}
+			live.push_back(index);
+		}
+		//release the older half of what is alive, it becomes reusable framesInFlight frames later
+		size_t releaseCount = live.size() / 2;
+		completed.insert(completed.end(), live.begin(), live.begin() + releaseCount);
+		live.erase(live.begin(), live.begin() + releaseCount);
+	}
+	std::chrono::duration<double, std::nano> poolTime = std::chrono::high_resolution_clock::now() - start;
+
+	double allocations = double(frames) * allocationsPerFrame;
+	std::cout << "Descriptor ring: " << ringTime.count() / allocations << " ns per allocation ("
+	          << 1e3 / (ringTime.count() / allocations) << " M/s), " << failedRing << " failed" << std::endl;
+	std::cout << "Descriptor pool: " << poolTime.count() / allocations << " ns per allocation and free ("
+	          << 1e3 / (poolTime.count() / allocations) << " M/s), " << failedPool << " failed" << std::endl;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+//linear allocator for descriptors that live for one frame, like the copies of a pipeline's texture
+//table. Allocations run around a fixed region of the heap and a frame's share comes back as a
+//whole once the gpu passed the fence value it was closed with, so nothing the gpu may still read
+//is overwritten. Knows nothing about d3d, the heap owning the descriptors sits on top of it
+class DescriptorRing
+{
+public:
+	static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+	explicit DescriptorRing(uint32_t base = 0, uint32_t capacity = 0) { Reset(base, capacity); }
+
+	//forgets every allocation, indices are handed out from [base, base + capacity)
+	void Reset(uint32_t base, uint32_t capacity);
+
+	//first index of count consecutive indices for the current frame. A run never wraps, the unused
+	//end of the region is skipped instead. InvalidIndex when count is 0 or frames in flight hold
+	//too much of the ring
+	uint32_t Allocate(uint32_t count);
+	//closes the current frame, its allocations are reused once Reclaim sees fenceValue completed
+	void FinishFrame(uint64_t fenceValue);
+	//frees the frames whose fence value is at most completedFenceValue
+	void Reclaim(uint64_t completedFenceValue);
+
+	uint32_t GetCapacity() const { return Capacity; }
+	uint32_t GetUsedCount() const { return UsedCount; }
+	uint32_t GetFramesInFlight() const { return static_cast<uint32_t>(Frames.size()); }
+	//counts FinishFrame calls, an allocation is only valid while this has not changed
+	uint64_t GetFrameSerial() const { return FrameSerial; }
+
+private:
+	struct Frame
+	{
+		uint64_t FenceValue;
+		uint32_t Count; //including the skipped end of the region
+	};
+
+	uint32_t Base = 0;
+	uint32_t Capacity = 0;
+	uint32_t Head = 0; //next index to hand out, relative to Base
+	uint32_t UsedCount = 0; //the used run ends at Head
+	uint32_t CurrentFrameCount = 0;
+	uint64_t FrameSerial = 0;
+	std::deque<Frame> Frames; //oldest first
+};
+
+//allocations per second of the frame ring and of the persistent DescriptorIndexAllocator, with
+//fences completing a few frames late like a gpu would
+void BenchmarkDescriptorAllocators();
@@ -1,11 +1,70 @@
 #include "DynamicRootSignature.h"
 
+#include "RootSignatureCache.h"
+
+#include <algorithm>
 #include <iostream>
+#include <tuple>
 
 DynamicRootSignature::DynamicRootSignature()
 {
 }
 
+//size of the root arguments in 32 bit values: a table costs one, a root descriptor two and root
+//constants one per value
+static uint32_t GetRootParameterCost(const D3D12_ROOT_PARAMETER1& parameter)
+{
+    switch (parameter.ParameterType)
+    {
+    case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+        return 1;
+    case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+        return parameter.Constants.Num32BitValues;
+    default:
+        return 2;
+    }
+}
+
+//turns the smallest cbuffers into root constants for as long as the whole root signature stays
+//within D3D12_MAX_ROOT_COST, the rest stay root descriptors
+static void PromoteConstantBuffers(ShaderParameters& parameters)
+{
+    uint32_t cost = 0;
+    for (const D3D12_ROOT_PARAMETER1& parameter : parameters.RootParameters)
+    {
+        cost += GetRootParameterCost(parameter);
+    }
+
+    //the bindless indices can only be set as root constants, so that cbuffer goes first
+    std::vector<std::tuple<bool, uint32_t, std::string>> candidates;
+    for (auto& [name, size] : parameters.ConstantBufferSizes)
+    {
+        if (parameters.FreeParameterIndexMap.count(name) > 0)
+        {
+            candidates.push_back({ name != BindlessConstantBufferName, (size + 3) / 4, name });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (auto& [notBindless, valueCount, name] : candidates)
+    {
+        D3D12_ROOT_PARAMETER1& parameter = parameters.RootParameters[parameters.FreeParameterIndexMap[name]];
+        if (parameter.ParameterType != D3D12_ROOT_PARAMETER_TYPE_CBV || cost - GetRootParameterCost(parameter) + valueCount > D3D12_MAX_ROOT_COST)
+        {
+            continue;
+        }
+        cost = cost - GetRootParameterCost(parameter) + valueCount;
+
+        D3D12_ROOT_CONSTANTS constants = {};
+        constants.ShaderRegister = parameter.Descriptor.ShaderRegister;
+        constants.RegisterSpace = parameter.Descriptor.RegisterSpace;
+        constants.Num32BitValues = valueCount;
+        parameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+        parameter.Constants = constants;
+        parameters.RootConstantCounts[name] = valueCount;
+    }
+}
+
 bool DynamicRootSignature::Initialize(ID3D12Device* device, VertexShader* vertexShader, PixelShader* pixelShader)
 {
     D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData;
@@ -38,16 +97,19 @@ bool DynamicRootSignature::Initialize(ID3D12Device* device, VertexShader* vertex
         Parameters.RootParameters.push_back(rootParam);
         Parameters.FreeParameterIndexMap[name] = Parameters.RootParameters.size() - 1;
 	}
+    Parameters.ConstantBufferSizes.insert(vertexShader->Parameters.ConstantBufferSizes.begin(), vertexShader->Parameters.ConstantBufferSizes.end());
+    Parameters.BindlessTextureOffsets.insert(vertexShader->Parameters.BindlessTextureOffsets.begin(), vertexShader->Parameters.BindlessTextureOffsets.end());
 
     for (auto& [name, descTable]: vertexShader->Parameters.DescriptorTableIndexMap)
 	{
         auto rootParam = vertexShader->Parameters.RootParameters[descTable.Index];
         DescriptorTableIndexed newDescTable = descTable;
-        rootParam.DescriptorTable.pDescriptorRanges = newDescTable.DescriptorRanges.data();
-        rootParam.DescriptorTable.NumDescriptorRanges = newDescTable.DescriptorRanges.size();
-        Parameters.RootParameters.push_back(rootParam);
-        newDescTable.Index = Parameters.RootParameters.size() - 1;
         Parameters.DescriptorTableIndexMap[name] = newDescTable;
+        //point at the ranges stored in the map, the local copy goes away and the cache reads them
+        rootParam.DescriptorTable.pDescriptorRanges = Parameters.DescriptorTableIndexMap[name].DescriptorRanges.data();
+        rootParam.DescriptorTable.NumDescriptorRanges = Parameters.DescriptorTableIndexMap[name].DescriptorRanges.size();
+        Parameters.RootParameters.push_back(rootParam);
+        Parameters.DescriptorTableIndexMap[name].Index = Parameters.RootParameters.size() - 1;
 	}
 
     for (auto& [name, idx]: pixelShader->Parameters.FreeParameterIndexMap)
@@ -56,6 +118,8 @@ bool DynamicRootSignature::Initialize(ID3D12Device* device, VertexShader* vertex
         Parameters.RootParameters.push_back(rootParam);
         Parameters.FreeParameterIndexMap[name] = Parameters.RootParameters.size() - 1;
 	}
+    Parameters.ConstantBufferSizes.insert(pixelShader->Parameters.ConstantBufferSizes.begin(), pixelShader->Parameters.ConstantBufferSizes.end());
+    Parameters.BindlessTextureOffsets.insert(pixelShader->Parameters.BindlessTextureOffsets.begin(), pixelShader->Parameters.BindlessTextureOffsets.end());
 
     for (auto& [name, descTable]: pixelShader->Parameters.DescriptorTableIndexMap)
 	{
@@ -68,37 +132,26 @@ bool DynamicRootSignature::Initialize(ID3D12Device* device, VertexShader* vertex
         Parameters.DescriptorTableIndexMap[name].Index = Parameters.RootParameters.size() - 1;
 	}
 
-    D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
-    rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
-    rootSignatureDesc.Desc_1_1.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
-    rootSignatureDesc.Desc_1_1.NumParameters = Parameters.RootParameters.size();
-    rootSignatureDesc.Desc_1_1.pParameters = Parameters.RootParameters.data();
-    rootSignatureDesc.Desc_1_1.NumStaticSamplers = 1;
-    rootSignatureDesc.Desc_1_1.pStaticSamplers = &sampler;
+    //the budget covers the whole root signature, so promotion waits until both stages are merged
+    PromoteConstantBuffers(Parameters);
 
-    ID3DBlob* signature;
-    ID3DBlob* error;
-
-    try
+    D3D12_ROOT_SIGNATURE_DESC1 rootSignatureDesc = {};
+    rootSignatureDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+    if (!Parameters.BindlessTextureOffsets.empty())
     {
-        ThrowIfFailed(D3D12SerializeVersionedRootSignature(&rootSignatureDesc, &signature, &error));
-        ThrowIfFailed(
-            device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
-        rootSignature->SetName(L"Dynamic Root Signature");
-    }
-    catch (std::exception e)
-    {
-        const char* errStr = (const char*)error->GetBufferPointer();
-        std::cout << errStr;
-        error->Release();
-        error = nullptr;
-        return false;
+        rootSignatureDesc.Flags |= D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED;
     }
+    rootSignatureDesc.NumParameters = Parameters.RootParameters.size();
+    rootSignatureDesc.pParameters = Parameters.RootParameters.data();
+    rootSignatureDesc.NumStaticSamplers = 1;
+    rootSignatureDesc.pStaticSamplers = &sampler;
 
-    if(signature)
+    //pipelines with the same layout share one root signature, the parameter maps stay per pipeline
+    rootSignature = RootSignatureCache::GetInstance()->GetOrCreate(device, rootSignatureDesc);
+    Hash = HashRootSignature(CanonicalizeRootSignature(rootSignatureDesc));
+    if (!rootSignature)
     {
-        signature->Release();
-        signature = nullptr;
+        return false;
     }
 
     return true;
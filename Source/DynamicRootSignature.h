@@ -8,7 +8,9 @@ public:
 	DynamicRootSignature();
 	bool Initialize(ID3D12Device* device, VertexShader* vertexShader, PixelShader* pixelShader);
 	
-    ID3D12RootSignature* rootSignature;
+    ID3D12RootSignature* rootSignature = nullptr;
+	//canonical hash of the layout, stable between runs so pipeline state caches can key on it
+	uint64_t Hash = 0;
 
 	ShaderParameters Parameters;
 };
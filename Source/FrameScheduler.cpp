@@ -0,0 +1,54 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+FrameScheduler::FrameScheduler(FrameFence* fence, uint32_t framesInFlight)
+	: Fence(fence), ContextFenceValues(std::max(1u, framesInFlight), 0)
+{
+	Current = GetFramesInFlight() - 1;
+}
+
+uint32_t FrameScheduler::BeginFrame()
+{
+	Current = (Current + 1) % GetFramesInFlight();
+
+	uint64_t reuseValue = ContextFenceValues[Current];
+	if(reuseValue > Fence->GetCompletedValue())
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		Fence->Wait(reuseValue);
+		Stats.WaitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		Stats.Waits++;
+	}
+	if(LastSignaled > Fence->GetCompletedValue())
+	{
+		Stats.OverlappedFrames++;
+	}
+	return Current;
+}
+
+uint64_t FrameScheduler::EndFrame()
+{
+	LastSignaled = Fence->Signal();
+	ContextFenceValues[Current] = LastSignaled;
+	Stats.Frames++;
+	return LastSignaled;
+}
+
+void FrameScheduler::WaitForIdle()
+{
+	if(LastSignaled > Fence->GetCompletedValue())
+	{
+		Fence->Wait(LastSignaled);
+	}
+}
+
+void FrameScheduler::ReportStats() const
+{
+	double frames = double(std::max<uint64_t>(1, Stats.Frames));
+	std::cout << "Frames in flight: " << GetFramesInFlight() << ", " << 100.0 * Stats.OverlappedFrames / frames
+	          << "% of frames recorded while the gpu was busy, waited " << Stats.Waits << " times for "
+	          << Stats.WaitMilliseconds / frames << " ms per frame" << std::endl;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//gpu side of the frame scheduler, the d3d12 implementation signals a fence on the direct queue
+//while the tests run a simulated gpu timeline
+class FrameFence
+{
+public:
+	virtual ~FrameFence() = default;
+
+	//signals after everything submitted so far, returns the value that completes with it
+	virtual uint64_t Signal() = 0;
+	virtual uint64_t GetCompletedValue() = 0;
+	//blocks until fenceValue completed
+	virtual void Wait(uint64_t fenceValue) = 0;
+};
+
+struct FrameSchedulerStats
+{
+	uint64_t Frames = 0;
+	uint64_t Waits = 0; //BeginFrame calls that blocked on the gpu
+	double WaitMilliseconds = 0.0;
+	uint64_t OverlappedFrames = 0; //recording started while the gpu still worked on an earlier frame
+};
+
+//hands out frame contexts round robin so the cpu records up to framesInFlight frames ahead of the
+//gpu. Each context remembers the fence value of the frame that last used it and BeginFrame only
+//waits when that frame has not finished, after that the context's command allocator and anything
+//else the caller keeps per context can be reused
+class FrameScheduler
+{
+public:
+	FrameScheduler(FrameFence* fence, uint32_t framesInFlight);
+
+	//index of the context to record the next frame with
+	uint32_t BeginFrame();
+	//call after the frame's command lists were submitted. Returns the fence value the frame's
+	//transient allocations are tagged with
+	uint64_t EndFrame();
+	//waits for every submitted frame, before releasing anything the gpu may still use at shutdown.
+	//The frame loop never calls it, what it replaces is released once EndFrame's fence value completed
+	void WaitForIdle();
+
+	uint64_t GetCompletedValue() { return Fence->GetCompletedValue(); }
+	uint32_t GetFramesInFlight() const { return static_cast<uint32_t>(ContextFenceValues.size()); }
+	uint32_t GetContextIndex() const { return Current; }
+	const FrameSchedulerStats& GetStats() const { return Stats; }
+	void ReportStats() const;
+
+private:
+	FrameFence* Fence;
+	std::vector<uint64_t> ContextFenceValues; //0 until the context was first submitted
+	uint32_t Current = 0;
+	uint64_t LastSignaled = 0;
+	FrameSchedulerStats Stats;
+};
@@ -0,0 +1,201 @@
+#include "Frustum.h"
+
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <glm/geometric.hpp>
+
+//the avx path is compiled on every x86 build and picked at runtime, so the binary still runs on
+//cpus without avx
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRUSTUM_CULL_AVX
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FRUSTUM_AVX_TARGET
+#else
+#include <cpuid.h>
+#define FRUSTUM_AVX_TARGET __attribute__((target("avx")))
+#endif
+#endif
+
+#ifdef FRUSTUM_CULL_AVX
+namespace
+{
+	//avx needs the cpu flag and the os saving the ymm registers on context switches
+	bool CpuSupportsAvx()
+	{
+		const unsigned osxsave = 1u << 27;
+		const unsigned avx = 1u << 28;
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		unsigned ecx = static_cast<unsigned>(info[2]);
+#else
+		unsigned eax, ebx, ecx, edx;
+		if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return false;
+#endif
+		if((ecx & (osxsave | avx)) != (osxsave | avx))
+			return false;
+
+#ifdef _MSC_VER
+		unsigned long long xcr0 = _xgetbv(0);
+#else
+		unsigned xcr0Low, xcr0High;
+		__asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+		unsigned long long xcr0 = (static_cast<unsigned long long>(xcr0High) << 32) | xcr0Low;
+#endif
+		//xmm and ymm state
+		return (xcr0 & 6) == 6;
+	}
+
+	const bool HasAvx = CpuSupportsAvx();
+
+	FRUSTUM_AVX_TARGET void CullAabbsAvx(const glm::vec4 (&planes)[Frustum::PlaneCount], const AabbList& boxes, std::vector<uint32_t>& outVisible)
+	{
+		for(uint32_t base = 0; base < boxes.Count; base += 8)
+		{
+			int outside = 0;
+			for(const auto& plane : planes)
+			{
+				//the box corner furthest along the plane normal decides if the box is completely behind it
+				const float* x = plane.x > 0.f ? &boxes.MaxX[base] : &boxes.MinX[base];
+				const float* y = plane.y > 0.f ? &boxes.MaxY[base] : &boxes.MinY[base];
+				const float* z = plane.z > 0.f ? &boxes.MaxZ[base] : &boxes.MinZ[base];
+
+				__m256 distance = _mm256_set1_ps(plane.w);
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_loadu_ps(x), _mm256_set1_ps(plane.x)));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_loadu_ps(y), _mm256_set1_ps(plane.y)));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_loadu_ps(z), _mm256_set1_ps(plane.z)));
+				outside |= _mm256_movemask_ps(_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+			}
+
+			//padding boxes are inverted and always end up outside
+			int inside = ~outside & 0xff;
+			while(inside)
+			{
+				int lane = 0;
+				while(!(inside & (1 << lane)))
+					lane++;
+				inside &= inside - 1;
+				outVisible.push_back(base + lane);
+			}
+		}
+	}
+}
+#endif
+
+void AabbList::Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	//grow in blocks of 8, padding boxes are inverted so they never pass the plane tests
+	if(Count % 8 == 0)
+	{
+		for(auto* component : { &MinX, &MinY, &MinZ })
+			component->resize(Count + 8, FLT_MAX);
+		for(auto* component : { &MaxX, &MaxY, &MaxZ })
+			component->resize(Count + 8, -FLT_MAX);
+	}
+
+	MinX[Count] = boundsMin.x;
+	MinY[Count] = boundsMin.y;
+	MinZ[Count] = boundsMin.z;
+	MaxX[Count] = boundsMax.x;
+	MaxY[Count] = boundsMax.y;
+	MaxZ[Count] = boundsMax.z;
+	Count++;
+}
+
+Frustum Frustum::FromViewProjection(const glm::mat4& viewProjection)
+{
+	//glm matrices are column major, gather the rows for the Gribb-Hartmann extraction
+	glm::vec4 rows[4];
+	for(int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	Frustum frustum;
+	frustum.Planes[Left] = rows[3] + rows[0];
+	frustum.Planes[Right] = rows[3] - rows[0];
+	frustum.Planes[Bottom] = rows[3] + rows[1];
+	frustum.Planes[Top] = rows[3] - rows[1];
+	frustum.Planes[Near] = rows[2]; //clip depth starts from 0 (GLM_DEPTH_ZERO_TO_ONE)
+	frustum.Planes[Far] = rows[3] - rows[2];
+
+	for(auto& plane : frustum.Planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+{
+	for(const auto& plane : Planes)
+	{
+		if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+void Frustum::CullAabbs(const AabbList& boxes, std::vector<uint32_t>& outVisible) const
+{
+#ifdef FRUSTUM_CULL_AVX
+	if(HasAvx)
+	{
+		CullAabbsAvx(Planes, boxes, outVisible);
+		return;
+	}
+#endif
+	CullAabbsScalar(boxes, outVisible);
+}
+
+void Frustum::CullAabbsScalar(const AabbList& boxes, std::vector<uint32_t>& outVisible) const
+{
+	for(uint32_t i = 0; i < boxes.Count; i++)
+	{
+		bool inside = true;
+		for(const auto& plane : Planes)
+		{
+			float x = plane.x > 0.f ? boxes.MaxX[i] : boxes.MinX[i];
+			float y = plane.y > 0.f ? boxes.MaxY[i] : boxes.MinY[i];
+			float z = plane.z > 0.f ? boxes.MaxZ[i] : boxes.MinZ[i];
+			if(plane.x * x + plane.y * y + plane.z * z + plane.w < 0.f)
+			{
+				inside = false;
+				break;
+			}
+		}
+		if(inside)
+			outVisible.push_back(i);
+	}
+}
+
+void BenchmarkAabbCulling(const Frustum& frustum, const AabbList& boxes)
+{
+	const int iterations = 10000;
+	std::vector<uint32_t> visible;
+	visible.reserve(boxes.Count);
+
+	auto measure = [&](auto cull)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for(int i = 0; i < iterations; i++)
+		{
+			visible.clear();
+			cull();
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count() / iterations;
+	};
+
+	double scalarTime = measure([&]() { frustum.CullAabbsScalar(boxes, visible); });
+	double simdTime = measure([&]() { frustum.CullAabbs(boxes, visible); });
+
+	std::cout << "Chunk culling: " << boxes.Count << " boxes, " << visible.size() << " visible ("
+	          << (boxes.Count ? 100.0 * visible.size() / boxes.Count : 0.0) << "%), scalar "
+	          << scalarTime << " ns, simd " << simdTime << " ns per cull" << std::endl;
+}
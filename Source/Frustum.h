@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+//axis aligned boxes stored as separate component arrays, padded to a multiple of 8 for the simd culler
+struct AabbList
+{
+	std::vector<float> MinX, MinY, MinZ;
+	std::vector<float> MaxX, MaxY, MaxZ;
+	uint32_t Count = 0;
+
+	void Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
+
+//view frustum as six inward facing planes (xyz = normal, w = distance)
+struct Frustum
+{
+	enum Plane
+	{
+		Left,
+		Right,
+		Bottom,
+		Top,
+		Near,
+		Far,
+		PlaneCount
+	};
+
+	glm::vec4 Planes[PlaneCount];
+
+	//extracts the planes from a view projection matrix using dx12 style 0 to 1 clip depth
+	static Frustum FromViewProjection(const glm::mat4& viewProjection);
+
+	bool IntersectsSphere(const glm::vec3& center, float radius) const;
+
+	//appends the indices of boxes that are at least partially inside, testing 8 boxes per iteration
+	//with avx when cpuid reports it at startup
+	void CullAabbs(const AabbList& boxes, std::vector<uint32_t>& outVisible) const;
+	//one box at a time reference path, used when the cpu or the os does not support avx
+	void CullAabbsScalar(const AabbList& boxes, std::vector<uint32_t>& outVisible) const;
+};
+
+//times both culling paths over the boxes and prints their throughput and visible fraction
+void BenchmarkAabbCulling(const Frustum& frustum, const AabbList& boxes);
@@ -1,9 +1,14 @@
+#include <algorithm>
 #include <iostream>
 
 //#define DEBUG_CAMERA_LOCATION //uncomment to log camera data
+//#define DEBUG_CHUNK_CULLING //uncomment to log visible scene chunks every frame
+//#define RUN_BENCHMARKS //uncomment to run cpu side microbenchmarks at startup
+//#define USE_SHADER_BUNDLE //uncomment to load precompiled shaders instead of compiling them, cook the bundle with --cook-shaders
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
 #include <SDL_syswm.h>
+#include <cstring>
 #include <fstream>
 #include <vector>
 
@@ -13,13 +18,29 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include "ConstantBuffer.h"
+#include "BindlessHeap.h"
+#include "Bvh.h"
+#include "CommandRecorder.h"
+#include "D3D12CommandListSink.h"
+#include "D3D12FrameFence.h"
+#include "D3D12TextureUploadSink.h"
+#include "D3D12VirtualTexture.h"
+#include "DeferredReleaseQueue.h"
+#include "DescriptorRing.h"
 #include "DynamicRootSignature.h"
+#include "FrameScheduler.h"
+#include "Frustum.h"
 #include "pch.h"
 #include "Mesh.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
 #include "Pipeline.h"
+#include "PipelineStateCache.h"
+#include "RootSignatureCache.h"
 #include "Shader.h"
+#include "ShaderHotReload.h"
 #include "Texture.h"
+#include "UploadRing.h"
 
 // Global variables for the window and DirectX
 SDL_Window* GWindow = nullptr;
@@ -104,11 +125,55 @@ inline std::vector<char> readFile(const std::string& filename)
     return buffer;
 };
 
+//volumetric quality tiers, from cheapest to the original look
+constexpr uint32_t VolumetricQualityCount = 3;
+ShaderDefines GetVolumetricDefines(uint32_t quality, int width, int height, bool bindless)
+{
+    const ShaderDefines qualityDefines[VolumetricQualityCount] =
+    {
+        {{L"MARCH_STEPS", L"64"}, {L"FBM_OCTAVES", L"4"}, {L"MIN_STEP_SIZE", L"0.2"}, {L"STEP_SIZE_SCALE", L"0.08"}},
+        {{L"MARCH_STEPS", L"128"}, {L"FBM_OCTAVES", L"6"}, {L"MIN_STEP_SIZE", L"0.1"}, {L"STEP_SIZE_SCALE", L"0.04"}},
+        {{L"MARCH_STEPS", L"250"}, {L"FBM_OCTAVES", L"8"}, {L"MIN_STEP_SIZE", L"0.05"}, {L"STEP_SIZE_SCALE", L"0.02"}},
+    };
+    ShaderDefines defines = {{L"SCREEN_WIDTH", std::to_wstring(width)}, {L"SCREEN_HEIGHT", std::to_wstring(height)}};
+    defines.insert(defines.end(), qualityDefines[quality].begin(), qualityDefines[quality].end());
+    if (bindless)
+    {
+        defines.push_back({BindlessShaderDefine, L"1"});
+    }
+    return defines;
+}
+
+//every shader and permutation the renderer can ask for, the paths have to match the ones used below
+std::vector<ShaderBundleSource> GetShaderManifest(int width, int height)
+{
+    std::vector<ShaderBundleSource> sources =
+    {
+        {true, L"../Assets/triangle.vert.hlsl", {}},
+        {true, L"../Assets/noop.vert.hlsl", {}},
+        {false, L"../Assets/triangle.px.hlsl", {}},
+        {false, L"../Assets/depth_save.px.hlsl", {}},
+        {false, L"../Assets/vt_feedback.px.hlsl", {}},
+    };
+    //the bundle does not know the device, so both the bindless and the descriptor table variants go in
+    for (uint32_t quality = 0; quality < VolumetricQualityCount; quality++)
+    {
+        sources.push_back({false, L"../Assets/volumetric.px.hlsl", GetVolumetricDefines(quality, width, height, false)});
+        sources.push_back({false, L"../Assets/volumetric.px.hlsl", GetVolumetricDefines(quality, width, height, true)});
+    }
+    return sources;
+}
+
 int main(int argc, char* argv[]) 
 {
     const int windowWidth = 800;
     const int windowHeight = 600;
 
+    if (argc > 1 && strcmp(argv[1], "--cook-shaders") == 0)
+    {
+        return CookShaderBundle(L"../Assets/shaders.shb", GetShaderManifest(windowWidth, windowHeight)) ? 0 : 1;
+    }
+
     if (!InitializeWindow(windowWidth, windowHeight))
     {
         return 1;
@@ -159,22 +224,52 @@ int main(int argc, char* argv[])
     queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
     ThrowIfFailed(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&commandQueue)));
 
-    ID3D12CommandAllocator* commandAllocator;
-    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator)));
+    //every pipeline takes its descriptors from this one heap, so draws never switch heaps
+    BindlessHeap bindlessHeap;
+    bindlessHeap.Initialize(device, 4096, 1024);
+    BindlessHeap::Active = &bindlessHeap;
+
+    //per frame constants that do not fit in root constants are copied here, a frame's space is reused
+    //once its fence completed
+    UploadRing uploadRing;
+    uploadRing.Initialize(device, 4 * 1024 * 1024);
+    UploadRing::Active = &uploadRing;
+
+    //pipeline states, root signatures and heaps replaced by a shader reload stay alive here until
+    //the frames that may still draw with them are done
+    DeferredReleaseQueue releaseQueue;
+    DeferredReleaseQueue::Active = &releaseQueue;
+
+    //pipeline states compiled in earlier runs load from the library instead of going through the driver compiler
+    PipelineStateCache::GetInstance()->Open(device, L"ShaderCache/pipelines.bin");
+
+    //ResourceDescriptorHeap needs shader model 6.6 and resource binding tier 3, the volumetric pass
+    //falls back to its descriptor table without them
+    D3D12_FEATURE_DATA_SHADER_MODEL shaderModel = { D3D_SHADER_MODEL_6_6 };
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    bool bindlessSupported =
+        SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shaderModel, sizeof(shaderModel))) &&
+        shaderModel.HighestShaderModel >= D3D_SHADER_MODEL_6_6 &&
+        SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))) &&
+        options.ResourceBindingTier >= D3D12_RESOURCE_BINDING_TIER_3;
+    std::cout << "Bindless textures: " << (bindlessSupported ? "yes" : "no") << std::endl;
+
+    //the cpu records up to framesInFlight frames ahead of the gpu, each frame context has its own
+    //command allocator and the rings tag their allocations with the frame's fence value
+    static const UINT framesInFlight = 2;
+    ID3D12CommandAllocator* commandAllocators[framesInFlight];
+    for (UINT n = 0; n < framesInFlight; n++)
+    {
+        ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocators[n])));
+    }
+    D3D12FrameFence frameFence(device, commandQueue);
+    FrameScheduler frameScheduler(&frameFence, framesInFlight);
 
     UINT frameIndex = 0;
-    HANDLE fenceEvent;
-    ID3D12Fence* fence;
-    UINT64 fenceValue = 0;
-
-    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
-	 fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-	if (fenceEvent == nullptr)
-	{
-		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-	}
 
     static const UINT backbufferCount = 2;
+    //the depth targets are picked by back buffer, a frame may only reuse one the gpu finished with
+    static_assert(framesInFlight <= backbufferCount, "more frames in flight than back buffers");
     UINT currentBuffer;
     ID3D12DescriptorHeap* renderTargetViewHeap;
     ID3D12Resource* renderTargets[backbufferCount];
@@ -325,14 +420,22 @@ int main(int argc, char* argv[])
 
     Mesh mesh;
     mesh.loadFromObj(device, "../Assets/graveyard.obj");
+    //chunks first, the lods are simplified chunk by chunk so neighbours at different levels do not crack
+    mesh.buildChunks(device, 16);
+    std::cout << "Scene chunks: " << mesh._chunks.size() << std::endl;
+    mesh.generateLods(device, { 0.5f, 0.25f, 0.125f, 0.0625f });
+    for (size_t i = 0; i < mesh._lods.size(); i++)
+    {
+        std::cout << "LOD " << i << ": " << mesh._lods[i].IndexCount / 3 << " triangles, error " << mesh._lods[i].Error << std::endl;
+    }
 
     Mesh cubeMesh;
     cubeMesh.loadFromObj(device, "../Assets/cube.obj");
 
     //vertices for fullscreen triangle
-    Vertex a = { {-3.0f, -1.0f, 0.0f}, {3.f, 3.f, 3.f}, {3.f, 3.f, 3.f}, {3.f, 3.f} };
-    Vertex b = { {1.0f, -1.0f, 0.0f}, {3.f, 3.f, 3.f}, {3.f, 3.f, 3.f}, {3.f, 3.f} };
-    Vertex c = { {1.0f, 3.0f, 0.0f}, {3.f, 3.f, 3.f}, {3.f, 3.f, 3.f}, {3.f, 3.f} };
+    Vertex a = { {-3.0f, -1.0f, 0.0f}, {3.f, 3.f, 3.f}, {3.f, 3.f} };
+    Vertex b = { {1.0f, -1.0f, 0.0f}, {3.f, 3.f, 3.f}, {3.f, 3.f} };
+    Vertex c = { {1.0f, 3.0f, 0.0f}, {3.f, 3.f, 3.f}, {3.f, 3.f} };
     std::vector<Vertex> tri = { a, b, c };
     Mesh triangle;
     triangle.loadFromVertices(device, tri);
@@ -353,50 +456,220 @@ int main(int argc, char* argv[])
     auto modelMatrix = glm::mat4(1.f);
     cbVS.MVP = projectionMatrix * viewMatrix * modelMatrix;
 
-    VertexShader triangleVertexShader(L"../Assets/triangle.vert.hlsl");
-    PixelShader trianglePixelShader(L"../Assets/triangle.px.hlsl");
-    PixelShader depthPixelShader(L"../Assets/depth_save.px.hlsl");
+    MeshletMesh meshMeshlets;
+    BuildMeshlets(mesh, meshMeshlets);
+    std::cout << "Meshlets: " << meshMeshlets.Meshlets.size() << " for " << mesh._indices.size() / 3 << " triangles" << std::endl;
+
+    //default viewpoints, the initial camera and the one the frame loop starts from
+    const glm::vec3 viewpoints[][2] =
+    {
+        { eye, eye_dir },
+        { glm::vec3(8.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f) },
+    };
+    std::vector<uint32_t> visibleMeshlets;
+    for (const auto& viewpoint : viewpoints)
+    {
+        MeshletCullStats stats = CullMeshlets(meshMeshlets, viewpoint[0], viewpoint[1], up, projectionMatrix, visibleMeshlets);
+        std::cout << "Meshlet culling from eye (" << viewpoint[0].x << ", " << viewpoint[0].y << ", " << viewpoint[0].z << "): "
+                  << stats.VisibleMeshlets << "/" << stats.TotalMeshlets << " meshlets visible, "
+                  << stats.FrustumCulledTriangles << " frustum / " << stats.ConeCulledTriangles << " cone culled triangles, "
+                  << stats.CulledTriangleRatio() * 100.f << "% culled" << std::endl;
+    }
+
+#ifdef RUN_BENCHMARKS
+    BenchmarkAabbCulling(Frustum::FromViewProjection(projectionMatrix * viewMatrix), mesh.chunkBounds);
+    Bvh sceneBvh;
+    sceneBvh.Build(mesh);
+    BenchmarkBvh(sceneBvh, eye, eye_dir, up, glm::radians(46.f), windowWidth, windowHeight);
+    BenchmarkVirtualTexture();
+#endif
+
+    auto shaderStart = std::chrono::high_resolution_clock::now();
+#ifdef USE_SHADER_BUNDLE
+    ShaderBundle shaderBundle;
+    if (!shaderBundle.Open(L"../Assets/shaders.shb"))
+    {
+        throw std::runtime_error("missing or outdated shader bundle, cook it with --cook-shaders");
+    }
+    ShaderBundle::Active = &shaderBundle;
+#endif
+    ShaderBatch shaderBatch;
+    auto triangleVertexShaderJob = shaderBatch.AddVertexShader(L"../Assets/triangle.vert.hlsl");
+    auto trianglePixelShaderJob = shaderBatch.AddPixelShader(L"../Assets/triangle.px.hlsl");
+    auto depthPixelShaderJob = shaderBatch.AddPixelShader(L"../Assets/depth_save.px.hlsl");
+    auto noopVertexShaderJob = shaderBatch.AddVertexShader(L"../Assets/noop.vert.hlsl");
+    auto feedbackPixelShaderJob = shaderBatch.AddPixelShader(L"../Assets/vt_feedback.px.hlsl");
+    shaderBatch.Start();
+
+    std::unique_ptr<VertexShader> triangleVertexShader = triangleVertexShaderJob.get();
+    std::unique_ptr<PixelShader> trianglePixelShader = trianglePixelShaderJob.get();
+    std::unique_ptr<PixelShader> depthPixelShader = depthPixelShaderJob.get();
+
+	std::unique_ptr<VertexShader> noopVertexShader = noopVertexShaderJob.get();
+	std::unique_ptr<PixelShader> feedbackPixelShader = feedbackPixelShaderJob.get();
 
-	VertexShader noopVertexShader(L"../Assets/noop.vert.hlsl");
-	PixelShader volumePixelShader(L"../Assets/volumetric.px.hlsl");
+    {
+        //the first launch after a shader or compiler change is a cold start, later ones should only hit the cache
+        std::chrono::duration<double, std::milli> shaderTime = std::chrono::high_resolution_clock::now() - shaderStart;
+#ifdef USE_SHADER_BUNDLE
+        std::cout << "Shaders ready in " << shaderTime.count() << " ms (" << shaderBundle.GetEntryCount() << " in a "
+                  << shaderBundle.GetSize() / 1024.0 << " KB bundle)" << std::endl;
+#else
+        std::cout << "Shaders ready in " << shaderTime.count() << " ms (" << ShaderCompiler::CacheHits << " cache hits, "
+                  << ShaderCompiler::CacheMisses << " compiled)" << std::endl;
+#endif
+    }
+
+    //recompiles shaders in the background when they or their includes are saved
+    ShaderHotReload shaderHotReload;
 
 	Pipeline pipeline;
-	pipeline.Initialize(device, &triangleVertexShader, &trianglePixelShader);
+	pipeline.Initialize(device, triangleVertexShader.get(), trianglePixelShader.get());
 
 	Pipeline depthBackPipeline;
     depthBackPipeline.CullMode = D3D12_CULL_MODE_BACK;
     depthBackPipeline.writeDepth = false;
-	depthBackPipeline.Initialize(device, &triangleVertexShader, &depthPixelShader);
+	depthBackPipeline.Initialize(device, triangleVertexShader.get(), depthPixelShader.get());
 
 	Pipeline depthFrontPipeline;
     depthFrontPipeline.CullMode = D3D12_CULL_MODE_FRONT;
     depthFrontPipeline.writeDepth = false;
-	depthFrontPipeline.Initialize(device, &triangleVertexShader, &depthPixelShader);
+	depthFrontPipeline.Initialize(device, triangleVertexShader.get(), depthPixelShader.get());
+
+    //q cycles through the volumetric quality tiers. A tier's permutation and pipeline are built the first time it is selected
+    uint32_t volumetricQuality = VolumetricQualityCount - 1;
+    ShaderPermutations<PixelShader> volumePixelShaders(L"../Assets/volumetric.px.hlsl");
+    Pipeline volumetricPipelines[VolumetricQualityCount];
+    struct VolumetricBindings
+    {
+        BindingHandle Cube;
+        BindingHandle FrontCulled;
+        BindingHandle BackCulled;
+    } volumetricBindings[VolumetricQualityCount];
+    auto getVolumetricPipeline = [&](uint32_t quality) -> Pipeline&
+    {
+        Pipeline& volumetricPipeline = volumetricPipelines[quality];
+        if (!volumetricPipeline.PipelineState)
+        {
+            volumetricPipeline.useAlphaBlend = true;
+            volumetricPipeline.Initialize(device, noopVertexShader.get(), volumePixelShaders.Get(GetVolumetricDefines(quality, windowWidth, windowHeight, bindlessSupported)));
+            shaderHotReload.Watch(&volumetricPipeline);
+            volumetricBindings[quality] = { volumetricPipeline.GetBinding("cb"), volumetricPipeline.GetBinding("frontCulled"), volumetricPipeline.GetBinding("backCulled") };
+        }
+        return volumetricPipeline;
+    };
+    getVolumetricPipeline(volumetricQuality);
+
+	Pipeline feedbackPipeline;
+    feedbackPipeline.RenderTargetFormat = DXGI_FORMAT_R32_UINT;
+	feedbackPipeline.Initialize(device, triangleVertexShader.get(), feedbackPixelShader.get());
+
+    shaderHotReload.Watch(&pipeline);
+    shaderHotReload.Watch(&depthBackPipeline);
+    shaderHotReload.Watch(&depthFrontPipeline);
+    shaderHotReload.Watch(&feedbackPipeline);
+
+    //names are resolved once here, the frame loop binds through the handles
+    BindingHandle sceneBinding = pipeline.GetBinding("cb");
+    BindingHandle virtualTextureBinding = pipeline.GetBinding("virtualTexture");
+    BindingHandle materialBinding = pipeline.GetBinding("material");
+    BindingHandle feedbackSceneBinding = feedbackPipeline.GetBinding("cb");
+    BindingHandle feedbackVirtualTextureBinding = feedbackPipeline.GetBinding("virtualTexture");
+    BindingHandle depthBackCubeBinding = depthBackPipeline.GetBinding("cb");
+    BindingHandle depthFrontCubeBinding = depthFrontPipeline.GetBinding("cb");
+
+    //the depth targets are registered once, bindless volumetric draws only switch indices
+    uint32_t backDepthIndices[backbufferCount];
+    uint32_t frontDepthIndices[backbufferCount];
+    for (UINT n = 0; n < backbufferCount; n++)
+    {
+        backDepthIndices[n] = bindlessSupported ? bindlessHeap.RegisterTexture(device, backDepthRenderTargets[n]) : DescriptorIndexAllocator::InvalidIndex;
+        frontDepthIndices[n] = bindlessSupported ? bindlessHeap.RegisterTexture(device, frontDepthRenderTargets[n]) : DescriptorIndexAllocator::InvalidIndex;
+    }
 
-	Pipeline volumetricPipeline;
-    volumetricPipeline.useAlphaBlend = true;
-	volumetricPipeline.Initialize(device, &noopVertexShader, &volumePixelShader);
+    RootSignatureCacheStats rootSignatureStats = RootSignatureCache::GetInstance()->GetStats();
+    std::cout << "Root signatures: " << rootSignatureStats.Created << " created for " << rootSignatureStats.Requests << " pipelines" << std::endl;
+    PipelineStateCacheStats pipelineStateStats = PipelineStateCache::GetInstance()->GetStats();
+    std::cout << "Pipeline states: " << pipelineStateStats.Created << " compiled, " << pipelineStateStats.LibraryLoads << " loaded from the library for " << pipelineStateStats.Requests << " pipelines" << std::endl;
+    PipelineStateCache::GetInstance()->Save();
 
-    ConstantBuffer sceneBuffer;
-    sceneBuffer.Initialize(device, sizeof(cbVS));
-    UINT8* sceneBufferMapped = sceneBuffer.Map();
+    D3D12TextureUploadSink textureUploadSink(device, commandQueue);
+    TextureStreamer textureStreamer(&textureUploadSink, [](const std::wstring& filename, DecodedTexture& out)
+    {
+        //bc3 keeps decoding quick while iterating, switch to bc7 for shipping quality
+        return Texture::Decode(filename.c_str(), MipFilter::Kaiser, TextureCompression::BC3, out);
+    });
+    uint32_t sceneTextureId = textureStreamer.Request(L"../Assets/lost_empire-RGBA.png");
+    bool streamingReported = false;
 
+    //bound as a null descriptor until the first mip is resident
     Texture texture;
-    texture.LoadFromFile(device, commandQueue, L"../Assets/lost_empire-RGBA.png");
+    texture.Resource = nullptr;
+    texture.Width = 1;
+    texture.Height = 1;
+    texture.MipLevels = 1;
+    texture.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+#ifdef RUN_BENCHMARKS
+    BenchmarkPngDecode(L"../Assets/lost_empire-RGBA.png");
+    {
+        D3D12_RESOURCE_DESC imageDesc;
+        UINT64 imageBytesPerRow;
+        BYTE* imageData;
+        LoadImageDataFromFile(&imageData, imageDesc, L"../Assets/lost_empire-RGBA.png", imageBytesPerRow);
+        BenchmarkMipGeneration(imageData, UINT(imageDesc.Width), imageDesc.Height, UINT(imageBytesPerRow));
+
+        std::vector<MipLevel> imageMips;
+        GenerateMips(imageData, UINT(imageDesc.Width), imageDesc.Height, UINT(imageBytesPerRow), MipFilter::Box, true, imageMips);
+        BenchmarkBlockCompression(imageMips[0]);
+        free(imageData);
+    }
+    {
+        auto measure = [](auto load)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            Texture benchmarkTexture;
+            load(benchmarkTexture);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            benchmarkTexture.Resource->Release();
+            return elapsed.count();
+        };
+        Texture::Cook(device, L"../Assets/lost_empire-RGBA.png", L"../Assets/lost_empire-RGBA.ctex", MipFilter::Kaiser, TextureCompression::BC3);
+        double pngTime = measure([&](Texture& t) { t.LoadFromFile(device, commandQueue, L"../Assets/lost_empire-RGBA.png", MipFilter::Kaiser, TextureCompression::BC3); });
+        double cookedTime = measure([&](Texture& t) { t.LoadFromCookedFile(device, commandQueue, L"../Assets/lost_empire-RGBA.ctex"); });
+        std::cout << "Texture load: png " << pngTime << " ms, cooked " << cookedTime << " ms" << std::endl;
+    }
+#endif
 
     pipeline.BindTexture(device, "g_texture", &texture);
 
+    //the same atlas paged in on demand, feedback is rendered at a quarter of the resolution
+    D3D12VirtualTexture virtualTexture;
+    if (!virtualTexture.Initialize(device, L"../Assets/lost_empire-RGBA.vtex", windowWidth, windowWidth / 4, windowHeight / 4, framesInFlight))
+    {
+        Texture::CookVirtual(L"../Assets/lost_empire-RGBA.png", L"../Assets/lost_empire-RGBA.vtex");
+        if (!virtualTexture.Initialize(device, L"../Assets/lost_empire-RGBA.vtex", windowWidth, windowWidth / 4, windowHeight / 4, framesInFlight))
+        {
+            throw std::runtime_error("failed to load the virtual texture");
+        }
+    }
+    pipeline.BindTexture(device, "g_pageTable", virtualTexture.PageTable);
+    pipeline.BindTexture(device, "g_physicalPages", virtualTexture.PhysicalPages);
+
+#ifdef RUN_BENCHMARKS
+    BenchmarkPipelineBindings(pipeline);
+    BenchmarkDescriptorAllocators();
+#endif
+
 	ID3D12GraphicsCommandList* commandList;
 	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
-											commandAllocator, pipeline.PipelineState,
+											commandAllocators[0], pipeline.PipelineState,
 											IID_PPV_ARGS(&commandList)));
     commandList->Close();
+    //pipelines and the frame loop bind state through the recorder, which drops what is already bound
+    D3D12CommandListSink commandListSink(commandList);
+    CommandRecorder recorder(&commandListSink);
 
-	memcpy(sceneBufferMapped, &cbVS, sizeof(cbVS));
-
-    ConstantBuffer cubeBuffer;
-    cubeBuffer.Initialize(device, sizeof(ShaderMatrixCB));
-    UINT8* cubeBufferMapped = cubeBuffer.Map();
     ShaderMatrixCB CubeMvp;
     auto CubeMvpprojectionMatrix = glm::perspective(glm::radians(45.f), 1.33f, 1.0f, 1000.f);
     auto CubeMvpviewMatrix = glm::lookAt(eye, eye + eye_dir, up);
@@ -404,7 +677,6 @@ int main(int argc, char* argv[])
     CubeMvp.MVP = CubeMvpprojectionMatrix * CubeMvpviewMatrix * CubeMvpmodelMatrix;
     CubeMvp.inverseVP = glm::inverse(CubeMvpprojectionMatrix* CubeMvpviewMatrix);
     CubeMvp.eye = eye;
-	memcpy(cubeBufferMapped, &CubeMvp, sizeof(ShaderMatrixCB));
 
 	std::chrono::time_point<std::chrono::system_clock> startTime;
 	startTime = std::chrono::system_clock::now();
@@ -417,6 +689,8 @@ int main(int argc, char* argv[])
     static const glm::vec3 forward(0.f,0.f,1.f);
     static const glm::vec3 right(-1.f,0.f,0.f);
     bool captureDir = false;
+    std::vector<uint32_t> visibleChunks;
+    std::vector<MeshSubmesh> drawBatches;
     eye = glm::vec3(8.0f, 0.0f, 0.0f);
     eye_dir = glm::vec3(-1.0f, 0.0f, 0.0f);
     while (!quit)
@@ -444,6 +718,10 @@ int main(int argc, char* argv[])
 					case SDLK_a:
 						eye -= glm::cross(eye_dir, up) * speed;
 						break;
+					case SDLK_q:
+						volumetricQuality = (volumetricQuality + 1) % VolumetricQualityCount;
+						std::cout << "Volumetric quality " << volumetricQuality << std::endl;
+						break;
 					case SDLK_r:
 						eye = glm::vec3(0.f, 0.f, -3.f);
 						eye_dir =  glm::vec3(0.f,0.f,1.f);
@@ -458,6 +736,28 @@ int main(int argc, char* argv[])
                 captureDir = true;
             }
 		}
+
+        //texture binds go to the pipeline's staging table, frames in flight keep their own copies
+        textureStreamer.Update();
+        //the replaced pipeline states go to the release queue, so this never waits for the gpu
+        shaderHotReload.Update(device);
+        uint32_t residentMip = textureStreamer.GetResidentMip(sceneTextureId);
+        if (residentMip < textureStreamer.GetMipCount(sceneTextureId) && (texture.Resource == nullptr || residentMip != texture.MostDetailedMip))
+        {
+            texture.Resource = textureUploadSink.GetResource(sceneTextureId);
+            texture.Width = UINT(texture.Resource->GetDesc().Width);
+            texture.Height = texture.Resource->GetDesc().Height;
+            texture.MipLevels = texture.Resource->GetDesc().MipLevels;
+            texture.Format = texture.Resource->GetDesc().Format;
+            texture.MostDetailedMip = residentMip;
+            pipeline.BindTexture(device, "g_texture", &texture);
+        }
+        if (!streamingReported && textureStreamer.IsIdle())
+        {
+            textureStreamer.ReportStats();
+            streamingReported = true;
+        }
+
         if(captureDir)
         {
 			int x, y;
@@ -491,14 +791,53 @@ int main(int argc, char* argv[])
         std::cout << "up " << up.x << " " << up.y << " " << up.z << std::endl;
         std::cout << "==========================================================" << std::endl;
 #endif
-		memcpy(sceneBufferMapped, &cbVS, sizeof(cbVS));
-		memcpy(cubeBufferMapped, &CubeMvp, sizeof(ShaderMatrixCB));
 
-		ThrowIfFailed(commandAllocator->Reset());
+		//only waits when the gpu has not finished the frame that last used this context
+		uint32_t frameContext = frameScheduler.BeginFrame();
+		ThrowIfFailed(commandAllocators[frameContext]->Reset());
+		bindlessHeap.Reclaim(frameScheduler.GetCompletedValue());
+		uploadRing.Reclaim(frameScheduler.GetCompletedValue());
+		releaseQueue.Reclaim(frameScheduler.GetCompletedValue());
+
+		ThrowIfFailed(commandList->Reset(commandAllocators[frameContext], nullptr));
+		recorder.Reset();
+
+		//cull and batch once, the feedback pass and the main pass draw the same ranges
+		visibleChunks.clear();
+		Frustum::FromViewProjection(projectionMatrix * viewMatrix).CullAabbs(mesh.chunkBounds, visibleChunks);
+		drawBatches.clear();
+		for (uint32_t chunkIndex : visibleChunks)
+		{
+			const MeshChunk& chunk = mesh._chunks[chunkIndex];
+			glm::vec3 chunkCenter = (chunk.BoundsMin + chunk.BoundsMax) * 0.5f;
+			uint32_t lod = SelectLod(chunk.Lods, chunkCenter, glm::length(chunk.BoundsMax - chunkCenter), eye, glm::radians(46.f), windowHeight);
+			drawBatches.insert(drawBatches.end(), chunk.LodSubmeshes[lod].begin(), chunk.LodSubmeshes[lod].end());
+		}
+		//group the visible ranges by material so each material is bound once per frame
+		std::sort(drawBatches.begin(), drawBatches.end(), [](const MeshSubmesh& a, const MeshSubmesh& b)
+		{
+			return a.MaterialIndex < b.MaterialIndex || (a.MaterialIndex == b.MaterialIndex && a.IndexOffset < b.IndexOffset);
+		});
 
-		ThrowIfFailed(commandList->Reset(commandAllocator, nullptr));
+		//pages requested last frame are copied in before anything samples them
+		virtualTexture.Update(commandList, frameContext);
+		virtualTexture.BeginFeedback(commandList);
+		if (feedbackPipeline.SetPipelineState(recorder))
+		{
+			feedbackPipeline.SetConstants(feedbackSceneBinding, cbVS, recorder);
+			feedbackPipeline.SetConstants(feedbackVirtualTextureBinding, virtualTexture.Constants, recorder);
+			recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			recorder.IASetVertexBuffer(0, mesh.vertexBufferView);
+			recorder.IASetIndexBuffer(mesh.indexBufferView);
+			for (const MeshSubmesh& batch : drawBatches)
+			{
+				recorder.DrawIndexedInstanced(batch.IndexCount, 1, batch.IndexOffset, 0, 0);
+			}
+		}
+		virtualTexture.EndFeedback(commandList, frameContext);
 
-        pipeline.SetPipelineState(commandAllocator, commandList);
+        //a pipeline whose texture table did not fit in the frame ring skips its draws, the targets are still cleared
+        bool sceneBound = pipeline.SetPipelineState(recorder);
 
         commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[frameIndex], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
 
@@ -517,11 +856,27 @@ int main(int argc, char* argv[])
 		commandList->RSSetViewports(1, &viewport);
 		commandList->RSSetScissorRects(1, &surfaceSize);
 		commandList->ClearRenderTargetView(rtvHandle2, clearColor, 0, nullptr);
-		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		pipeline.BindConstantBuffer("cb", &sceneBuffer, commandList);
-		commandList->IASetVertexBuffers(0, 1, &mesh.vertexBufferView);
-		//commandList->IASetIndexBuffer(&indexBufferView);
-        commandList->DrawInstanced(mesh._vertices.size(), 1, 0, 0);
+		if (sceneBound)
+		{
+			recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			pipeline.SetConstants(sceneBinding, cbVS, recorder);
+			pipeline.SetConstants(virtualTextureBinding, virtualTexture.Constants, recorder);
+			recorder.IASetVertexBuffer(0, mesh.vertexBufferView);
+			recorder.IASetIndexBuffer(mesh.indexBufferView);
+			uint32_t boundMaterial = UINT32_MAX;
+			for (const MeshSubmesh& batch : drawBatches)
+			{
+				if (batch.MaterialIndex != boundMaterial)
+				{
+					pipeline.SetConstants(materialBinding, mesh._materials[batch.MaterialIndex], recorder);
+					boundMaterial = batch.MaterialIndex;
+				}
+				recorder.DrawIndexedInstanced(batch.IndexCount, 1, batch.IndexOffset, 0, 0);
+			}
+		}
+#ifdef DEBUG_CHUNK_CULLING
+		std::cout << "visible chunks " << visibleChunks.size() << "/" << mesh._chunks.size() << std::endl;
+#endif
 
 
 		D3D12_CPU_DESCRIPTOR_HANDLE
@@ -535,10 +890,13 @@ int main(int argc, char* argv[])
 		
         commandList->OMSetRenderTargets(1, &rtvHandle3, FALSE, &dsvHandle);
 
-        depthBackPipeline.SetPipelineState(commandAllocator, commandList);
-    	depthBackPipeline.BindConstantBuffer("cb", &cubeBuffer, commandList);
-		commandList->IASetVertexBuffers(0, 1, &cubeMesh.vertexBufferView);
-        commandList->DrawInstanced(cubeMesh._vertices.size(), 1, 0, 0);
+        if (depthBackPipeline.SetPipelineState(recorder))
+        {
+            depthBackPipeline.SetConstants(depthBackCubeBinding, CubeMvp, recorder);
+            recorder.IASetVertexBuffer(0, cubeMesh.vertexBufferView);
+            recorder.IASetIndexBuffer(cubeMesh.indexBufferView);
+            recorder.DrawIndexedInstanced(cubeMesh._indices.size(), 1, 0, 0, 0);
+        }
 
 		D3D12_CPU_DESCRIPTOR_HANDLE
 			rtvHandle4(sideRenderTargetViewHeap->GetCPUDescriptorHandleForHeapStart());
@@ -547,10 +905,13 @@ int main(int argc, char* argv[])
 		commandList->ClearRenderTargetView(rtvHandle4, clearColorx, 0, nullptr);
         
         commandList->OMSetRenderTargets(1, &rtvHandle4, FALSE, &dsvHandle);
-        depthFrontPipeline.SetPipelineState(commandAllocator, commandList);
-    	depthFrontPipeline.BindConstantBuffer("cb", &cubeBuffer, commandList);
-		commandList->IASetVertexBuffers(0, 1, &cubeMesh.vertexBufferView);
-        commandList->DrawInstanced(cubeMesh._vertices.size(), 1, 0, 0);
+        if (depthFrontPipeline.SetPipelineState(recorder))
+        {
+            depthFrontPipeline.SetConstants(depthFrontCubeBinding, CubeMvp, recorder);
+            recorder.IASetVertexBuffer(0, cubeMesh.vertexBufferView);
+            recorder.IASetIndexBuffer(cubeMesh.indexBufferView);
+            recorder.DrawIndexedInstanced(cubeMesh._indices.size(), 1, 0, 0, 0);
+        }
 
 
 		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(backDepthRenderTargets[frameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE));
@@ -560,12 +921,25 @@ int main(int argc, char* argv[])
         commandList->ClearDepthStencilView(dsDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
                                            D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-        volumetricPipeline.SetPipelineState(commandAllocator, commandList);
-    	volumetricPipeline.BindConstantBuffer("cb", &cubeBuffer, commandList);
-    	volumetricPipeline.BindTexture(device, "frontCulled", backDepthRenderTargets[frameIndex]);
-    	volumetricPipeline.BindTexture(device, "backCulled", frontDepthRenderTargets[frameIndex]);
-		commandList->IASetVertexBuffers(0, 1, &triangle.vertexBufferView);
-        commandList->DrawInstanced(triangle._vertices.size(), 1, 0, 0);
+        Pipeline& volumetricPipeline = getVolumetricPipeline(volumetricQuality);
+        //table textures are copied into the frame ring by SetPipelineState, so they are bound first
+        if (!bindlessSupported)
+        {
+            volumetricPipeline.BindTexture(device, volumetricBindings[volumetricQuality].FrontCulled, backDepthRenderTargets[frameIndex]);
+            volumetricPipeline.BindTexture(device, volumetricBindings[volumetricQuality].BackCulled, frontDepthRenderTargets[frameIndex]);
+        }
+        if (volumetricPipeline.SetPipelineState(recorder))
+        {
+            volumetricPipeline.SetConstants(volumetricBindings[volumetricQuality].Cube, CubeMvp, recorder);
+            if (bindlessSupported)
+            {
+                volumetricPipeline.SetBindlessIndex(volumetricBindings[volumetricQuality].FrontCulled, backDepthIndices[frameIndex], recorder);
+                volumetricPipeline.SetBindlessIndex(volumetricBindings[volumetricQuality].BackCulled, frontDepthIndices[frameIndex], recorder);
+            }
+            recorder.IASetVertexBuffer(0, triangle.vertexBufferView);
+            recorder.IASetIndexBuffer(triangle.indexBufferView);
+            recorder.DrawIndexedInstanced(triangle._indices.size(), 1, 0, 0, 0);
+        }
 
         commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[frameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 
@@ -576,19 +950,22 @@ int main(int argc, char* argv[])
 
 		 swapchain->Present(1, 0);
 
-		// Signal and increment the fence value.
-		ThrowIfFailed(commandQueue->Signal(fence, fenceValue++));
-
-		// Wait until the previous frame is finished.
-		if (fence->GetCompletedValue() < fenceValue - 1)
-		{
-			ThrowIfFailed(fence->SetEventOnCompletion(fenceValue - 1, fenceEvent));
-			WaitForSingleObject(fenceEvent, INFINITE);
-		}
+		uint64_t frameFenceValue = frameScheduler.EndFrame();
+		bindlessHeap.FinishFrame(frameFenceValue);
+		uploadRing.FinishFrame(frameFenceValue);
+		releaseQueue.FinishFrame(frameFenceValue);
 
 		frameIndex = swapchain->GetCurrentBackBufferIndex();
 
     }
+    //wait for the gpu to go idle before the rings, heaps, pipelines and the release queue are released
+    frameScheduler.WaitForIdle();
+
+    virtualTexture.ReportStats();
+    frameScheduler.ReportStats();
+    std::cout << "Command recorder: " << recorder.GetStats().Issued << " state calls issued, " << recorder.GetStats().Elided << " elided" << std::endl;
+    //volumetric quality levels and hot reloads build pipelines after startup
+    PipelineStateCache::GetInstance()->Save();
 
     SDL_DestroyWindow(GWindow);
     SDL_Quit();
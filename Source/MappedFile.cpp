@@ -0,0 +1,61 @@
+#include "MappedFile.h"
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(LPCWSTR filename)
+{
+	Close();
+
+	File = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(File, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	Mapping = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(Mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	Data = static_cast<const uint8_t*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+	if(Data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	Size = size_t(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+	if(Mapping)
+	{
+		CloseHandle(Mapping);
+	}
+	if(File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(File);
+	}
+	Data = nullptr;
+	Size = 0;
+	Mapping = nullptr;
+	File = INVALID_HANDLE_VALUE;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+//read only view of a whole file, pages are faulted in by the os as they are touched
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	//returns false when the file does not exist or is empty
+	bool Open(LPCWSTR filename);
+	void Close();
+
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+
+private:
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+};
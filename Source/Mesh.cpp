@@ -1,6 +1,15 @@
 #include "Mesh.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <tuple>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "MeshSimplifier.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -27,6 +36,30 @@ bool Mesh::loadFromObj(ID3D12Device* device, const char* filename)
         return false;
     }
 
+    //faces without a material use a white default appended after the obj materials
+    for(const auto& material : materials)
+    {
+        _materials.push_back({ {material.diffuse[0], material.diffuse[1], material.diffuse[2]}, 0.f });
+    }
+    const int defaultMaterial = static_cast<int>(_materials.size());
+    _materials.push_back({ {1.f, 1.f, 1.f}, 0.f });
+
+    //obj faces reference separate position/normal/uv streams, weld identical combinations into one
+    //indexed vertex. Vertices are not shared across materials so lods keep the material borders.
+    struct VertexKey
+    {
+        int vertex;
+        int normal;
+        int texcoord;
+        int material;
+
+        bool operator<(const VertexKey& other) const
+        {
+            return std::tie(vertex, normal, texcoord, material) < std::tie(other.vertex, other.normal, other.texcoord, other.material);
+        }
+    };
+    std::map<VertexKey, uint32_t> uniqueVertices;
+
     for(size_t s = 0; s < shapes.size(); s++)
     {
         size_t index_offset = 0;
@@ -37,6 +70,15 @@ bool Mesh::loadFromObj(ID3D12Device* device, const char* filename)
             {
                 tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
 
+                int materialIndex = shapes[s].mesh.material_ids[f] >= 0 ? shapes[s].mesh.material_ids[f] : defaultMaterial;
+                VertexKey key = { idx.vertex_index, idx.normal_index, idx.texcoord_index, materialIndex };
+                auto found = uniqueVertices.find(key);
+                if(found != uniqueVertices.end())
+                {
+                    _indices.push_back(found->second);
+                    continue;
+                }
+
                 tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
                 tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
                 tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
@@ -49,68 +91,211 @@ bool Mesh::loadFromObj(ID3D12Device* device, const char* filename)
                 tinyobj::real_t ux = attrib.texcoords[2 * idx.texcoord_index + 0];
                 tinyobj::real_t uy = attrib.texcoords[2 * idx.texcoord_index + 1];
 
-                tinyobj::real_t cx = materials[shapes[s].mesh.material_ids[f]].diffuse[0];
-                tinyobj::real_t cy = materials[shapes[s].mesh.material_ids[f]].diffuse[1];
-                tinyobj::real_t cz = materials[shapes[s].mesh.material_ids[f]].diffuse[2];
-
                 Vertex new_vert =
                 {
                     {vx, vy, vz},
                     {nx, ny, nz},
-					{cx, cy, cz},
                     {ux, 1-uy}
                 };
 
+                uint32_t newIndex = static_cast<uint32_t>(_vertices.size());
+                uniqueVertices[key] = newIndex;
                 _vertices.push_back(new_vert);
+                _vertexMaterials.push_back(materialIndex);
+                _indices.push_back(newIndex);
             }
             index_offset += fv;
         }
     }
 
-    const UINT vertexBufferSize = _vertices.size() * sizeof(Vertex);
+    uploadBuffers(device);
 
-    D3D12_HEAP_PROPERTIES heapProps;
-    heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-    heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-    heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-    heapProps.CreationNodeMask = 1;
-    heapProps.VisibleNodeMask = 1;
+	return true;
+}
 
-    D3D12_RESOURCE_DESC vertexBufferResourceDesc;
-    vertexBufferResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    vertexBufferResourceDesc.Alignment = 0;
-    vertexBufferResourceDesc.Width = vertexBufferSize;
-    vertexBufferResourceDesc.Height = 1;
-    vertexBufferResourceDesc.DepthOrArraySize = 1;
-    vertexBufferResourceDesc.MipLevels = 1;
-    vertexBufferResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-    vertexBufferResourceDesc.SampleDesc.Count = 1;
-    vertexBufferResourceDesc.SampleDesc.Quality = 0;
-    vertexBufferResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-    vertexBufferResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+bool Mesh::loadFromVertices(ID3D12Device* device, std::vector<Vertex>& vertices)
+{
+    _vertices = vertices;
+    _materials = { { {1.f, 1.f, 1.f}, 0.f } };
+    _vertexMaterials.assign(_vertices.size(), 0);
+    _indices.resize(_vertices.size());
+    for(uint32_t i = 0; i < _indices.size(); i++)
+    {
+        _indices[i] = i;
+    }
 
-    ThrowIfFailed(device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &vertexBufferResourceDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&vertexBuffer)));
+    uploadBuffers(device);
 
-    UINT8* pVertexDataBegin;
+	return true;
+}
 
-    D3D12_RANGE readRange;
-    readRange.Begin = 0;
-    readRange.End = 0;
+void Mesh::generateLods(ID3D12Device* device, const std::vector<float>& triangleRatios)
+{
+    const size_t fullTriangleCount = _lods[0].IndexCount / 3;
+    const uint32_t partitionCount = std::max<uint32_t>(1, static_cast<uint32_t>(_chunks.size()));
 
-    ThrowIfFailed(vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-    memcpy(pVertexDataBegin, _vertices.data(), vertexBufferSize);
-    vertexBuffer->Unmap(0, nullptr);
+    std::vector<uint32_t> previousPartitions;
+    for(size_t level = 0; level < triangleRatios.size(); level++)
+    {
+        //every level is built from the previous one. Chunks are simplified separately with the vertices they
+        //share locked, so neighbouring chunks drawn at different levels still meet along the same edges
+        const MeshLod previous = _lods.back();
+        std::vector<uint32_t> previousIndices(_indices.begin() + previous.IndexOffset, _indices.begin() + previous.IndexOffset + previous.IndexCount);
+        previousPartitions.assign(previous.IndexCount / 3, 0);
+        for(uint32_t c = 0; c < _chunks.size(); c++)
+        {
+            const MeshLod& chunkLod = _chunks[c].Lods.back();
+            if(chunkLod.IndexCount == 0)
+                continue;
+            uint32_t firstTriangle = (chunkLod.IndexOffset - previous.IndexOffset) / 3;
+            std::fill_n(previousPartitions.begin() + firstTriangle, chunkLod.IndexCount / 3, c);
+        }
 
-    vertexBufferView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
-    vertexBufferView.StrideInBytes = sizeof(Vertex);
-    vertexBufferView.SizeInBytes = vertexBufferSize;
+        SimplifyResult result = SimplifyMeshPartitioned(_vertices, previousIndices, previousPartitions, partitionCount, static_cast<size_t>(fullTriangleCount * triangleRatios[level]));
+        if(result.Indices.size() >= previousIndices.size())
+            break;
 
-	return true;
+        MeshLod lod;
+        lod.IndexOffset = static_cast<uint32_t>(_indices.size());
+        lod.IndexCount = static_cast<uint32_t>(result.Indices.size());
+        lod.Error = previous.Error + result.Error;
+        _indices.insert(_indices.end(), result.Indices.begin(), result.Indices.end());
+        _lods.push_back(lod);
+
+        if(!_chunks.empty())
+        {
+            sortChunkLevel(_lods.size() - 1, result.TrianglePartitions);
+        }
+    }
+
+    indexBuffer->Release();
+    uploadIndexBuffer(device);
 }
 
-bool Mesh::loadFromVertices(ID3D12Device* device, std::vector<Vertex>& vertices)
+void Mesh::buildChunks(ID3D12Device* device, uint32_t chunksPerAxis)
 {
-    _vertices = vertices;
+    //chunks are cut from the full detail level, generateLods derives every coarser level chunk by chunk
+    _lods.resize(1);
+    _indices.resize(_lods[0].IndexOffset + _lods[0].IndexCount);
+
+    glm::vec3 boundsMin = boundsCenter - glm::vec3(boundsRadius);
+    glm::vec3 extent(0.f);
+    for(const auto& vertex : _vertices)
+    {
+        extent = glm::max(extent, vertex.position - boundsMin);
+    }
+    const float cellSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) / chunksPerAxis;
+
+    std::map<uint32_t, uint32_t> cellToChunk;
+    const MeshLod& lod = _lods[0];
+    const uint32_t triangleCount = lod.IndexCount / 3;
+    const uint32_t* triangles = &_indices[lod.IndexOffset];
+    std::vector<uint32_t> triangleChunk(triangleCount);
+
+    _chunks.clear();
+    for(uint32_t t = 0; t < triangleCount; t++)
+    {
+        glm::vec3 centroid = (_vertices[triangles[t * 3]].position + _vertices[triangles[t * 3 + 1]].position + _vertices[triangles[t * 3 + 2]].position) / 3.f;
+        glm::vec3 cellPosition = (centroid - boundsMin) / cellSize;
+
+        uint32_t cell = 0;
+        for(int axis = 2; axis >= 0; axis--)
+        {
+            uint32_t coordinate = static_cast<uint32_t>(std::clamp(cellPosition[axis], 0.f, float(chunksPerAxis - 1)));
+            cell = cell * chunksPerAxis + coordinate;
+        }
+
+        auto [it, inserted] = cellToChunk.emplace(cell, static_cast<uint32_t>(_chunks.size()));
+        if(inserted)
+        {
+            MeshChunk chunk;
+            chunk.BoundsMin = glm::vec3(FLT_MAX);
+            chunk.BoundsMax = glm::vec3(-FLT_MAX);
+            _chunks.push_back(chunk);
+        }
+        triangleChunk[t] = it->second;
+
+        //coarser levels only reuse vertices of the chunk's own triangles, so the box covers them as well
+        MeshChunk& chunk = _chunks[it->second];
+        for(int k = 0; k < 3; k++)
+        {
+            chunk.BoundsMin = glm::min(chunk.BoundsMin, _vertices[triangles[t * 3 + k]].position);
+            chunk.BoundsMax = glm::max(chunk.BoundsMax, _vertices[triangles[t * 3 + k]].position);
+        }
+    }
+    sortChunkLevel(0, triangleChunk);
+
+    chunkBounds = {};
+    for(const auto& chunk : _chunks)
+    {
+        chunkBounds.Add(chunk.BoundsMin, chunk.BoundsMax);
+    }
+
+    indexBuffer->Release();
+    uploadIndexBuffer(device);
+}
+
+void Mesh::sortChunkLevel(size_t level, const std::vector<uint32_t>& triangleChunk)
+{
+    const MeshLod& lod = _lods[level];
+    const uint32_t triangleCount = lod.IndexCount / 3;
+    const uint32_t* triangles = &_indices[lod.IndexOffset];
+
+    for(auto& chunk : _chunks)
+    {
+        chunk.Lods.push_back({ 0, 0, lod.Error });
+        chunk.LodSubmeshes.emplace_back();
+    }
+
+    //order the level's triangles by chunk, then by material so every chunk lod splits into one range per material
+    std::vector<uint32_t> triangleOrder(triangleCount);
+    for(uint32_t t = 0; t < triangleCount; t++)
+    {
+        triangleOrder[t] = t;
+    }
+    std::sort(triangleOrder.begin(), triangleOrder.end(), [&](uint32_t a, uint32_t b)
+    {
+        return std::make_tuple(triangleChunk[a], _vertexMaterials[triangles[a * 3]], a) < std::make_tuple(triangleChunk[b], _vertexMaterials[triangles[b * 3]], b);
+    });
+
+    std::vector<uint32_t> sorted(lod.IndexCount);
+    for(uint32_t i = 0; i < triangleCount; i++)
+    {
+        uint32_t t = triangleOrder[i];
+        memcpy(&sorted[i * 3], &triangles[t * 3], sizeof(uint32_t) * 3);
+
+        MeshChunk& chunk = _chunks[triangleChunk[t]];
+        uint32_t indexOffset = lod.IndexOffset + i * 3;
+        uint32_t materialIndex = _vertexMaterials[triangles[t * 3]];
+        auto& submeshes = chunk.LodSubmeshes[level];
+        if(submeshes.empty())
+        {
+            chunk.Lods[level].IndexOffset = indexOffset;
+        }
+        if(submeshes.empty() || submeshes.back().MaterialIndex != materialIndex)
+        {
+            submeshes.push_back({ materialIndex, indexOffset, 0 });
+        }
+        submeshes.back().IndexCount += 3;
+        chunk.Lods[level].IndexCount += 3;
+    }
+    memcpy(&_indices[lod.IndexOffset], sorted.data(), sorted.size() * sizeof(uint32_t));
+}
+
+void Mesh::uploadBuffers(ID3D12Device* device)
+{
+    _lods = { { 0, static_cast<uint32_t>(_indices.size()), 0.f } };
+
+    glm::vec3 boundsMin(FLT_MAX);
+    glm::vec3 boundsMax(-FLT_MAX);
+    for(const auto& vertex : _vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+    boundsCenter = (boundsMin + boundsMax) * 0.5f;
+    boundsRadius = glm::length(boundsMax - boundsCenter);
+
     const UINT vertexBufferSize = _vertices.size() * sizeof(Vertex);
 
     D3D12_HEAP_PROPERTIES heapProps;
@@ -149,5 +334,32 @@ bool Mesh::loadFromVertices(ID3D12Device* device, std::vector<Vertex>& vertices)
     vertexBufferView.StrideInBytes = sizeof(Vertex);
     vertexBufferView.SizeInBytes = vertexBufferSize;
 
-	return true;
+    uploadIndexBuffer(device);
+}
+
+void Mesh::uploadIndexBuffer(ID3D12Device* device)
+{
+    const UINT indexBufferSize = _indices.size() * sizeof(uint32_t);
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&indexBuffer)));
+
+    UINT8* pIndexDataBegin;
+
+    D3D12_RANGE readRange;
+    readRange.Begin = 0;
+    readRange.End = 0;
+
+    ThrowIfFailed(indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pIndexDataBegin)));
+    memcpy(pIndexDataBegin, _indices.data(), indexBufferSize);
+    indexBuffer->Unmap(0, nullptr);
+
+    indexBufferView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
+    indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    indexBufferView.SizeInBytes = indexBufferSize;
 }
@@ -3,13 +3,13 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include "pch.h"
+#include "Frustum.h"
 
 
 struct Vertex
 {
 	glm::vec3 position;
 	glm::vec3 normal;
-	glm::vec3 color;
 	glm::vec2 uv;
 
 	static inline D3D12_INPUT_ELEMENT_DESC Description[] = 
@@ -18,20 +18,77 @@ struct Vertex
 		 D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
 		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, sizeof(glm::vec3) ,
 		 D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-		{"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, sizeof(glm::vec3) * 2,
-		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, sizeof(glm::vec3) * 3,
+		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, sizeof(glm::vec3) * 2,
 		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
 	};
 };
 
+//matches the material cbuffer in triangle.px.hlsl, bound as root constants per batch
+struct Material
+{
+	glm::vec3 diffuse;
+	float padding;
+};
+
+//range of Mesh::_indices drawn for one level of detail
+struct MeshLod
+{
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+	float Error; //world space simplification error of this level
+};
+
+//triangles of a single material inside a chunk lod
+struct MeshSubmesh
+{
+	uint32_t MaterialIndex;
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+};
+
+//spatial cell of the mesh with its own index range for every lod
+struct MeshChunk
+{
+	glm::vec3 BoundsMin;
+	glm::vec3 BoundsMax;
+	std::vector<MeshLod> Lods;
+	std::vector<std::vector<MeshSubmesh>> LodSubmeshes; //material ranges inside each entry of Lods
+};
+
 struct Mesh
 {
 	std::vector<Vertex> _vertices;
+	std::vector<uint32_t> _indices;
+	std::vector<MeshLod> _lods;
+	std::vector<MeshChunk> _chunks;
+	std::vector<Material> _materials;
+	std::vector<uint32_t> _vertexMaterials; //vertices are split at material borders so each one has a single material
+	AabbList chunkBounds;
+
+	glm::vec3 boundsCenter;
+	float boundsRadius;
 
     ID3D12Resource* vertexBuffer;
     D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
 
+    ID3D12Resource* indexBuffer;
+    D3D12_INDEX_BUFFER_VIEW indexBufferView;
+
 	bool loadFromObj(ID3D12Device* device, const char* filename);
 	bool loadFromVertices(ID3D12Device* device, std::vector<Vertex>& vertices);
-};
\ No newline at end of file
+
+	//appends simplified levels at the given fractions of the full detail triangle count and re-uploads the index buffer.
+	//Call after buildChunks, every chunk is simplified on its own with the vertices it shares with other chunks locked
+	void generateLods(ID3D12Device* device, const std::vector<float>& triangleRatios);
+
+	//sorts the full detail triangles by cubic cells (chunksPerAxis along the longest axis) and by material inside each
+	//cell, then re-uploads the index buffer. Drops the coarser lods, generateLods rebuilds them per chunk
+	void buildChunks(ID3D12Device* device, uint32_t chunksPerAxis);
+
+private:
+	//creates upload heap vertex and index buffers from _vertices and _indices
+	void uploadBuffers(ID3D12Device* device);
+	void uploadIndexBuffer(ID3D12Device* device);
+	//sorts the triangles of _lods[level] by chunk and material and appends the level's ranges to every chunk
+	void sortChunkLevel(size_t level, const std::vector<uint32_t>& triangleChunk);
+};
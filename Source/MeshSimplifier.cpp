@@ -0,0 +1,485 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace
+{
+	//symmetric 4x4 plane quadric, evaluated as p^T A p + 2 b.p + c
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		void AddPlane(const glm::vec3& normal, float distance, double planeWeight)
+		{
+			double nx = normal.x, ny = normal.y, nz = normal.z, d = distance;
+			a00 += planeWeight * nx * nx; a01 += planeWeight * nx * ny; a02 += planeWeight * nx * nz;
+			a11 += planeWeight * ny * ny; a12 += planeWeight * ny * nz; a22 += planeWeight * nz * nz;
+			b0 += planeWeight * nx * d; b1 += planeWeight * ny * d; b2 += planeWeight * nz * d;
+			c += planeWeight * d * d;
+			weight += planeWeight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a00 += other.a00; a01 += other.a01; a02 += other.a02;
+			a11 += other.a11; a12 += other.a12; a22 += other.a22;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+		}
+
+		double Evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double result = a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+			return std::max(result, 0.0);
+		}
+	};
+
+	struct Collapse
+	{
+		double Cost;
+		uint32_t From;
+		uint32_t To;
+		uint32_t Version;
+
+		bool operator>(const Collapse& other) const { return Cost > other.Cost; }
+	};
+
+	//open edges are held in place by a plane through the edge perpendicular to its triangle
+	constexpr double BorderWeight = 10.0;
+
+	struct PartitionResult
+	{
+		std::vector<uint32_t> Indices;
+		float Error = 0.f;
+	};
+
+	PartitionResult SimplifyPartition(const std::vector<Vertex>& vertices, const std::vector<uint8_t>& locked,
+	                                  const uint32_t* triangleIndices, size_t triangleCount, size_t targetTriangleCount)
+	{
+		PartitionResult result;
+
+		//local vertex numbering
+		std::vector<uint32_t> globalIndex(triangleIndices, triangleIndices + triangleCount * 3);
+		std::sort(globalIndex.begin(), globalIndex.end());
+		globalIndex.erase(std::unique(globalIndex.begin(), globalIndex.end()), globalIndex.end());
+		auto toLocal = [&](uint32_t index)
+		{
+			return static_cast<uint32_t>(std::lower_bound(globalIndex.begin(), globalIndex.end(), index) - globalIndex.begin());
+		};
+
+		const size_t vertexCount = globalIndex.size();
+		std::vector<uint32_t> triangles(triangleCount * 3);
+		for(size_t i = 0; i < triangles.size(); i++)
+		{
+			triangles[i] = toLocal(triangleIndices[i]);
+		}
+		auto position = [&](uint32_t local) -> const glm::vec3& { return vertices[globalIndex[local]].position; };
+
+		std::vector<uint8_t> alive(triangleCount, 1);
+		std::vector<std::vector<uint32_t>> adjacency(vertexCount);
+		std::vector<Quadric> quadrics(vertexCount);
+		std::unordered_map<uint64_t, uint32_t> edgeUse;
+
+		size_t liveTriangles = triangleCount;
+		for(uint32_t t = 0; t < triangleCount; t++)
+		{
+			const uint32_t* tri = &triangles[t * 3];
+			if(tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+			{
+				alive[t] = 0;
+				liveTriangles--;
+				continue;
+			}
+
+			glm::vec3 normal = glm::cross(position(tri[1]) - position(tri[0]), position(tri[2]) - position(tri[0]));
+			float area = glm::length(normal);
+			if(area > 0.f)
+			{
+				normal /= area;
+				for(int k = 0; k < 3; k++)
+				{
+					quadrics[tri[k]].AddPlane(normal, -glm::dot(normal, position(tri[0])), area * 0.5);
+				}
+			}
+
+			for(int k = 0; k < 3; k++)
+			{
+				adjacency[tri[k]].push_back(t);
+				uint32_t a = std::min(tri[k], tri[(k + 1) % 3]);
+				uint32_t b = std::max(tri[k], tri[(k + 1) % 3]);
+				edgeUse[(uint64_t(a) << 32) | b]++;
+			}
+		}
+
+		for(uint32_t t = 0; t < triangleCount; t++)
+		{
+			if(!alive[t])
+				continue;
+
+			const uint32_t* tri = &triangles[t * 3];
+			glm::vec3 normal = glm::cross(position(tri[1]) - position(tri[0]), position(tri[2]) - position(tri[0]));
+			for(int k = 0; k < 3; k++)
+			{
+				uint32_t a = tri[k];
+				uint32_t b = tri[(k + 1) % 3];
+				if(edgeUse[(uint64_t(std::min(a, b)) << 32) | std::max(a, b)] != 1)
+					continue;
+
+				glm::vec3 edge = position(b) - position(a);
+				glm::vec3 borderNormal = glm::cross(edge, normal);
+				float length = glm::length(borderNormal);
+				if(length <= 0.f)
+					continue;
+
+				borderNormal /= length;
+				double weight = glm::dot(edge, edge) * BorderWeight;
+				quadrics[a].AddPlane(borderNormal, -glm::dot(borderNormal, position(a)), weight);
+				quadrics[b].AddPlane(borderNormal, -glm::dot(borderNormal, position(a)), weight);
+			}
+		}
+
+		std::vector<uint8_t> removed(vertexCount, 0);
+		std::vector<uint32_t> version(vertexCount, 0);
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+		auto cost = [&](uint32_t from, uint32_t to)
+		{
+			Quadric merged = quadrics[from];
+			merged.Add(quadrics[to]);
+			return merged.weight > 0 ? merged.Evaluate(position(to)) / merged.weight : 0.0;
+		};
+
+		//finds the cheapest neighbour to collapse the vertex onto, dead triangles are dropped from its list on the way
+		auto pushBestCollapse = [&](uint32_t from)
+		{
+			auto& vertexTriangles = adjacency[from];
+			vertexTriangles.erase(std::remove_if(vertexTriangles.begin(), vertexTriangles.end(), [&](uint32_t t) { return !alive[t]; }), vertexTriangles.end());
+
+			version[from]++;
+			if(removed[from] || locked[globalIndex[from]])
+				return;
+
+			Collapse best = { DBL_MAX, from, from, version[from] };
+			for(uint32_t t : vertexTriangles)
+			{
+				for(int k = 0; k < 3; k++)
+				{
+					uint32_t to = triangles[t * 3 + k];
+					if(to == from)
+						continue;
+
+					double collapseCost = cost(from, to);
+					if(collapseCost < best.Cost)
+					{
+						best.Cost = collapseCost;
+						best.To = to;
+					}
+				}
+			}
+
+			if(best.To != from)
+				queue.push(best);
+		};
+
+		//a collapse is rejected when one of the remaining triangles around the vertex would flip
+		auto collapseFlips = [&](uint32_t from, uint32_t to)
+		{
+			for(uint32_t t : adjacency[from])
+			{
+				if(!alive[t])
+					continue;
+
+				const uint32_t* tri = &triangles[t * 3];
+				if(tri[0] == to || tri[1] == to || tri[2] == to)
+					continue;
+
+				glm::vec3 corners[3] = { position(tri[0]), position(tri[1]), position(tri[2]) };
+				glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				for(int k = 0; k < 3; k++)
+				{
+					if(tri[k] == from)
+						corners[k] = position(to);
+				}
+				glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				if(glm::dot(before, after) <= 0.f)
+					return true;
+			}
+			return false;
+		};
+
+		for(uint32_t v = 0; v < vertexCount; v++)
+		{
+			pushBestCollapse(v);
+		}
+
+		double maxCost = 0.0;
+		std::vector<uint32_t> neighbours;
+		while(liveTriangles > targetTriangleCount && !queue.empty())
+		{
+			Collapse collapse = queue.top();
+			queue.pop();
+
+			if(removed[collapse.From] || collapse.Version != version[collapse.From])
+				continue;
+
+			if(removed[collapse.To])
+			{
+				pushBestCollapse(collapse.From);
+				continue;
+			}
+
+			if(collapseFlips(collapse.From, collapse.To))
+			{
+				//stays out of the queue until a neighbouring collapse changes its surroundings
+				version[collapse.From]++;
+				continue;
+			}
+
+			for(uint32_t t : adjacency[collapse.From])
+			{
+				if(!alive[t])
+					continue;
+
+				uint32_t* tri = &triangles[t * 3];
+				if(tri[0] == collapse.To || tri[1] == collapse.To || tri[2] == collapse.To)
+				{
+					alive[t] = 0;
+					liveTriangles--;
+					continue;
+				}
+
+				for(int k = 0; k < 3; k++)
+				{
+					if(tri[k] == collapse.From)
+						tri[k] = collapse.To;
+				}
+				adjacency[collapse.To].push_back(t);
+			}
+
+			removed[collapse.From] = 1;
+			adjacency[collapse.From].clear();
+			quadrics[collapse.To].Add(quadrics[collapse.From]);
+			maxCost = std::max(maxCost, collapse.Cost);
+
+			neighbours.clear();
+			for(uint32_t t : adjacency[collapse.To])
+			{
+				if(!alive[t])
+					continue;
+				neighbours.insert(neighbours.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+			}
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+			for(uint32_t v : neighbours)
+			{
+				pushBestCollapse(v);
+			}
+		}
+
+		result.Indices.reserve(liveTriangles * 3);
+		for(uint32_t t = 0; t < triangleCount; t++)
+		{
+			if(!alive[t])
+				continue;
+			for(int k = 0; k < 3; k++)
+			{
+				result.Indices.push_back(globalIndex[triangles[t * 3 + k]]);
+			}
+		}
+		result.Error = static_cast<float>(std::sqrt(maxCost));
+		return result;
+	}
+}
+
+namespace
+{
+	//vertices sharing a position with a differently attributed vertex sit on a uv or material seam
+	std::vector<uint8_t> FindSeamVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				uint32_t bits[3];
+				memcpy(bits, &p, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+
+		std::vector<uint8_t> locked(vertices.size(), 0);
+		std::unordered_map<glm::vec3, uint32_t, PositionHash> firstAtPosition;
+		for(uint32_t index : indices)
+		{
+			auto [it, inserted] = firstAtPosition.emplace(vertices[index].position, index);
+			if(!inserted && it->second != index)
+			{
+				locked[index] = 1;
+				locked[it->second] = 1;
+			}
+		}
+		return locked;
+	}
+
+	SimplifyResult SimplifyPartitions(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<uint8_t> locked,
+	                                  const std::vector<uint32_t>& trianglePartitions, uint32_t partitionCount, size_t targetTriangleCount)
+	{
+		const size_t triangleCount = indices.size() / 3;
+
+		std::vector<uint32_t> partitionTriangleCount(partitionCount, 0);
+		std::vector<uint32_t> vertexPartition(vertices.size(), UINT32_MAX);
+		for(size_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t partition = trianglePartitions[t];
+			partitionTriangleCount[partition]++;
+
+			//vertices used by more than one partition keep the partitions stitched together
+			for(int k = 0; k < 3; k++)
+			{
+				uint32_t index = indices[t * 3 + k];
+				if(vertexPartition[index] == UINT32_MAX)
+					vertexPartition[index] = partition;
+				else if(vertexPartition[index] != partition)
+					locked[index] = 1;
+			}
+		}
+
+		std::vector<uint32_t> partitionOffset(partitionCount + 1, 0);
+		for(uint32_t partition = 0; partition < partitionCount; partition++)
+		{
+			partitionOffset[partition + 1] = partitionOffset[partition] + partitionTriangleCount[partition];
+		}
+
+		std::vector<uint32_t> sortedIndices(indices.size());
+		{
+			std::vector<uint32_t> cursor(partitionOffset.begin(), partitionOffset.end() - 1);
+			for(size_t t = 0; t < triangleCount; t++)
+			{
+				uint32_t slot = cursor[trianglePartitions[t]]++;
+				memcpy(&sortedIndices[slot * 3], &indices[t * 3], sizeof(uint32_t) * 3);
+			}
+		}
+
+		const double targetRatio = double(targetTriangleCount) / triangleCount;
+		std::vector<PartitionResult> partitions(partitionCount);
+		std::atomic<uint32_t> nextPartition = 0;
+		auto worker = [&]()
+		{
+			for(uint32_t partition = nextPartition++; partition < partitions.size(); partition = nextPartition++)
+			{
+				if(partitionTriangleCount[partition] == 0)
+					continue;
+
+				size_t target = static_cast<size_t>(std::ceil(partitionTriangleCount[partition] * targetRatio));
+				partitions[partition] = SimplifyPartition(vertices, locked, &sortedIndices[partitionOffset[partition] * 3], partitionTriangleCount[partition], target);
+			}
+		};
+
+		std::vector<std::thread> threads(std::max(1u, std::thread::hardware_concurrency()) - 1);
+		for(auto& thread : threads)
+		{
+			thread = std::thread(worker);
+		}
+		worker();
+		for(auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		SimplifyResult result;
+		for(uint32_t partition = 0; partition < partitionCount; partition++)
+		{
+			const PartitionResult& simplified = partitions[partition];
+			result.Indices.insert(result.Indices.end(), simplified.Indices.begin(), simplified.Indices.end());
+			result.TrianglePartitions.insert(result.TrianglePartitions.end(), simplified.Indices.size() / 3, partition);
+			result.Error = std::max(result.Error, simplified.Error);
+		}
+		return result;
+	}
+}
+
+SimplifyResult SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                            size_t targetTriangleCount, uint32_t partitionsPerAxis, float gridOffset)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if(triangleCount == 0 || targetTriangleCount >= triangleCount)
+	{
+		SimplifyResult result;
+		result.Indices = indices;
+		return result;
+	}
+
+	glm::vec3 boundsMin(FLT_MAX);
+	glm::vec3 boundsMax(-FLT_MAX);
+	for(uint32_t index : indices)
+	{
+		boundsMin = glm::min(boundsMin, vertices[index].position);
+		boundsMax = glm::max(boundsMax, vertices[index].position);
+	}
+
+	//the offset grid needs one extra cell per axis
+	const uint32_t cellsPerAxis = partitionsPerAxis + 1;
+	const glm::vec3 cellSize = glm::max((boundsMax - boundsMin) / float(partitionsPerAxis), glm::vec3(1e-6f));
+
+	std::vector<uint32_t> triangleCell(triangleCount);
+	for(size_t t = 0; t < triangleCount; t++)
+	{
+		glm::vec3 centroid = (vertices[indices[t * 3]].position + vertices[indices[t * 3 + 1]].position + vertices[indices[t * 3 + 2]].position) / 3.f;
+		glm::vec3 cellPosition = (centroid - boundsMin) / cellSize + glm::vec3(gridOffset);
+
+		uint32_t cell = 0;
+		for(int axis = 2; axis >= 0; axis--)
+		{
+			uint32_t coordinate = static_cast<uint32_t>(std::clamp(cellPosition[axis], 0.f, float(cellsPerAxis - 1)));
+			cell = cell * cellsPerAxis + coordinate;
+		}
+		triangleCell[t] = cell;
+	}
+
+	return SimplifyPartitions(vertices, indices, FindSeamVertices(vertices, indices), triangleCell, cellsPerAxis * cellsPerAxis * cellsPerAxis, targetTriangleCount);
+}
+
+SimplifyResult SimplifyMeshPartitioned(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                       const std::vector<uint32_t>& trianglePartitions, uint32_t partitionCount, size_t targetTriangleCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if(triangleCount == 0 || targetTriangleCount >= triangleCount)
+	{
+		SimplifyResult result;
+		result.Indices = indices;
+		result.TrianglePartitions = trianglePartitions;
+		return result;
+	}
+	return SimplifyPartitions(vertices, indices, FindSeamVertices(vertices, indices), trianglePartitions, partitionCount, targetTriangleCount);
+}
+
+uint32_t SelectLod(const std::vector<MeshLod>& lods, const glm::vec3& boundsCenter, float boundsRadius,
+                   const glm::vec3& eye, float fovY, float screenHeight, float maxPixelError)
+{
+	float distance = std::max(glm::length(boundsCenter - eye) - boundsRadius, 1e-3f);
+	float pixelsPerUnit = screenHeight / (2.f * std::tan(fovY * 0.5f) * distance);
+
+	uint32_t selected = 0;
+	for(uint32_t i = 1; i < lods.size(); i++)
+	{
+		if(lods[i].Error * pixelsPerUnit > maxPixelError)
+			break;
+		selected = i;
+	}
+	return selected;
+}
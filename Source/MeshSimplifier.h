@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include "Mesh.h"
+
+struct SimplifyResult
+{
+	std::vector<uint32_t> Indices;
+	float Error = 0.f; //largest world space distance introduced by a collapse
+	std::vector<uint32_t> TrianglePartitions; //partition of every triangle in Indices
+};
+
+//quadric error metric edge collapse over an indexed triangle list. Vertices are never moved,
+//a collapse snaps one vertex onto its neighbour so every level can share the original vertex buffer.
+//Vertices on uv/material seams and on open borders between partitions are kept in place.
+//The mesh is split into a partitionsPerAxis^3 grid (shifted by gridOffset cells) and the cells
+//are simplified in parallel.
+SimplifyResult SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                            size_t targetTriangleCount, uint32_t partitionsPerAxis = 4, float gridOffset = 0.f);
+
+//same as SimplifyMesh with the caller's partitions instead of the grid, trianglePartitions holds one id
+//below partitionCount per triangle. Triangles never move between partitions and vertices shared by two
+//partitions are locked, so partitions simplified to different levels still meet without cracks
+SimplifyResult SimplifyMeshPartitioned(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                       const std::vector<uint32_t>& trianglePartitions, uint32_t partitionCount, size_t targetTriangleCount);
+
+//picks the coarsest lod whose error projects to less than maxPixelError on screen
+uint32_t SelectLod(const std::vector<MeshLod>& lods, const glm::vec3& boundsCenter, float boundsRadius,
+                   const glm::vec3& eye, float fovY, float screenHeight, float maxPixelError = 1.f);
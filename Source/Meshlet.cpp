@@ -0,0 +1,177 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Frustum.h"
+
+namespace
+{
+	void ComputeMeshletBounds(const Mesh& mesh, const MeshletMesh& meshlets, Meshlet& meshlet)
+	{
+		const uint32_t* vertexIndices = &meshlets.VertexIndices[meshlet.VertexOffset];
+		const uint8_t* triangles = &meshlets.Triangles[meshlet.TriangleOffset];
+
+		glm::vec3 boundsMin = mesh._vertices[vertexIndices[0]].position;
+		glm::vec3 boundsMax = boundsMin;
+		for(uint32_t i = 1; i < meshlet.VertexCount; i++)
+		{
+			boundsMin = glm::min(boundsMin, mesh._vertices[vertexIndices[i]].position);
+			boundsMax = glm::max(boundsMax, mesh._vertices[vertexIndices[i]].position);
+		}
+
+		meshlet.Center = (boundsMin + boundsMax) * 0.5f;
+		meshlet.Radius = 0.f;
+		for(uint32_t i = 0; i < meshlet.VertexCount; i++)
+		{
+			meshlet.Radius = std::max(meshlet.Radius, glm::length(mesh._vertices[vertexIndices[i]].position - meshlet.Center));
+		}
+
+		//face normals are taken from the positions, vertex normals can be smoothed over the silhouette
+		std::vector<glm::vec3> faceNormals;
+		faceNormals.reserve(meshlet.TriangleCount);
+		glm::vec3 normalSum(0.f);
+		for(uint32_t t = 0; t < meshlet.TriangleCount; t++)
+		{
+			const glm::vec3& a = mesh._vertices[vertexIndices[triangles[t * 3 + 0]]].position;
+			const glm::vec3& b = mesh._vertices[vertexIndices[triangles[t * 3 + 1]]].position;
+			const glm::vec3& c = mesh._vertices[vertexIndices[triangles[t * 3 + 2]]].position;
+
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal);
+			normal = area > 0.f ? normal / area : glm::vec3(0.f);
+			faceNormals.push_back(normal);
+			normalSum += normal;
+		}
+
+		//degenerate cones get a cutoff that can never be satisfied
+		meshlet.ConeApex = meshlet.Center;
+		meshlet.ConeAxis = glm::vec3(0.f, 0.f, 1.f);
+		meshlet.ConeCutoff = 1.f;
+
+		float normalSumLength = glm::length(normalSum);
+		if(normalSumLength <= 0.f)
+			return;
+
+		glm::vec3 axis = normalSum / normalSumLength;
+		//zero area triangles are never rasterized, their zero normal would otherwise force minDot to 0
+		float minDot = 1.f;
+		for(const auto& normal : faceNormals)
+		{
+			if(normal != glm::vec3(0.f))
+				minDot = std::min(minDot, glm::dot(normal, axis));
+		}
+
+		//cones wider than ~84 degrees are not worth testing
+		if(minDot <= 0.1f)
+			return;
+
+		//the apex is the point along -axis that lies behind every triangle plane of the meshlet
+		float maxT = 0.f;
+		for(uint32_t t = 0; t < meshlet.TriangleCount; t++)
+		{
+			const glm::vec3& corner = mesh._vertices[vertexIndices[triangles[t * 3]]].position;
+			float dc = glm::dot(meshlet.Center - corner, faceNormals[t]);
+			float dn = glm::dot(axis, faceNormals[t]);
+			if(dn > 0.f)
+				maxT = std::max(maxT, dc / dn);
+		}
+
+		meshlet.ConeApex = meshlet.Center - axis * maxT;
+		meshlet.ConeAxis = axis;
+		meshlet.ConeCutoff = std::sqrt(1.f - minDot * minDot);
+	}
+}
+
+void BuildMeshlets(const Mesh& mesh, MeshletMesh& outMeshlets)
+{
+	outMeshlets = {};
+
+	//local index of each mesh vertex in the meshlet being built, 0xff when not used yet
+	std::vector<uint8_t> localIndex(mesh._vertices.size(), 0xff);
+
+	Meshlet current = {};
+	auto flush = [&]()
+	{
+		if(current.TriangleCount == 0)
+			return;
+
+		for(uint32_t i = 0; i < current.VertexCount; i++)
+		{
+			localIndex[outMeshlets.VertexIndices[current.VertexOffset + i]] = 0xff;
+		}
+
+		ComputeMeshletBounds(mesh, outMeshlets, current);
+		outMeshlets.Meshlets.push_back(current);
+
+		current = {};
+		current.VertexOffset = static_cast<uint32_t>(outMeshlets.VertexIndices.size());
+		current.TriangleOffset = static_cast<uint32_t>(outMeshlets.Triangles.size());
+	};
+
+	//meshlets are built for the full detail level only
+	const MeshLod& lod = mesh._lods[0];
+	for(size_t i = lod.IndexOffset; i + 2 < lod.IndexOffset + lod.IndexCount; i += 3)
+	{
+		uint32_t a = mesh._indices[i + 0];
+		uint32_t b = mesh._indices[i + 1];
+		uint32_t c = mesh._indices[i + 2];
+
+		uint32_t newVertices = (localIndex[a] == 0xff) + (localIndex[b] == 0xff && b != a) + (localIndex[c] == 0xff && c != a && c != b);
+		if(current.VertexCount + newVertices > Meshlet::MaxVertices || current.TriangleCount + 1 > Meshlet::MaxTriangles)
+		{
+			flush();
+		}
+
+		for(uint32_t vertex : {a, b, c})
+		{
+			if(localIndex[vertex] == 0xff)
+			{
+				localIndex[vertex] = static_cast<uint8_t>(current.VertexCount++);
+				outMeshlets.VertexIndices.push_back(vertex);
+			}
+			outMeshlets.Triangles.push_back(localIndex[vertex]);
+		}
+		current.TriangleCount++;
+	}
+
+	flush();
+}
+
+MeshletCullStats CullMeshlets(const MeshletMesh& meshlets, const glm::vec3& eye, const glm::vec3& eyeDir,
+                              const glm::vec3& up, const glm::mat4& projection, std::vector<uint32_t>& outVisible)
+{
+	MeshletCullStats stats;
+	outVisible.clear();
+
+	Frustum frustum = Frustum::FromViewProjection(projection * glm::lookAt(eye, eye + eyeDir, up));
+
+	stats.TotalMeshlets = static_cast<uint32_t>(meshlets.Meshlets.size());
+	for(uint32_t i = 0; i < meshlets.Meshlets.size(); i++)
+	{
+		const Meshlet& meshlet = meshlets.Meshlets[i];
+		stats.TotalTriangles += meshlet.TriangleCount;
+
+		if(!frustum.IntersectsSphere(meshlet.Center, meshlet.Radius))
+		{
+			stats.FrustumCulledTriangles += meshlet.TriangleCount;
+			continue;
+		}
+
+		glm::vec3 toApex = meshlet.ConeApex - eye;
+		float distance = glm::length(toApex);
+		if(distance > 0.f && glm::dot(toApex, meshlet.ConeAxis) >= meshlet.ConeCutoff * distance)
+		{
+			stats.ConeCulledTriangles += meshlet.TriangleCount;
+			continue;
+		}
+
+		outVisible.push_back(i);
+	}
+
+	stats.VisibleMeshlets = static_cast<uint32_t>(outVisible.size());
+	return stats;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include "Mesh.h"
+
+//cluster of up to MaxVertices unique vertices and MaxTriangles triangles of a mesh
+struct Meshlet
+{
+	static constexpr uint32_t MaxVertices = 64;
+	static constexpr uint32_t MaxTriangles = 124;
+
+	uint32_t VertexOffset; //into MeshletMesh::VertexIndices
+	uint32_t TriangleOffset; //into MeshletMesh::Triangles, 3 local indices per triangle
+	uint32_t VertexCount;
+	uint32_t TriangleCount;
+
+	//bounding sphere
+	glm::vec3 Center;
+	float Radius;
+
+	//backface cone, the whole meshlet faces away from any viewer with
+	//dot(normalize(ConeApex - eye), ConeAxis) >= ConeCutoff
+	glm::vec3 ConeApex;
+	glm::vec3 ConeAxis;
+	float ConeCutoff;
+};
+
+struct MeshletMesh
+{
+	std::vector<Meshlet> Meshlets;
+	std::vector<uint32_t> VertexIndices;
+	std::vector<uint8_t> Triangles;
+};
+
+struct MeshletCullStats
+{
+	uint32_t TotalMeshlets = 0;
+	uint32_t VisibleMeshlets = 0;
+	uint32_t TotalTriangles = 0;
+	uint32_t FrustumCulledTriangles = 0;
+	uint32_t ConeCulledTriangles = 0;
+
+	float CulledTriangleRatio() const
+	{
+		return TotalTriangles ? float(FrustumCulledTriangles + ConeCulledTriangles) / TotalTriangles : 0.f;
+	}
+};
+
+//splits the indexed mesh into meshlets, keeping the original triangle order
+void BuildMeshlets(const Mesh& mesh, MeshletMesh& outMeshlets);
+
+//fills outVisible with the indices of meshlets that survive frustum and backface cone culling
+MeshletCullStats CullMeshlets(const MeshletMesh& meshlets, const glm::vec3& eye, const glm::vec3& eyeDir,
+                              const glm::vec3& up, const glm::mat4& projection, std::vector<uint32_t>& outVisible);
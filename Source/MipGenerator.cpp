@@ -0,0 +1,352 @@
+#include "MipGenerator.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+namespace
+{
+	constexpr float Pi = 3.14159265358979f;
+	constexpr float KaiserAlpha = 4.f;
+	constexpr float KaiserWidth = 3.f; //filter radius in destination texels
+	constexpr uint32_t EncodeTableSize = 4096;
+	//rows are only handed to other threads once a batch holds this many pixels
+	constexpr uint32_t MinPixelsPerBatch = 16 * 1024;
+
+	//one premultiplied linear rgba texel per register
+	struct FloatImage
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		std::vector<__m128> Pixels;
+	};
+
+	struct ColorTables
+	{
+		float Decode[256];
+		uint8_t Encode[EncodeTableSize];
+		uint8_t EncodeLinear[EncodeTableSize];
+
+		ColorTables()
+		{
+			for(uint32_t i = 0; i < 256; i++)
+			{
+				float c = i / 255.f;
+				Decode[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for(uint32_t i = 0; i < EncodeTableSize; i++)
+			{
+				float c = float(i) / (EncodeTableSize - 1);
+				float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+				Encode[i] = uint8_t(std::min(255.f, s * 255.f + 0.5f));
+				EncodeLinear[i] = uint8_t(std::min(255.f, c * 255.f + 0.5f));
+			}
+		}
+	};
+
+	const ColorTables& GetColorTables()
+	{
+		static ColorTables tables;
+		return tables;
+	}
+
+	uint32_t RowBatch(uint32_t width)
+	{
+		return std::max(1u, MinPixelsPerBatch / std::max(1u, width));
+	}
+
+	void Decode(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, bool srgb, FloatImage& image)
+	{
+		const ColorTables& tables = GetColorTables();
+		image.Width = width;
+		image.Height = height;
+		image.Pixels.resize(size_t(width) * height);
+
+		ParallelFor(height, RowBatch(width), [&](uint32_t begin, uint32_t end)
+		{
+			const __m128 inv255 = _mm_set1_ps(1.f / 255.f);
+			for(uint32_t y = begin; y < end; y++)
+			{
+				const uint8_t* row = pixels + size_t(y) * rowPitch;
+				__m128* out = &image.Pixels[size_t(y) * width];
+				for(uint32_t x = 0; x < width; x++)
+				{
+					const uint8_t* p = row + x * 4;
+					float a = p[3] / 255.f;
+					__m128 color = srgb
+						? _mm_setr_ps(tables.Decode[p[0]], tables.Decode[p[1]], tables.Decode[p[2]], 1.f)
+						: _mm_mul_ps(_mm_setr_ps(p[0], p[1], p[2], 255.f), inv255);
+					out[x] = _mm_mul_ps(color, _mm_set1_ps(a));
+				}
+			}
+		});
+	}
+
+	void Encode(const FloatImage& image, bool srgb, MipLevel& level)
+	{
+		const ColorTables& tables = GetColorTables();
+		const uint8_t* colorTable = srgb ? tables.Encode : tables.EncodeLinear;
+		level.Width = image.Width;
+		level.Height = image.Height;
+		level.Pixels.resize(size_t(image.Width) * image.Height * 4);
+
+		ParallelFor(image.Height, RowBatch(image.Width), [&](uint32_t begin, uint32_t end)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 scale = _mm_set1_ps(float(EncodeTableSize - 1));
+			const __m128 alphaMask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+			alignas(16) int32_t index[4];
+			for(uint32_t y = begin; y < end; y++)
+			{
+				const __m128* row = &image.Pixels[size_t(y) * image.Width];
+				uint8_t* out = &level.Pixels[size_t(y) * image.Width * 4];
+				for(uint32_t x = 0; x < image.Width; x++)
+				{
+					__m128 v = _mm_min_ps(_mm_max_ps(row[x], zero), one);
+					__m128 alpha = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+					//undo the premultiply, fully transparent texels keep a black color
+					__m128 color = _mm_and_ps(_mm_div_ps(v, _mm_max_ps(alpha, _mm_set1_ps(1e-8f))), _mm_cmpgt_ps(alpha, zero));
+					color = _mm_min_ps(color, one);
+					color = _mm_or_ps(_mm_andnot_ps(alphaMask, color), _mm_and_ps(alphaMask, v));
+					_mm_store_si128((__m128i*)index, _mm_cvtps_epi32(_mm_mul_ps(color, scale)));
+					out[x * 4 + 0] = colorTable[index[0]];
+					out[x * 4 + 1] = colorTable[index[1]];
+					out[x * 4 + 2] = colorTable[index[2]];
+					out[x * 4 + 3] = tables.EncodeLinear[index[3]];
+				}
+			}
+		});
+	}
+
+	void DownsampleBox(const FloatImage& src, FloatImage& dst)
+	{
+		ParallelFor(dst.Height, RowBatch(dst.Width), [&](uint32_t begin, uint32_t end)
+		{
+			const __m128 quarter = _mm_set1_ps(0.25f);
+			for(uint32_t y = begin; y < end; y++)
+			{
+				const __m128* row0 = &src.Pixels[size_t(std::min(y * 2, src.Height - 1)) * src.Width];
+				const __m128* row1 = &src.Pixels[size_t(std::min(y * 2 + 1, src.Height - 1)) * src.Width];
+				__m128* out = &dst.Pixels[size_t(y) * dst.Width];
+				for(uint32_t x = 0; x < dst.Width; x++)
+				{
+					uint32_t x0 = std::min(x * 2, src.Width - 1);
+					uint32_t x1 = std::min(x * 2 + 1, src.Width - 1);
+					__m128 sum = _mm_add_ps(_mm_add_ps(row0[x0], row0[x1]), _mm_add_ps(row1[x0], row1[x1]));
+					out[x] = _mm_mul_ps(sum, quarter);
+				}
+			}
+		});
+	}
+
+	float BesselI0(float x)
+	{
+		float sum = 1.f;
+		float term = 1.f;
+		for(int k = 1; k < 32 && term > sum * 1e-8f; k++)
+		{
+			float half = x / (2.f * k);
+			term *= half * half;
+			sum += term;
+		}
+		return sum;
+	}
+
+	float Kaiser(float x)
+	{
+		float t = x / KaiserWidth;
+		if(std::abs(t) >= 1.f)
+		{
+			return 0.f;
+		}
+		float sinc = x == 0.f ? 1.f : std::sin(Pi * x) / (Pi * x);
+		return sinc * BesselI0(KaiserAlpha * std::sqrt(1.f - t * t)) / BesselI0(KaiserAlpha);
+	}
+
+	//normalized weights of every destination texel along one axis, sources are clamped to the edge
+	struct FilterTaps
+	{
+		uint32_t TapCount;
+		std::vector<int32_t> First;
+		std::vector<float> Weights;
+	};
+
+	FilterTaps BuildKaiserTaps(uint32_t srcSize, uint32_t dstSize)
+	{
+		float scale = float(srcSize) / dstSize;
+		float support = KaiserWidth * scale;
+
+		FilterTaps taps;
+		taps.TapCount = uint32_t(std::ceil(support * 2.f)) + 1;
+		taps.First.resize(dstSize);
+		taps.Weights.resize(size_t(dstSize) * taps.TapCount);
+		for(uint32_t d = 0; d < dstSize; d++)
+		{
+			float center = (d + 0.5f) * scale;
+			int32_t first = int32_t(std::floor(center - support));
+			float* weights = &taps.Weights[size_t(d) * taps.TapCount];
+			float sum = 0.f;
+			for(uint32_t t = 0; t < taps.TapCount; t++)
+			{
+				weights[t] = Kaiser((first + int32_t(t) + 0.5f - center) / scale);
+				sum += weights[t];
+			}
+			for(uint32_t t = 0; t < taps.TapCount; t++)
+			{
+				weights[t] /= sum;
+			}
+			taps.First[d] = first;
+		}
+		return taps;
+	}
+
+	uint32_t ClampIndex(int32_t i, uint32_t size)
+	{
+		return uint32_t(std::min(std::max(i, 0), int32_t(size) - 1));
+	}
+
+	void DownsampleKaiser(const FloatImage& src, FloatImage& dst, FloatImage& scratch)
+	{
+		FilterTaps horizontal = BuildKaiserTaps(src.Width, dst.Width);
+		FilterTaps vertical = BuildKaiserTaps(src.Height, dst.Height);
+
+		//horizontal pass into scratch, the negative lobes are clamped away after each pass
+		scratch.Width = dst.Width;
+		scratch.Height = src.Height;
+		scratch.Pixels.resize(size_t(scratch.Width) * scratch.Height);
+		ParallelFor(src.Height, RowBatch(src.Width), [&](uint32_t begin, uint32_t end)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			for(uint32_t y = begin; y < end; y++)
+			{
+				const __m128* row = &src.Pixels[size_t(y) * src.Width];
+				__m128* out = &scratch.Pixels[size_t(y) * scratch.Width];
+				for(uint32_t x = 0; x < dst.Width; x++)
+				{
+					const float* weights = &horizontal.Weights[size_t(x) * horizontal.TapCount];
+					__m128 sum = zero;
+					for(uint32_t t = 0; t < horizontal.TapCount; t++)
+					{
+						sum = _mm_add_ps(sum, _mm_mul_ps(row[ClampIndex(horizontal.First[x] + t, src.Width)], _mm_set1_ps(weights[t])));
+					}
+					out[x] = _mm_max_ps(sum, zero);
+				}
+			}
+		});
+
+		//vertical pass accumulates whole rows to stay cache friendly
+		ParallelFor(dst.Height, RowBatch(dst.Width * vertical.TapCount), [&](uint32_t begin, uint32_t end)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			for(uint32_t y = begin; y < end; y++)
+			{
+				const float* weights = &vertical.Weights[size_t(y) * vertical.TapCount];
+				__m128* out = &dst.Pixels[size_t(y) * dst.Width];
+				std::fill(out, out + dst.Width, zero);
+				for(uint32_t t = 0; t < vertical.TapCount; t++)
+				{
+					if(weights[t] == 0.f)
+					{
+						continue;
+					}
+					const __m128* row = &scratch.Pixels[size_t(ClampIndex(vertical.First[y] + t, scratch.Height)) * scratch.Width];
+					__m128 weight = _mm_set1_ps(weights[t]);
+					for(uint32_t x = 0; x < dst.Width; x++)
+					{
+						out[x] = _mm_add_ps(out[x], _mm_mul_ps(row[x], weight));
+					}
+				}
+				for(uint32_t x = 0; x < dst.Width; x++)
+				{
+					out[x] = _mm_max_ps(out[x], zero);
+				}
+			}
+		});
+	}
+}
+
+void GenerateMips(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch,
+                  MipFilter filter, bool srgb, std::vector<MipLevel>& outLevels)
+{
+	uint32_t levelCount = 1;
+	while((std::max(width, height) >> levelCount) > 0)
+	{
+		levelCount++;
+	}
+
+	outLevels.clear();
+	outLevels.resize(levelCount);
+	outLevels[0].Width = width;
+	outLevels[0].Height = height;
+	outLevels[0].Pixels.resize(size_t(width) * height * 4);
+	for(uint32_t y = 0; y < height; y++)
+	{
+		memcpy(&outLevels[0].Pixels[size_t(y) * width * 4], pixels + size_t(y) * rowPitch, width * 4);
+	}
+
+	//levels ping pong between two buffers, converting a finished level back to bytes
+	//overlaps with filtering the next one
+	FloatImage images[2];
+	FloatImage scratch;
+	Decode(pixels, width, height, rowPitch, srgb, images[0]);
+
+	std::future<void> pendingEncode;
+	for(uint32_t level = 1; level < levelCount; level++)
+	{
+		const FloatImage& src = images[(level - 1) & 1];
+		FloatImage& dst = images[level & 1];
+		dst.Width = std::max(1u, src.Width / 2);
+		dst.Height = std::max(1u, src.Height / 2);
+		dst.Pixels.resize(size_t(dst.Width) * dst.Height);
+
+		if(filter == MipFilter::Kaiser)
+		{
+			DownsampleKaiser(src, dst, scratch);
+		}
+		else
+		{
+			DownsampleBox(src, dst);
+		}
+
+		if(pendingEncode.valid())
+		{
+			pendingEncode.wait();
+		}
+		pendingEncode = std::async(std::launch::async, [&dst, &outLevels, level, srgb]() { Encode(dst, srgb, outLevels[level]); });
+	}
+	if(pendingEncode.valid())
+	{
+		pendingEncode.wait();
+	}
+}
+
+void BenchmarkMipGeneration(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch)
+{
+	const int iterations = 5;
+	std::vector<MipLevel> levels;
+
+	auto measure = [&](MipFilter filter)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for(int i = 0; i < iterations; i++)
+		{
+			GenerateMips(pixels, width, height, rowPitch, filter, true, levels);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return double(width) * height * iterations / elapsed.count() / 1e6;
+	};
+
+	double boxRate = measure(MipFilter::Box);
+	double kaiserRate = measure(MipFilter::Kaiser);
+
+	std::cout << "Mip generation: " << width << "x" << height << ", " << levels.size() << " levels, box "
+	          << boxRate << " MPix/s, kaiser " << kaiserRate << " MPix/s" << std::endl;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter
+{
+	Box, //2x2 average
+	Kaiser, //windowed sinc, sharper minification
+};
+
+struct MipLevel
+{
+	uint32_t Width;
+	uint32_t Height;
+	std::vector<uint8_t> Pixels; //tightly packed rows
+};
+
+//builds the full mip chain of an rgba8 image down to 1x1, level 0 is a copy of the source.
+//Filtering happens on linear (when srgb is set) alpha premultiplied colors so transparent
+//texels do not bleed into their neighbours, rows of every level are split across threads.
+void GenerateMips(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch,
+                  MipFilter filter, bool srgb, std::vector<MipLevel>& outLevels);
+
+//runs both filters over the image and prints the throughput in source megapixels per second
+void BenchmarkMipGeneration(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch);
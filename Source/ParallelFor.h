@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+//splits [0, count) into contiguous ranges of at least minBatch items and runs func(begin, end)
+//for each of them on the hardware threads, the calling thread takes the first range
+template<typename Func>
+void ParallelFor(uint32_t count, uint32_t minBatch, Func&& func)
+{
+	uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, std::max(1u, count / std::max(1u, minBatch)));
+	if(threadCount <= 1)
+	{
+		func(0u, count);
+		return;
+	}
+
+	uint32_t batch = (count + threadCount - 1) / threadCount;
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for(uint32_t begin = batch; begin < count; begin += batch)
+	{
+		threads.emplace_back([&func, begin, end = std::min(count, begin + batch)]() { func(begin, end); });
+	}
+	func(0u, std::min(count, batch));
+	for(auto& thread : threads)
+	{
+		thread.join();
+	}
+}
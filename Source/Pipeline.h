@@ -1,24 +1,100 @@
 #pragma once
+#include "BindingName.h"
+#include "CommandRecorder.h"
 #include "DynamicRootSignature.h"
 #include "Shader.h"
 
+//index of a binding in Pipeline::Bindings, resolved once with Pipeline::GetBinding. Stays valid
+//across Rebuild, a binding the new shaders no longer use is skipped until it comes back
+struct BindingHandle
+{
+	uint32_t Index = UINT32_MAX;
+	bool IsValid() const { return Index != UINT32_MAX; }
+};
+
+enum class BindingType : uint8_t
+{
+	None, //not used by the current shaders
+	ConstantBuffer,
+	RootConstants,
+	Texture,
+	BindlessTexture, //index into ResourceDescriptorHeap passed as a root constant
+};
+
+struct PipelineBinding
+{
+	std::string Name;
+	uint32_t NameHash;
+	BindingType Type = BindingType::None;
+	uint32_t RootIndex = 0; //ConstantBuffer, RootConstants and BindlessTexture
+	uint32_t ConstantCount = 0; //RootConstants
+	uint32_t ConstantOffset = 0; //BindlessTexture, in 32 bit values
+	uint32_t HeapIndex = 0; //Texture, slot in Pipeline::DescriptorHeap
+	uint32_t BindlessIndex = UINT32_MAX; //BindlessTexture, the heap index BindTexture registered
+	ID3D12Resource* TextureResource = nullptr; //last texture bound, replayed by Rebuild
+	D3D12_SHADER_RESOURCE_VIEW_DESC TextureViewDesc = {};
+};
+
 class Pipeline
 {
 public:
 	void Initialize(ID3D12Device* device, VertexShader* vertexShader, PixelShader* pixelShader);
+	//recreates the root signature, descriptor heap and pipeline state for new shaders and rewrites
+	//the bound textures the new shaders still use. Keeps the current state and returns false when
+	//the pipeline state can not be created. The old objects go to DeferredReleaseQueue::Active and
+	//are released once the frames in flight are done with them, without one they are released
+	//right away and the gpu must be done with them
+	bool Rebuild(ID3D12Device* device, VertexShader* vertexShader, PixelShader* pixelShader);
+
+	//goes through the recorder, so binding the pipeline again or one sharing its root signature only
+	//records what changed. Returns false when the texture table did not fit in the frame ring of
+	//BindlessHeap::Active, the draws of this pipeline have to be skipped for the frame then
+	bool SetPipelineState(CommandRecorder& recorder);
 
-	void SetPipelineState(ID3D12CommandAllocator* commandAllocator, ID3D12GraphicsCommandList* commandList);
+	//invalid when the current shaders do not use the name
+	BindingHandle GetBinding(BindingName name) const;
 
-	void BindTexture(ID3D12Device* device, std::string name, class Texture* texture);
-	void BindTexture(ID3D12Device* device, std::string name, ID3D12Resource* texture);
-	void BindConstantBuffer(std::string name, class ConstantBuffer* constantBuffer, ID3D12GraphicsCommandList* commandList);
+	//the frame loop should bind through handles, the name overloads look the binding up each call.
+	//A table texture takes effect at the next SetPipelineState. A bindless texture gets a new index
+	//in BindlessHeap::Active on every bind, the previous one is retired behind the frame fence. The
+	//index is set by every SetPipelineState
+	void BindTexture(ID3D12Device* device, BindingHandle binding, class Texture* texture);
+	void BindTexture(ID3D12Device* device, BindingHandle binding, ID3D12Resource* texture);
+	void BindConstantBuffer(BindingHandle binding, D3D12_GPU_VIRTUAL_ADDRESS address, CommandRecorder& recorder);
+	void BindTexture(ID3D12Device* device, BindingName name, class Texture* texture) { BindTexture(device, GetBinding(name), texture); }
+	void BindTexture(ID3D12Device* device, BindingName name, ID3D12Resource* texture) { BindTexture(device, GetBinding(name), texture); }
+	void BindConstantBuffer(BindingName name, class ConstantBuffer* constantBuffer, CommandRecorder& recorder);
+	void BindConstantBuffer(BindingName name, D3D12_GPU_VIRTUAL_ADDRESS address, CommandRecorder& recorder) { BindConstantBuffer(GetBinding(name), address, recorder); }
+
+	//writes the values of a cbuffer that was promoted to root constants straight into the command
+	//list. A cbuffer that stayed a root constant buffer view gets a copy in UploadRing::Active
+	//instead. T has to match the start of the cbuffer layout
+	template<typename T>
+	void SetConstants(BindingHandle binding, const T& constants, CommandRecorder& recorder)
+	{
+		static_assert(sizeof(T) % 4 == 0, "root constants are set in 32 bit values");
+		SetConstants(binding, &constants, sizeof(T), recorder);
+	}
+	template<typename T>
+	void SetConstants(BindingName name, const T& constants, CommandRecorder& recorder)
+	{
+		SetConstants(GetBinding(name), constants, recorder);
+	}
+	void SetConstants(BindingHandle binding, const void* data, uint32_t size, CommandRecorder& recorder);
+	//points a bindless texture at a descriptor the caller registered in BindlessHeap::Active, for
+	//the current draws only. Has to come after SetPipelineState
+	void SetBindlessIndex(BindingHandle binding, uint32_t index, CommandRecorder& recorder);
 
 	void Release();
 
     ID3D12PipelineState* PipelineState = nullptr;
+	//the pipeline's own heap holding its texture table. With a BindlessHeap active it is a cpu only
+	//staging heap copied into the frame ring, otherwise a shader visible heap the draws read directly
 	ID3D12DescriptorHeap* DescriptorHeap = nullptr;
+	uint32_t DescriptorCount = 0;
 	bool writeDepth = true;
 	bool useAlphaBlend = false;
+	DXGI_FORMAT RenderTargetFormat = DXGI_FORMAT_UNKNOWN; //overrides the format picked from writeDepth
 
 	VertexShader* VShader;
 	PixelShader* PShader;
@@ -31,4 +107,23 @@ public:
 	std::vector<ID3D12DescriptorHeap*> DescriptorHeaps;
 	std::map<std::string, uint32_t> HeapIndexMap;
 
+	//one entry per cbuffer and texture name the pipeline has seen, in the order they first showed up
+	std::vector<PipelineBinding> Bindings;
+
+private:
+	//points the bindings at the root parameters and heap slots of the current root signature
+	void UpdateBindings();
+	void WriteTextureView(ID3D12Device* device, PipelineBinding& binding);
+	bool UsesBindless() const { return !RootSignature->Parameters.BindlessTextureOffsets.empty(); }
+
+	uint32_t TextureTableIndex = UINT32_MAX;
+	uint32_t DescriptorIncrementSize = 0;
+
+	bool StagedTable = false;
+	bool TableDirty = true; //a bind changed the staging heap since the last copy
+	uint32_t TransientBase = UINT32_MAX; //the last copy in the frame ring
+	uint64_t TransientFrame = UINT64_MAX; //frame serial of that copy
 };
+
+//compares binding by std::string through the parameter maps with binding by name hash and by handle
+void BenchmarkPipelineBindings(const Pipeline& pipeline);
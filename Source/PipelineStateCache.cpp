@@ -0,0 +1,287 @@
+#include "PipelineStateCache.h"
+
+#include "ShaderCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+static uint32_t FloatBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static void PushHash(std::vector<uint32_t>& words, uint64_t hash)
+{
+	words.push_back(static_cast<uint32_t>(hash));
+	words.push_back(static_cast<uint32_t>(hash >> 32));
+}
+
+static void PushShader(std::vector<uint32_t>& words, const D3D12_SHADER_BYTECODE& shader)
+{
+	words.push_back(static_cast<uint32_t>(shader.BytecodeLength));
+	PushHash(words, shader.pShaderBytecode ? HashBytes(shader.pShaderBytecode, shader.BytecodeLength) : 0);
+}
+
+static void PushString(std::vector<uint32_t>& words, const char* value)
+{
+	PushHash(words, value ? HashBytes(value, strlen(value)) : 0);
+}
+
+static void PushStencilOp(std::vector<uint32_t>& words, const D3D12_DEPTH_STENCILOP_DESC& op)
+{
+	words.push_back(static_cast<uint32_t>(op.StencilFailOp));
+	words.push_back(static_cast<uint32_t>(op.StencilDepthFailOp));
+	words.push_back(static_cast<uint32_t>(op.StencilPassOp));
+	words.push_back(static_cast<uint32_t>(op.StencilFunc));
+}
+
+std::vector<uint32_t> CanonicalizeGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+{
+	std::vector<uint32_t> words;
+	PushHash(words, rootSignatureHash);
+	PushShader(words, desc.VS);
+	PushShader(words, desc.PS);
+	PushShader(words, desc.DS);
+	PushShader(words, desc.HS);
+	PushShader(words, desc.GS);
+
+	words.push_back(desc.StreamOutput.NumEntries);
+	for(uint32_t i = 0; i < desc.StreamOutput.NumEntries; i++)
+	{
+		const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+		words.push_back(entry.Stream);
+		PushString(words, entry.SemanticName);
+		words.push_back(entry.SemanticIndex);
+		words.push_back(entry.StartComponent);
+		words.push_back(entry.ComponentCount);
+		words.push_back(entry.OutputSlot);
+	}
+	words.push_back(desc.StreamOutput.NumStrides);
+	for(uint32_t i = 0; i < desc.StreamOutput.NumStrides; i++)
+	{
+		words.push_back(desc.StreamOutput.pBufferStrides[i]);
+	}
+	words.push_back(desc.StreamOutput.RasterizedStream);
+
+	words.push_back(desc.BlendState.AlphaToCoverageEnable);
+	words.push_back(desc.BlendState.IndependentBlendEnable);
+	for(const D3D12_RENDER_TARGET_BLEND_DESC& target : desc.BlendState.RenderTarget)
+	{
+		words.push_back(target.BlendEnable);
+		words.push_back(target.LogicOpEnable);
+		words.push_back(static_cast<uint32_t>(target.SrcBlend));
+		words.push_back(static_cast<uint32_t>(target.DestBlend));
+		words.push_back(static_cast<uint32_t>(target.BlendOp));
+		words.push_back(static_cast<uint32_t>(target.SrcBlendAlpha));
+		words.push_back(static_cast<uint32_t>(target.DestBlendAlpha));
+		words.push_back(static_cast<uint32_t>(target.BlendOpAlpha));
+		words.push_back(static_cast<uint32_t>(target.LogicOp));
+		words.push_back(target.RenderTargetWriteMask);
+	}
+	words.push_back(desc.SampleMask);
+
+	const D3D12_RASTERIZER_DESC& raster = desc.RasterizerState;
+	words.push_back(static_cast<uint32_t>(raster.FillMode));
+	words.push_back(static_cast<uint32_t>(raster.CullMode));
+	words.push_back(raster.FrontCounterClockwise);
+	words.push_back(static_cast<uint32_t>(raster.DepthBias));
+	words.push_back(FloatBits(raster.DepthBiasClamp));
+	words.push_back(FloatBits(raster.SlopeScaledDepthBias));
+	words.push_back(raster.DepthClipEnable);
+	words.push_back(raster.MultisampleEnable);
+	words.push_back(raster.AntialiasedLineEnable);
+	words.push_back(raster.ForcedSampleCount);
+	words.push_back(static_cast<uint32_t>(raster.ConservativeRaster));
+
+	const D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+	words.push_back(depthStencil.DepthEnable);
+	words.push_back(static_cast<uint32_t>(depthStencil.DepthWriteMask));
+	words.push_back(static_cast<uint32_t>(depthStencil.DepthFunc));
+	words.push_back(depthStencil.StencilEnable);
+	words.push_back(depthStencil.StencilReadMask);
+	words.push_back(depthStencil.StencilWriteMask);
+	PushStencilOp(words, depthStencil.FrontFace);
+	PushStencilOp(words, depthStencil.BackFace);
+
+	words.push_back(desc.InputLayout.NumElements);
+	for(uint32_t i = 0; i < desc.InputLayout.NumElements; i++)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+		PushString(words, element.SemanticName);
+		words.push_back(element.SemanticIndex);
+		words.push_back(static_cast<uint32_t>(element.Format));
+		words.push_back(element.InputSlot);
+		words.push_back(element.AlignedByteOffset);
+		words.push_back(static_cast<uint32_t>(element.InputSlotClass));
+		words.push_back(element.InstanceDataStepRate);
+	}
+
+	words.push_back(static_cast<uint32_t>(desc.IBStripCutValue));
+	words.push_back(static_cast<uint32_t>(desc.PrimitiveTopologyType));
+	words.push_back(desc.NumRenderTargets);
+	for(DXGI_FORMAT format : desc.RTVFormats)
+	{
+		words.push_back(static_cast<uint32_t>(format));
+	}
+	words.push_back(static_cast<uint32_t>(desc.DSVFormat));
+	words.push_back(desc.SampleDesc.Count);
+	words.push_back(desc.SampleDesc.Quality);
+	words.push_back(desc.NodeMask);
+	words.push_back(static_cast<uint32_t>(desc.Flags));
+	return words;
+}
+
+uint64_t HashPipelineState(const std::vector<uint32_t>& canonical)
+{
+	return HashBytes(canonical.data(), canonical.size() * sizeof(uint32_t));
+}
+
+PipelineStateCache* PipelineStateCache::GetInstance()
+{
+	static PipelineStateCache instance;
+	return &instance;
+}
+
+void PipelineStateCache::Open(ID3D12Device* device, std::filesystem::path filename)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	Filename = std::move(filename);
+
+	ID3D12Device1* device1 = nullptr;
+	if(FAILED(device->QueryInterface(IID_PPV_ARGS(&device1))))
+	{
+		std::cout << "Pipeline library not supported, pipeline states are only shared in memory" << std::endl;
+		return;
+	}
+
+	std::ifstream file(Filename, std::ios::binary | std::ios::ate);
+	if(file)
+	{
+		LibraryData.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(LibraryData.data()), LibraryData.size());
+		if(!file)
+			LibraryData.clear();
+	}
+
+	//a new driver or a different adapter refuses the old library, it is rebuilt from scratch
+	if(LibraryData.empty() || FAILED(device1->CreatePipelineLibrary(LibraryData.data(), LibraryData.size(), IID_PPV_ARGS(&Library))))
+	{
+		LibraryData.clear();
+		if(FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&Library))))
+		{
+			Library = nullptr;
+			std::cout << "Could not create a pipeline library, pipeline states are only shared in memory" << std::endl;
+		}
+	}
+	device1->Release();
+}
+
+ID3D12PipelineState* PipelineStateCache::GetOrCreate(ID3D12Device* device, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+{
+	std::vector<uint32_t> canonical = CanonicalizeGraphicsPipelineDesc(desc, rootSignatureHash);
+	uint64_t hash = HashPipelineState(canonical);
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	Stats.Requests++;
+	std::vector<Entry>& bucket = Entries[hash];
+	for(Entry& entry : bucket)
+	{
+		if(entry.Canonical == canonical)
+		{
+			entry.PipelineState->AddRef();
+			return entry.PipelineState;
+		}
+	}
+
+	//the first desc with a hash owns the library name, a colliding desc is only kept in memory
+	std::wstring name = std::to_wstring(hash);
+	bool useLibrary = Library && bucket.empty();
+	ID3D12PipelineState* pipelineState = nullptr;
+	if(useLibrary && SUCCEEDED(Library->LoadGraphicsPipeline(name.c_str(), &desc, IID_PPV_ARGS(&pipelineState))))
+	{
+		Stats.LibraryLoads++;
+	}
+	else
+	{
+		ThrowIfFailed(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+		Stats.Created++;
+		if(useLibrary && SUCCEEDED(Library->StorePipeline(name.c_str(), pipelineState)))
+		{
+			Dirty = true;
+		}
+	}
+
+	bucket.push_back({ std::move(canonical), pipelineState });
+	pipelineState->AddRef();
+	return pipelineState;
+}
+
+bool PipelineStateCache::Save()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	if(!Library || !Dirty)
+	{
+		return true;
+	}
+
+	std::vector<uint8_t> data(Library->GetSerializedSize());
+	if(FAILED(Library->Serialize(data.data(), data.size())))
+	{
+		return false;
+	}
+
+	std::error_code error;
+	if(Filename.has_parent_path())
+		std::filesystem::create_directories(Filename.parent_path(), error);
+	std::filesystem::path tempPath = Filename;
+	tempPath += ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if(!file)
+		{
+			file.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+	std::filesystem::rename(tempPath, Filename, error);
+	if(error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	Dirty = false;
+	return true;
+}
+
+PipelineStateCacheStats PipelineStateCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Stats;
+}
+
+void PipelineStateCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	for(auto& [hash, bucket] : Entries)
+	{
+		for(Entry& entry : bucket)
+		{
+			entry.PipelineState->Release();
+		}
+	}
+	Entries.clear();
+	if(Library)
+	{
+		Library->Release();
+		Library = nullptr;
+	}
+	LibraryData.clear();
+	Dirty = false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//flattens a graphics pipeline desc into words that compare equal exactly when the descs build the
+//same pipeline: shader bytecode by content hash, the root signature by its canonical hash (see
+//HashRootSignature) and every state, layout and format field in order. Pointers never go in, so
+//the words and their hash are the same between runs and need no device
+std::vector<uint32_t> CanonicalizeGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash);
+uint64_t HashPipelineState(const std::vector<uint32_t>& canonical);
+
+struct PipelineStateCacheStats
+{
+	uint32_t Requests = 0;
+	uint32_t LibraryLoads = 0; //found in the pipeline library written by an earlier run
+	uint32_t Created = 0; //compiled by the driver
+};
+
+//shares pipeline states between identical descs and keeps them in an ID3D12PipelineLibrary on
+//disk, so later runs skip the driver compile
+class PipelineStateCache
+{
+public:
+	static PipelineStateCache* GetInstance();
+
+	//loads the library from filename. Without ID3D12Device1, or when the file was written by
+	//another driver or adapter, the cache starts empty and Save replaces the file
+	void Open(ID3D12Device* device, std::filesystem::path filename);
+	//returns an AddRef'ed pipeline state, throws com_exception when the driver can not create it
+	ID3D12PipelineState* GetOrCreate(ID3D12Device* device, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash);
+	//writes the library if pipelines were added since Open
+	bool Save();
+
+	PipelineStateCacheStats GetStats() const;
+	//releases the cache's references and the library, pipeline states held by pipelines stay alive
+	void Clear();
+
+private:
+	PipelineStateCache() = default;
+
+	struct Entry
+	{
+		std::vector<uint32_t> Canonical; //compared on a hash match, so a collision never shares the wrong state
+		ID3D12PipelineState* PipelineState;
+	};
+
+	mutable std::mutex Mutex;
+	std::unordered_map<uint64_t, std::vector<Entry>> Entries;
+	PipelineStateCacheStats Stats;
+
+	std::filesystem::path Filename;
+	std::vector<uint8_t> LibraryData; //the library reads from this until it is released
+	ID3D12PipelineLibrary* Library = nullptr;
+	bool Dirty = false;
+};
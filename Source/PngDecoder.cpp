@@ -0,0 +1,948 @@
+#include "PngDecoder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <emmintrin.h>
+
+namespace
+{
+	constexpr uint32_t FastBits = 10;
+	constexpr uint32_t MaxCodeLength = 15;
+	constexpr uint16_t InvalidSymbol = 0xFFFF;
+	//bytes the match copy may write past the end of the inflate buffer
+	constexpr size_t InflateSlack = 8;
+	//a 16k x 16k rgba16 image, the largest 2d texture d3d12 can create. Larger headers fail cleanly
+	//instead of running into the allocator
+	constexpr uint64_t MaxImageBytes = 16384ull * 16384 * 8;
+
+	const uint16_t LengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	const uint8_t LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	const uint16_t DistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+	                                   1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+	const uint8_t DistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+	const uint8_t CodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+	//64 bit lsb first bit buffer, reads past the end produce zeros and are caught by Overrun
+	struct BitReader
+	{
+		const uint8_t* Data;
+		size_t Size;
+		size_t Position = 0;
+		uint64_t Bits = 0;
+		uint32_t Count = 0;
+
+		//tops the buffer up to at least 56 bits
+		void Refill()
+		{
+			if(Position + 8 <= Size)
+			{
+				uint64_t word;
+				memcpy(&word, Data + Position, 8);
+				Bits |= word << Count;
+				Position += (63 - Count) >> 3;
+				Count |= 56;
+				return;
+			}
+			while(Count <= 56)
+			{
+				uint64_t byte = Position < Size ? Data[Position] : 0;
+				Bits |= byte << Count;
+				Position++;
+				Count += 8;
+			}
+		}
+
+		bool Overrun() const
+		{
+			return Position - Count / 8 > Size;
+		}
+
+		void Consume(uint32_t count)
+		{
+			Bits >>= count;
+			Count -= count;
+		}
+
+		//the caller makes sure enough bits are buffered
+		uint32_t Take(uint32_t count)
+		{
+			uint32_t value = uint32_t(Bits & ((uint64_t(1) << count) - 1));
+			Consume(count);
+			return value;
+		}
+
+		uint32_t Read(uint32_t count)
+		{
+			if(Count < count)
+			{
+				Refill();
+			}
+			return Take(count);
+		}
+	};
+
+	struct Huffman
+	{
+		uint16_t Fast[1 << FastBits]; //symbol << 4 | code length, 0 for codes longer than FastBits
+		uint16_t Counts[MaxCodeLength + 1];
+		uint16_t Symbols[288];
+
+		bool Build(const uint8_t* lengths, uint32_t count)
+		{
+			memset(Counts, 0, sizeof(Counts));
+			for(uint32_t i = 0; i < count; i++)
+			{
+				Counts[lengths[i]]++;
+			}
+			Counts[0] = 0;
+
+			int left = 1;
+			for(uint32_t length = 1; length <= MaxCodeLength; length++)
+			{
+				left = (left << 1) - Counts[length];
+				if(left < 0)
+				{
+					return false;
+				}
+			}
+
+			uint16_t offsets[MaxCodeLength + 2] = {};
+			for(uint32_t length = 1; length <= MaxCodeLength; length++)
+			{
+				offsets[length + 1] = offsets[length] + Counts[length];
+			}
+			for(uint32_t symbol = 0; symbol < count; symbol++)
+			{
+				if(lengths[symbol])
+				{
+					Symbols[offsets[lengths[symbol]]++] = uint16_t(symbol);
+				}
+			}
+
+			//codes are stored msb first in an lsb first stream, so the table is indexed by the reversed code
+			memset(Fast, 0, sizeof(Fast));
+			uint32_t code = 0;
+			uint32_t index = 0;
+			for(uint32_t length = 1; length <= FastBits; length++)
+			{
+				for(uint32_t i = 0; i < Counts[length]; i++, code++)
+				{
+					uint32_t reversed = 0;
+					for(uint32_t bit = 0; bit < length; bit++)
+					{
+						reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+					}
+					uint16_t entry = uint16_t((Symbols[index + i] << 4) | length);
+					for(uint32_t slot = reversed; slot < (1u << FastBits); slot += 1u << length)
+					{
+						Fast[slot] = entry;
+					}
+				}
+				index += Counts[length];
+				code <<= 1;
+			}
+			return true;
+		}
+
+		//needs MaxCodeLength buffered bits
+		uint32_t Decode(BitReader& reader) const
+		{
+			uint16_t entry = Fast[reader.Bits & ((1u << FastBits) - 1)];
+			if(entry)
+			{
+				reader.Consume(entry & 15);
+				return entry >> 4;
+			}
+
+			//canonical decode one bit at a time for the rare long codes
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for(uint32_t length = 1; length <= MaxCodeLength; length++)
+			{
+				code |= int((reader.Bits >> (length - 1)) & 1);
+				int count = Counts[length];
+				if(code - count < first)
+				{
+					reader.Consume(length);
+					return Symbols[index + (code - first)];
+				}
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+			return InvalidSymbol;
+		}
+	};
+
+	const char* BuildFixedTables(Huffman& literals, Huffman& distances)
+	{
+		uint8_t lengths[288];
+		std::fill(lengths, lengths + 144, uint8_t(8));
+		std::fill(lengths + 144, lengths + 256, uint8_t(9));
+		std::fill(lengths + 256, lengths + 280, uint8_t(7));
+		std::fill(lengths + 280, lengths + 288, uint8_t(8));
+		literals.Build(lengths, 288);
+		std::fill(lengths, lengths + 30, uint8_t(5));
+		distances.Build(lengths, 30);
+		return nullptr;
+	}
+
+	const char* ReadDynamicTables(BitReader& reader, Huffman& literals, Huffman& distances)
+	{
+		reader.Refill();
+		uint32_t literalCount = reader.Take(5) + 257;
+		uint32_t distanceCount = reader.Take(5) + 1;
+		uint32_t codeLengthCount = reader.Take(4) + 4;
+		if(literalCount > 286 || distanceCount > 30)
+		{
+			return "invalid dynamic block header";
+		}
+
+		uint8_t codeLengthLengths[19] = {};
+		for(uint32_t i = 0; i < codeLengthCount; i++)
+		{
+			codeLengthLengths[CodeLengthOrder[i]] = uint8_t(reader.Read(3));
+		}
+		Huffman codeLengths;
+		if(!codeLengths.Build(codeLengthLengths, 19))
+		{
+			return "invalid code length code";
+		}
+
+		uint8_t lengths[286 + 30] = {};
+		uint32_t total = literalCount + distanceCount;
+		for(uint32_t n = 0; n < total;)
+		{
+			if(reader.Count < 32)
+			{
+				reader.Refill();
+			}
+			uint32_t symbol = codeLengths.Decode(reader);
+			if(symbol < 16)
+			{
+				lengths[n++] = uint8_t(symbol);
+				continue;
+			}
+
+			uint8_t value = 0;
+			uint32_t repeat;
+			if(symbol == 16)
+			{
+				if(n == 0)
+				{
+					return "length repeat without a previous length";
+				}
+				value = lengths[n - 1];
+				repeat = 3 + reader.Take(2);
+			}
+			else if(symbol == 17)
+			{
+				repeat = 3 + reader.Take(3);
+			}
+			else if(symbol == 18)
+			{
+				repeat = 11 + reader.Take(7);
+			}
+			else
+			{
+				return "invalid code length symbol";
+			}
+			if(n + repeat > total)
+			{
+				return "code lengths overflow";
+			}
+			std::fill(lengths + n, lengths + n + repeat, value);
+			n += repeat;
+		}
+
+		if(lengths[256] == 0)
+		{
+			return "missing end of block code";
+		}
+		if(!literals.Build(lengths, literalCount) || !distances.Build(lengths + literalCount, distanceCount))
+		{
+			return "invalid literal or distance code";
+		}
+		return nullptr;
+	}
+
+	//raw deflate into a buffer of known size that has InflateSlack writable bytes past outSize
+	const char* Inflate(const uint8_t* data, size_t size, uint8_t* out, size_t outSize)
+	{
+		BitReader reader{data, size};
+		uint8_t* cursor = out;
+		uint8_t* const end = out + outSize;
+		Huffman literals;
+		Huffman distances;
+
+		bool finalBlock = false;
+		while(!finalBlock)
+		{
+			reader.Refill();
+			if(reader.Overrun())
+			{
+				return "truncated image data";
+			}
+			finalBlock = reader.Take(1) != 0;
+			uint32_t type = reader.Take(2);
+
+			if(type == 0)
+			{
+				//stored block, realign the reader onto the byte stream
+				reader.Consume(reader.Count & 7);
+				reader.Position -= reader.Count / 8;
+				reader.Bits = 0;
+				reader.Count = 0;
+				if(reader.Position + 4 > size)
+				{
+					return "truncated stored block";
+				}
+				uint32_t length = data[reader.Position] | (data[reader.Position + 1] << 8);
+				uint32_t inverse = data[reader.Position + 2] | (data[reader.Position + 3] << 8);
+				reader.Position += 4;
+				if((length ^ 0xFFFF) != inverse || reader.Position + length > size || length > size_t(end - cursor))
+				{
+					return "invalid stored block";
+				}
+				memcpy(cursor, data + reader.Position, length);
+				cursor += length;
+				reader.Position += length;
+				continue;
+			}
+
+			const char* tableError = type == 1 ? BuildFixedTables(literals, distances)
+			                       : type == 2 ? ReadDynamicTables(reader, literals, distances)
+			                       : "invalid block type";
+			if(tableError)
+			{
+				return tableError;
+			}
+
+			while(true)
+			{
+				//literal/length code, 5 extra bits, distance code and 13 extra bits fit in 48 bits
+				if(reader.Count < 48)
+				{
+					reader.Refill();
+				}
+				uint32_t symbol = literals.Decode(reader);
+				if(symbol < 256)
+				{
+					if(cursor == end)
+					{
+						return "image data overflows the image";
+					}
+					*cursor++ = uint8_t(symbol);
+					continue;
+				}
+				if(symbol == 256)
+				{
+					break;
+				}
+
+				symbol -= 257;
+				if(symbol >= 29)
+				{
+					return "invalid length code";
+				}
+				size_t length = LengthBase[symbol] + reader.Take(LengthExtra[symbol]);
+				uint32_t distanceSymbol = distances.Decode(reader);
+				if(distanceSymbol >= 30)
+				{
+					return "invalid distance code";
+				}
+				size_t distance = DistanceBase[distanceSymbol] + reader.Take(DistanceExtra[distanceSymbol]);
+				if(distance > size_t(cursor - out) || length > size_t(end - cursor))
+				{
+					return "invalid match";
+				}
+
+				const uint8_t* source = cursor - distance;
+				uint8_t* stop = cursor + length;
+				if(distance >= 8)
+				{
+					do
+					{
+						memcpy(cursor, source, 8);
+						cursor += 8;
+						source += 8;
+					} while(cursor < stop);
+				}
+				else if(distance == 1)
+				{
+					memset(cursor, *source, length);
+				}
+				else
+				{
+					for(uint8_t* c = cursor; c < stop; c++, source++)
+					{
+						*c = *source;
+					}
+				}
+				cursor = stop;
+
+				if(reader.Overrun())
+				{
+					return "truncated image data";
+				}
+			}
+		}
+
+		return cursor == end ? nullptr : "not enough image data";
+	}
+
+	__m128i LoadPixel(const uint8_t* p, uint32_t bpp)
+	{
+		int32_t value = 0;
+		memcpy(&value, p, bpp);
+		return _mm_cvtsi32_si128(value);
+	}
+
+	void StorePixel(uint8_t* p, __m128i pixel, uint32_t bpp)
+	{
+		int32_t value = _mm_cvtsi128_si32(pixel);
+		memcpy(p, &value, bpp);
+	}
+
+	//Sub, Avg and Paeth depend on the pixel to the left, so for 3 and 4 byte pixels one
+	//pixel is processed per iteration with all channels in parallel
+	void UnfilterSubSimd(uint8_t* row, size_t rowBytes, uint32_t bpp)
+	{
+		__m128i left = _mm_setzero_si128();
+		for(size_t i = 0; i < rowBytes; i += bpp)
+		{
+			left = _mm_add_epi8(left, LoadPixel(row + i, bpp));
+			StorePixel(row + i, left, bpp);
+		}
+	}
+
+	void UnfilterAverageSimd(uint8_t* row, const uint8_t* previous, size_t rowBytes, uint32_t bpp)
+	{
+		const __m128i one = _mm_set1_epi8(1);
+		__m128i left = _mm_setzero_si128();
+		for(size_t i = 0; i < rowBytes; i += bpp)
+		{
+			__m128i up = LoadPixel(previous + i, bpp);
+			//avg_epu8 rounds up, the filter rounds down
+			__m128i average = _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one));
+			left = _mm_add_epi8(LoadPixel(row + i, bpp), average);
+			StorePixel(row + i, left, bpp);
+		}
+	}
+
+	__m128i Select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	__m128i Abs16(__m128i value)
+	{
+		return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+	}
+
+	void UnfilterPaethSimd(uint8_t* row, const uint8_t* previous, size_t rowBytes, uint32_t bpp)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i left = zero;
+		__m128i upLeft = zero;
+		for(size_t i = 0; i < rowBytes; i += bpp)
+		{
+			__m128i up = _mm_unpacklo_epi8(LoadPixel(previous + i, bpp), zero);
+			__m128i value = _mm_unpacklo_epi8(LoadPixel(row + i, bpp), zero);
+
+			__m128i pa = _mm_sub_epi16(up, upLeft);
+			__m128i pb = _mm_sub_epi16(left, upLeft);
+			__m128i pc = Abs16(_mm_add_epi16(pa, pb));
+			pa = Abs16(pa);
+			pb = Abs16(pb);
+			__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			__m128i predictor = Select(_mm_cmpeq_epi16(smallest, pa), left,
+			                           Select(_mm_cmpeq_epi16(smallest, pb), up, upLeft));
+
+			//byte adds keep every 16 bit lane below 256
+			left = _mm_add_epi8(value, predictor);
+			StorePixel(row + i, _mm_packus_epi16(left, left), bpp);
+			upLeft = up;
+		}
+	}
+
+	void UnfilterUp(uint8_t* row, const uint8_t* previous, size_t rowBytes)
+	{
+		size_t i = 0;
+		for(; i + 16 <= rowBytes; i += 16)
+		{
+			__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+			__m128i up = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_add_epi8(value, up));
+		}
+		for(; i < rowBytes; i++)
+		{
+			row[i] = uint8_t(row[i] + previous[i]);
+		}
+	}
+
+	uint8_t Paeth(int a, int b, int c)
+	{
+		int pa = std::abs(b - c);
+		int pb = std::abs(a - c);
+		int pc = std::abs(a + b - 2 * c);
+		return uint8_t(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+	}
+
+	bool Unfilter(uint8_t filter, uint8_t* row, const uint8_t* previous, size_t rowBytes, uint32_t bpp)
+	{
+		bool simd = bpp == 3 || bpp == 4;
+		switch(filter)
+		{
+		case 0:
+			return true;
+		case 1:
+			if(simd)
+			{
+				UnfilterSubSimd(row, rowBytes, bpp);
+				return true;
+			}
+			for(size_t i = bpp; i < rowBytes; i++)
+			{
+				row[i] = uint8_t(row[i] + row[i - bpp]);
+			}
+			return true;
+		case 2:
+			UnfilterUp(row, previous, rowBytes);
+			return true;
+		case 3:
+			if(simd)
+			{
+				UnfilterAverageSimd(row, previous, rowBytes, bpp);
+				return true;
+			}
+			for(size_t i = 0; i < rowBytes; i++)
+			{
+				int left = i >= bpp ? row[i - bpp] : 0;
+				row[i] = uint8_t(row[i] + ((left + previous[i]) >> 1));
+			}
+			return true;
+		case 4:
+			if(simd)
+			{
+				UnfilterPaethSimd(row, previous, rowBytes, bpp);
+				return true;
+			}
+			for(size_t i = 0; i < rowBytes; i++)
+			{
+				int left = i >= bpp ? row[i - bpp] : 0;
+				int upLeft = i >= bpp ? previous[i - bpp] : 0;
+				row[i] = uint8_t(row[i] + Paeth(left, previous[i], upLeft));
+			}
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	uint32_t ReadBigEndian32(const uint8_t* p)
+	{
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+	}
+
+	struct PngHeader
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t BitDepth;
+		uint32_t ColorType;
+		uint32_t Channels;
+		bool Interlaced;
+
+		uint32_t BitsPerPixel() const { return Channels * BitDepth; }
+		//distance to the corresponding byte of the previous pixel, used by the filters
+		uint32_t FilterBpp() const { return std::max(1u, BitsPerPixel() / 8); }
+		size_t RowBytes(uint32_t width) const { return (size_t(width) * BitsPerPixel() + 7) / 8; }
+	};
+
+	struct Transparency
+	{
+		uint8_t Palette[256][4];
+		bool HasKey = false;
+		uint16_t Key[3] = {}; //gray or rgb sample that becomes fully transparent
+	};
+
+	uint32_t OutputPixelBytes(PngFormat format)
+	{
+		switch(format)
+		{
+		case PngFormat::R8: return 1;
+		case PngFormat::R16: return 2;
+		case PngFormat::R8G8B8A8: return 4;
+		default: return 8;
+		}
+	}
+
+	uint32_t ReadSample(const uint8_t* row, uint32_t x, uint32_t bitDepth)
+	{
+		uint32_t bit = x * bitDepth;
+		return (row[bit >> 3] >> (8 - bitDepth - (bit & 7))) & ((1u << bitDepth) - 1);
+	}
+
+	void Store16(uint8_t* out, uint32_t value)
+	{
+		out[0] = uint8_t(value);
+		out[1] = uint8_t(value >> 8);
+	}
+
+	//expands one unfiltered row into the output format
+	void ConvertRow(const PngHeader& header, const Transparency& transparency, const uint8_t* row, uint32_t width, uint8_t* out)
+	{
+		uint32_t depth = header.BitDepth;
+		if(depth == 16)
+		{
+			for(uint32_t x = 0; x < width; x++)
+			{
+				const uint8_t* p = row + size_t(x) * header.Channels * 2;
+				uint32_t samples[4];
+				for(uint32_t c = 0; c < header.Channels; c++)
+				{
+					samples[c] = (uint32_t(p[c * 2]) << 8) | p[c * 2 + 1];
+				}
+				switch(header.ColorType)
+				{
+				case 0:
+					if(!transparency.HasKey)
+					{
+						Store16(out + x * 2, samples[0]);
+						break;
+					}
+					Store16(out + x * 8, samples[0]);
+					Store16(out + x * 8 + 2, samples[0]);
+					Store16(out + x * 8 + 4, samples[0]);
+					Store16(out + x * 8 + 6, samples[0] == transparency.Key[0] ? 0 : 0xFFFF);
+					break;
+				case 2:
+				{
+					bool transparent = transparency.HasKey && samples[0] == transparency.Key[0] &&
+					                   samples[1] == transparency.Key[1] && samples[2] == transparency.Key[2];
+					Store16(out + x * 8, samples[0]);
+					Store16(out + x * 8 + 2, samples[1]);
+					Store16(out + x * 8 + 4, samples[2]);
+					Store16(out + x * 8 + 6, transparent ? 0 : 0xFFFF);
+					break;
+				}
+				case 4:
+					Store16(out + x * 8, samples[0]);
+					Store16(out + x * 8 + 2, samples[0]);
+					Store16(out + x * 8 + 4, samples[0]);
+					Store16(out + x * 8 + 6, samples[1]);
+					break;
+				default:
+					for(uint32_t c = 0; c < 4; c++)
+					{
+						Store16(out + x * 8 + c * 2, samples[c]);
+					}
+					break;
+				}
+			}
+			return;
+		}
+
+		switch(header.ColorType)
+		{
+		case 0:
+		{
+			uint32_t scale = 255 / ((1u << depth) - 1);
+			for(uint32_t x = 0; x < width; x++)
+			{
+				uint32_t sample = ReadSample(row, x, depth);
+				if(!transparency.HasKey)
+				{
+					out[x] = uint8_t(sample * scale);
+					continue;
+				}
+				//the key is compared before scaling, it is given at the image's bit depth
+				out[x * 4 + 0] = out[x * 4 + 1] = out[x * 4 + 2] = uint8_t(sample * scale);
+				out[x * 4 + 3] = sample == transparency.Key[0] ? 0 : 255;
+			}
+			break;
+		}
+		case 2:
+			for(uint32_t x = 0; x < width; x++)
+			{
+				const uint8_t* p = row + size_t(x) * 3;
+				bool transparent = transparency.HasKey && p[0] == transparency.Key[0] && p[1] == transparency.Key[1] && p[2] == transparency.Key[2];
+				out[x * 4 + 0] = p[0];
+				out[x * 4 + 1] = p[1];
+				out[x * 4 + 2] = p[2];
+				out[x * 4 + 3] = transparent ? 0 : 255;
+			}
+			break;
+		case 3:
+			for(uint32_t x = 0; x < width; x++)
+			{
+				memcpy(out + x * 4, transparency.Palette[ReadSample(row, x, depth)], 4);
+			}
+			break;
+		case 4:
+			for(uint32_t x = 0; x < width; x++)
+			{
+				out[x * 4 + 0] = row[x * 2];
+				out[x * 4 + 1] = row[x * 2];
+				out[x * 4 + 2] = row[x * 2];
+				out[x * 4 + 3] = row[x * 2 + 1];
+			}
+			break;
+		default:
+			memcpy(out, row, size_t(width) * 4);
+			break;
+		}
+	}
+
+	struct Pass
+	{
+		uint32_t X, Y, StepX, StepY;
+	};
+
+	const Pass Adam7[7] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+	const Pass Progressive = {0, 0, 1, 1};
+}
+
+bool DecodePng(const uint8_t* data, size_t size, PngImage& out, std::string* error)
+{
+	auto fail = [error](const char* message)
+	{
+		if(error)
+		{
+			*error = message;
+		}
+		return false;
+	};
+
+	static const uint8_t Signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+	if(size < 8 || memcmp(data, Signature, 8) != 0)
+	{
+		return fail("not a png file");
+	}
+
+	PngHeader header = {};
+	Transparency transparency;
+	for(uint32_t i = 0; i < 256; i++)
+	{
+		transparency.Palette[i][0] = transparency.Palette[i][1] = transparency.Palette[i][2] = 0;
+		transparency.Palette[i][3] = 255;
+	}
+	bool hasHeader = false;
+	bool hasPalette = false;
+	std::vector<uint8_t> compressed;
+
+	size_t position = 8;
+	while(true)
+	{
+		if(position + 12 > size)
+		{
+			return fail("missing IEND chunk");
+		}
+		uint32_t length = ReadBigEndian32(data + position);
+		const uint8_t* type = data + position + 4;
+		const uint8_t* body = data + position + 8;
+		if(length > size - position - 12)
+		{
+			return fail("truncated chunk");
+		}
+		position += size_t(length) + 12;
+
+		if(memcmp(type, "IHDR", 4) == 0)
+		{
+			if(length != 13)
+			{
+				return fail("invalid IHDR chunk");
+			}
+			header.Width = ReadBigEndian32(body);
+			header.Height = ReadBigEndian32(body + 4);
+			header.BitDepth = body[8];
+			header.ColorType = body[9];
+			header.Interlaced = body[12] == 1;
+			const uint32_t channels[7] = {1, 0, 3, 1, 2, 0, 4};
+			header.Channels = header.ColorType < 7 ? channels[header.ColorType] : 0;
+
+			uint32_t depth = header.BitDepth;
+			bool validDepth = depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+			bool validCombination = header.Channels != 0 && validDepth &&
+			                        (header.ColorType == 0 || header.ColorType == 3 || depth >= 8) && (header.ColorType != 3 || depth <= 8);
+			if(!validCombination || body[10] != 0 || body[11] != 0 || body[12] > 1)
+			{
+				return fail("unsupported IHDR settings");
+			}
+			if(header.Width == 0 || header.Height == 0 || header.Width > (1u << 24) || header.Height > (1u << 24))
+			{
+				return fail("invalid image size");
+			}
+			hasHeader = true;
+		}
+		else if(memcmp(type, "PLTE", 4) == 0)
+		{
+			if(length % 3 != 0 || length > 768)
+			{
+				return fail("invalid PLTE chunk");
+			}
+			for(uint32_t i = 0; i < length / 3; i++)
+			{
+				memcpy(transparency.Palette[i], body + i * 3, 3);
+			}
+			hasPalette = true;
+		}
+		else if(memcmp(type, "tRNS", 4) == 0)
+		{
+			if(header.ColorType == 3)
+			{
+				for(uint32_t i = 0; i < std::min(length, 256u); i++)
+				{
+					transparency.Palette[i][3] = body[i];
+				}
+			}
+			else if(header.ColorType == 0 && length >= 2)
+			{
+				transparency.HasKey = true;
+				transparency.Key[0] = uint16_t((body[0] << 8) | body[1]);
+			}
+			else if(header.ColorType == 2 && length >= 6)
+			{
+				transparency.HasKey = true;
+				for(uint32_t c = 0; c < 3; c++)
+				{
+					transparency.Key[c] = uint16_t((body[c * 2] << 8) | body[c * 2 + 1]);
+				}
+			}
+		}
+		else if(memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), body, body + length);
+		}
+		else if(memcmp(type, "IEND", 4) == 0)
+		{
+			break;
+		}
+		else if(!(type[0] & 0x20))
+		{
+			return fail("unknown critical chunk");
+		}
+	}
+
+	if(!hasHeader || compressed.size() < 2)
+	{
+		return fail("missing IHDR or IDAT chunk");
+	}
+	if(header.ColorType == 3 && !hasPalette)
+	{
+		return fail("missing PLTE chunk");
+	}
+	if((compressed[0] & 15) != 8 || ((compressed[0] << 8) | compressed[1]) % 31 != 0 || (compressed[1] & 0x20))
+	{
+		return fail("invalid zlib header");
+	}
+
+	//gray with a transparent key needs an alpha channel, so it is expanded like gray alpha
+	if(header.ColorType == 0 && !transparency.HasKey)
+	{
+		out.Format = header.BitDepth == 16 ? PngFormat::R16 : PngFormat::R8;
+	}
+	else
+	{
+		out.Format = header.BitDepth == 16 ? PngFormat::R16G16B16A16 : PngFormat::R8G8B8A8;
+	}
+	uint32_t pixelBytes = OutputPixelBytes(out.Format);
+	//the filtered rows take at most one more byte per row than the output, so this bounds both buffers
+	uint64_t imageBytes = uint64_t(header.Width) * header.Height * pixelBytes;
+	if(imageBytes > MaxImageBytes || imageBytes + header.Height > SIZE_MAX)
+	{
+		return fail("image too large");
+	}
+
+	//one pass for progressive images, seven reduced images for adam7
+	const Pass* passes = header.Interlaced ? Adam7 : &Progressive;
+	uint32_t passCount = header.Interlaced ? 7 : 1;
+	size_t filteredSize = 0;
+	for(uint32_t p = 0; p < passCount; p++)
+	{
+		uint32_t width = (header.Width - passes[p].X + passes[p].StepX - 1) / passes[p].StepX;
+		uint32_t height = (header.Height - passes[p].Y + passes[p].StepY - 1) / passes[p].StepY;
+		if(width && height)
+		{
+			filteredSize += (header.RowBytes(width) + 1) * height;
+		}
+	}
+
+	std::vector<uint8_t> filtered(filteredSize + InflateSlack);
+	if(const char* inflateError = Inflate(compressed.data() + 2, compressed.size() - 2, filtered.data(), filteredSize))
+	{
+		return fail(inflateError);
+	}
+
+	out.Width = header.Width;
+	out.Height = header.Height;
+	out.RowPitch = header.Width * pixelBytes;
+	out.Pixels.resize(size_t(out.RowPitch) * header.Height);
+
+	uint32_t bpp = header.FilterBpp();
+	std::vector<uint8_t> zeroRow(header.RowBytes(header.Width), 0);
+	std::vector<uint8_t> passRow(header.Interlaced ? size_t(out.RowPitch) : 0);
+	uint8_t* cursor = filtered.data();
+	for(uint32_t p = 0; p < passCount; p++)
+	{
+		const Pass& pass = passes[p];
+		uint32_t width = (header.Width - pass.X + pass.StepX - 1) / pass.StepX;
+		uint32_t height = (header.Height - pass.Y + pass.StepY - 1) / pass.StepY;
+		if(width == 0 || height == 0)
+		{
+			continue;
+		}
+
+		//rows are unfiltered in place, the previous row sits right before the current one
+		size_t rowBytes = header.RowBytes(width);
+		const uint8_t* previous = zeroRow.data();
+		for(uint32_t y = 0; y < height; y++)
+		{
+			uint8_t* row = cursor + 1;
+			if(!Unfilter(cursor[0], row, previous, rowBytes, bpp))
+			{
+				return fail("invalid filter type");
+			}
+
+			uint32_t outY = pass.Y + y * pass.StepY;
+			if(!header.Interlaced)
+			{
+				ConvertRow(header, transparency, row, width, &out.Pixels[size_t(outY) * out.RowPitch]);
+			}
+			else
+			{
+				ConvertRow(header, transparency, row, width, passRow.data());
+				for(uint32_t x = 0; x < width; x++)
+				{
+					uint32_t outX = pass.X + x * pass.StepX;
+					memcpy(&out.Pixels[size_t(outY) * out.RowPitch + size_t(outX) * pixelBytes], &passRow[size_t(x) * pixelBytes], pixelBytes);
+				}
+			}
+			previous = row;
+			cursor += rowBytes + 1;
+		}
+	}
+	return true;
+}
+
+bool LoadPngFile(const std::filesystem::path& filename, PngImage& out, std::string* error)
+{
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	if(!file)
+	{
+		if(error)
+		{
+			*error = "failed to open file";
+		}
+		return false;
+	}
+
+	std::vector<uint8_t> data(size_t(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	return DecodePng(data.data(), data.size(), out, error);
+}
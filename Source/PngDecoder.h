@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+//the formats WIC would hand out for the png, mapped to dxgi by the texture loader:
+//gray -> R8/R16, everything with color, alpha, a palette or a transparent gray key -> R8G8B8A8/R16G16B16A16
+enum class PngFormat
+{
+	R8,
+	R16,
+	R8G8B8A8,
+	R16G16B16A16,
+};
+
+struct PngImage
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t RowPitch; //tightly packed
+	PngFormat Format;
+	std::vector<uint8_t> Pixels; //16 bit channels are little endian
+};
+
+//decodes a png held in memory without any platform codec. Handles every bit depth, color
+//type and interlacing the spec allows, chunk crcs and the zlib checksum are not verified.
+//Returns false and describes the problem in error for malformed or truncated files
+bool DecodePng(const uint8_t* data, size_t size, PngImage& out, std::string* error = nullptr);
+
+bool LoadPngFile(const std::filesystem::path& filename, PngImage& out, std::string* error = nullptr);
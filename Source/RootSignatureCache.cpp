@@ -0,0 +1,156 @@
+#include "RootSignatureCache.h"
+
+#include "ShaderCache.h"
+
+#include <cstring>
+#include <iostream>
+
+static uint32_t FloatBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+std::vector<uint32_t> CanonicalizeRootSignature(const D3D12_ROOT_SIGNATURE_DESC1& desc)
+{
+	std::vector<uint32_t> words;
+	words.push_back(static_cast<uint32_t>(desc.Flags));
+
+	words.push_back(desc.NumParameters);
+	for(uint32_t i = 0; i < desc.NumParameters; i++)
+	{
+		const D3D12_ROOT_PARAMETER1& parameter = desc.pParameters[i];
+		words.push_back(static_cast<uint32_t>(parameter.ParameterType));
+		words.push_back(static_cast<uint32_t>(parameter.ShaderVisibility));
+		switch(parameter.ParameterType)
+		{
+		case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+		{
+			words.push_back(parameter.DescriptorTable.NumDescriptorRanges);
+			uint32_t offset = 0;
+			for(uint32_t r = 0; r < parameter.DescriptorTable.NumDescriptorRanges; r++)
+			{
+				const D3D12_DESCRIPTOR_RANGE1& range = parameter.DescriptorTable.pDescriptorRanges[r];
+				if(range.OffsetInDescriptorsFromTableStart != D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND)
+				{
+					offset = range.OffsetInDescriptorsFromTableStart;
+				}
+				words.push_back(static_cast<uint32_t>(range.RangeType));
+				words.push_back(range.NumDescriptors);
+				words.push_back(range.BaseShaderRegister);
+				words.push_back(range.RegisterSpace);
+				words.push_back(static_cast<uint32_t>(range.Flags));
+				words.push_back(offset);
+				offset += range.NumDescriptors;
+			}
+			break;
+		}
+		case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+			words.push_back(parameter.Constants.ShaderRegister);
+			words.push_back(parameter.Constants.RegisterSpace);
+			words.push_back(parameter.Constants.Num32BitValues);
+			break;
+		default:
+			words.push_back(parameter.Descriptor.ShaderRegister);
+			words.push_back(parameter.Descriptor.RegisterSpace);
+			words.push_back(static_cast<uint32_t>(parameter.Descriptor.Flags));
+			break;
+		}
+	}
+
+	words.push_back(desc.NumStaticSamplers);
+	for(uint32_t i = 0; i < desc.NumStaticSamplers; i++)
+	{
+		const D3D12_STATIC_SAMPLER_DESC& sampler = desc.pStaticSamplers[i];
+		words.push_back(static_cast<uint32_t>(sampler.Filter));
+		words.push_back(static_cast<uint32_t>(sampler.AddressU));
+		words.push_back(static_cast<uint32_t>(sampler.AddressV));
+		words.push_back(static_cast<uint32_t>(sampler.AddressW));
+		words.push_back(FloatBits(sampler.MipLODBias));
+		words.push_back(sampler.MaxAnisotropy);
+		words.push_back(static_cast<uint32_t>(sampler.ComparisonFunc));
+		words.push_back(static_cast<uint32_t>(sampler.BorderColor));
+		words.push_back(FloatBits(sampler.MinLOD));
+		words.push_back(FloatBits(sampler.MaxLOD));
+		words.push_back(sampler.ShaderRegister);
+		words.push_back(sampler.RegisterSpace);
+		words.push_back(static_cast<uint32_t>(sampler.ShaderVisibility));
+	}
+	return words;
+}
+
+uint64_t HashRootSignature(const std::vector<uint32_t>& canonical)
+{
+	return HashBytes(canonical.data(), canonical.size() * sizeof(uint32_t));
+}
+
+RootSignatureCache* RootSignatureCache::GetInstance()
+{
+	static RootSignatureCache instance;
+	return &instance;
+}
+
+ID3D12RootSignature* RootSignatureCache::GetOrCreate(ID3D12Device* device, const D3D12_ROOT_SIGNATURE_DESC1& desc)
+{
+	std::vector<uint32_t> canonical = CanonicalizeRootSignature(desc);
+	uint64_t hash = HashRootSignature(canonical);
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	Stats.Requests++;
+	std::vector<Entry>& bucket = Entries[hash];
+	for(Entry& entry : bucket)
+	{
+		if(entry.Canonical == canonical)
+		{
+			entry.RootSignature->AddRef();
+			return entry.RootSignature;
+		}
+	}
+
+	D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+	rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+	rootSignatureDesc.Desc_1_1 = desc;
+
+	ID3DBlob* signature = nullptr;
+	ID3DBlob* error = nullptr;
+	ID3D12RootSignature* rootSignature = nullptr;
+	if(FAILED(D3D12SerializeVersionedRootSignature(&rootSignatureDesc, &signature, &error)) ||
+	   FAILED(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&rootSignature))))
+	{
+		if(error)
+		{
+			std::cout << static_cast<const char*>(error->GetBufferPointer());
+			error->Release();
+		}
+		if(signature)
+			signature->Release();
+		return nullptr;
+	}
+	signature->Release();
+	rootSignature->SetName(L"Dynamic Root Signature");
+
+	Stats.Created++;
+	bucket.push_back({ std::move(canonical), rootSignature });
+	rootSignature->AddRef();
+	return rootSignature;
+}
+
+RootSignatureCacheStats RootSignatureCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Stats;
+}
+
+void RootSignatureCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	for(auto& [hash, bucket] : Entries)
+	{
+		for(Entry& entry : bucket)
+		{
+			entry.RootSignature->Release();
+		}
+	}
+	Entries.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//flattens a root signature into words that compare equal exactly when the root signatures are
+//interchangeable: every parameter, range and static sampler field in order, with appended range
+//offsets resolved and float sampler fields taken bit for bit. Needs no device
+std::vector<uint32_t> CanonicalizeRootSignature(const D3D12_ROOT_SIGNATURE_DESC1& desc);
+uint64_t HashRootSignature(const std::vector<uint32_t>& canonical);
+
+struct RootSignatureCacheStats
+{
+	uint32_t Requests = 0;
+	uint32_t Created = 0;
+};
+
+//shares one ID3D12RootSignature between all pipelines whose shaders reflect to the same layout
+class RootSignatureCache
+{
+public:
+	static RootSignatureCache* GetInstance();
+
+	//returns an AddRef'ed root signature, nullptr when serialization or creation fails
+	ID3D12RootSignature* GetOrCreate(ID3D12Device* device, const D3D12_ROOT_SIGNATURE_DESC1& desc);
+
+	RootSignatureCacheStats GetStats() const;
+	//releases the cache's references, signatures still held by pipelines stay alive
+	void Clear();
+
+private:
+	RootSignatureCache() = default;
+
+	struct Entry
+	{
+		std::vector<uint32_t> Canonical; //compared on a hash match, so a collision never shares the wrong signature
+		ID3D12RootSignature* RootSignature;
+	};
+
+	mutable std::mutex Mutex;
+	std::unordered_map<uint64_t, std::vector<Entry>> Entries;
+	RootSignatureCacheStats Stats;
+};
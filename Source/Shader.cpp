@@ -1,12 +1,24 @@
 #include "Shader.h"
 
 #include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
 #include <optional>
+#include <stdexcept>
 
 Shader::Shader()
 {
 }
 
+void Shader::SetSource(LPCWSTR shaderFile, const ShaderDefines& defines, const ShaderCompileOutput& shaderData)
+{
+	SourceFile = shaderFile;
+	Defines = defines;
+	Dependencies = shaderData.Dependencies;
+}
+
 void Shader::Reflect(ShaderCompileOutput shaderData, D3D12_SHADER_VISIBILITY shaderVisibility)
 {
 	D3D12_SHADER_DESC shaderDesc{};
@@ -22,9 +34,20 @@ void Shader::Reflect(ShaderCompileOutput shaderData, D3D12_SHADER_VISIBILITY sha
 		if(shaderInputBindDesc.Type == D3D_SIT_CBUFFER)
 		{
 			Parameters.FreeParameterIndexMap[shaderInputBindDesc.Name] = static_cast<uint32_t>(Parameters.RootParameters.size());
-			ID3D12ShaderReflectionConstantBuffer* shaderReflectionConstantBuffer = shaderData.ShaderReflection->GetConstantBufferByIndex(i);
+			//constant buffers are indexed separately from bound resources, so look it up by name
+			ID3D12ShaderReflectionConstantBuffer* shaderReflectionConstantBuffer = shaderData.ShaderReflection->GetConstantBufferByName(shaderInputBindDesc.Name);
 			D3D12_SHADER_BUFFER_DESC constantBufferDesc = {};
-			shaderReflectionConstantBuffer->GetDesc(&constantBufferDesc);
+			ThrowIfFailed(shaderReflectionConstantBuffer->GetDesc(&constantBufferDesc));
+			Parameters.ConstantBufferSizes[shaderInputBindDesc.Name] = constantBufferDesc.Size;
+			if(strcmp(shaderInputBindDesc.Name, BindlessConstantBufferName) == 0)
+			{
+				for(uint32_t v = 0; v < constantBufferDesc.Variables; v++)
+				{
+					D3D12_SHADER_VARIABLE_DESC variableDesc = {};
+					ThrowIfFailed(shaderReflectionConstantBuffer->GetVariableByIndex(v)->GetDesc(&variableDesc));
+					Parameters.BindlessTextureOffsets[variableDesc.Name] = variableDesc.StartOffset / 4;
+				}
+			}
 
 			D3D12_ROOT_PARAMETER1 rootParameter;
 			rootParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
@@ -102,14 +125,198 @@ void Shader::Reflect(ShaderCompileOutput shaderData, D3D12_SHADER_VISIBILITY sha
 	}
 }
 
-D3D12_SHADER_BYTECODE Shader::GetShaderByteCode()
+D3D12_SHADER_BYTECODE Shader::GetShaderByteCode() const
 {
 	D3D12_SHADER_BYTECODE bytecode = {};
+	if(!ShaderBlob)
+	{
+		bytecode.BytecodeLength = BundleByteCodeSize;
+		bytecode.pShaderBytecode = BundleByteCode;
+		return bytecode;
+	}
 	bytecode.BytecodeLength = ShaderBlob->GetBufferSize();
 	bytecode.pShaderBytecode = ShaderBlob->GetBufferPointer();
 	return bytecode;
 }
 
+std::string Shader::GetBundleKey(const char* stage, const std::wstring& shaderFile, const ShaderDefines& defines)
+{
+	//utf-8 so the key does not depend on the size of wchar_t
+	return std::string(stage) + "|" + std::filesystem::path(shaderFile).u8string() + "|" + std::filesystem::path(GetPermutationKey(defines)).u8string();
+}
+
+void Shader::WriteParameters(ByteWriter& writer) const
+{
+	writer.Write(static_cast<uint32_t>(Parameters.RootParameters.size()));
+	for(const D3D12_ROOT_PARAMETER1& parameter : Parameters.RootParameters)
+	{
+		writer.Write(static_cast<uint32_t>(parameter.ParameterType));
+		writer.Write(static_cast<uint32_t>(parameter.ShaderVisibility));
+		switch(parameter.ParameterType)
+		{
+		case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+			writer.Write(parameter.Constants.ShaderRegister);
+			writer.Write(parameter.Constants.RegisterSpace);
+			writer.Write(parameter.Constants.Num32BitValues);
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_CBV:
+		case D3D12_ROOT_PARAMETER_TYPE_SRV:
+		case D3D12_ROOT_PARAMETER_TYPE_UAV:
+			writer.Write(parameter.Descriptor.ShaderRegister);
+			writer.Write(parameter.Descriptor.RegisterSpace);
+			writer.Write(static_cast<uint32_t>(parameter.Descriptor.Flags));
+			break;
+		default:
+			break; //tables are restored from DescriptorTableIndexMap
+		}
+	}
+
+	writer.Write(static_cast<uint32_t>(Parameters.FreeParameterIndexMap.size()));
+	for(const auto& [name, index] : Parameters.FreeParameterIndexMap)
+	{
+		writer.Write(name);
+		writer.Write(index);
+	}
+
+	writer.Write(static_cast<uint32_t>(Parameters.DescriptorTableIndexMap.size()));
+	for(const auto& [name, table] : Parameters.DescriptorTableIndexMap)
+	{
+		writer.Write(name);
+		writer.Write(table.Index);
+		writer.Write(static_cast<uint32_t>(table.DescriptorRanges.size()));
+		for(const D3D12_DESCRIPTOR_RANGE1& range : table.DescriptorRanges)
+		{
+			writer.Write(static_cast<uint32_t>(range.RangeType));
+			writer.Write(range.NumDescriptors);
+			writer.Write(range.BaseShaderRegister);
+			writer.Write(range.RegisterSpace);
+			writer.Write(static_cast<uint32_t>(range.Flags));
+			writer.Write(range.OffsetInDescriptorsFromTableStart);
+		}
+		writer.Write(static_cast<uint32_t>(table.IndexMap.size()));
+		for(const auto& [textureName, textureIndex] : table.IndexMap)
+		{
+			writer.Write(textureName);
+			writer.Write(textureIndex);
+		}
+	}
+
+	writer.Write(static_cast<uint32_t>(Parameters.ConstantBufferSizes.size()));
+	for(const auto& [name, size] : Parameters.ConstantBufferSizes)
+	{
+		writer.Write(name);
+		writer.Write(size);
+	}
+
+	writer.Write(static_cast<uint32_t>(Parameters.BindlessTextureOffsets.size()));
+	for(const auto& [name, offset] : Parameters.BindlessTextureOffsets)
+	{
+		writer.Write(name);
+		writer.Write(offset);
+	}
+}
+
+ByteReader Shader::LoadFromBundle(const ShaderBundle& bundle, const char* stage, LPCWSTR shaderFile, const ShaderDefines& defines)
+{
+	const uint8_t* reflection = nullptr;
+	size_t reflectionSize = 0;
+	if(!bundle.Find(GetBundleKey(stage, shaderFile, defines), BundleByteCode, BundleByteCodeSize, reflection, reflectionSize))
+	{
+		throw std::runtime_error("Shader missing from the bundle, cook it again");
+	}
+	SourceFile = shaderFile;
+	Defines = defines;
+
+	ByteReader reader(reflection, reflectionSize);
+	Parameters.RootParameters.resize(reader.ReadUint());
+	for(D3D12_ROOT_PARAMETER1& parameter : Parameters.RootParameters)
+	{
+		parameter = {};
+		parameter.ParameterType = static_cast<D3D12_ROOT_PARAMETER_TYPE>(reader.ReadUint());
+		parameter.ShaderVisibility = static_cast<D3D12_SHADER_VISIBILITY>(reader.ReadUint());
+		switch(parameter.ParameterType)
+		{
+		case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+			parameter.Constants.ShaderRegister = reader.ReadUint();
+			parameter.Constants.RegisterSpace = reader.ReadUint();
+			parameter.Constants.Num32BitValues = reader.ReadUint();
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_CBV:
+		case D3D12_ROOT_PARAMETER_TYPE_SRV:
+		case D3D12_ROOT_PARAMETER_TYPE_UAV:
+			parameter.Descriptor.ShaderRegister = reader.ReadUint();
+			parameter.Descriptor.RegisterSpace = reader.ReadUint();
+			parameter.Descriptor.Flags = static_cast<D3D12_ROOT_DESCRIPTOR_FLAGS>(reader.ReadUint());
+			break;
+		default:
+			break;
+		}
+	}
+
+	uint32_t freeParameterCount = reader.ReadUint();
+	for(uint32_t i = 0; i < freeParameterCount && !reader.Failed; i++)
+	{
+		std::string name = reader.ReadString();
+		Parameters.FreeParameterIndexMap[name] = reader.ReadUint();
+	}
+
+	uint32_t tableCount = reader.ReadUint();
+	for(uint32_t i = 0; i < tableCount && !reader.Failed; i++)
+	{
+		DescriptorTableIndexed& table = Parameters.DescriptorTableIndexMap[reader.ReadString()];
+		table.Index = reader.ReadUint();
+		table.DescriptorRanges.resize(std::min<uint32_t>(reader.ReadUint(), 64));
+		for(D3D12_DESCRIPTOR_RANGE1& range : table.DescriptorRanges)
+		{
+			range.RangeType = static_cast<D3D12_DESCRIPTOR_RANGE_TYPE>(reader.ReadUint());
+			range.NumDescriptors = reader.ReadUint();
+			range.BaseShaderRegister = reader.ReadUint();
+			range.RegisterSpace = reader.ReadUint();
+			range.Flags = static_cast<D3D12_DESCRIPTOR_RANGE_FLAGS>(reader.ReadUint());
+			range.OffsetInDescriptorsFromTableStart = reader.ReadUint();
+		}
+		uint32_t textureCount = reader.ReadUint();
+		for(uint32_t j = 0; j < textureCount && !reader.Failed; j++)
+		{
+			std::string textureName = reader.ReadString();
+			table.IndexMap[textureName] = reader.ReadUint();
+		}
+
+		if(table.Index >= Parameters.RootParameters.size() ||
+		   Parameters.RootParameters[table.Index].ParameterType != D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+		{
+			reader.Failed = true;
+			break;
+		}
+		Parameters.RootParameters[table.Index].DescriptorTable.NumDescriptorRanges = static_cast<uint32_t>(table.DescriptorRanges.size());
+		Parameters.RootParameters[table.Index].DescriptorTable.pDescriptorRanges = table.DescriptorRanges.data();
+	}
+
+	uint32_t constantBufferCount = reader.ReadUint();
+	for(uint32_t i = 0; i < constantBufferCount && !reader.Failed; i++)
+	{
+		std::string name = reader.ReadString();
+		Parameters.ConstantBufferSizes[name] = reader.ReadUint();
+	}
+
+	uint32_t bindlessTextureCount = reader.ReadUint();
+	for(uint32_t i = 0; i < bindlessTextureCount && !reader.Failed; i++)
+	{
+		std::string name = reader.ReadString();
+		Parameters.BindlessTextureOffsets[name] = reader.ReadUint();
+	}
+
+	for(const auto& [name, index] : Parameters.FreeParameterIndexMap)
+	{
+		reader.Failed |= index >= Parameters.RootParameters.size();
+	}
+	if(reader.Failed)
+	{
+		throw std::runtime_error("Corrupt shader bundle entry");
+	}
+	return reader;
+}
+
 DXGI_FORMAT maskToFormat(BYTE mask, D3D_REGISTER_COMPONENT_TYPE componentType)
 {
 	switch (componentType)
@@ -156,11 +363,45 @@ DXGI_FORMAT maskToFormat(BYTE mask, D3D_REGISTER_COMPONENT_TYPE componentType)
 
 }
 
-VertexShader::VertexShader(LPCWSTR shaderFile): Shader()
+VertexShader::VertexShader(LPCWSTR shaderFile, const ShaderDefines& defines): Shader()
 {
+	if(ShaderBundle::Active)
+	{
+		ByteReader reader = LoadFromBundle(*ShaderBundle::Active, "vs", shaderFile, defines);
+		uint32_t elementCount = std::min<uint32_t>(reader.ReadUint(), D3D12_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT);
+		InputElementSemanticNames.reserve(elementCount);
+		InputElementDescs.reserve(elementCount);
+		for(uint32_t i = 0; i < elementCount; i++)
+		{
+			InputElementSemanticNames.push_back(reader.ReadString());
+
+			D3D12_INPUT_ELEMENT_DESC inputElementDesc;
+			inputElementDesc.SemanticName = InputElementSemanticNames.back().c_str();
+			inputElementDesc.SemanticIndex = reader.ReadUint();
+			inputElementDesc.Format = static_cast<DXGI_FORMAT>(reader.ReadUint());
+			inputElementDesc.InputSlot = reader.ReadUint();
+			inputElementDesc.AlignedByteOffset = reader.ReadUint();
+			inputElementDesc.InputSlotClass = static_cast<D3D12_INPUT_CLASSIFICATION>(reader.ReadUint());
+			inputElementDesc.InstanceDataStepRate = reader.ReadUint();
+			InputElementDescs.push_back(inputElementDesc);
+		}
+		if(reader.Failed)
+		{
+			throw std::runtime_error("Corrupt shader bundle entry");
+		}
+
+		InputLayoutDesc.NumElements = static_cast<uint32_t>(InputElementDescs.size());
+		InputLayoutDesc.pInputElementDescs = InputElementDescs.data();
+		return;
+	}
+
 	auto shaderCompiler = ShaderCompiler::GetInstance();
 	ShaderCompileOutput shaderData;
-	shaderCompiler->CompileVertexShader(shaderFile, shaderData);
+	if(!shaderCompiler->CompileVertexShader(shaderFile, shaderData, L"", defines))
+	{
+		throw std::runtime_error("Failed to compile vertex shader");
+	}
+	SetSource(shaderFile, defines, shaderData);
 	ShaderBlob = shaderData.ShaderBlob;
 	D3D12_SHADER_DESC shaderDesc{};
 	ThrowIfFailed(shaderData.ShaderReflection->GetDesc(&shaderDesc));
@@ -193,12 +434,147 @@ VertexShader::VertexShader(LPCWSTR shaderFile): Shader()
 	Reflect(shaderData, D3D12_SHADER_VISIBILITY_VERTEX);
 }
 
-PixelShader::PixelShader(LPCWSTR shaderFile): Shader()
+ShaderBundleItem VertexShader::SerializeForBundle() const
+{
+	ShaderBundleItem item;
+	item.Key = GetBundleKey("vs", SourceFile, Defines);
+	D3D12_SHADER_BYTECODE byteCode = GetShaderByteCode();
+	item.Object.assign(static_cast<const uint8_t*>(byteCode.pShaderBytecode), static_cast<const uint8_t*>(byteCode.pShaderBytecode) + byteCode.BytecodeLength);
+
+	ByteWriter writer(item.Reflection);
+	WriteParameters(writer);
+	writer.Write(static_cast<uint32_t>(InputElementDescs.size()));
+	for(const D3D12_INPUT_ELEMENT_DESC& inputElementDesc : InputElementDescs)
+	{
+		writer.Write(std::string(inputElementDesc.SemanticName));
+		writer.Write(inputElementDesc.SemanticIndex);
+		writer.Write(static_cast<uint32_t>(inputElementDesc.Format));
+		writer.Write(inputElementDesc.InputSlot);
+		writer.Write(inputElementDesc.AlignedByteOffset);
+		writer.Write(static_cast<uint32_t>(inputElementDesc.InputSlotClass));
+		writer.Write(inputElementDesc.InstanceDataStepRate);
+	}
+	return item;
+}
+
+PixelShader::PixelShader(LPCWSTR shaderFile, const ShaderDefines& defines): Shader()
 {
+	if(ShaderBundle::Active)
+	{
+		LoadFromBundle(*ShaderBundle::Active, "ps", shaderFile, defines);
+		return;
+	}
+
 	auto shaderCompiler = ShaderCompiler::GetInstance();
 	ShaderCompileOutput shaderData;
-	shaderCompiler->CompilePixelShader(shaderFile, shaderData);
+	if(!shaderCompiler->CompilePixelShader(shaderFile, shaderData, L"", defines))
+	{
+		throw std::runtime_error("Failed to compile pixel shader");
+	}
+	SetSource(shaderFile, defines, shaderData);
 	ShaderBlob = shaderData.ShaderBlob;
 
 	Reflect(shaderData, D3D12_SHADER_VISIBILITY_PIXEL);
 }
+
+ShaderBundleItem PixelShader::SerializeForBundle() const
+{
+	ShaderBundleItem item;
+	item.Key = GetBundleKey("ps", SourceFile, Defines);
+	D3D12_SHADER_BYTECODE byteCode = GetShaderByteCode();
+	item.Object.assign(static_cast<const uint8_t*>(byteCode.pShaderBytecode), static_cast<const uint8_t*>(byteCode.pShaderBytecode) + byteCode.BytecodeLength);
+
+	ByteWriter writer(item.Reflection);
+	WriteParameters(writer);
+	return item;
+}
+
+bool CookShaderBundle(const std::filesystem::path& filename, const std::vector<ShaderBundleSource>& sources)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ShaderBatch batch;
+	std::vector<std::future<std::unique_ptr<VertexShader>>> vertexShaders;
+	std::vector<std::future<std::unique_ptr<PixelShader>>> pixelShaders;
+	for(const ShaderBundleSource& source : sources)
+	{
+		if(source.IsVertex)
+			vertexShaders.push_back(batch.AddVertexShader(source.ShaderFile, source.Defines));
+		else
+			pixelShaders.push_back(batch.AddPixelShader(source.ShaderFile, source.Defines));
+	}
+	batch.Start();
+
+	std::vector<ShaderBundleItem> items;
+	try
+	{
+		for(auto& shader : vertexShaders)
+			items.push_back(shader.get()->SerializeForBundle());
+		for(auto& shader : pixelShaders)
+			items.push_back(shader.get()->SerializeForBundle());
+	}
+	catch(const std::exception& e)
+	{
+		std::cout << "Shader bundle not written: " << e.what() << std::endl;
+		return false;
+	}
+
+	if(!WriteShaderBundle(filename, std::move(items)))
+	{
+		return false;
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "Cooked " << sources.size() << " shaders into " << filename.string() << " ("
+	          << std::filesystem::file_size(filename) / 1024.0 << " KB) in " << elapsed.count() << " ms" << std::endl;
+	return true;
+}
+
+ShaderBatch::~ShaderBatch()
+{
+	for(auto& worker : Workers)
+	{
+		worker.join();
+	}
+}
+
+//packaged_task is move only while std::function has to be copyable, so the task is shared
+template<typename T>
+static std::future<std::unique_ptr<T>> AddJob(std::vector<std::function<void()>>& jobs, std::wstring shaderFile, ShaderDefines defines)
+{
+	auto task = std::make_shared<std::packaged_task<std::unique_ptr<T>()>>([shaderFile = std::move(shaderFile), defines = std::move(defines)]()
+	{
+		return std::make_unique<T>(shaderFile.c_str(), defines);
+	});
+	jobs.emplace_back([task]() { (*task)(); });
+	return task->get_future();
+}
+
+std::future<std::unique_ptr<VertexShader>> ShaderBatch::AddVertexShader(std::wstring shaderFile, ShaderDefines defines)
+{
+	assert(Workers.empty());
+	return AddJob<VertexShader>(Jobs, std::move(shaderFile), std::move(defines));
+}
+
+std::future<std::unique_ptr<PixelShader>> ShaderBatch::AddPixelShader(std::wstring shaderFile, ShaderDefines defines)
+{
+	assert(Workers.empty());
+	return AddJob<PixelShader>(Jobs, std::move(shaderFile), std::move(defines));
+}
+
+void ShaderBatch::Start()
+{
+	size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), Jobs.size());
+	Workers.reserve(threadCount);
+	for(size_t i = 0; i < threadCount; i++)
+	{
+		Workers.emplace_back(&ShaderBatch::WorkerLoop, this);
+	}
+}
+
+void ShaderBatch::WorkerLoop()
+{
+	for(size_t job = NextJob++; job < Jobs.size(); job = NextJob++)
+	{
+		Jobs[job]();
+	}
+}
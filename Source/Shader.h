@@ -1,6 +1,13 @@
 #pragma once
+#include <atomic>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
+#include <string>
+#include <thread>
 
+#include "ShaderBundle.h"
 #include "ShaderCompiler.h"
 
 struct DescriptorTableIndexed
@@ -16,17 +23,45 @@ struct ShaderParameters
 
 	std::map<std::string, uint32_t> FreeParameterIndexMap;
 	std::map<std::string, DescriptorTableIndexed> DescriptorTableIndexMap;
+
+	std::map<std::string, uint32_t> ConstantBufferSizes; //bytes, as reflected
+	//cbuffers DynamicRootSignature turned into root constants and their number of 32 bit values,
+	//their FreeParameterIndexMap entries point at 32BIT_CONSTANTS parameters instead of CBVs
+	std::map<std::string, uint32_t> RootConstantCounts;
+
+	//members of the bindless cbuffer by name and their offset in 32 bit values, see BindlessConstantBufferName
+	std::map<std::string, uint32_t> BindlessTextureOffsets;
 };
 
+//bindless convention: every uint in a cbuffer of this name is the ResourceDescriptorHeap index of
+//the texture bound under the member's name, e.g.
+//	cbuffer bindless { uint frontCulled; };
+//	Texture2D<float> frontCulledTexture = ResourceDescriptorHeap[frontCulled];
+//The cbuffer is promoted to root constants before any other so Pipeline can set the indices
+constexpr char BindlessConstantBufferName[] = "bindless";
+
 class Shader
 {
 protected:
 	Shader();
 	void Reflect(ShaderCompileOutput shaderData, D3D12_SHADER_VISIBILITY shaderVisibility);
+	void SetSource(LPCWSTR shaderFile, const ShaderDefines& defines, const ShaderCompileOutput& shaderData);
+	//points the bytecode into the bundle and restores Parameters, the returned reader continues
+	//with whatever the derived shader wrote after them. Throws when the bundle lacks the shader
+	ByteReader LoadFromBundle(const ShaderBundle& bundle, const char* stage, LPCWSTR shaderFile, const ShaderDefines& defines);
+	void WriteParameters(ByteWriter& writer) const;
 public:
+	//"stage|file|defines", the file is used as given so cooking and loading have to use the same paths
+	static std::string GetBundleKey(const char* stage, const std::wstring& shaderFile, const ShaderDefines& defines);
+
 	std::string ShaderName;
+	std::wstring SourceFile;
+	ShaderDefines Defines;
+	std::vector<std::filesystem::path> Dependencies; //SourceFile followed by every file it includes
 	CComPtr<ID3DBlob> ShaderBlob;
-	D3D12_SHADER_BYTECODE GetShaderByteCode();
+	const uint8_t* BundleByteCode = nullptr; //used instead of ShaderBlob when loaded from a bundle
+	size_t BundleByteCodeSize = 0;
+	D3D12_SHADER_BYTECODE GetShaderByteCode() const;
 
 	ShaderParameters Parameters;
 };
@@ -34,7 +69,8 @@ public:
 class VertexShader : public Shader
 {
 public:
-	VertexShader(LPCWSTR shaderFile);
+	VertexShader(LPCWSTR shaderFile, const ShaderDefines& defines = {});
+	ShaderBundleItem SerializeForBundle() const;
 	std::vector<std::string> InputElementSemanticNames;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> InputElementDescs;
 	D3D12_INPUT_LAYOUT_DESC InputLayoutDesc;
@@ -43,5 +79,67 @@ public:
 class PixelShader : public Shader
 {
 public:
-	PixelShader(LPCWSTR shaderFile);
+	PixelShader(LPCWSTR shaderFile, const ShaderDefines& defines = {});
+	ShaderBundleItem SerializeForBundle() const;
+};
+
+//compiles shaders concurrently on up to hardware_concurrency threads. ShaderCompiler::GetInstance
+//hands every thread its own dxc compiler and the shader constructors reflect on the worker as
+//well, so a future only becomes ready once its shader can be used to build a Pipeline
+class ShaderBatch
+{
+public:
+	ShaderBatch() = default;
+	ShaderBatch(const ShaderBatch&) = delete;
+	ShaderBatch& operator=(const ShaderBatch&) = delete;
+	~ShaderBatch(); //waits for the workers
+
+	//jobs have to be added before Start
+	std::future<std::unique_ptr<VertexShader>> AddVertexShader(std::wstring shaderFile, ShaderDefines defines = {});
+	std::future<std::unique_ptr<PixelShader>> AddPixelShader(std::wstring shaderFile, ShaderDefines defines = {});
+
+	void Start();
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::function<void()>> Jobs;
+	std::atomic<size_t> NextJob{0};
+	std::vector<std::thread> Workers;
+};
+
+struct ShaderBundleSource
+{
+	bool IsVertex;
+	std::wstring ShaderFile;
+	ShaderDefines Defines;
+};
+
+//compiles every source with a ShaderBatch and writes dxil plus serialized reflection into one
+//bundle. Loading it needs neither dxc nor shader reflection
+bool CookShaderBundle(const std::filesystem::path& filename, const std::vector<ShaderBundleSource>& sources);
+
+//permutations of one shader file, each one is compiled the first time it is asked for and kept
+//until the container goes away. Define sets that only differ in order share a permutation
+template<typename T>
+class ShaderPermutations
+{
+public:
+	explicit ShaderPermutations(std::wstring shaderFile) : ShaderFile(std::move(shaderFile)) {}
+
+	T* Get(const ShaderDefines& defines)
+	{
+		std::unique_ptr<T>& permutation = Permutations[GetPermutationKey(defines)];
+		if(!permutation)
+		{
+			permutation = std::make_unique<T>(ShaderFile.c_str(), defines);
+		}
+		return permutation.get();
+	}
+
+	size_t GetPermutationCount() const { return Permutations.size(); }
+
+private:
+	std::wstring ShaderFile;
+	std::map<std::wstring, std::unique_ptr<T>> Permutations;
 };
@@ -0,0 +1,129 @@
+#include "ShaderBundle.h"
+
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+bool WriteShaderBundle(const std::filesystem::path& filename, std::vector<ShaderBundleItem> items)
+{
+	std::vector<ShaderBundleEntry> entries(items.size());
+	for(size_t i = 0; i < items.size(); i++)
+	{
+		entries[i].KeyHash = HashBytes(items[i].Key.data(), items[i].Key.size());
+	}
+	std::vector<uint32_t> order(items.size());
+	for(uint32_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&entries](uint32_t a, uint32_t b) { return entries[a].KeyHash < entries[b].KeyHash; });
+
+	//dxil first at 4 byte aligned offsets, keys and reflection after it
+	std::vector<uint8_t> payload;
+	auto append = [&payload](const void* data, size_t size, uint32_t& outOffset, uint32_t& outSize)
+	{
+		payload.resize((payload.size() + 3) & ~size_t(3));
+		outOffset = static_cast<uint32_t>(payload.size());
+		outSize = static_cast<uint32_t>(size);
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		payload.insert(payload.end(), bytes, bytes + size);
+	};
+	std::vector<ShaderBundleEntry> sorted;
+	sorted.reserve(items.size());
+	for(uint32_t index : order)
+	{
+		ShaderBundleEntry entry = entries[index];
+		append(items[index].Object.data(), items[index].Object.size(), entry.ObjectOffset, entry.ObjectSize);
+		sorted.push_back(entry);
+	}
+	for(size_t i = 0; i < order.size(); i++)
+	{
+		const ShaderBundleItem& item = items[order[i]];
+		if(i > 0 && sorted[i].KeyHash == sorted[i - 1].KeyHash)
+		{
+			std::cout << "Shader bundle key collision for " << item.Key << std::endl;
+			return false;
+		}
+		append(item.Key.data(), item.Key.size(), sorted[i].KeyOffset, sorted[i].KeySize);
+		append(item.Reflection.data(), item.Reflection.size(), sorted[i].ReflectionOffset, sorted[i].ReflectionSize);
+	}
+
+	uint32_t payloadOffset = static_cast<uint32_t>(sizeof(ShaderBundleHeader) + sorted.size() * sizeof(ShaderBundleEntry));
+	for(ShaderBundleEntry& entry : sorted)
+	{
+		entry.KeyOffset += payloadOffset;
+		entry.ObjectOffset += payloadOffset;
+		entry.ReflectionOffset += payloadOffset;
+	}
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if(!file)
+	{
+		std::cout << "Could not write shader bundle " << filename.string() << std::endl;
+		return false;
+	}
+	ShaderBundleHeader header = {};
+	header.Magic = ShaderBundleMagic;
+	header.Version = ShaderBundleVersion;
+	header.EntryCount = static_cast<uint32_t>(sorted.size());
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(sorted.data()), sorted.size() * sizeof(ShaderBundleEntry));
+	file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+	return static_cast<bool>(file);
+}
+
+bool ShaderBundle::Open(LPCWSTR filename)
+{
+	Entries = nullptr;
+	EntryCount = 0;
+	if(!File.Open(filename))
+	{
+		return false;
+	}
+
+	const ShaderBundleHeader* header = reinterpret_cast<const ShaderBundleHeader*>(File.Data);
+	if(File.Size < sizeof(ShaderBundleHeader) || header->Magic != ShaderBundleMagic || header->Version != ShaderBundleVersion ||
+	   (File.Size - sizeof(ShaderBundleHeader)) / sizeof(ShaderBundleEntry) < header->EntryCount)
+	{
+		File.Close();
+		return false;
+	}
+
+	const ShaderBundleEntry* entries = reinterpret_cast<const ShaderBundleEntry*>(File.Data + sizeof(ShaderBundleHeader));
+	for(uint32_t i = 0; i < header->EntryCount; i++)
+	{
+		const ShaderBundleEntry& entry = entries[i];
+		if(uint64_t(entry.KeyOffset) + entry.KeySize > File.Size || uint64_t(entry.ObjectOffset) + entry.ObjectSize > File.Size ||
+		   uint64_t(entry.ReflectionOffset) + entry.ReflectionSize > File.Size)
+		{
+			File.Close();
+			return false;
+		}
+	}
+
+	Entries = entries;
+	EntryCount = header->EntryCount;
+	return true;
+}
+
+bool ShaderBundle::Find(const std::string& key, const uint8_t*& outObject, size_t& outObjectSize,
+                        const uint8_t*& outReflection, size_t& outReflectionSize) const
+{
+	uint64_t keyHash = HashBytes(key.data(), key.size());
+	const ShaderBundleEntry* end = Entries + EntryCount;
+	const ShaderBundleEntry* entry = std::lower_bound(Entries, end, keyHash,
+	                                                  [](const ShaderBundleEntry& entry, uint64_t hash) { return entry.KeyHash < hash; });
+	if(entry == end || entry->KeyHash != keyHash || entry->KeySize != key.size() ||
+	   memcmp(File.Data + entry->KeyOffset, key.data(), key.size()) != 0)
+	{
+		return false;
+	}
+
+	outObject = File.Data + entry->ObjectOffset;
+	outObjectSize = entry->ObjectSize;
+	outReflection = File.Data + entry->ReflectionOffset;
+	outReflectionSize = entry->ReflectionSize;
+	return true;
+}
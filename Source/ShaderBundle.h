@@ -0,0 +1,132 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+constexpr uint32_t ShaderBundleMagic = 0x4E424853; //"SHBN"
+constexpr uint32_t ShaderBundleVersion = 3; //2: cbuffer sizes, 3: bindless texture offsets in the reflection
+
+//bundle layout: this header, EntryCount entries sorted by KeyHash, then the key strings, dxil and
+//serialized reflection the entries point at. Offsets are from the start of the file
+struct ShaderBundleHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t EntryCount;
+	uint32_t Reserved;
+};
+
+struct ShaderBundleEntry
+{
+	uint64_t KeyHash;
+	uint32_t KeyOffset;
+	uint32_t KeySize;
+	uint32_t ObjectOffset;
+	uint32_t ObjectSize;
+	uint32_t ReflectionOffset;
+	uint32_t ReflectionSize;
+};
+
+struct ShaderBundleItem
+{
+	std::string Key; //see Shader::GetBundleKey
+	std::vector<uint8_t> Object;
+	std::vector<uint8_t> Reflection;
+};
+
+//sorts the items by key hash and writes them as one bundle
+bool WriteShaderBundle(const std::filesystem::path& filename, std::vector<ShaderBundleItem> items);
+
+//appends little endian values and length prefixed strings
+class ByteWriter
+{
+public:
+	explicit ByteWriter(std::vector<uint8_t>& out) : Out(out) {}
+
+	void Write(uint32_t value) { WriteBytes(&value, sizeof(value)); }
+	void Write(const std::string& value)
+	{
+		Write(static_cast<uint32_t>(value.size()));
+		WriteBytes(value.data(), value.size());
+	}
+	void WriteBytes(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		Out.insert(Out.end(), bytes, bytes + size);
+	}
+
+private:
+	std::vector<uint8_t>& Out;
+};
+
+//reads what ByteWriter wrote, reads past the end return zeros and set Failed
+class ByteReader
+{
+public:
+	ByteReader(const uint8_t* data, size_t size) : Data(data), Size(size) {}
+
+	uint32_t ReadUint()
+	{
+		uint32_t value = 0;
+		ReadBytes(&value, sizeof(value));
+		return value;
+	}
+	std::string ReadString()
+	{
+		uint32_t size = ReadUint();
+		if(size > Size - Offset)
+		{
+			Failed = true;
+			return {};
+		}
+		std::string value(reinterpret_cast<const char*>(Data + Offset), size);
+		Offset += size;
+		return value;
+	}
+	void ReadBytes(void* out, size_t size)
+	{
+		if(Failed || size > Size - Offset)
+		{
+			Failed = true;
+			memset(out, 0, size);
+			return;
+		}
+		memcpy(out, Data + Offset, size);
+		Offset += size;
+	}
+
+	bool Failed = false;
+
+private:
+	const uint8_t* Data;
+	size_t Size;
+	size_t Offset = 0;
+};
+
+//read only view of a cooked bundle. Shaders point straight into the mapping, so the bundle has to
+//outlive every shader and pipeline created from it
+class ShaderBundle
+{
+public:
+	//returns false when the file is missing, truncated or written with a different version
+	bool Open(LPCWSTR filename);
+	//returns false when the bundle was not cooked with the key
+	bool Find(const std::string& key, const uint8_t*& outObject, size_t& outObjectSize,
+	          const uint8_t*& outReflection, size_t& outReflectionSize) const;
+
+	size_t GetSize() const { return File.Size; }
+	uint32_t GetEntryCount() const { return EntryCount; }
+
+	//when set, shader constructors load from this bundle instead of invoking the compiler
+	inline static ShaderBundle* Active = nullptr;
+
+private:
+	MappedFile File;
+	const ShaderBundleEntry* Entries = nullptr;
+	uint32_t EntryCount = 0;
+};
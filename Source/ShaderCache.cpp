@@ -0,0 +1,209 @@
+#include "ShaderCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <thread>
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+//the length goes in first so consecutive strings can not run into each other
+static uint64_t HashSized(const void* data, size_t size, uint64_t seed)
+{
+	uint64_t length = size;
+	return HashBytes(data, size, HashBytes(&length, sizeof(length), seed));
+}
+
+static bool ReadWholeFile(const std::filesystem::path& path, std::string& outContents)
+{
+	std::ifstream file(path, std::ios::binary);
+	if(!file)
+	{
+		return false;
+	}
+	outContents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+//returns the file names of the #include "..." and #include <...> directives in source order
+static std::vector<std::string> FindIncludes(const std::string& source)
+{
+	std::vector<std::string> includes;
+	size_t lineStart = 0;
+	while(lineStart < source.size())
+	{
+		size_t lineEnd = source.find('\n', lineStart);
+		if(lineEnd == std::string::npos)
+		{
+			lineEnd = source.size();
+		}
+
+		size_t i = source.find_first_not_of(" \t", lineStart);
+		if(i < lineEnd && source[i] == '#')
+		{
+			i = source.find_first_not_of(" \t", i + 1);
+			if(i < lineEnd && source.compare(i, 7, "include") == 0)
+			{
+				i = source.find_first_not_of(" \t", i + 7);
+				if(i < lineEnd && (source[i] == '"' || source[i] == '<'))
+				{
+					char close = source[i] == '"' ? '"' : '>';
+					size_t nameEnd = source.find(close, i + 1);
+					if(nameEnd < lineEnd)
+					{
+						includes.push_back(source.substr(i + 1, nameEnd - i - 1));
+					}
+				}
+			}
+		}
+		lineStart = lineEnd + 1;
+	}
+	return includes;
+}
+
+static uint64_t HashSourceTree(const std::filesystem::path& path, const std::string& contents, uint64_t hash,
+                               std::set<std::filesystem::path>& visited, std::vector<std::filesystem::path>* outDependencies)
+{
+	hash = HashSized(contents.data(), contents.size(), hash);
+
+	for(const std::string& include : FindIncludes(contents))
+	{
+		hash = HashSized(include.data(), include.size(), hash);
+
+		std::filesystem::path resolved = (path.parent_path() / include).lexically_normal();
+		std::string includeContents;
+		if(!ReadWholeFile(resolved, includeContents))
+		{
+			resolved = std::filesystem::path(include).lexically_normal();
+			if(!ReadWholeFile(resolved, includeContents))
+			{
+				//the compile will fail, but the key still has to change once the file shows up
+				uint8_t missing = 0;
+				hash = HashBytes(&missing, 1, hash);
+				continue;
+			}
+		}
+
+		//a file included twice only contributes its contents once, the name above still keys the order
+		if(!visited.insert(resolved).second)
+		{
+			continue;
+		}
+		if(outDependencies)
+		{
+			outDependencies->push_back(resolved);
+		}
+		hash = HashSourceTree(resolved, includeContents, hash, visited, outDependencies);
+	}
+	return hash;
+}
+
+bool ShaderCache::ComputeKey(const std::filesystem::path& sourcePath, const std::vector<std::wstring>& arguments, const std::string& compilerVersion,
+                             uint64_t& outKey, std::vector<std::filesystem::path>* outDependencies) const
+{
+	std::string contents;
+	if(!ReadWholeFile(sourcePath, contents))
+	{
+		return false;
+	}
+
+	uint64_t hash = HashSized(compilerVersion.data(), compilerVersion.size(), HashBytes(&ShaderCacheVersion, sizeof(ShaderCacheVersion)));
+	for(const std::wstring& argument : arguments)
+	{
+		hash = HashSized(argument.data(), argument.size() * sizeof(wchar_t), hash);
+	}
+
+	std::set<std::filesystem::path> visited = { sourcePath.lexically_normal() };
+	outKey = HashSourceTree(sourcePath, contents, hash, visited, outDependencies);
+	return true;
+}
+
+std::filesystem::path ShaderCache::GetEntryPath(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.shc", static_cast<unsigned long long>(key));
+	return Directory / name;
+}
+
+bool ShaderCache::Load(uint64_t key, ShaderCacheEntry& outEntry) const
+{
+	std::ifstream file(GetEntryPath(key), std::ios::binary);
+	if(!file)
+	{
+		return false;
+	}
+
+	ShaderCacheFileHeader header;
+	if(!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.Magic != ShaderCacheMagic ||
+	   header.Version != ShaderCacheVersion || header.Key != key || header.ObjectSize == 0)
+	{
+		return false;
+	}
+
+	file.seekg(0, std::ios::end);
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	if(fileSize != sizeof(header) + header.ObjectSize + header.ReflectionSize)
+	{
+		return false;
+	}
+	file.seekg(sizeof(header));
+
+	outEntry.Object.resize(header.ObjectSize);
+	outEntry.Reflection.resize(header.ReflectionSize);
+	file.read(reinterpret_cast<char*>(outEntry.Object.data()), header.ObjectSize);
+	file.read(reinterpret_cast<char*>(outEntry.Reflection.data()), header.ReflectionSize);
+	return static_cast<bool>(file);
+}
+
+bool ShaderCache::Store(uint64_t key, const ShaderCacheEntry& entry) const
+{
+	std::error_code error;
+	std::filesystem::create_directories(Directory, error);
+
+	std::filesystem::path entryPath = GetEntryPath(key);
+	//two threads can compile the same shader at once, each writes its own temporary file
+	std::filesystem::path tempPath = entryPath;
+	tempPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if(!file)
+		{
+			return false;
+		}
+
+		ShaderCacheFileHeader header = {};
+		header.Magic = ShaderCacheMagic;
+		header.Version = ShaderCacheVersion;
+		header.Key = key;
+		header.ObjectSize = entry.Object.size();
+		header.ReflectionSize = entry.Reflection.size();
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entry.Object.data()), entry.Object.size());
+		file.write(reinterpret_cast<const char*>(entry.Reflection.data()), entry.Reflection.size());
+		if(!file)
+		{
+			file.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, entryPath, error);
+	if(error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
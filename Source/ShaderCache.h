@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+constexpr uint32_t ShaderCacheMagic = 0x43444853; //"SHDC"
+constexpr uint32_t ShaderCacheVersion = 1;
+
+//cache file layout: this header followed by ObjectSize bytes of dxil and ReflectionSize bytes of
+//the reflection container, Key is repeated so a renamed or truncated file is never accepted
+struct ShaderCacheFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Key;
+	uint64_t ObjectSize;
+	uint64_t ReflectionSize;
+};
+
+struct ShaderCacheEntry
+{
+	std::vector<uint8_t> Object;
+	std::vector<uint8_t> Reflection;
+};
+
+//64 bit fnv-1a, chain calls by passing the previous hash as seed
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0xCBF29CE484222325ull);
+
+//on disk shader cache, one file per key. Has no compiler dependencies so the key and the file
+//format can be exercised without dxc
+class ShaderCache
+{
+public:
+	explicit ShaderCache(std::filesystem::path directory) : Directory(std::move(directory)) {}
+
+	//hashes the compiler version, the arguments, the source and every file it #includes, found
+	//next to the including file first and in the working directory second. Includes are
+	//followed even inside inactive #if blocks, which only costs a spurious miss. Returns false
+	//when the source can not be read, outDependencies receives the resolved include paths
+	bool ComputeKey(const std::filesystem::path& sourcePath, const std::vector<std::wstring>& arguments, const std::string& compilerVersion,
+	                uint64_t& outKey, std::vector<std::filesystem::path>* outDependencies = nullptr) const;
+
+	bool Load(uint64_t key, ShaderCacheEntry& outEntry) const;
+	//writes to a temporary file first so a crash never leaves a partial entry behind, safe to call
+	//from several threads
+	bool Store(uint64_t key, const ShaderCacheEntry& entry) const;
+
+	std::filesystem::path GetEntryPath(uint64_t key) const;
+
+private:
+	std::filesystem::path Directory;
+};
@@ -1,51 +1,116 @@
 #include "ShaderCompiler.h"
 
+#include <algorithm>
 #include <iostream>
 
-ShaderCompiler::ShaderCompiler()
+ShaderCompiler::ShaderCompiler() : Cache(L"ShaderCache")
 {
 	DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&Utils));
     DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&Compiler));
     Utils->CreateDefaultIncludeHandler(&IncludeHandler);
+
+    //a different dxc build can produce different dxil for the same source, so it is part of the cache key
+    CComPtr<IDxcVersionInfo> versionInfo;
+    if(SUCCEEDED(Compiler.QueryInterface(&versionInfo)))
+    {
+        UINT32 major = 0, minor = 0;
+        versionInfo->GetVersion(&major, &minor);
+        CompilerVersion = std::to_string(major) + "." + std::to_string(minor);
+    }
+    CComPtr<IDxcVersionInfo2> versionInfo2;
+    if(SUCCEEDED(Compiler.QueryInterface(&versionInfo2)))
+    {
+        UINT32 commitCount = 0;
+        char* commitHash = nullptr;
+        if(SUCCEEDED(versionInfo2->GetCommitInfo(&commitCount, &commitHash)))
+        {
+            CompilerVersion += "." + std::to_string(commitCount) + "-" + commitHash;
+            CoTaskMemFree(commitHash);
+        }
+    }
 }
 
 ShaderCompiler* ShaderCompiler::GetInstance()
 {
-	if(!Instance)
-	{
-        Instance = new ShaderCompiler();
-	}
-    return Instance;
+    thread_local ShaderCompiler instance;
+    return &instance;
 }
 
-bool ShaderCompiler::CompileVertexShader(LPCWSTR shaderPath, ShaderCompileOutput& outCompileResults, LPCWSTR shaderName) const
+ShaderDefines CanonicalizeDefines(const ShaderDefines& defines)
 {
-    LPCWSTR args[] =
+    ShaderDefines canonical;
+    for(const ShaderDefine& define : defines)
     {
-        shaderName,            // Optional shader source file name for error reporting and for PIX shader source view.  
-        L"-E", L"main",              // Entry point.
-        L"-T", L"vs_6_0",            // Target.
-    };
-
-    CComPtr<IDxcBlobUtf16> outShaderName;
-    return CompileShader(args, _countof(args), shaderPath, shaderName, outCompileResults);
+        auto it = std::find_if(canonical.begin(), canonical.end(), [&define](const ShaderDefine& other) { return other.Name == define.Name; });
+        if(it != canonical.end())
+        {
+            it->Value = define.Value;
+        }
+        else
+        {
+            canonical.push_back(define);
+        }
+    }
+    std::sort(canonical.begin(), canonical.end(), [](const ShaderDefine& a, const ShaderDefine& b) { return a.Name < b.Name; });
+    return canonical;
 }
 
-bool ShaderCompiler::CompilePixelShader(LPCWSTR shaderPath, ShaderCompileOutput& outCompileResults, LPCWSTR shaderName) const
+std::wstring GetPermutationKey(const ShaderDefines& defines)
 {
-    LPCWSTR args[] =
+    std::wstring key;
+    for(const ShaderDefine& define : CanonicalizeDefines(defines))
     {
-        shaderName,                  // Optional shader source file name for error reporting and for PIX shader source view.  
-        L"-E", L"main",              // Entry point.
-        L"-T", L"ps_6_0",            // Target.
-    };
+        key += define.Name + L"=" + define.Value + L";";
+    }
+    return key;
+}
 
-    CComPtr<IDxcBlobUtf16> outShaderName;
-    return CompileShader(args, _countof(args), shaderPath, shaderName, outCompileResults);
+static bool UsesBindless(const ShaderDefines& defines)
+{
+    return std::any_of(defines.begin(), defines.end(), [](const ShaderDefine& define) { return define.Name == BindlessShaderDefine; });
+}
+
+bool ShaderCompiler::CompileVertexShader(LPCWSTR shaderPath, ShaderCompileOutput& outCompileResults, LPCWSTR shaderName, const ShaderDefines& defines) const
+{
+    return CompileShader(UsesBindless(defines) ? L"vs_6_6" : L"vs_6_0", shaderPath, shaderName, defines, outCompileResults);
 }
 
-bool ShaderCompiler::CompileShader(LPCWSTR* args, UINT argSize, LPCWSTR shaderPath, LPCWSTR shaderName, ShaderCompileOutput& outResults) const
+bool ShaderCompiler::CompilePixelShader(LPCWSTR shaderPath, ShaderCompileOutput& outCompileResults, LPCWSTR shaderName, const ShaderDefines& defines) const
 {
+    return CompileShader(UsesBindless(defines) ? L"ps_6_6" : L"ps_6_0", shaderPath, shaderName, defines, outCompileResults);
+}
+
+bool ShaderCompiler::CompileShader(LPCWSTR target, LPCWSTR shaderPath, LPCWSTR shaderName, const ShaderDefines& defines, ShaderCompileOutput& outResults) const
+{
+    std::vector<std::wstring> arguments =
+    {
+        shaderName,            // Optional shader source file name for error reporting and for PIX shader source view.
+        L"-E", L"main",        // Entry point.
+        L"-T", target,         // Target.
+    };
+    for(const ShaderDefine& define : CanonicalizeDefines(defines))
+    {
+        arguments.push_back(L"-D");
+        arguments.push_back(define.Name + L"=" + define.Value);
+    }
+    std::vector<LPCWSTR> args;
+    for(const std::wstring& argument : arguments)
+    {
+        args.push_back(argument.c_str());
+    }
+
+    uint64_t cacheKey = 0;
+    outResults.Dependencies = { shaderPath };
+    bool cacheable = Cache.ComputeKey(shaderPath, arguments, CompilerVersion, cacheKey, &outResults.Dependencies);
+    ShaderCacheEntry cacheEntry;
+    if(cacheable && Cache.Load(cacheKey, cacheEntry))
+    {
+        CacheHits++;
+        CreateOutputFromCache(cacheEntry, outResults);
+        return true;
+    }
+    CacheMisses++;
+
 	CComPtr<IDxcBlobEncoding> pSource = nullptr;
     Utils->LoadFile(shaderPath, nullptr, &pSource);
     if(!pSource)
@@ -61,8 +126,8 @@ bool ShaderCompiler::CompileShader(LPCWSTR* args, UINT argSize, LPCWSTR shaderPa
     CComPtr<IDxcResult> results;
     Compiler->Compile(
         &Source,                // Source buffer.
-        args,                // Array of pointers to arguments.
-        argSize,      // Number of arguments.
+        args.data(),         // Array of pointers to arguments.
+        static_cast<UINT32>(args.size()), // Number of arguments.
         IncludeHandler,        // User-provided interface to handle #include directives (optional).
         IID_PPV_ARGS(&results) // Compiler output status, buffer, and errors.
     );
@@ -91,5 +156,31 @@ bool ShaderCompiler::CompileShader(LPCWSTR* args, UINT argSize, LPCWSTR shaderPa
 	Utils->CreateReflection(&reflectionBuffer, IID_PPV_ARGS(&outResults.ShaderReflection));
 
     results->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&outResults.ShaderBlob), &outResults.ShaderName);
+
+    if(cacheable)
+    {
+        const uint8_t* object = static_cast<const uint8_t*>(outResults.ShaderBlob->GetBufferPointer());
+        const uint8_t* reflection = static_cast<const uint8_t*>(reflectionBlob->GetBufferPointer());
+        cacheEntry.Object.assign(object, object + outResults.ShaderBlob->GetBufferSize());
+        cacheEntry.Reflection.assign(reflection, reflection + reflectionBlob->GetBufferSize());
+        if(!Cache.Store(cacheKey, cacheEntry))
+        {
+            std::wcout << "Could not write shader cache entry for " << shaderPath << std::endl;
+        }
+    }
     return true;
 }
+
+void ShaderCompiler::CreateOutputFromCache(const ShaderCacheEntry& entry, ShaderCompileOutput& outResults) const
+{
+    //IDxcBlob and ID3DBlob share the same iid, so the copy CreateBlob makes can be handed out as shader bytecode
+    CComPtr<IDxcBlobEncoding> objectBlob;
+    ThrowIfFailed(Utils->CreateBlob(entry.Object.data(), static_cast<UINT32>(entry.Object.size()), DXC_CP_ACP, &objectBlob));
+    ThrowIfFailed(objectBlob.QueryInterface(&outResults.ShaderBlob));
+
+    DxcBuffer reflectionBuffer = {};
+    reflectionBuffer.Ptr = entry.Reflection.data();
+    reflectionBuffer.Size = entry.Reflection.size();
+    reflectionBuffer.Encoding = 0;
+    ThrowIfFailed(Utils->CreateReflection(&reflectionBuffer, IID_PPV_ARGS(&outResults.ShaderReflection)));
+}
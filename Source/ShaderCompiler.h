@@ -1,33 +1,66 @@
 #pragma once
 #include <atlbase.h>
+#include <atomic>
 #include <d3dcommon.h>
 #include <dxcapi.h>
 #include <d3d12shader.h>
 
+#include "ShaderCache.h"
+
+#include <string>
+#include <vector>
+
+//passed to dxc as -D Name=Value
+struct ShaderDefine
+{
+	std::wstring Name;
+	std::wstring Value;
+};
+using ShaderDefines = std::vector<ShaderDefine>;
+
+//shaders compiled with this define target shader model 6.6 instead of 6.0 so they can index
+//ResourceDescriptorHeap, see BindlessConstantBufferName
+constexpr wchar_t BindlessShaderDefine[] = L"BINDLESS";
+
+//sorts the defines by name, a later define of the same name replaces an earlier one. Define sets
+//that only differ in order compile to the same permutation and share their cache entry
+ShaderDefines CanonicalizeDefines(const ShaderDefines& defines);
+//"Name=Value;Name=Value" of the canonical defines
+std::wstring GetPermutationKey(const ShaderDefines& defines);
+
 struct ShaderCompileOutput
 {
 	ShaderCompileOutput() = default;
 	CComPtr<ID3DBlob> ShaderBlob;
 	CComPtr<ID3D12ShaderReflection> ShaderReflection;
 	CComPtr<IDxcBlobUtf16> ShaderName;
+	std::vector<std::filesystem::path> Dependencies; //the source file followed by every file it includes
 };
 
 class ShaderCompiler
 {
 public:
 
+	//one compiler per thread, dxc compiler instances must not be shared between threads
 	static ShaderCompiler* GetInstance();
-	inline static ShaderCompiler* Instance;
 	
-	bool CompileVertexShader(LPCWSTR shaderPath, ShaderCompileOutput& outCompileResults, LPCWSTR shaderName = L"") const;
-	bool CompilePixelShader(LPCWSTR shaderPath, ShaderCompileOutput& outCompileResults, LPCWSTR shaderName = L"") const;
+	bool CompileVertexShader(LPCWSTR shaderPath, ShaderCompileOutput& outCompileResults, LPCWSTR shaderName = L"", const ShaderDefines& defines = {}) const;
+	bool CompilePixelShader(LPCWSTR shaderPath, ShaderCompileOutput& outCompileResults, LPCWSTR shaderName = L"", const ShaderDefines& defines = {}) const;
 
 	CComPtr<IDxcUtils> Utils;
 	CComPtr<IDxcCompiler3> Compiler;
 	CComPtr<IDxcIncludeHandler> IncludeHandler;
 
+	//compiled shaders are looked up here before dxc is invoked, see ShaderCache::ComputeKey
+	ShaderCache Cache;
+	std::string CompilerVersion;
+	//summed over the compilers of all threads
+	inline static std::atomic<uint32_t> CacheHits{0};
+	inline static std::atomic<uint32_t> CacheMisses{0};
+
 private:
 	ShaderCompiler();
-	bool CompileShader(LPCWSTR* args, UINT argSize, LPCWSTR shaderPath, LPCWSTR shaderName,
+	bool CompileShader(LPCWSTR target, LPCWSTR shaderPath, LPCWSTR shaderName, const ShaderDefines& defines,
 	                   ShaderCompileOutput& outResults) const;
+	void CreateOutputFromCache(const ShaderCacheEntry& entry, ShaderCompileOutput& outResults) const;
 };
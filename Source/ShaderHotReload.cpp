@@ -0,0 +1,168 @@
+#include "ShaderHotReload.h"
+
+#include "Pipeline.h"
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+ShaderHotReload::ShaderHotReload(std::chrono::milliseconds pollInterval) : PollInterval(pollInterval)
+{
+	Worker = std::thread(&ShaderHotReload::WatchLoop, this);
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+	}
+	StopRequested.notify_all();
+	Worker.join();
+}
+
+void ShaderHotReload::Watch(Pipeline* pipeline)
+{
+	AddShader(pipeline->VShader, true, pipeline);
+	AddShader(pipeline->PShader, false, pipeline);
+}
+
+void ShaderHotReload::AddShader(Shader* shader, bool isVertex, Pipeline* pipeline)
+{
+	auto it = std::find_if(Shaders.begin(), Shaders.end(), [shader](const WatchedShader& watched) { return watched.Current == shader; });
+	if(it != Shaders.end())
+	{
+		if(std::find(it->Pipelines.begin(), it->Pipelines.end(), pipeline) == it->Pipelines.end())
+		{
+			it->Pipelines.push_back(pipeline);
+		}
+		return;
+	}
+
+	WatchedShader watched = {};
+	watched.IsVertex = isVertex;
+	watched.Current = shader;
+	watched.Pipelines.push_back(pipeline);
+	Shaders.push_back(std::move(watched));
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	Sources.push_back({ Shaders.size() - 1, isVertex, shader->SourceFile, shader->Defines, shader->Dependencies });
+}
+
+void ShaderHotReload::Update(ID3D12Device* device)
+{
+	std::vector<ReloadedShader> reloaded;
+	{
+		std::unique_lock<std::mutex> lock(Mutex, std::try_to_lock);
+		if(!lock.owns_lock() || Reloaded.empty())
+		{
+			return;
+		}
+		reloaded.swap(Reloaded);
+	}
+
+	for(ReloadedShader& shader : reloaded)
+	{
+		WatchedShader& watched = Shaders[shader.Index];
+		Shader* replacement = shader.Vertex ? static_cast<Shader*>(shader.Vertex.get()) : shader.Pixel.get();
+
+		uint32_t rebuilt = 0;
+		for(Pipeline* pipeline : watched.Pipelines)
+		{
+			VertexShader* vertexShader = watched.IsVertex ? shader.Vertex.get() : pipeline->VShader;
+			PixelShader* pixelShader = watched.IsVertex ? pipeline->PShader : shader.Pixel.get();
+			rebuilt += pipeline->Rebuild(device, vertexShader, pixelShader) ? 1 : 0;
+		}
+		std::wcout << L"Reloaded " << replacement->SourceFile << L", rebuilt " << rebuilt << L"/" << watched.Pipelines.size() << L" pipelines" << std::endl;
+
+		if(rebuilt == 0)
+		{
+			continue;
+		}
+		//pipelines that failed to rebuild still reference the previous shader, keep it alive
+		if(rebuilt != watched.Pipelines.size())
+		{
+			if(watched.OwnedVertex)
+				RetiredVertexShaders.push_back(std::move(watched.OwnedVertex));
+			if(watched.OwnedPixel)
+				RetiredPixelShaders.push_back(std::move(watched.OwnedPixel));
+		}
+		watched.Current = replacement;
+		watched.OwnedVertex = std::move(shader.Vertex);
+		watched.OwnedPixel = std::move(shader.Pixel);
+	}
+}
+
+void ShaderHotReload::WatchLoop()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	while(!StopRequested.wait_for(lock, PollInterval, [this]() { return Stopping; }))
+	{
+		std::vector<ShaderSource> sources = Sources;
+		lock.unlock();
+
+		//files are checked once per poll, an include shared by several shaders reloads all of them
+		std::set<std::wstring> checkedFiles;
+		std::set<std::wstring> changedFiles;
+		for(const ShaderSource& source : sources)
+		{
+			for(const std::filesystem::path& dependency : source.Dependencies)
+			{
+				std::wstring file = dependency.wstring();
+				if(!checkedFiles.insert(file).second)
+				{
+					continue;
+				}
+				std::error_code error;
+				std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(dependency, error);
+				if(error)
+				{
+					continue; //editors that save by renaming briefly remove the file
+				}
+				auto [it, inserted] = WriteTimes.try_emplace(file, writeTime);
+				if(!inserted && it->second != writeTime)
+				{
+					it->second = writeTime;
+					changedFiles.insert(file);
+				}
+			}
+		}
+
+		for(ShaderSource& source : sources)
+		{
+			bool changed = std::any_of(source.Dependencies.begin(), source.Dependencies.end(),
+			                           [&changedFiles](const std::filesystem::path& dependency) { return changedFiles.count(dependency.wstring()) != 0; });
+			if(!changed)
+			{
+				continue;
+			}
+
+			//a failed compile keeps the old shader, the next save triggers another attempt
+			ReloadedShader reloaded = { source.Index };
+			try
+			{
+				if(source.IsVertex)
+				{
+					reloaded.Vertex = std::make_unique<VertexShader>(source.SourceFile.c_str(), source.Defines);
+				}
+				else
+				{
+					reloaded.Pixel = std::make_unique<PixelShader>(source.SourceFile.c_str(), source.Defines);
+				}
+			}
+			catch(const std::exception& e)
+			{
+				std::wcout << L"Keeping the previous " << source.SourceFile << L": " << e.what() << std::endl;
+				continue;
+			}
+
+			//includes can be added or removed by the edit
+			const std::vector<std::filesystem::path>& dependencies = reloaded.Vertex ? reloaded.Vertex->Dependencies : reloaded.Pixel->Dependencies;
+			std::lock_guard<std::mutex> reloadLock(Mutex);
+			Sources[source.Index].Dependencies = dependencies;
+			Reloaded.push_back(std::move(reloaded));
+		}
+
+		lock.lock();
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Shader.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Pipeline;
+
+//watches the source and include files of the shaders used by the registered pipelines. A
+//background thread polls their write times, recompiles the shaders that depend on a changed
+//file and hands them to Update, which rebuilds only the pipelines using those shaders
+class ShaderHotReload
+{
+public:
+	explicit ShaderHotReload(std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250));
+	ShaderHotReload(const ShaderHotReload&) = delete;
+	ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+	~ShaderHotReload();
+
+	//the pipeline has to be initialized and outlive the watcher
+	void Watch(Pipeline* pipeline);
+
+	//never waits on the compile thread or the gpu, recompiled shaders are picked up on a later call
+	//when the thread is busy. The pipeline states the rebuilt pipelines replaced go to
+	//DeferredReleaseQueue::Active, since the frames in flight may still use them
+	void Update(ID3D12Device* device);
+
+private:
+	struct WatchedShader
+	{
+		bool IsVertex;
+		Shader* Current;
+		std::vector<Pipeline*> Pipelines;
+		//set once the shader has been reloaded, the shaders the watcher started with belong to the caller
+		std::unique_ptr<VertexShader> OwnedVertex;
+		std::unique_ptr<PixelShader> OwnedPixel;
+	};
+
+	//what the compile thread needs to know about a shader, copied under the lock
+	struct ShaderSource
+	{
+		size_t Index;
+		bool IsVertex;
+		std::wstring SourceFile;
+		ShaderDefines Defines;
+		std::vector<std::filesystem::path> Dependencies;
+	};
+
+	struct ReloadedShader
+	{
+		size_t Index;
+		std::unique_ptr<VertexShader> Vertex;
+		std::unique_ptr<PixelShader> Pixel;
+	};
+
+	void AddShader(Shader* shader, bool isVertex, Pipeline* pipeline);
+	void WatchLoop();
+
+	std::chrono::milliseconds PollInterval;
+
+	//only touched by the thread calling Watch and Update
+	std::vector<WatchedShader> Shaders;
+	std::vector<std::unique_ptr<VertexShader>> RetiredVertexShaders;
+	std::vector<std::unique_ptr<PixelShader>> RetiredPixelShaders;
+
+	//only touched by the compile thread
+	std::unordered_map<std::wstring, std::filesystem::file_time_type> WriteTimes;
+
+	//shared with the compile thread
+	std::mutex Mutex;
+	std::condition_variable StopRequested;
+	std::vector<ShaderSource> Sources;
+	std::vector<ReloadedShader> Reloaded;
+	bool Stopping = false;
+	std::thread Worker;
+};
@@ -0,0 +1,59 @@
+#include "StagingRing.h"
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void StagingRing::Initialize(uint64_t capacity)
+{
+	Capacity = capacity;
+	Head = 0;
+	UsedBytes = 0;
+	UncommittedBytes = 0;
+	PendingReleases.clear();
+}
+
+bool StagingRing::Allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset)
+{
+	if(UsedBytes == 0)
+	{
+		Head = 0;
+	}
+
+	//free space is the contiguous (wrapping) stretch from Head to the oldest live allocation
+	uint64_t offset = AlignUp(Head, alignment);
+	if(offset + size > Capacity)
+	{
+		offset = 0;
+	}
+	uint64_t consumed = (offset >= Head ? offset - Head : Capacity - Head) + size;
+	if(size > Capacity || UsedBytes + consumed > Capacity)
+	{
+		return false;
+	}
+
+	Head = offset + size;
+	UsedBytes += consumed;
+	UncommittedBytes += consumed;
+	outOffset = offset;
+	return true;
+}
+
+void StagingRing::Commit(uint64_t fenceValue)
+{
+	if(UncommittedBytes > 0)
+	{
+		PendingReleases.push_back({fenceValue, UncommittedBytes});
+		UncommittedBytes = 0;
+	}
+}
+
+void StagingRing::Reclaim(uint64_t completedFenceValue)
+{
+	while(!PendingReleases.empty() && PendingReleases.front().first <= completedFenceValue)
+	{
+		UsedBytes -= PendingReleases.front().second;
+		PendingReleases.pop_front();
+	}
+}
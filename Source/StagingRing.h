@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+//fifo suballocator over a fixed block of staging memory, space comes back once the fence of
+//the submit it was used in has completed
+class StagingRing
+{
+public:
+	void Initialize(uint64_t capacity);
+	//returns false when there is not enough contiguous space left
+	bool Allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset);
+	//tags every allocation since the last commit with the fence value
+	void Commit(uint64_t fenceValue);
+	void Reclaim(uint64_t completedFenceValue);
+
+	uint64_t GetCapacity() const { return Capacity; }
+	uint64_t GetUsedBytes() const { return UsedBytes; }
+
+private:
+	uint64_t Capacity = 0;
+	uint64_t Head = 0;
+	uint64_t UsedBytes = 0; //including padding skipped when wrapping
+	uint64_t UncommittedBytes = 0;
+	std::deque<std::pair<uint64_t, uint64_t>> PendingReleases; //fence value, bytes
+};
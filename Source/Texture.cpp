@@ -1,45 +1,60 @@
 #include "Texture.h"
 
-#include "WICTextureLoader.h"
+#include "CookedTexture.h"
+#include "MappedFile.h"
+#include "PngDecoder.h"
 #include "ResourceUploadBatch.h"
+#include "VirtualTexture.h"
 
-void Texture::LoadFromFile(ID3D12Device* device, ID3D12CommandQueue* commandQueue, LPCWSTR filename)
-{
-	DirectX::ResourceUploadBatch resourceUpload(device);
-
-	resourceUpload.Begin();
+#include <algorithm>
+#include <chrono>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
 
-	ThrowIfFailed(
-		CreateWICTextureFromFile(device, resourceUpload, filename,
-			&Resource, true)
-	);
-
-	// Upload the resources to the GPU.
-	auto uploadResourcesFinished = resourceUpload.End(commandQueue);
+//images are decoded on streaming workers too, so every calling thread joins the multithreaded
+//apartment and the factory is created once in a thread safe way
+static IWICImagingFactory2* GetWicFactory()
+{
+    thread_local HRESULT comInitialized = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    (void)comInitialized;
 
-	// Wait for the upload thread to terminate
-	uploadResourcesFinished.wait();
+    static IWICImagingFactory2* wicFactory = []()
+    {
+        IWICImagingFactory2* factory;
+        ThrowIfFailed(CoCreateInstance(CLSID_WICImagingFactory2, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory)));
+        return factory;
+    }();
+    return wicFactory;
+}
 
-	Width = Resource->GetDesc().Width;
-	Height = Resource->GetDesc().Height;
-    Format = Resource->GetDesc().Format;
+static D3D12_RESOURCE_DESC DescribeImage(UINT width, UINT height, DXGI_FORMAT format)
+{
+    D3D12_RESOURCE_DESC resourceDescription = {};
+    resourceDescription.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    resourceDescription.Alignment = 0;
+    resourceDescription.Width = width;
+    resourceDescription.Height = height;
+    resourceDescription.DepthOrArraySize = 1;
+    resourceDescription.MipLevels = 1;
+    resourceDescription.Format = format;
+    resourceDescription.SampleDesc.Count = 1;
+    resourceDescription.SampleDesc.Quality = 0;
+    resourceDescription.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    resourceDescription.Flags = D3D12_RESOURCE_FLAG_NONE;
+    return resourceDescription;
 }
 
-int LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescription, LPCWSTR filename, UINT64& bytesPerRow)
+static int LoadImageDataFromFileWic(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescription, LPCWSTR filename, UINT64& bytesPerRow)
 {
-	static IWICImagingFactory2 *wicFactory;
+	IWICImagingFactory2* wicFactory = GetWicFactory();
 
     // reset decoder, frame and converter since these will be different for each image we load
     IWICBitmapDecoder *wicDecoder = NULL;
     IWICBitmapFrameDecode *wicFrame = NULL;
     IWICFormatConverter *wicConverter = NULL;
 
-    if(wicFactory == NULL)
-    {
-		CoInitialize(NULL);
-		ThrowIfFailed(CoCreateInstance(CLSID_WICImagingFactory2, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&wicFactory)));
-    }
-
     ThrowIfFailed(wicFactory->CreateDecoderFromFilename(
         filename,
         NULL,
@@ -56,11 +71,22 @@ int LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescrip
     ThrowIfFailed(wicFrame->GetSize(&textureWidth, &textureHeight));
 
     DXGI_FORMAT dxgiFormat = GetDXGIFormatFromWICFormat(pixelFormat);
+    IWICBitmapSource* wicSource = wicFrame;
 
-	if(DXGI_FORMAT_UNKNOWN)
-	{
-		//TODO convert the image https://www.braynzarsoft.net/viewtutorial/q16390-directx-12-textures-from-file
-	}
+    if(dxgiFormat == DXGI_FORMAT_UNKNOWN)
+    {
+        WICPixelFormatGUID convertToPixelFormat = GetConvertToWICFormat(pixelFormat);
+        BOOL canConvert = FALSE;
+        ThrowIfFailed(wicFactory->CreateFormatConverter(&wicConverter));
+        ThrowIfFailed(wicConverter->CanConvert(pixelFormat, convertToPixelFormat, &canConvert));
+        if(!canConvert)
+        {
+            throw com_exception(WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT);
+        }
+        ThrowIfFailed(wicConverter->Initialize(wicFrame, convertToPixelFormat, WICBitmapDitherTypeErrorDiffusion, 0, 0, WICBitmapPaletteTypeCustom));
+        dxgiFormat = GetDXGIFormatFromWICFormat(convertToPixelFormat);
+        wicSource = wicConverter;
+    }
 
     UINT64 bitsPerPixel = GetDXGIFormatBitsPerPixel(dxgiFormat);
     bytesPerRow = (textureWidth * bitsPerPixel) / 8;
@@ -68,33 +94,250 @@ int LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescrip
 
     *imageData = (BYTE*)malloc(imageSize);
 
-    ThrowIfFailed(wicFrame->CopyPixels(0, bytesPerRow, imageSize, *imageData));
+    ThrowIfFailed(wicSource->CopyPixels(0, bytesPerRow, imageSize, *imageData));
 
-    resourceDescription = {};
-    resourceDescription.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    resourceDescription.Alignment = 0;
-    resourceDescription.Width = textureWidth;
-    resourceDescription.Height = textureHeight;
-    resourceDescription.DepthOrArraySize = 1;
-    resourceDescription.MipLevels = 1;
-    resourceDescription.Format = dxgiFormat;
-    resourceDescription.SampleDesc.Count = 1;
-    resourceDescription.SampleDesc.Quality = 0;
-    resourceDescription.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-    resourceDescription.Flags = D3D12_RESOURCE_FLAG_NONE;
+    if(wicConverter)
+    {
+        wicConverter->Release();
+    }
+    wicFrame->Release();
+    wicDecoder->Release();
+
+    resourceDescription = DescribeImage(textureWidth, textureHeight, dxgiFormat);
 
     return imageSize;
 }
 
-void Texture::LoadFromFileManual(ID3D12Device* device, ID3D12CommandQueue* commandQueue, ID3D12CommandAllocator* commandAllocator, LPCWSTR filename)
+static DXGI_FORMAT GetPngDxgiFormat(PngFormat format)
 {
-    ID3D12Resource* textureBuffer;
-    ID3D12Resource* textureBufferUploadHeap;
+    switch (format)
+    {
+    case PngFormat::R8: return DXGI_FORMAT_R8_UNORM;
+    case PngFormat::R16: return DXGI_FORMAT_R16_UNORM;
+    case PngFormat::R8G8B8A8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+    default: return DXGI_FORMAT_R16G16B16A16_UNORM;
+    }
+}
 
-    D3D12_RESOURCE_DESC textureDesc;
+static bool IsPngFile(LPCWSTR filename)
+{
+    std::wstring extension = std::filesystem::path(filename).extension().wstring();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return wchar_t(std::towlower(c)); });
+    return extension == L".png";
+}
+
+//pngs go through the portable decoder, WIC stays as the fallback for every other container
+//and for pngs the decoder rejects
+int LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescription, LPCWSTR filename, UINT64& bytesPerRow)
+{
+    if(IsPngFile(filename))
+    {
+        PngImage image;
+        std::string error;
+        if(LoadPngFile(filename, image, &error))
+        {
+            *imageData = (BYTE*)malloc(image.Pixels.size());
+            memcpy(*imageData, image.Pixels.data(), image.Pixels.size());
+            bytesPerRow = image.RowPitch;
+            resourceDescription = DescribeImage(image.Width, image.Height, GetPngDxgiFormat(image.Format));
+            return int(image.Pixels.size());
+        }
+        std::wcout << L"png decoder failed on " << filename << L": " << error.c_str() << L", falling back to WIC" << std::endl;
+    }
+    return LoadImageDataFromFileWic(imageData, resourceDescription, filename, bytesPerRow);
+}
+
+void BenchmarkPngDecode(LPCWSTR filename)
+{
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    std::vector<uint8_t> data(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+    //the first run of each decoder only warms the allocator and the file cache
+    const int iterations = 4;
+    PngImage image;
+    double pngMs = 0.0;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        DecodePng(data.data(), data.size(), image);
+        auto end = std::chrono::high_resolution_clock::now();
+        pngMs += i ? std::chrono::duration<double, std::milli>(end - start).count() : 0.0;
+    }
+
+    BYTE* wicData = nullptr;
+    D3D12_RESOURCE_DESC wicDesc;
+    UINT64 wicBytesPerRow;
+    double wicMs = 0.0;
+    for (int i = 0; i < iterations; i++)
+    {
+        free(wicData);
+        auto start = std::chrono::high_resolution_clock::now();
+        LoadImageDataFromFileWic(&wicData, wicDesc, filename, wicBytesPerRow);
+        auto end = std::chrono::high_resolution_clock::now();
+        wicMs += i ? std::chrono::duration<double, std::milli>(end - start).count() : 0.0;
+    }
+
+    //WIC hands out bgra for 8 bit color pngs, compare texels with the channels swapped back
+    bool swapRedBlue = wicDesc.Format == DXGI_FORMAT_B8G8R8A8_UNORM && image.Format == PngFormat::R8G8B8A8;
+    bool match = (wicDesc.Format == GetPngDxgiFormat(image.Format) || swapRedBlue) && wicBytesPerRow == image.RowPitch;
+    for (size_t i = 0; match && i < image.Pixels.size(); i++)
+    {
+        size_t source = swapRedBlue && (i & 3) != 3 ? (i & ~size_t(3)) + 2 - (i & 3) : i;
+        match = image.Pixels[i] == wicData[source];
+    }
+    free(wicData);
+
+    double megaPixels = double(image.Width) * image.Height / 1000000.0;
+    pngMs /= iterations - 1;
+    wicMs /= iterations - 1;
+    std::cout << "Png decode " << image.Width << "x" << image.Height << ": " << megaPixels / pngMs * 1000.0 << " MPix/s, WIC "
+              << megaPixels / wicMs * 1000.0 << " MPix/s, " << (match ? "identical" : "MISMATCH") << std::endl;
+}
+
+//cpu side copy of every subresource, Subresources point into the level vectors
+struct TextureData
+{
+    D3D12_RESOURCE_DESC Desc;
+    std::vector<MipLevel> Levels;
+    std::vector<CompressedLevel> CompressedLevels;
+    std::vector<D3D12_SUBRESOURCE_DATA> Subresources;
+};
+
+static DXGI_FORMAT GetCompressedFormat(TextureCompression compression)
+{
+    switch (compression)
+    {
+    case TextureCompression::BC1: return DXGI_FORMAT_BC1_UNORM;
+    case TextureCompression::BC3: return DXGI_FORMAT_BC3_UNORM;
+    case TextureCompression::BC7: return DXGI_FORMAT_BC7_UNORM;
+    default: return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+//decodes the image, builds its mip chain and optionally block compresses it on the cpu.
+//Formats the generator does not understand come back as a single uncompressed level
+static void LoadTextureData(LPCWSTR filename, MipFilter mipFilter, TextureCompression compression, TextureData& data)
+{
+    D3D12_RESOURCE_DESC& textureDesc = data.Desc;
     UINT64 imageBytesPerRow;
     BYTE* imageData;
-    UINT64 imageSize = LoadImageDataFromFile(&imageData, textureDesc, L"../Assets/lost_empire-RGBA.png", imageBytesPerRow);
+    LoadImageDataFromFile(&imageData, textureDesc, filename, imageBytesPerRow);
+
+    //rgba and bgra only differ in channel order, alpha is the last byte in both
+    bool isRgba = textureDesc.Format == DXGI_FORMAT_R8G8B8A8_UNORM;
+    bool isBgra = textureDesc.Format == DXGI_FORMAT_B8G8R8A8_UNORM;
+    if(isRgba || isBgra)
+    {
+        GenerateMips(imageData, UINT(textureDesc.Width), textureDesc.Height, UINT(imageBytesPerRow), mipFilter, true, data.Levels);
+    }
+    else
+    {
+        data.Levels.resize(1);
+        data.Levels[0].Width = UINT(textureDesc.Width);
+        data.Levels[0].Height = textureDesc.Height;
+        data.Levels[0].Pixels.assign(imageData, imageData + imageBytesPerRow * textureDesc.Height);
+    }
+    free(imageData);
+
+    textureDesc.MipLevels = UINT16(data.Levels.size());
+    data.Subresources.resize(data.Levels.size());
+
+    //block compressed textures need the top level to be a whole number of blocks
+    bool compress = compression != TextureCompression::None && (isRgba || isBgra) &&
+                    textureDesc.Width % 4 == 0 && textureDesc.Height % 4 == 0;
+    if(compress)
+    {
+        data.CompressedLevels.resize(data.Levels.size());
+        for (size_t i = 0; i < data.Levels.size(); i++)
+        {
+            MipLevel& level = data.Levels[i];
+            if(isBgra)
+            {
+                for (size_t texel = 0; texel < level.Pixels.size(); texel += 4)
+                {
+                    std::swap(level.Pixels[texel], level.Pixels[texel + 2]);
+                }
+            }
+            CompressLevel(level, compression, data.CompressedLevels[i]);
+
+            const CompressedLevel& compressed = data.CompressedLevels[i];
+            data.Subresources[i].pData = compressed.Blocks.data();
+            data.Subresources[i].RowPitch = compressed.RowPitch;
+            data.Subresources[i].SlicePitch = compressed.Blocks.size();
+        }
+        data.Levels.clear();
+        textureDesc.Format = GetCompressedFormat(compression);
+        return;
+    }
+
+    for (size_t i = 0; i < data.Levels.size(); i++)
+    {
+        data.Subresources[i].pData = data.Levels[i].Pixels.data();
+        data.Subresources[i].RowPitch = data.Levels[i].Pixels.size() / data.Levels[i].Height;
+        data.Subresources[i].SlicePitch = data.Levels[i].Pixels.size();
+    }
+}
+
+void Texture::LoadFromFile(ID3D12Device* device, ID3D12CommandQueue* commandQueue, LPCWSTR filename,
+                           MipFilter mipFilter, TextureCompression compression)
+{
+    TextureData data;
+    LoadTextureData(filename, mipFilter, compression, data);
+
+    ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &data.Desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&Resource)));
+
+	DirectX::ResourceUploadBatch resourceUpload(device);
+
+	resourceUpload.Begin();
+
+	resourceUpload.Upload(Resource, 0, data.Subresources.data(), UINT(data.Subresources.size()));
+	resourceUpload.Transition(Resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE);
+
+	// Upload the resources to the GPU.
+	auto uploadResourcesFinished = resourceUpload.End(commandQueue);
+
+	// Wait for the upload thread to terminate
+	uploadResourcesFinished.wait();
+
+	Width = Resource->GetDesc().Width;
+	Height = Resource->GetDesc().Height;
+	MipLevels = Resource->GetDesc().MipLevels;
+    Format = Resource->GetDesc().Format;
+}
+
+//blocks until everything submitted to the queue so far has executed
+static void WaitForQueue(ID3D12Device* device, ID3D12CommandQueue* commandQueue)
+{
+    ID3D12Fence* fence;
+    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+    ThrowIfFailed(commandQueue->Signal(fence, 1));
+    if (fence->GetCompletedValue() < 1)
+    {
+        HANDLE fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        ThrowIfFailed(fence->SetEventOnCompletion(1, fenceEvent));
+        WaitForSingleObject(fenceEvent, INFINITE);
+        CloseHandle(fenceEvent);
+    }
+    fence->Release();
+}
+
+void Texture::LoadFromFileManual(ID3D12Device* device, ID3D12CommandQueue* commandQueue, ID3D12CommandAllocator* commandAllocator, LPCWSTR filename,
+                                 MipFilter mipFilter, TextureCompression compression)
+{
+    ID3D12Resource* textureBuffer;
+    ID3D12Resource* textureBufferUploadHeap;
+
+    TextureData data;
+    LoadTextureData(filename, mipFilter, compression, data);
+    D3D12_RESOURCE_DESC& textureDesc = data.Desc;
 
     ThrowIfFailed(device->CreateCommittedResource(
 		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
@@ -106,7 +349,7 @@ void Texture::LoadFromFileManual(ID3D12Device* device, ID3D12CommandQueue* comma
     textureBuffer->SetName(L"Texture Buffer Resource Heap");
 
     UINT64 textureUploadBufferSize;
-    device->GetCopyableFootprints(&textureDesc, 0, 1, 0, nullptr, nullptr, nullptr, &textureUploadBufferSize);
+    device->GetCopyableFootprints(&textureDesc, 0, textureDesc.MipLevels, 0, nullptr, nullptr, nullptr, &textureUploadBufferSize);
 
     ThrowIfFailed(device->CreateCommittedResource(
 		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
@@ -115,27 +358,285 @@ void Texture::LoadFromFileManual(ID3D12Device* device, ID3D12CommandQueue* comma
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
         IID_PPV_ARGS(&textureBufferUploadHeap)));
-    textureBuffer->SetName(L"Texture Buffer Upload Resource Heap");
-
-    D3D12_SUBRESOURCE_DATA textureData = {};
-    textureData.pData = &imageData[0];
-    textureData.RowPitch = imageBytesPerRow;
-    textureData.SlicePitch = imageBytesPerRow * textureDesc.Height;
-
+    textureBufferUploadHeap->SetName(L"Texture Buffer Upload Resource Heap");
 
 	ID3D12GraphicsCommandList* uploadCommandList;
 	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
 											commandAllocator, nullptr,
 											IID_PPV_ARGS(&uploadCommandList)));
-    UpdateSubresources(uploadCommandList, textureBuffer, textureBufferUploadHeap, 0, 0, 1, &textureData);
+    UpdateSubresources(uploadCommandList, textureBuffer, textureBufferUploadHeap, 0, 0, UINT(data.Subresources.size()), data.Subresources.data());
     uploadCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(textureBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE));
     uploadCommandList->Close();
 
     ID3D12CommandList* ppCommandLists[] = {uploadCommandList};
     commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 
+    //the upload heap has to live until the copy executed
+    WaitForQueue(device, commandQueue);
+    uploadCommandList->Release();
+    textureBufferUploadHeap->Release();
+
     Resource = textureBuffer;
     Width = textureDesc.Width;
     Height = textureDesc.Height;
+    MipLevels = textureDesc.MipLevels;
     Format = textureDesc.Format;
 }
+
+void Texture::Cook(ID3D12Device* device, LPCWSTR sourceFilename, LPCWSTR cookedFilename, MipFilter mipFilter, TextureCompression compression)
+{
+    TextureData data;
+    LoadTextureData(sourceFilename, mipFilter, compression, data);
+
+    UINT subresourceCount = UINT(data.Subresources.size());
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(subresourceCount);
+    std::vector<UINT> rowCounts(subresourceCount);
+    std::vector<UINT64> rowSizes(subresourceCount);
+    UINT64 totalBytes;
+    device->GetCopyableFootprints(&data.Desc, 0, subresourceCount, 0, footprints.data(), rowCounts.data(), rowSizes.data(), &totalBytes);
+
+    //lay the rows out exactly like an upload buffer would hold them
+    std::vector<uint8_t> payload(totalBytes, 0);
+    std::vector<CookedSubresource> subresources(subresourceCount);
+    for (UINT i = 0; i < subresourceCount; i++)
+    {
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = footprints[i];
+        const uint8_t* source = static_cast<const uint8_t*>(data.Subresources[i].pData);
+        for (UINT row = 0; row < rowCounts[i]; row++)
+        {
+            memcpy(&payload[footprint.Offset + row * footprint.Footprint.RowPitch], source + row * data.Subresources[i].RowPitch, rowSizes[i]);
+        }
+        subresources[i] = {footprint.Offset, footprint.Footprint.Width, footprint.Footprint.Height, footprint.Footprint.RowPitch, rowCounts[i]};
+    }
+
+    CookedTextureHeader header = {};
+    header.Magic = CookedTextureMagic;
+    header.Version = CookedTextureVersion;
+    header.Width = UINT(data.Desc.Width);
+    header.Height = data.Desc.Height;
+    header.MipLevels = subresourceCount;
+    header.Format = data.Desc.Format;
+    header.MipFilter = uint32_t(mipFilter);
+    header.Compression = uint32_t(compression);
+    UINT64 tableEnd = sizeof(header) + sizeof(CookedSubresource) * subresourceCount;
+    header.DataOffset = (tableEnd + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~UINT64(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+    header.DataSize = totalBytes;
+
+    std::ofstream file(cookedFilename, std::ios::binary | std::ios::trunc);
+    std::vector<char> padding(header.DataOffset - tableEnd, 0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(subresources.data()), sizeof(CookedSubresource) * subresourceCount);
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    if (!file)
+    {
+        throw std::runtime_error("failed to write cooked texture");
+    }
+}
+
+void Texture::CookVirtual(LPCWSTR sourceFilename, LPCWSTR pageFilename, MipFilter mipFilter)
+{
+    TextureData data;
+    LoadTextureData(sourceFilename, mipFilter, TextureCompression::None, data);
+    if (data.Desc.Format != DXGI_FORMAT_R8G8B8A8_UNORM && data.Desc.Format != DXGI_FORMAT_B8G8R8A8_UNORM)
+    {
+        throw std::runtime_error("virtual textures need an rgba8 source");
+    }
+    if (data.Desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM)
+    {
+        for (MipLevel& level : data.Levels)
+        {
+            for (size_t texel = 0; texel < level.Pixels.size(); texel += 4)
+            {
+                std::swap(level.Pixels[texel], level.Pixels[texel + 2]);
+            }
+        }
+    }
+
+    VirtualTextureLayout layout = VirtualTextureLayout::Create(UINT(data.Desc.Width), data.Desc.Height);
+    if (!layout.IsValid() || !WriteVirtualTexturePages(data.Levels, layout, pageFilename))
+    {
+        throw std::runtime_error("failed to write virtual texture pages");
+    }
+}
+
+bool Texture::LoadFromCookedFile(ID3D12Device* device, ID3D12CommandQueue* commandQueue, LPCWSTR filename)
+{
+    MappedFile file;
+    if (!file.Open(filename) || file.Size < sizeof(CookedTextureHeader))
+    {
+        return false;
+    }
+
+    const CookedTextureHeader& header = *reinterpret_cast<const CookedTextureHeader*>(file.Data);
+    const CookedSubresource* subresources = reinterpret_cast<const CookedSubresource*>(file.Data + sizeof(CookedTextureHeader));
+    if (header.Magic != CookedTextureMagic || header.Version != CookedTextureVersion ||
+        sizeof(CookedTextureHeader) + sizeof(CookedSubresource) * header.MipLevels > header.DataOffset ||
+        header.DataOffset > file.Size || header.DataSize > file.Size - header.DataOffset)
+    {
+        return false;
+    }
+    if (header.Width == 0 || header.Height == 0 || header.Width > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+        header.Height > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION || header.MipLevels == 0 || header.MipLevels > D3D12_REQ_MIP_LEVELS ||
+        (std::max(header.Width, header.Height) >> (header.MipLevels - 1)) == 0)
+    {
+        return false;
+    }
+
+    //every mip is copied out of the payload with the footprint stored in the file. It has to be the
+    //footprint the device expects for this texture and its rows have to lie inside the payload, so a
+    //truncated or corrupt table can neither read past the file nor copy a mismatched region
+    DXGI_FORMAT format = DXGI_FORMAT(header.Format);
+    CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(format, header.Width, header.Height, 1, UINT16(header.MipLevels));
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(header.MipLevels);
+    std::vector<UINT> rowCounts(header.MipLevels);
+    std::vector<UINT64> rowSizes(header.MipLevels);
+    UINT64 totalBytes = UINT64_MAX;
+    device->GetCopyableFootprints(&textureDesc, 0, header.MipLevels, 0, footprints.data(), rowCounts.data(), rowSizes.data(), &totalBytes);
+    if (totalBytes > header.DataSize)
+    {
+        return false;
+    }
+    for (UINT i = 0; i < header.MipLevels; i++)
+    {
+        const CookedSubresource& subresource = subresources[i];
+        const D3D12_SUBRESOURCE_FOOTPRINT& expected = footprints[i].Footprint;
+        if (subresource.Offset != footprints[i].Offset || subresource.Width != expected.Width || subresource.Height != expected.Height ||
+            subresource.RowPitch != expected.RowPitch || subresource.RowCount != rowCounts[i] || rowSizes[i] > subresource.RowPitch)
+        {
+            return false;
+        }
+        uint64_t size = uint64_t(subresource.RowPitch) * subresource.RowCount;
+        if (subresource.Offset > header.DataSize || size > header.DataSize - subresource.Offset)
+        {
+            return false;
+        }
+    }
+
+    ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &textureDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&Resource)));
+
+    ID3D12Resource* uploadBuffer;
+    ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(header.DataSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&uploadBuffer)));
+
+    //the payload already has the copy footprint layout, no per row work needed
+    void* uploadData;
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(uploadBuffer->Map(0, &readRange, &uploadData));
+    memcpy(uploadData, file.Data + header.DataOffset, header.DataSize);
+    uploadBuffer->Unmap(0, nullptr);
+
+    ID3D12CommandAllocator* uploadCommandAllocator;
+    ID3D12GraphicsCommandList* uploadCommandList;
+    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&uploadCommandAllocator)));
+    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, uploadCommandAllocator, nullptr, IID_PPV_ARGS(&uploadCommandList)));
+
+    for (UINT i = 0; i < header.MipLevels; i++)
+    {
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+        footprint.Offset = subresources[i].Offset;
+        footprint.Footprint.Format = format;
+        footprint.Footprint.Width = subresources[i].Width;
+        footprint.Footprint.Height = subresources[i].Height;
+        footprint.Footprint.Depth = 1;
+        footprint.Footprint.RowPitch = subresources[i].RowPitch;
+
+        CD3DX12_TEXTURE_COPY_LOCATION destination(Resource, i);
+        CD3DX12_TEXTURE_COPY_LOCATION source(uploadBuffer, footprint);
+        uploadCommandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    }
+    uploadCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(Resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE));
+    uploadCommandList->Close();
+
+    ID3D12CommandList* ppCommandLists[] = {uploadCommandList};
+    commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    WaitForQueue(device, commandQueue);
+
+    uploadCommandList->Release();
+    uploadCommandAllocator->Release();
+    uploadBuffer->Release();
+
+    Width = header.Width;
+    Height = header.Height;
+    MipLevels = header.MipLevels;
+    Format = format;
+    return true;
+}
+
+static bool IsCookedTextureCurrent(LPCWSTR sourceFilename, LPCWSTR cookedFilename, MipFilter mipFilter, TextureCompression compression)
+{
+    std::error_code error;
+    auto cookedTime = std::filesystem::last_write_time(cookedFilename, error);
+    if (error)
+    {
+        return false;
+    }
+    //a missing source is fine, shipped builds only carry the cooked files
+    auto sourceTime = std::filesystem::last_write_time(sourceFilename, error);
+    if (!error && sourceTime > cookedTime)
+    {
+        return false;
+    }
+
+    CookedTextureHeader header = {};
+    std::ifstream file(cookedFilename, std::ios::binary);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    return file && header.Magic == CookedTextureMagic && header.Version == CookedTextureVersion &&
+           header.MipFilter == uint32_t(mipFilter) && header.Compression == uint32_t(compression);
+}
+
+void Texture::LoadCached(ID3D12Device* device, ID3D12CommandQueue* commandQueue, LPCWSTR sourceFilename, MipFilter mipFilter, TextureCompression compression)
+{
+    std::wstring cookedFilename = std::filesystem::path(sourceFilename).replace_extension(L".ctex").wstring();
+    if (!IsCookedTextureCurrent(sourceFilename, cookedFilename.c_str(), mipFilter, compression))
+    {
+        Cook(device, sourceFilename, cookedFilename.c_str(), mipFilter, compression);
+    }
+    if (!LoadFromCookedFile(device, commandQueue, cookedFilename.c_str()))
+    {
+        throw std::runtime_error("failed to load cooked texture");
+    }
+}
+
+bool Texture::Decode(LPCWSTR filename, MipFilter mipFilter, TextureCompression compression, DecodedTexture& out)
+{
+    TextureData data;
+    try
+    {
+        LoadTextureData(filename, mipFilter, compression, data);
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Failed to decode texture: " << e.what() << std::endl;
+        return false;
+    }
+
+    bool blockCompressed = !data.CompressedLevels.empty();
+    out.Width = UINT(data.Desc.Width);
+    out.Height = data.Desc.Height;
+    out.Format = data.Desc.Format;
+    out.Mips.resize(data.Subresources.size());
+    for (size_t i = 0; i < out.Mips.size(); i++)
+    {
+        StreamedMip& mip = out.Mips[i];
+        const D3D12_SUBRESOURCE_DATA& subresource = data.Subresources[i];
+        mip.RowSize = UINT(subresource.RowPitch);
+        mip.RowCount = UINT(subresource.SlicePitch / subresource.RowPitch);
+        //copy footprints of block compressed mips cover whole blocks
+        mip.Width = blockCompressed ? data.CompressedLevels[i].RowPitch / GetBlockBytes(compression) * 4 : std::max(1u, out.Width >> i);
+        mip.Height = blockCompressed ? mip.RowCount * 4 : std::max(1u, out.Height >> i);
+        mip.Data.assign(static_cast<const uint8_t*>(subresource.pData), static_cast<const uint8_t*>(subresource.pData) + subresource.SlicePitch);
+    }
+    return true;
+}
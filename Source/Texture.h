@@ -1,18 +1,53 @@
 #pragma once
 
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "TextureStreamer.h"
+
+//decodes an image, pngs through the portable PngDecoder and everything else through WIC where
+//formats without a dxgi equivalent are converted first. imageData is malloc'ed and owned by the caller
+int LoadImageDataFromFile(BYTE** imageData, D3D12_RESOURCE_DESC& resourceDescription, LPCWSTR filename, UINT64& bytesPerRow);
+
+//decodes the png with the portable decoder and with WIC, prints both throughputs and whether the texels agree
+void BenchmarkPngDecode(LPCWSTR filename);
+
 class Texture
 {
 public:
 	//Creates resources using directxtk helpers
-	void LoadFromFile(ID3D12Device* device, ID3D12CommandQueue* commandQueue, LPCWSTR filename);
+	void LoadFromFile(ID3D12Device* device, ID3D12CommandQueue* commandQueue, LPCWSTR filename,
+	                  MipFilter mipFilter = MipFilter::Kaiser, TextureCompression compression = TextureCompression::None);
 
-	//Creates resource without helpers
+	//Creates resource without helpers, blocks until the upload executed
 	void LoadFromFileManual(ID3D12Device* device, ID3D12CommandQueue* commandQueue,
-	                        ID3D12CommandAllocator* commandAllocator, LPCWSTR filename);
+	                        ID3D12CommandAllocator* commandAllocator, LPCWSTR filename,
+	                        MipFilter mipFilter = MipFilter::Kaiser,
+	                        TextureCompression compression = TextureCompression::None);
+
+	//Decodes and processes an image once and writes the result as a .ctex file
+	static void Cook(ID3D12Device* device, LPCWSTR sourceFilename, LPCWSTR cookedFilename,
+	                 MipFilter mipFilter = MipFilter::Kaiser, TextureCompression compression = TextureCompression::None);
+
+	//Tiles the image and its mips into a .vtex page file for D3D12VirtualTexture, the image has to
+	//be rgba8 with power of two multiples of the page size as dimensions
+	static void CookVirtual(LPCWSTR sourceFilename, LPCWSTR pageFilename, MipFilter mipFilter = MipFilter::Kaiser);
+
+	//Maps a .ctex file and copies its payload to the gpu as is, returns false if the file is missing or invalid
+	bool LoadFromCookedFile(ID3D12Device* device, ID3D12CommandQueue* commandQueue, LPCWSTR filename);
+
+	//Loads the .ctex next to the source image, cooking it first when it is missing, older than
+	//the source or was cooked with other settings
+	void LoadCached(ID3D12Device* device, ID3D12CommandQueue* commandQueue, LPCWSTR sourceFilename,
+	                MipFilter mipFilter = MipFilter::Kaiser, TextureCompression compression = TextureCompression::None);
+
+	//Decodes an image into the mip layout TextureStreamer uploads, safe to call from worker threads
+	static bool Decode(LPCWSTR filename, MipFilter mipFilter, TextureCompression compression, DecodedTexture& out);
 
 	ID3D12Resource* Resource;
 
 	UINT Width;
 	UINT Height;
+	UINT MipLevels;
+	UINT MostDetailedMip = 0; //streamed textures only expose their resident mips
 	DXGI_FORMAT Format;
-};
\ No newline at end of file
+};
@@ -0,0 +1,277 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	//same as D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+	constexpr uint64_t StagingRowPitchAlignment = 256;
+	constexpr uint64_t StagingPlacementAlignment = 512;
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	double Milliseconds(std::chrono::high_resolution_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+}
+
+TextureStreamer::TextureStreamer(TextureUploadSink* sink, TextureDecoder decoder, uint64_t stagingCapacity,
+                                 uint32_t workerCount, uint64_t maxBytesPerUpdate)
+	: Sink(sink), Decoder(std::move(decoder)), MaxBytesPerUpdate(maxBytesPerUpdate)
+{
+	Ring.Initialize(stagingCapacity);
+	Staging = Sink->MapStaging(stagingCapacity);
+	for(uint32_t i = 0; i < std::max(1u, workerCount); i++)
+	{
+		Workers.emplace_back(&TextureStreamer::WorkerLoop, this);
+	}
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stopping = true;
+	}
+	WorkAvailable.notify_all();
+	for(auto& worker : Workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t TextureStreamer::Request(const std::wstring& filename)
+{
+	uint32_t textureId = static_cast<uint32_t>(Textures.size());
+	Textures.emplace_back();
+	Textures.back().RequestTime = Clock::now();
+	Textures.back().Stats.Filename = filename;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		DecodeQueue.push_back({textureId, filename});
+	}
+	WorkAvailable.notify_one();
+	return textureId;
+}
+
+void TextureStreamer::WorkerLoop()
+{
+	while(true)
+	{
+		std::pair<uint32_t, std::wstring> job;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			WorkAvailable.wait(lock, [this]() { return Stopping || !DecodeQueue.empty(); });
+			if(Stopping)
+			{
+				return;
+			}
+			job = std::move(DecodeQueue.front());
+			DecodeQueue.pop_front();
+		}
+
+		auto texture = std::make_unique<DecodedTexture>();
+		if(!Decoder(job.second, *texture) || texture->Mips.empty())
+		{
+			texture.reset();
+		}
+
+		std::lock_guard<std::mutex> lock(Mutex);
+		Decoded.push_back({job.first, std::move(texture), Clock::now()});
+	}
+}
+
+void TextureStreamer::Update()
+{
+	RetireCopies();
+	AcceptDecoded();
+	ScheduleCopies();
+	PeakStagingBytes = std::max(PeakStagingBytes, Ring.GetUsedBytes());
+}
+
+void TextureStreamer::RetireCopies()
+{
+	uint64_t completedFenceValue = Sink->GetCompletedFenceValue();
+	Ring.Reclaim(completedFenceValue);
+
+	auto now = Clock::now();
+	while(!InFlight.empty() && InFlight.front().FenceValue <= completedFenceValue)
+	{
+		StreamedTexture& texture = Textures[InFlight.front().TextureId];
+		if(texture.ResidentMip == texture.MipCount)
+		{
+			texture.Stats.FirstMipMilliseconds = Milliseconds(now - texture.RequestTime);
+		}
+		texture.ResidentMip = std::min(texture.ResidentMip, InFlight.front().Mip);
+		if(texture.ResidentMip == 0)
+		{
+			texture.Stats.CompleteMilliseconds = Milliseconds(now - texture.RequestTime);
+			texture.Decoded.reset();
+		}
+		InFlight.pop_front();
+	}
+}
+
+void TextureStreamer::AcceptDecoded()
+{
+	std::vector<DecodeResult> decoded;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		decoded.swap(Decoded);
+	}
+
+	for(auto& result : decoded)
+	{
+		StreamedTexture& texture = Textures[result.TextureId];
+		texture.Decoding = false;
+		texture.Stats.DecodeMilliseconds = Milliseconds(result.FinishTime - texture.RequestTime);
+		if(!result.Texture)
+		{
+			Fail(result.TextureId, L"could not be decoded");
+			continue;
+		}
+
+		texture.MipCount = static_cast<uint32_t>(result.Texture->Mips.size());
+		texture.NextMip = texture.MipCount;
+		texture.ResidentMip = texture.MipCount;
+		texture.Decoded = std::move(result.Texture);
+		Sink->CreateTexture(result.TextureId, *texture.Decoded);
+		UploadQueue.push_back(result.TextureId);
+	}
+}
+
+void TextureStreamer::ScheduleCopies()
+{
+	std::vector<std::pair<uint32_t, uint32_t>> recorded;
+	uint64_t recordedBytes = 0;
+	bool ringFull = false;
+
+	//one mip per texture and pass, coarsest first, until the budget or the ring runs out
+	bool progress = true;
+	while(progress && !ringFull && recordedBytes < MaxBytesPerUpdate)
+	{
+		progress = false;
+		for(uint32_t textureId : UploadQueue)
+		{
+			StreamedTexture& texture = Textures[textureId];
+			if(texture.NextMip == 0 || texture.Failed)
+			{
+				continue;
+			}
+
+			uint32_t mip = texture.NextMip - 1;
+			const StreamedMip& layout = texture.Decoded->Mips[mip];
+			uint32_t rowPitch = static_cast<uint32_t>(AlignUp(layout.RowSize, StagingRowPitchAlignment));
+			uint64_t size = uint64_t(rowPitch) * layout.RowCount;
+			if(size > Ring.GetCapacity())
+			{
+				Fail(textureId, L"mip " + std::to_wstring(mip) + L" needs " + std::to_wstring(size) + L" bytes, more than the whole staging ring");
+				continue;
+			}
+
+			uint64_t offset;
+			if(!Ring.Allocate(size, StagingPlacementAlignment, offset))
+			{
+				ringFull = true;
+				break;
+			}
+			for(uint32_t row = 0; row < layout.RowCount; row++)
+			{
+				memcpy(Staging + offset + uint64_t(row) * rowPitch, &layout.Data[size_t(row) * layout.RowSize], layout.RowSize);
+			}
+			Sink->CopyMip(textureId, mip, layout, offset, rowPitch);
+			recorded.push_back({textureId, mip});
+			texture.NextMip--;
+			recordedBytes += size;
+			progress = true;
+			if(recordedBytes >= MaxBytesPerUpdate)
+			{
+				break;
+			}
+		}
+	}
+
+	UploadQueue.erase(std::remove_if(UploadQueue.begin(), UploadQueue.end(), [this](uint32_t textureId)
+	{
+		return Textures[textureId].NextMip == 0 || Textures[textureId].Failed;
+	}), UploadQueue.end());
+
+	if(!recorded.empty())
+	{
+		uint64_t fenceValue = Sink->Submit();
+		Ring.Commit(fenceValue);
+		for(const auto& copy : recorded)
+		{
+			InFlight.push_back({fenceValue, copy.first, copy.second});
+		}
+	}
+}
+
+void TextureStreamer::Fail(uint32_t textureId, std::wstring reason)
+{
+	StreamedTexture& texture = Textures[textureId];
+	texture.Failed = true;
+	texture.Decoded.reset();
+	texture.Stats.FailureReason = std::move(reason);
+}
+
+uint32_t TextureStreamer::GetResidentMip(uint32_t textureId) const
+{
+	return Textures[textureId].ResidentMip;
+}
+
+uint32_t TextureStreamer::GetMipCount(uint32_t textureId) const
+{
+	return Textures[textureId].MipCount;
+}
+
+bool TextureStreamer::IsComplete(uint32_t textureId) const
+{
+	const StreamedTexture& texture = Textures[textureId];
+	return !texture.Decoding && !texture.Failed && texture.ResidentMip == 0;
+}
+
+bool TextureStreamer::IsFailed(uint32_t textureId) const
+{
+	return Textures[textureId].Failed;
+}
+
+bool TextureStreamer::IsIdle() const
+{
+	for(uint32_t i = 0; i < Textures.size(); i++)
+	{
+		if(!IsComplete(i) && !(IsFailed(i) && !Textures[i].Decoding))
+		{
+			return false;
+		}
+	}
+	return InFlight.empty();
+}
+
+const TextureStreamStats& TextureStreamer::GetStats(uint32_t textureId) const
+{
+	return Textures[textureId].Stats;
+}
+
+void TextureStreamer::ReportStats() const
+{
+	for(uint32_t i = 0; i < Textures.size(); i++)
+	{
+		const TextureStreamStats& stats = Textures[i].Stats;
+		if(Textures[i].Failed)
+		{
+			std::wcout << L"Streaming " << stats.Filename << L" failed: " << stats.FailureReason << std::endl;
+			continue;
+		}
+		std::wcout << L"Streamed " << stats.Filename << L": decoded " << stats.DecodeMilliseconds << L" ms, first mip "
+		           << stats.FirstMipMilliseconds << L" ms, complete " << stats.CompleteMilliseconds << L" ms" << std::endl;
+	}
+	std::cout << "Texture streaming: peak staging " << PeakStagingBytes / 1024 << " KiB of "
+	          << Ring.GetCapacity() / 1024 << " KiB" << std::endl;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StagingRing.h"
+
+struct StreamedMip
+{
+	uint32_t Width; //copy footprint size, block aligned for compressed formats
+	uint32_t Height;
+	uint32_t RowSize; //bytes per row of texels or blocks
+	uint32_t RowCount;
+	std::vector<uint8_t> Data; //tightly packed rows
+};
+
+struct DecodedTexture
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t Format; //DXGI_FORMAT
+	std::vector<StreamedMip> Mips; //most detailed first
+};
+
+//runs on a worker thread, returns false when the file could not be decoded
+using TextureDecoder = std::function<bool(const std::wstring& filename, DecodedTexture& out)>;
+
+//receives the streamer's gpu work, the d3d12 implementation records copies on a queue while
+//tests can just track offsets and fence values
+class TextureUploadSink
+{
+public:
+	virtual ~TextureUploadSink() = default;
+
+	//persistently mapped staging memory the ring suballocates from, called once
+	virtual uint8_t* MapStaging(uint64_t size) = 0;
+	virtual void CreateTexture(uint32_t textureId, const DecodedTexture& texture) = 0;
+	//copies a mip whose rows start at stagingOffset, rowPitch bytes apart
+	virtual void CopyMip(uint32_t textureId, uint32_t mip, const StreamedMip& layout, uint64_t stagingOffset, uint32_t rowPitch) = 0;
+	//submits everything recorded since the last call, returns the fence value signalled after it
+	virtual uint64_t Submit() = 0;
+	virtual uint64_t GetCompletedFenceValue() = 0;
+};
+
+struct TextureStreamStats
+{
+	std::wstring Filename;
+	double DecodeMilliseconds = 0.0; //request until the decoded mips were handed over
+	double FirstMipMilliseconds = 0.0; //request until the coarsest mip was resident
+	double CompleteMilliseconds = 0.0; //request until every mip was resident
+	std::wstring FailureReason; //empty unless the texture failed to stream
+};
+
+//decodes textures on worker threads and streams them to the gpu through a fixed size staging
+//ring, coarse mips of every pending texture go first so everything becomes visible early and
+//sharpens over the following frames
+class TextureStreamer
+{
+public:
+	//the sink has to outlive the streamer and must not be destroyed while copies are in flight
+	TextureStreamer(TextureUploadSink* sink, TextureDecoder decoder, uint64_t stagingCapacity = 32 * 1024 * 1024,
+	                uint32_t workerCount = 2, uint64_t maxBytesPerUpdate = 8 * 1024 * 1024);
+	~TextureStreamer();
+
+	uint32_t Request(const std::wstring& filename);
+
+	//call once per frame, retires finished copies and records new ones within the byte budget
+	void Update();
+
+	//most detailed mip whose data is on the gpu, equals the mip count while nothing is resident
+	uint32_t GetResidentMip(uint32_t textureId) const;
+	uint32_t GetMipCount(uint32_t textureId) const;
+	bool IsComplete(uint32_t textureId) const;
+	bool IsFailed(uint32_t textureId) const;
+	//true once every request has completed or failed
+	bool IsIdle() const;
+
+	const TextureStreamStats& GetStats(uint32_t textureId) const;
+	uint64_t GetPeakStagingBytes() const { return PeakStagingBytes; }
+	void ReportStats() const;
+
+private:
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct StreamedTexture
+	{
+		Clock::time_point RequestTime;
+		std::unique_ptr<DecodedTexture> Decoded;
+		uint32_t MipCount = 0;
+		uint32_t NextMip = 0; //mips below this one still need to be copied
+		uint32_t ResidentMip = 0;
+		bool Decoding = true;
+		bool Failed = false;
+		TextureStreamStats Stats;
+	};
+
+	struct DecodeResult
+	{
+		uint32_t TextureId;
+		std::unique_ptr<DecodedTexture> Texture; //null when decoding failed
+		Clock::time_point FinishTime;
+	};
+
+	struct InFlightCopy
+	{
+		uint64_t FenceValue;
+		uint32_t TextureId;
+		uint32_t Mip;
+	};
+
+	void WorkerLoop();
+	void RetireCopies();
+	void AcceptDecoded();
+	void ScheduleCopies();
+	//stops streaming the texture and frees its decoded mips, what is resident stays resident
+	void Fail(uint32_t textureId, std::wstring reason);
+
+	TextureUploadSink* Sink;
+	TextureDecoder Decoder;
+	StagingRing Ring;
+	uint8_t* Staging;
+	uint64_t MaxBytesPerUpdate;
+	uint64_t PeakStagingBytes = 0;
+
+	//only touched by the thread calling Request and Update
+	std::vector<StreamedTexture> Textures;
+	std::deque<uint32_t> UploadQueue;
+	std::deque<InFlightCopy> InFlight;
+
+	//shared with the workers
+	std::mutex Mutex;
+	std::condition_variable WorkAvailable;
+	std::deque<std::pair<uint32_t, std::wstring>> DecodeQueue;
+	std::vector<DecodeResult> Decoded;
+	bool Stopping = false;
+	std::vector<std::thread> Workers;
+};
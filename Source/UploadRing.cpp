@@ -0,0 +1,53 @@
+#include "UploadRing.h"
+
+#include <cstring>
+#include <iostream>
+
+UploadRing::~UploadRing()
+{
+	if(Active == this)
+		Active = nullptr;
+	if(Buffer)
+	{
+		Buffer->Unmap(0, nullptr);
+		Buffer->Release();
+	}
+}
+
+void UploadRing::Initialize(ID3D12Device* device, uint64_t capacity)
+{
+	CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+	ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+	                                              D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&Buffer)));
+	Buffer->SetName(L"Upload Ring");
+
+	//upload heaps can stay mapped for their whole life, the cpu never reads it back
+	D3D12_RANGE readRange = { 0, 0 };
+	ThrowIfFailed(Buffer->Map(0, &readRange, reinterpret_cast<void**>(&MappedData)));
+	Ring.Initialize(capacity);
+}
+
+UploadAllocation UploadRing::Allocate(uint64_t size, uint64_t alignment)
+{
+	//a constant buffer view covers whole 256 byte blocks, so the size is rounded like the offset
+	uint64_t alignedSize = (size + alignment - 1) / alignment * alignment;
+	uint64_t offset;
+	if(!Ring.Allocate(alignedSize, alignment, offset))
+	{
+		if(!ReportedFull)
+			std::cout << "upload ring is full" << std::endl;
+		ReportedFull = true;
+		return {};
+	}
+	return { MappedData + offset, Buffer->GetGPUVirtualAddress() + offset, alignedSize };
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS UploadRing::Upload(const void* data, uint64_t size)
+{
+	UploadAllocation allocation = Allocate(size);
+	if(!allocation.IsValid())
+		return 0;
+	memcpy(allocation.CpuAddress, data, size);
+	return allocation.GpuAddress;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "StagingRing.h"
+
+struct UploadAllocation
+{
+	uint8_t* CpuAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GpuAddress = 0;
+	uint64_t Size = 0; //rounded up to the alignment
+
+	bool IsValid() const { return CpuAddress != nullptr; }
+};
+
+//one persistently mapped upload buffer for data the cpu writes every frame, like cbuffers that did
+//not fit in root constants. Each allocation is fresh memory, so nothing the gpu may still read
+//from an earlier frame is overwritten, and a frame's space comes back once its fence completed
+class UploadRing
+{
+public:
+	UploadRing() = default;
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+	~UploadRing();
+
+	void Initialize(ID3D12Device* device, uint64_t capacity);
+
+	//256 byte aligned by default so the address can be bound as a root constant buffer view.
+	//Invalid when the frames in flight fill the ring
+	UploadAllocation Allocate(uint64_t size, uint64_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	//allocates and copies size bytes, 0 when the ring is full
+	D3D12_GPU_VIRTUAL_ADDRESS Upload(const void* data, uint64_t size);
+
+	//call once per frame with the fence value signaled after its command lists
+	void FinishFrame(uint64_t fenceValue)
+	{
+		Ring.Commit(fenceValue);
+		ReportedFull = false;
+	}
+	//call before recording a frame with the fence's completed value
+	void Reclaim(uint64_t completedFenceValue) { Ring.Reclaim(completedFenceValue); }
+	uint64_t GetUsedBytes() const { return Ring.GetUsedBytes(); }
+	uint64_t GetCapacity() const { return Ring.GetCapacity(); }
+
+	ID3D12Resource* Buffer = nullptr;
+
+	//when set, Pipeline::SetConstants uploads cbuffers that stayed root constant buffer views here
+	inline static UploadRing* Active = nullptr;
+
+private:
+	StagingRing Ring;
+	uint8_t* MappedData = nullptr;
+	bool ReportedFull = false;
+};
@@ -0,0 +1,383 @@
+#include "VirtualTexture.h"
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+VirtualTextureLayout VirtualTextureLayout::Create(uint32_t width, uint32_t height, uint32_t pageSize, uint32_t border)
+{
+	VirtualTextureLayout layout;
+	layout.Width = width;
+	layout.Height = height;
+	layout.PageSize = pageSize;
+	layout.Border = border;
+	layout.PagesX = std::max(1u, width / pageSize);
+	layout.PagesY = std::max(1u, height / pageSize);
+
+	layout.MipCount = 1;
+	while((layout.PagesX >> (layout.MipCount - 1)) > 1 || (layout.PagesY >> (layout.MipCount - 1)) > 1)
+	{
+		layout.MipCount++;
+	}
+	return layout;
+}
+
+bool VirtualTextureLayout::IsValid() const
+{
+	bool powerOfTwo = (PagesX & (PagesX - 1)) == 0 && (PagesY & (PagesY - 1)) == 0;
+	return powerOfTwo && PagesX * PageSize == Width && PagesY * PageSize == Height;
+}
+
+uint32_t VirtualTextureLayout::GetPageCount() const
+{
+	uint32_t count = 0;
+	for(uint32_t mip = 0; mip < MipCount; mip++)
+	{
+		count += GetPagesWide(mip) * GetPagesHigh(mip);
+	}
+	return count;
+}
+
+uint32_t VirtualTextureLayout::GetPageIndex(uint32_t page) const
+{
+	uint32_t mip = GetPageMip(page);
+	uint32_t index = 0;
+	for(uint32_t i = 0; i < mip; i++)
+	{
+		index += GetPagesWide(i) * GetPagesHigh(i);
+	}
+	return index + GetPageY(page) * GetPagesWide(mip) + GetPageX(page);
+}
+
+void ExtractPage(const MipLevel& level, const VirtualTextureLayout& layout, uint32_t page, uint8_t* out)
+{
+	uint32_t size = layout.GetPhysicalPageSize();
+	int originX = int(GetPageX(page) * layout.PageSize) - int(layout.Border);
+	int originY = int(GetPageY(page) * layout.PageSize) - int(layout.Border);
+	for(uint32_t y = 0; y < size; y++)
+	{
+		int sourceY = std::min(std::max(originY + int(y), 0), int(level.Height) - 1);
+		const uint8_t* sourceRow = &level.Pixels[size_t(sourceY) * level.Width * 4];
+		uint8_t* row = out + size_t(y) * size * 4;
+
+		//the interior is one contiguous run, only the border texels can fall outside the level
+		for(uint32_t x = 0; x < size; x++)
+		{
+			int sourceX = std::min(std::max(originX + int(x), 0), int(level.Width) - 1);
+			memcpy(row + x * 4, sourceRow + size_t(sourceX) * 4, 4);
+		}
+	}
+}
+
+bool WriteVirtualTexturePages(const std::vector<MipLevel>& levels, const VirtualTextureLayout& layout, const std::filesystem::path& filename)
+{
+	if(!layout.IsValid() || levels.size() < layout.MipCount)
+	{
+		return false;
+	}
+
+	std::ofstream file(filename, std::ios::binary);
+	if(!file)
+	{
+		return false;
+	}
+
+	VirtualTextureFileHeader header = {};
+	header.Magic = VirtualTextureMagic;
+	header.Version = VirtualTextureVersion;
+	header.Width = layout.Width;
+	header.Height = layout.Height;
+	header.PageSize = layout.PageSize;
+	header.Border = layout.Border;
+	header.MipCount = layout.MipCount;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<uint8_t> page(layout.GetPageBytes());
+	for(uint32_t mip = 0; mip < layout.MipCount; mip++)
+	{
+		for(uint32_t y = 0; y < layout.GetPagesHigh(mip); y++)
+		{
+			for(uint32_t x = 0; x < layout.GetPagesWide(mip); x++)
+			{
+				ExtractPage(levels[mip], layout, PackPage(x, y, mip), page.data());
+				file.write(reinterpret_cast<const char*>(page.data()), page.size());
+			}
+		}
+	}
+	return bool(file);
+}
+
+VirtualTexture::VirtualTexture(const VirtualTextureLayout& layout, uint32_t physicalPagesX, uint32_t physicalPagesY, uint32_t maxUploadsPerFrame)
+	: Layout(layout), PhysicalPagesX(physicalPagesX), PhysicalPagesY(physicalPagesY), MaxUploadsPerFrame(maxUploadsPerFrame)
+{
+	assert(layout.IsValid() && physicalPagesX <= 256 && physicalPagesY <= 256);
+	Slots.resize(size_t(physicalPagesX) * physicalPagesY);
+	FreeSlotCount = uint32_t(Slots.size());
+	RootPage = PackPage(0, 0, Layout.MipCount - 1);
+
+	PageTable.resize(Layout.MipCount);
+	for(uint32_t mip = 0; mip < Layout.MipCount; mip++)
+	{
+		PageTable[mip].assign(size_t(Layout.GetPagesWide(mip)) * Layout.GetPagesHigh(mip), 0);
+	}
+}
+
+void VirtualTexture::Unlink(uint32_t slot)
+{
+	Slot& entry = Slots[slot];
+	(entry.Previous != InvalidPage ? Slots[entry.Previous].Next : LruHead) = entry.Next;
+	(entry.Next != InvalidPage ? Slots[entry.Next].Previous : LruTail) = entry.Previous;
+	entry.Previous = InvalidPage;
+	entry.Next = InvalidPage;
+}
+
+void VirtualTexture::LinkTail(uint32_t slot)
+{
+	Slot& entry = Slots[slot];
+	entry.Previous = LruTail;
+	entry.Next = InvalidPage;
+	(LruTail != InvalidPage ? Slots[LruTail].Next : LruHead) = slot;
+	LruTail = slot;
+}
+
+void VirtualTexture::Touch(uint32_t slot)
+{
+	Slot& entry = Slots[slot];
+	if(entry.LastUsedFrame == Frame)
+	{
+		return;
+	}
+	entry.LastUsedFrame = Frame;
+	//the root page is pinned and never part of the lru list
+	if(entry.Page != RootPage)
+	{
+		Unlink(slot);
+		LinkTail(slot);
+	}
+}
+
+uint32_t VirtualTexture::AllocateSlot()
+{
+	if(FreeSlotCount > 0)
+	{
+		return uint32_t(Slots.size()) - FreeSlotCount--;
+	}
+
+	//never evict a page this frame's feedback still needs, that would only thrash
+	uint32_t slot = LruHead;
+	if(slot == InvalidPage || Slots[slot].LastUsedFrame == Frame)
+	{
+		return InvalidPage;
+	}
+	Unlink(slot);
+	ResidentPages.erase(Slots[slot].Page);
+	Stats.Evictions++;
+	return slot;
+}
+
+const std::vector<PageLoad>& VirtualTexture::ProcessFeedback(const uint32_t* feedback, size_t count)
+{
+	Frame++;
+	Stats.Frames++;
+	Loads.clear();
+	RequestCounts.clear();
+	MissingPages.clear();
+
+	//neighbouring texels mostly ask for the same page, collapse runs before hashing
+	uint32_t runPage = 0;
+	uint32_t runLength = 0;
+	for(size_t i = 0; i < count; i++)
+	{
+		if(feedback[i] == runPage)
+		{
+			runLength++;
+			continue;
+		}
+		if(runPage & PageFeedbackValid)
+		{
+			RequestCounts[runPage & ~PageFeedbackValid] += runLength;
+		}
+		runPage = feedback[i];
+		runLength = 1;
+	}
+	if(runPage & PageFeedbackValid)
+	{
+		RequestCounts[runPage & ~PageFeedbackValid] += runLength;
+	}
+
+	//the coarsest page is the fallback for every texel, it is always requested
+	if(!IsResident(RootPage))
+	{
+		MissingPages[RootPage] += 1;
+	}
+
+	for(auto [page, requests] : RequestCounts)
+	{
+		uint32_t mip = GetPageMip(page);
+		if(mip >= Layout.MipCount || GetPageX(page) >= Layout.GetPagesWide(mip) || GetPageY(page) >= Layout.GetPagesHigh(mip))
+		{
+			continue;
+		}
+
+		Stats.RequestedPages++;
+		auto resident = ResidentPages.find(page);
+		if(resident != ResidentPages.end())
+		{
+			Stats.Hits++;
+		}
+
+		//walk up the chain so fallbacks stay resident and missing ancestors get loaded first
+		uint32_t x = GetPageX(page);
+		uint32_t y = GetPageY(page);
+		for(; mip < Layout.MipCount; mip++, x >>= 1, y >>= 1)
+		{
+			uint32_t ancestor = PackPage(x, y, mip);
+			auto found = ResidentPages.find(ancestor);
+			if(found != ResidentPages.end())
+			{
+				Touch(found->second);
+			}
+			else
+			{
+				MissingPages[ancestor] += requests;
+			}
+		}
+	}
+
+	LoadOrder.assign(MissingPages.begin(), MissingPages.end());
+	std::sort(LoadOrder.begin(), LoadOrder.end(), [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b)
+	{
+		uint32_t mipA = GetPageMip(a.first);
+		uint32_t mipB = GetPageMip(b.first);
+		if(mipA != mipB)
+		{
+			return mipA > mipB;
+		}
+		return a.second != b.second ? a.second > b.second : a.first < b.first;
+	});
+
+	for(auto [page, requests] : LoadOrder)
+	{
+		if(Loads.size() >= MaxUploadsPerFrame)
+		{
+			break;
+		}
+		uint32_t slot = AllocateSlot();
+		if(slot == InvalidPage)
+		{
+			break;
+		}
+
+		Slots[slot].Page = page;
+		Slots[slot].LastUsedFrame = Frame;
+		if(page != RootPage)
+		{
+			LinkTail(slot);
+		}
+		ResidentPages[page] = slot;
+		Loads.push_back({page, slot});
+	}
+
+	if(!Loads.empty())
+	{
+		Stats.Uploads += Loads.size();
+		Stats.MaxUploadsInFrame = std::max(Stats.MaxUploadsInFrame, uint32_t(Loads.size()));
+		RebuildPageTable();
+	}
+	return Loads;
+}
+
+void VirtualTexture::RebuildPageTable()
+{
+	//coarse to fine, so every missing page can inherit the entry of its parent
+	for(uint32_t mip = Layout.MipCount; mip-- > 0;)
+	{
+		uint32_t pagesWide = Layout.GetPagesWide(mip);
+		uint32_t pagesHigh = Layout.GetPagesHigh(mip);
+		std::vector<uint32_t>& table = PageTable[mip];
+		for(uint32_t y = 0; y < pagesHigh; y++)
+		{
+			for(uint32_t x = 0; x < pagesWide; x++)
+			{
+				uint32_t entry = 0;
+				auto resident = ResidentPages.find(PackPage(x, y, mip));
+				if(resident != ResidentPages.end())
+				{
+					uint32_t slot = resident->second;
+					entry = (slot % PhysicalPagesX) | ((slot / PhysicalPagesX) << 8) | (mip << 16) | (1u << 24);
+				}
+				else if(mip + 1 < Layout.MipCount)
+				{
+					entry = PageTable[mip + 1][(y >> 1) * Layout.GetPagesWide(mip + 1) + (x >> 1)];
+				}
+				table[size_t(y) * pagesWide + x] = entry;
+			}
+		}
+	}
+	PageTableDirty = true;
+}
+
+void VirtualTexture::ReportStats() const
+{
+	double hitRate = Stats.RequestedPages ? 100.0 * Stats.Hits / Stats.RequestedPages : 0.0;
+	double uploadsPerFrame = Stats.Frames ? double(Stats.Uploads) / Stats.Frames : 0.0;
+	std::cout << "Virtual texture: " << Stats.Frames << " frames, hit rate " << hitRate << "%, "
+	          << uploadsPerFrame << " pages uploaded per frame (max " << Stats.MaxUploadsInFrame << "), "
+	          << Stats.Evictions << " evictions, " << ResidentPages.size() << "/" << Slots.size() << " pages resident" << std::endl;
+}
+
+void BenchmarkVirtualTexture()
+{
+	//16k x 16k virtual texture in 128 texel pages against a 1024 page physical cache, feedback
+	//is rendered at a quarter of 1280x720
+	VirtualTextureLayout layout = VirtualTextureLayout::Create(16384, 16384);
+	VirtualTexture cache(layout, 32, 32, 16);
+
+	const uint32_t feedbackWidth = 320;
+	const uint32_t feedbackHeight = 180;
+	const float screenWidth = 1280.0f;
+	const int frameCount = 1200;
+	std::vector<uint32_t> feedback(feedbackWidth * feedbackHeight);
+
+	double processMs = 0.0;
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		//the camera pans along a loop while zooming in and out, rows towards the top of the
+		//screen look further away like a ground plane seen at an angle
+		float t = float(frame) / frameCount;
+		float centerU = 0.5f + 0.3f * std::cos(t * 6.2831853f);
+		float centerV = 0.5f + 0.3f * std::sin(t * 2.0f * 6.2831853f);
+		float extent = 0.02f + 0.1f * (0.5f + 0.5f * std::sin(t * 3.0f * 6.2831853f));
+
+		for (uint32_t y = 0; y < feedbackHeight; y++)
+		{
+			float distance = 1.0f + 3.0f * (1.0f - float(y) / feedbackHeight) * (1.0f - float(y) / feedbackHeight);
+			float rowExtent = extent * distance;
+			float texelsPerPixel = rowExtent * layout.Width / screenWidth;
+			uint32_t mip = uint32_t(std::min(std::max(std::log2(texelsPerPixel), 0.0f), float(layout.MipCount - 1)));
+			float v = centerV + (float(y) / feedbackHeight - 0.5f) * rowExtent * 0.5625f;
+			for (uint32_t x = 0; x < feedbackWidth; x++)
+			{
+				float u = centerU + (float(x) / feedbackWidth - 0.5f) * rowExtent;
+				if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f)
+				{
+					feedback[y * feedbackWidth + x] = 0;
+					continue;
+				}
+				uint32_t pageX = uint32_t(u * layout.PagesX) >> mip;
+				uint32_t pageY = uint32_t(v * layout.PagesY) >> mip;
+				feedback[y * feedbackWidth + x] = PageFeedbackValid | PackPage(pageX, pageY, mip);
+			}
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		cache.ProcessFeedback(feedback.data(), feedback.size());
+		processMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	cache.ReportStats();
+	std::cout << "Virtual texture feedback processing: " << processMs / frameCount * 1000.0 << " us per frame" << std::endl;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+//pages are identified by their position in the page grid of their mip, the same packing is
+//written by vt_feedback.px.hlsl with PageFeedbackValid set, cleared feedback texels are 0
+constexpr uint32_t PageFeedbackValid = 0x80000000u;
+constexpr uint32_t InvalidPage = 0xFFFFFFFFu;
+
+inline uint32_t PackPage(uint32_t x, uint32_t y, uint32_t mip) { return (mip << 24) | (y << 12) | x; }
+inline uint32_t GetPageX(uint32_t page) { return page & 0xFFF; }
+inline uint32_t GetPageY(uint32_t page) { return (page >> 12) & 0xFFF; }
+inline uint32_t GetPageMip(uint32_t page) { return (page >> 24) & 0x7F; }
+
+struct VirtualTextureLayout
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t PageSize; //texels of payload along each page side
+	uint32_t Border; //texels copied from the neighbouring pages on every side for filtering
+	uint32_t PagesX; //page grid of mip 0
+	uint32_t PagesY;
+	uint32_t MipCount; //down to the mip that fits in a single page
+
+	//width and height have to be power of two multiples of the page size, so the page grid
+	//halves evenly from one mip to the next just like the page table texture
+	static VirtualTextureLayout Create(uint32_t width, uint32_t height, uint32_t pageSize = 128, uint32_t border = 4);
+	bool IsValid() const;
+
+	uint32_t GetPagesWide(uint32_t mip) const { return std::max(1u, PagesX >> mip); }
+	uint32_t GetPagesHigh(uint32_t mip) const { return std::max(1u, PagesY >> mip); }
+	uint32_t GetPhysicalPageSize() const { return PageSize + 2 * Border; }
+	uint32_t GetPageBytes() const { return GetPhysicalPageSize() * GetPhysicalPageSize() * 4; }
+	uint32_t GetPageCount() const;
+	//position of the page in the page file, mips are stored finest first in row order
+	uint32_t GetPageIndex(uint32_t page) const;
+};
+
+constexpr uint32_t VirtualTextureMagic = 0x58455456; //"VTEX"
+constexpr uint32_t VirtualTextureVersion = 1;
+
+//page file layout: this header followed by GetPageCount() rgba8 pages of GetPageBytes() each
+struct VirtualTextureFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t PageSize;
+	uint32_t Border;
+	uint32_t MipCount;
+	uint32_t Reserved;
+};
+
+//copies one page plus its border out of the rgba8 level the page belongs to, texels outside
+//the level are clamped to the edge. out receives tightly packed rows
+void ExtractPage(const MipLevel& level, const VirtualTextureLayout& layout, uint32_t page, uint8_t* out);
+
+//tiles the mip chain into the page file, levels has to hold at least layout.MipCount levels
+bool WriteVirtualTexturePages(const std::vector<MipLevel>& levels, const VirtualTextureLayout& layout, const std::filesystem::path& filename);
+
+struct PageLoad
+{
+	uint32_t Page;
+	uint32_t Slot; //physical page, slot % physicalPagesX and slot / physicalPagesX in the atlas
+};
+
+struct VirtualTextureStats
+{
+	uint64_t Frames = 0;
+	uint64_t RequestedPages = 0; //distinct pages asked for by the feedback, summed over frames
+	uint64_t Hits = 0; //requested pages that were already resident
+	uint64_t Uploads = 0;
+	uint64_t Evictions = 0;
+	uint32_t MaxUploadsInFrame = 0;
+};
+
+//cpu side of the page cache: turns feedback into prioritized page loads, keeps the physical
+//pages in lru order and maintains the page table. Has no gpu dependencies so it can be driven
+//by synthetic feedback
+class VirtualTexture
+{
+public:
+	VirtualTexture(const VirtualTextureLayout& layout, uint32_t physicalPagesX, uint32_t physicalPagesY, uint32_t maxUploadsPerFrame = 16);
+
+	//consumes one frame of feedback. Requested pages and their resident ancestors are marked as
+	//used, missing pages (and missing ancestors, so the fallback gets sharper step by step) are
+	//loaded coarsest mip first, then by how many feedback texels asked for them, until the
+	//upload budget or the pages not used this frame run out. The page table already points at
+	//the returned slots, the caller has to fill them before sampling
+	const std::vector<PageLoad>& ProcessFeedback(const uint32_t* feedback, size_t count);
+
+	//page table entries are physical x | physical y << 8 | resident mip << 16 | 1 << 24, cells
+	//whose page is missing point at their closest resident ancestor, 0 when there is none
+	const std::vector<uint32_t>& GetPageTable(uint32_t mip) const { return PageTable[mip]; }
+	bool IsPageTableDirty() const { return PageTableDirty; }
+	void ClearPageTableDirty() { PageTableDirty = false; }
+
+	bool IsResident(uint32_t page) const { return ResidentPages.count(page) != 0; }
+	const VirtualTextureLayout& GetLayout() const { return Layout; }
+	uint32_t GetPhysicalPagesX() const { return PhysicalPagesX; }
+	uint32_t GetPhysicalPagesY() const { return PhysicalPagesY; }
+	const VirtualTextureStats& GetStats() const { return Stats; }
+	void ReportStats() const;
+
+private:
+	struct Slot
+	{
+		uint32_t Page = InvalidPage;
+		uint32_t LastUsedFrame = 0;
+		uint32_t Previous = InvalidPage; //lru list, head is the least recently used slot
+		uint32_t Next = InvalidPage;
+	};
+
+	void Touch(uint32_t slot);
+	void Unlink(uint32_t slot);
+	void LinkTail(uint32_t slot);
+	uint32_t AllocateSlot();
+	void RebuildPageTable();
+
+	VirtualTextureLayout Layout;
+	uint32_t PhysicalPagesX;
+	uint32_t PhysicalPagesY;
+	uint32_t MaxUploadsPerFrame;
+	uint32_t Frame = 0;
+	uint32_t RootPage;
+
+	std::vector<Slot> Slots;
+	uint32_t LruHead = InvalidPage;
+	uint32_t LruTail = InvalidPage;
+	uint32_t FreeSlotCount;
+	std::unordered_map<uint32_t, uint32_t> ResidentPages; //page -> slot
+
+	std::vector<std::vector<uint32_t>> PageTable;
+	bool PageTableDirty = true;
+
+	//per frame scratch, kept to avoid reallocating every frame
+	std::unordered_map<uint32_t, uint32_t> RequestCounts;
+	std::unordered_map<uint32_t, uint32_t> MissingPages;
+	std::vector<std::pair<uint32_t, uint32_t>> LoadOrder;
+	std::vector<PageLoad> Loads;
+
+	VirtualTextureStats Stats;
+};
+
+//drives the cache with a synthetic camera flying over a 16k virtual texture and prints the hit
+//rate, pages uploaded per frame and the cost of processing the feedback
+void BenchmarkVirtualTexture();
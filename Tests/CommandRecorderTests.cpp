@@ -0,0 +1,210 @@
+#include "Test.h"
+#include "CommandRecorder.h"
+
+#include <string>
+
+namespace
+{
+	//logs every call that reaches the command list as one line
+	class LoggingCommandListSink : public CommandListSink
+	{
+	public:
+		std::vector<std::string> Calls;
+
+		void SetPipelineState(ID3D12PipelineState* pipelineState) override { Log("pso", pipelineState); }
+		void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) override { Log("rootsig", rootSignature); }
+		void SetDescriptorHeap(ID3D12DescriptorHeap* heap) override { Log("heap", heap); }
+		void SetGraphicsRootDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override
+		{
+			Calls.push_back("table " + std::to_string(rootIndex) + " " + std::to_string(baseDescriptor.ptr));
+		}
+		void SetGraphicsRootConstantBufferView(uint32_t rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address) override
+		{
+			Calls.push_back("cbv " + std::to_string(rootIndex) + " " + std::to_string(address));
+		}
+		void SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset) override
+		{
+			std::string call = "constants " + std::to_string(rootIndex) + " @" + std::to_string(offset);
+			for(uint32_t i = 0; i < count; i++)
+			{
+				call += " " + std::to_string(static_cast<const uint32_t*>(data)[i]);
+			}
+			Calls.push_back(call);
+		}
+		void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override { Calls.push_back("topology " + std::to_string(topology)); }
+		void IASetVertexBuffer(uint32_t slot, const D3D12_VERTEX_BUFFER_VIEW& view) override
+		{
+			Calls.push_back("vb " + std::to_string(slot) + " " + std::to_string(view.BufferLocation));
+		}
+		void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) override { Calls.push_back("ib " + std::to_string(view.BufferLocation)); }
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override
+		{
+			Calls.push_back("draw " + std::to_string(indexCount));
+		}
+
+		//the calls since the last Take
+		std::vector<std::string> Take()
+		{
+			std::vector<std::string> calls;
+			calls.swap(Calls);
+			return calls;
+		}
+
+	private:
+		void Log(const char* name, const void* object)
+		{
+			Calls.push_back(std::string(name) + " " + std::to_string(reinterpret_cast<uintptr_t>(object)));
+		}
+	};
+
+	//the recorder only compares these pointers, it never dereferences them
+	template<typename T>
+	T* FakeObject(uintptr_t id)
+	{
+		return reinterpret_cast<T*>(id);
+	}
+
+	using Calls = std::vector<std::string>;
+}
+
+TEST(CommandRecorderDropsRepeatedState)
+{
+	LoggingCommandListSink sink;
+	CommandRecorder recorder(&sink);
+	auto* pso = FakeObject<ID3D12PipelineState>(0x10);
+	auto* rootSignature = FakeObject<ID3D12RootSignature>(0x20);
+	auto* heap = FakeObject<ID3D12DescriptorHeap>(0x30);
+
+	recorder.SetPipelineState(pso);
+	recorder.SetDescriptorHeap(heap);
+	recorder.SetGraphicsRootSignature(rootSignature);
+	recorder.SetGraphicsRootDescriptorTable(0, {1000});
+	recorder.SetGraphicsRootConstantBufferView(1, 2000);
+	uint32_t constants[] = {1, 2, 3};
+	recorder.SetGraphicsRoot32BitConstants(2, 3, constants, 0);
+	CHECK(sink.Take() == Calls({"pso 16", "heap 48", "rootsig 32", "table 0 1000", "cbv 1 2000", "constants 2 @0 1 2 3"}));
+
+	//binding the same pipeline again records nothing but the draw
+	recorder.SetPipelineState(pso);
+	recorder.SetDescriptorHeap(heap);
+	recorder.SetGraphicsRootSignature(rootSignature);
+	recorder.SetGraphicsRootDescriptorTable(0, {1000});
+	recorder.SetGraphicsRootConstantBufferView(1, 2000);
+	recorder.SetGraphicsRoot32BitConstants(2, 3, constants, 0);
+	recorder.SetGraphicsRoot32BitConstant(2, 2, 1);
+	recorder.DrawIndexedInstanced(36, 1, 0, 0, 0);
+	CHECK(sink.Take() == Calls({"draw 36"}));
+	CHECK(recorder.GetStats().Issued == 6);
+	CHECK(recorder.GetStats().Elided == 7);
+
+	//changed values go through, constants only when one of the written values differs or was never set
+	recorder.SetPipelineState(FakeObject<ID3D12PipelineState>(0x11));
+	recorder.SetGraphicsRootDescriptorTable(0, {1064});
+	recorder.SetGraphicsRootConstantBufferView(1, 2256);
+	recorder.SetGraphicsRoot32BitConstant(2, 7, 1);
+	recorder.SetGraphicsRoot32BitConstant(2, 4, 3);
+	recorder.SetGraphicsRoot32BitConstant(2, 4, 3);
+	CHECK(sink.Take() == Calls({"pso 17", "table 0 1064", "cbv 1 2256", "constants 2 @1 7", "constants 2 @3 4"}));
+}
+
+TEST(CommandRecorderDropsRepeatedInputAssemblerState)
+{
+	LoggingCommandListSink sink;
+	CommandRecorder recorder(&sink);
+	D3D12_VERTEX_BUFFER_VIEW vertices = {};
+	vertices.BufferLocation = 4096;
+	vertices.SizeInBytes = 1024;
+	vertices.StrideInBytes = 32;
+	D3D12_INDEX_BUFFER_VIEW indices = {};
+	indices.BufferLocation = 8192;
+	indices.SizeInBytes = 256;
+	indices.Format = DXGI_FORMAT_R32_UINT;
+
+	for(int i = 0; i < 2; i++)
+	{
+		recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		recorder.IASetVertexBuffer(0, vertices);
+		recorder.IASetIndexBuffer(indices);
+		recorder.DrawIndexedInstanced(3, 1, 0, 0, 0);
+	}
+	CHECK(sink.Take() == Calls({"topology 4", "vb 0 4096", "ib 8192", "draw 3", "draw 3"}));
+
+	//a view is only the same when every field matches
+	vertices.StrideInBytes = 16;
+	recorder.IASetVertexBuffer(0, vertices);
+	recorder.IASetVertexBuffer(1, vertices);
+	indices.Format = DXGI_FORMAT_R16_UINT;
+	recorder.IASetIndexBuffer(indices);
+	CHECK(sink.Take() == Calls({"vb 0 4096", "vb 1 4096", "ib 8192"}));
+}
+
+TEST(CommandRecorderRootSignatureAndHeapForgetArguments)
+{
+	LoggingCommandListSink sink;
+	CommandRecorder recorder(&sink);
+	auto* first = FakeObject<ID3D12RootSignature>(0x20);
+	auto* second = FakeObject<ID3D12RootSignature>(0x21);
+	uint32_t constant = 5;
+
+	recorder.SetDescriptorHeap(FakeObject<ID3D12DescriptorHeap>(0x30));
+	recorder.SetGraphicsRootSignature(first);
+	recorder.SetGraphicsRootDescriptorTable(0, {1000});
+	recorder.SetGraphicsRootConstantBufferView(1, 2000);
+	recorder.SetGraphicsRoot32BitConstants(2, 1, &constant, 0);
+	sink.Take();
+
+	//a new heap invalidates the tables but keeps the other root arguments
+	recorder.SetDescriptorHeap(FakeObject<ID3D12DescriptorHeap>(0x31));
+	recorder.SetGraphicsRootDescriptorTable(0, {1000});
+	recorder.SetGraphicsRootConstantBufferView(1, 2000);
+	recorder.SetGraphicsRoot32BitConstants(2, 1, &constant, 0);
+	CHECK(sink.Take() == Calls({"heap 49", "table 0 1000"}));
+
+	//a new root signature invalidates every root argument, even when switching back
+	recorder.SetGraphicsRootSignature(second);
+	recorder.SetGraphicsRootSignature(first);
+	recorder.SetGraphicsRootDescriptorTable(0, {1000});
+	recorder.SetGraphicsRootConstantBufferView(1, 2000);
+	recorder.SetGraphicsRoot32BitConstants(2, 1, &constant, 0);
+	CHECK(sink.Take() == Calls({"rootsig 33", "rootsig 32", "table 0 1000", "cbv 1 2000", "constants 2 @0 5"}));
+}
+
+TEST(CommandRecorderResetForgetsState)
+{
+	LoggingCommandListSink sink;
+	CommandRecorder recorder(&sink);
+	auto* pso = FakeObject<ID3D12PipelineState>(0x10);
+	auto* rootSignature = FakeObject<ID3D12RootSignature>(0x20);
+	auto* heap = FakeObject<ID3D12DescriptorHeap>(0x30);
+	uint32_t constant = 5;
+	D3D12_VERTEX_BUFFER_VIEW vertices = {};
+	vertices.BufferLocation = 4096;
+	D3D12_INDEX_BUFFER_VIEW indices = {};
+	indices.BufferLocation = 8192;
+
+	//records the same frame twice, the second time on a freshly reset command list
+	for(int frame = 0; frame < 2; frame++)
+	{
+		recorder.Reset();
+		recorder.SetPipelineState(pso);
+		recorder.SetDescriptorHeap(heap);
+		recorder.SetGraphicsRootSignature(rootSignature);
+		recorder.SetGraphicsRootDescriptorTable(0, {1000});
+		recorder.SetGraphicsRootConstantBufferView(1, 2000);
+		recorder.SetGraphicsRoot32BitConstants(2, 1, &constant, 0);
+		recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		recorder.IASetVertexBuffer(0, vertices);
+		recorder.IASetIndexBuffer(indices);
+		recorder.DrawIndexedInstanced(3, 1, 0, 0, 0);
+		CHECK(sink.Take() == Calls({"pso 16", "heap 48", "rootsig 32", "table 0 1000", "cbv 1 2000", "constants 2 @0 5",
+		                            "topology 4", "vb 0 4096", "ib 8192", "draw 3"}));
+	}
+
+	//stats survive the reset until asked to start over
+	CHECK(recorder.GetStats().Issued == 18);
+	CHECK(recorder.GetStats().Elided == 0);
+	recorder.ResetStats();
+	recorder.SetPipelineState(pso);
+	CHECK(recorder.GetStats().Issued == 0);
+	CHECK(recorder.GetStats().Elided == 1);
+}
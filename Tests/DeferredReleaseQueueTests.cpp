@@ -0,0 +1,69 @@
+#include "Test.h"
+#include "DeferredReleaseQueue.h"
+
+namespace
+{
+	//counts releases instead of freeing anything
+	class FakeObject : public IUnknown
+	{
+	public:
+		ULONG References = 1;
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** object) override
+		{
+			*object = nullptr;
+			return E_NOINTERFACE;
+		}
+		ULONG STDMETHODCALLTYPE AddRef() override { return ++References; }
+		ULONG STDMETHODCALLTYPE Release() override { return --References; }
+	};
+}
+
+TEST(DeferredReleaseQueueWaitsForTheFrameFence)
+{
+	FakeObject first;
+	FakeObject second;
+	FakeObject third;
+	DeferredReleaseQueue queue;
+
+	//replaced while recording frame 1, the frames before it may still use them
+	queue.ReleaseAfterFrame(&first);
+	queue.ReleaseAfterFrame(&second);
+	queue.Reclaim(UINT64_MAX);
+	CHECK(first.References == 1 && second.References == 1);
+	queue.FinishFrame(1);
+
+	queue.ReleaseAfterFrame(&third);
+	queue.FinishFrame(2);
+	CHECK(queue.GetPendingCount() == 3);
+
+	queue.Reclaim(0);
+	CHECK(first.References == 1 && second.References == 1 && third.References == 1);
+	queue.Reclaim(1);
+	CHECK(first.References == 0 && second.References == 0 && third.References == 1);
+	CHECK(queue.GetPendingCount() == 1);
+
+	//frames without replacements keep the completed values moving past it
+	queue.FinishFrame(3);
+	queue.Reclaim(3);
+	CHECK(third.References == 0);
+	CHECK(queue.GetPendingCount() == 0);
+}
+
+TEST(DeferredReleaseQueueReleasesTheRestOnDestruction)
+{
+	FakeObject finished;
+	FakeObject unfinished;
+	{
+		DeferredReleaseQueue queue;
+		DeferredReleaseQueue::Active = &queue;
+		queue.ReleaseAfterFrame(&finished);
+		queue.FinishFrame(1);
+		queue.ReleaseAfterFrame(&unfinished);
+		queue.ReleaseAfterFrame(nullptr);
+		CHECK(queue.GetPendingCount() == 2);
+	}
+	CHECK(DeferredReleaseQueue::Active == nullptr);
+	CHECK(finished.References == 0);
+	CHECK(unfinished.References == 0);
+}
@@ -0,0 +1,137 @@
+#include "Test.h"
+#include "DescriptorIndexAllocator.h"
+
+#include <random>
+
+TEST(DescriptorIndexAllocatorMergesOneSide)
+{
+	DescriptorIndexAllocator allocator(16);
+	uint32_t a = allocator.Allocate(4);
+	uint32_t b = allocator.Allocate(4);
+	uint32_t c = allocator.Allocate(4);
+	CHECK(a == 0 && b == 4 && c == 8);
+	CHECK(allocator.GetFreeRangeCount() == 1);
+
+	//freeing a, then b merges b into its free left neighbour
+	CHECK(allocator.Free(a, 4));
+	CHECK(allocator.GetFreeRangeCount() == 2);
+	CHECK(allocator.Free(b, 4));
+	CHECK(allocator.GetFreeRangeCount() == 2);
+	CHECK(allocator.Allocate(8) == 0);
+
+	//freeing c merges it into the free tail on its right
+	CHECK(allocator.Free(c, 4));
+	CHECK(allocator.GetFreeRangeCount() == 1);
+	CHECK(allocator.Allocate(8) == 8);
+}
+
+TEST(DescriptorIndexAllocatorMergesBothSides)
+{
+	DescriptorIndexAllocator allocator(12);
+	uint32_t left = allocator.Allocate(4);
+	uint32_t middle = allocator.Allocate(4);
+	uint32_t right = allocator.Allocate(4);
+	CHECK(allocator.Free(left, 4));
+	CHECK(allocator.Free(right, 4));
+	CHECK(allocator.GetFreeRangeCount() == 2);
+
+	CHECK(allocator.Free(middle, 4));
+	CHECK(allocator.GetFreeRangeCount() == 1);
+	CHECK(allocator.Allocate(12) == 0);
+}
+
+TEST(DescriptorIndexAllocatorFailsWhenExhausted)
+{
+	DescriptorIndexAllocator allocator(8);
+	CHECK(allocator.Allocate(0) == DescriptorIndexAllocator::InvalidIndex);
+	CHECK(allocator.Allocate(9) == DescriptorIndexAllocator::InvalidIndex);
+	CHECK(allocator.Allocate(8) == 0);
+	CHECK(allocator.Allocate(1) == DescriptorIndexAllocator::InvalidIndex);
+	CHECK(allocator.GetAllocatedCount() == 8);
+
+	//enough free indices in total but not in one run
+	CHECK(allocator.Free(0, 8));
+	uint32_t runs[4];
+	for(uint32_t& run : runs)
+	{
+		run = allocator.Allocate(2);
+	}
+	CHECK(allocator.Free(runs[0], 2));
+	CHECK(allocator.Free(runs[2], 2));
+	CHECK(allocator.Allocate(4) == DescriptorIndexAllocator::InvalidIndex);
+	CHECK(allocator.GetAllocatedCount() == 4);
+
+	//runs that were not handed out are rejected without touching the state
+	CHECK(!allocator.Free(runs[0], 2));
+	CHECK(!allocator.Free(runs[1], 1));
+	CHECK(!allocator.Free(runs[1] + 1, 1));
+	CHECK(allocator.GetAllocatedCount() == 4);
+	CHECK(allocator.GetFreeRangeCount() == 2);
+
+	DescriptorIndexAllocator empty;
+	CHECK(empty.Allocate(1) == DescriptorIndexAllocator::InvalidIndex);
+}
+
+TEST(DescriptorIndexAllocatorMatchesBitmap)
+{
+	constexpr uint32_t Capacity = 256;
+	DescriptorIndexAllocator allocator(Capacity);
+	std::vector<bool> used(Capacity, false);
+	std::vector<std::pair<uint32_t, uint32_t>> live;
+	std::mt19937 random(45);
+
+	//lowest run of count free bits in the reference bitmap
+	auto findFirstFit = [&](uint32_t count)
+	{
+		uint32_t length = 0;
+		for(uint32_t i = 0; i < Capacity; i++)
+		{
+			length = used[i] ? 0 : length + 1;
+			if(length == count)
+				return i + 1 - count;
+		}
+		return DescriptorIndexAllocator::InvalidIndex;
+	};
+
+	for(int step = 0; step < 20000; step++)
+	{
+		if(live.empty() || random() % 100 < 55)
+		{
+			uint32_t count = 1 + random() % 16;
+			uint32_t expected = findFirstFit(count);
+			uint32_t index = allocator.Allocate(count);
+			CHECK(index == expected);
+			if(index == DescriptorIndexAllocator::InvalidIndex)
+				continue;
+
+			for(uint32_t i = index; i < index + count; i++)
+			{
+				used[i] = true;
+			}
+			live.push_back({index, count});
+		}
+		else
+		{
+			size_t victim = random() % live.size();
+			auto run = live[victim];
+			live[victim] = live.back();
+			live.pop_back();
+			CHECK(allocator.Free(run.first, run.second));
+			for(uint32_t i = run.first; i < run.first + run.second; i++)
+			{
+				used[i] = false;
+			}
+		}
+
+		//the free runs are exactly the maximal stretches of clear bits
+		uint32_t usedCount = 0;
+		uint32_t freeRuns = 0;
+		for(uint32_t i = 0; i < Capacity; i++)
+		{
+			usedCount += used[i];
+			freeRuns += !used[i] && (i == 0 || used[i - 1]);
+		}
+		CHECK(allocator.GetAllocatedCount() == usedCount);
+		CHECK(allocator.GetFreeRangeCount() == freeRuns);
+	}
+}
@@ -0,0 +1,132 @@
+#include "Test.h"
+#include "DescriptorRing.h"
+
+#include <algorithm>
+#include <deque>
+#include <random>
+
+TEST(DescriptorRingWrapsAroundReclaimedFrames)
+{
+	DescriptorRing ring(100, 10);
+	CHECK(ring.Allocate(6) == 100);
+	ring.FinishFrame(1);
+	CHECK(ring.Allocate(3) == 106);
+	ring.FinishFrame(2);
+
+	//frame 1 still holds the start of the ring
+	CHECK(ring.Allocate(4) == DescriptorRing::InvalidIndex);
+
+	//the last index is too short for the run, it goes to the frame and the run starts over at 0
+	ring.Reclaim(1);
+	CHECK(ring.Allocate(4) == 100);
+	CHECK(ring.GetUsedCount() == 3 + 1 + 4);
+	ring.FinishFrame(3);
+
+	ring.Reclaim(2);
+	CHECK(ring.GetUsedCount() == 5);
+	CHECK(ring.Allocate(5) == 104);
+	CHECK(ring.Allocate(1) == DescriptorRing::InvalidIndex);
+	ring.FinishFrame(4);
+
+	//once everything completed the ring starts over at its base
+	ring.Reclaim(4);
+	CHECK(ring.GetUsedCount() == 0);
+	CHECK(ring.GetFramesInFlight() == 0);
+	CHECK(ring.Allocate(10) == 100);
+}
+
+TEST(DescriptorRingRejectsOversizedRuns)
+{
+	DescriptorRing ring(0, 8);
+	CHECK(ring.Allocate(0) == DescriptorRing::InvalidIndex);
+	CHECK(ring.Allocate(9) == DescriptorRing::InvalidIndex);
+	CHECK(ring.GetUsedCount() == 0);
+
+	//frames without allocations still count, but hold nothing
+	uint64_t serial = ring.GetFrameSerial();
+	ring.FinishFrame(1);
+	CHECK(ring.GetFrameSerial() == serial + 1);
+	CHECK(ring.GetFramesInFlight() == 0);
+}
+
+TEST(DescriptorRingNeverOverlapsLiveRuns)
+{
+	constexpr uint32_t Base = 64;
+	constexpr uint32_t Capacity = 500;
+	struct Run
+	{
+		uint32_t Index;
+		uint32_t Count;
+		uint64_t FenceValue;
+	};
+
+	DescriptorRing ring(Base, Capacity);
+	std::deque<Run> live;
+	std::mt19937 random(47);
+	uint64_t completed = 0;
+	uint32_t previousIndex = 0;
+	uint32_t wraps = 0;
+	uint32_t failures = 0;
+
+	for(uint64_t frame = 1; frame <= 5000; frame++)
+	{
+		//the gpu runs 0 to 3 frames behind and jumps forward in bursts
+		uint64_t lag = random() % 4;
+		if(frame > lag + 1)
+		{
+			completed = std::max(completed, frame - 1 - lag);
+		}
+		ring.Reclaim(completed);
+		while(!live.empty() && live.front().FenceValue <= completed)
+		{
+			live.pop_front();
+		}
+
+		uint32_t allocations = random() % 12;
+		for(uint32_t a = 0; a < allocations; a++)
+		{
+			uint32_t count = 1 + random() % 24;
+			uint32_t index = ring.Allocate(count);
+			if(index == DescriptorRing::InvalidIndex)
+			{
+				//skipped ends belong to frames with live runs, so an empty ring always has room
+				CHECK(!live.empty());
+				failures++;
+				continue;
+			}
+
+			CHECK(index >= Base && index + count <= Base + Capacity);
+			for(const Run& run : live)
+			{
+				CHECK(index >= run.Index + run.Count || run.Index >= index + count);
+			}
+			wraps += index < previousIndex;
+			previousIndex = index;
+			live.push_back({index, count, UINT64_MAX});
+		}
+
+		ring.FinishFrame(frame);
+		for(Run& run : live)
+		{
+			if(run.FenceValue == UINT64_MAX)
+				run.FenceValue = frame;
+		}
+
+		uint32_t liveCount = 0;
+		for(const Run& run : live)
+		{
+			liveCount += run.Count;
+		}
+		//skipped ends count as used, so the ring never reports less than the live runs
+		CHECK(ring.GetUsedCount() >= liveCount);
+		CHECK(ring.GetUsedCount() <= Capacity);
+	}
+
+	//the load is sized so the ring both wraps a lot and runs full now and then
+	CHECK(wraps > 100);
+	CHECK(failures > 0);
+
+	ring.Reclaim(UINT64_MAX);
+	CHECK(ring.GetUsedCount() == 0);
+	CHECK(ring.Allocate(Capacity) == Base);
+}
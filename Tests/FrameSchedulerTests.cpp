@@ -0,0 +1,117 @@
+#include "Test.h"
+#include "FrameScheduler.h"
+
+#include <algorithm>
+
+namespace
+{
+	//a queue that runs submitted frames one after another on a virtual clock the test advances
+	class SimulatedFrameFence : public FrameFence
+	{
+	public:
+		double Now = 0.0;
+		double GpuFrameTime = 0.0;
+		std::vector<uint64_t> Waits; //fence values passed to Wait
+
+		uint64_t Signal() override
+		{
+			double start = std::max(Now, CompletionTimes.empty() ? 0.0 : CompletionTimes.back());
+			CompletionTimes.push_back(start + GpuFrameTime);
+			return CompletionTimes.size();
+		}
+
+		uint64_t GetCompletedValue() override
+		{
+			//completion times only grow, so the completed values are a prefix
+			return std::upper_bound(CompletionTimes.begin(), CompletionTimes.end(), Now) - CompletionTimes.begin();
+		}
+
+		void Wait(uint64_t fenceValue) override
+		{
+			CHECK(fenceValue <= CompletionTimes.size());
+			Waits.push_back(fenceValue);
+			Now = std::max(Now, CompletionTimes[fenceValue - 1]);
+		}
+
+		uint64_t GetSignaledValue() const { return CompletionTimes.size(); }
+
+	private:
+		std::vector<double> CompletionTimes; //of fence value index + 1
+	};
+}
+
+TEST(FrameSchedulerBlocksWhenFramesAhead)
+{
+	for(uint32_t framesInFlight = 1; framesInFlight <= 3; framesInFlight++)
+	{
+		//the gpu takes 8 times as long as the cpu, so the cpu runs into the limit right away
+		SimulatedFrameFence fence;
+		fence.GpuFrameTime = 8.0;
+		FrameScheduler scheduler(&fence, framesInFlight);
+
+		for(uint64_t frame = 1; frame <= 20; frame++)
+		{
+			scheduler.BeginFrame();
+			if(frame <= framesInFlight)
+			{
+				CHECK(fence.Waits.empty());
+			}
+			else
+			{
+				//blocks on the frame that last used this context, framesInFlight frames back
+				CHECK(fence.Waits.size() == frame - framesInFlight);
+				CHECK(fence.Waits.back() == frame - framesInFlight);
+				CHECK(scheduler.GetStats().Waits == fence.Waits.size());
+			}
+			//with this frame the gpu has at most framesInFlight frames queued
+			CHECK(fence.GetSignaledValue() - fence.GetCompletedValue() < framesInFlight);
+
+			fence.Now += 1.0;
+			CHECK(scheduler.EndFrame() == frame);
+		}
+
+		//the gpu is the bottleneck, so frames come at its pace
+		CHECK(fence.Now >= 8.0 * (20 - framesInFlight));
+		scheduler.WaitForIdle();
+		CHECK(fence.GetCompletedValue() == 20);
+		CHECK(scheduler.GetStats().Frames == 20);
+	}
+}
+
+TEST(FrameSchedulerReusesContextsAfterTheirFence)
+{
+	constexpr uint32_t FramesInFlight = 3;
+	SimulatedFrameFence fence;
+	FrameScheduler scheduler(&fence, FramesInFlight);
+	uint64_t contextFenceValues[FramesInFlight] = {};
+
+	//gpu frame times vary around the cpu's, so it is sometimes ahead and sometimes behind
+	const double gpuFrameTimes[] = { 1.0, 5.0, 2.0, 9.0, 0.5, 3.0, 7.0, 1.0 };
+	for(uint32_t frame = 0; frame < 200; frame++)
+	{
+		fence.GpuFrameTime = gpuFrameTimes[frame % _countof(gpuFrameTimes)];
+		uint32_t context = scheduler.BeginFrame();
+		CHECK(context == frame % FramesInFlight);
+		CHECK(context == scheduler.GetContextIndex());
+		//the context's allocator is only handed out again once the gpu is done with it
+		CHECK(fence.GetCompletedValue() >= contextFenceValues[context]);
+
+		fence.Now += 3.0;
+		contextFenceValues[context] = scheduler.EndFrame();
+	}
+	CHECK(!fence.Waits.empty());
+	CHECK(scheduler.GetStats().OverlappedFrames > 0);
+
+	//a gpu that finishes before the cpu records the next frame never makes it wait
+	SimulatedFrameFence fastFence;
+	fastFence.GpuFrameTime = 0.5;
+	FrameScheduler fastScheduler(&fastFence, FramesInFlight);
+	for(uint32_t frame = 0; frame < 20; frame++)
+	{
+		fastScheduler.BeginFrame();
+		fastFence.Now += 1.0;
+		fastScheduler.EndFrame();
+	}
+	CHECK(fastFence.Waits.empty());
+	CHECK(fastScheduler.GetStats().Waits == 0);
+}
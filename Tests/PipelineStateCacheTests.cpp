@@ -0,0 +1,131 @@
+#include "Test.h"
+#include "PipelineStateCache.h"
+
+#include <climits>
+#include <cstring>
+
+namespace
+{
+	//owns everything a graphics pipeline desc points to, each instance in its own memory so only
+	//the contents can make two of them equal
+	struct PipelineDescription
+	{
+		std::vector<uint8_t> VertexShader = std::vector<uint8_t>(64, 0x11);
+		std::vector<uint8_t> PixelShader = std::vector<uint8_t>(96, 0x22);
+		char PositionName[16] = "POSITION";
+		char NormalName[16] = "NORMAL";
+		D3D12_INPUT_ELEMENT_DESC Elements[2] = {};
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = {};
+		uint64_t RootSignatureHash = 0x0123456789ABCDEFull;
+
+		//the opaque mesh pipeline, roughly what Pipeline::Initialize builds
+		PipelineDescription()
+		{
+			Elements[0].SemanticName = PositionName;
+			Elements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+			Elements[0].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+			Elements[1] = Elements[0];
+			Elements[1].SemanticName = NormalName;
+			Elements[1].AlignedByteOffset = 12;
+
+			Desc.InputLayout.pInputElementDescs = Elements;
+			Desc.InputLayout.NumElements = 2;
+			Desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+			Desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+			Desc.RasterizerState.DepthClipEnable = TRUE;
+			Desc.DepthStencilState.DepthEnable = TRUE;
+			Desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+			Desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+			for(D3D12_RENDER_TARGET_BLEND_DESC& target : Desc.BlendState.RenderTarget)
+			{
+				target.SrcBlend = target.SrcBlendAlpha = D3D12_BLEND_ONE;
+				target.DestBlend = target.DestBlendAlpha = D3D12_BLEND_ZERO;
+				target.BlendOp = target.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+				target.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+			}
+			Desc.SampleMask = UINT_MAX;
+			Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+			Desc.NumRenderTargets = 1;
+			Desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+			Desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+			Desc.SampleDesc.Count = 1;
+		}
+
+		PipelineDescription(const PipelineDescription&) = delete;
+
+		//the shader pointers are taken here so tests can resize or swap the bytecode first
+		std::vector<uint32_t> Canonicalize()
+		{
+			Desc.VS = { VertexShader.data(), VertexShader.size() };
+			Desc.PS = { PixelShader.data(), PixelShader.size() };
+			return CanonicalizeGraphicsPipelineDesc(Desc, RootSignatureHash);
+		}
+	};
+
+	bool SamePipeline(PipelineDescription& a, PipelineDescription& b)
+	{
+		std::vector<uint32_t> canonicalA = a.Canonicalize();
+		std::vector<uint32_t> canonicalB = b.Canonicalize();
+		if(canonicalA == canonicalB)
+		{
+			CHECK(HashPipelineState(canonicalA) == HashPipelineState(canonicalB));
+			return true;
+		}
+		CHECK(HashPipelineState(canonicalA) != HashPipelineState(canonicalB));
+		return false;
+	}
+}
+
+TEST(PipelineStateCanonicalFormIgnoresPointers)
+{
+	PipelineDescription a;
+	PipelineDescription b;
+	CHECK(a.VertexShader.data() != b.VertexShader.data());
+	CHECK(SamePipeline(a, b));
+
+	//the root signature object and a cached blob do not change what the pipeline does
+	int rootSignature;
+	b.Desc.pRootSignature = reinterpret_cast<ID3D12RootSignature*>(&rootSignature);
+	uint8_t cachedBlob[16] = {};
+	b.Desc.CachedPSO.pCachedBlob = cachedBlob;
+	b.Desc.CachedPSO.CachedBlobSizeInBytes = sizeof(cachedBlob);
+	CHECK(SamePipeline(a, b));
+
+	//semantic names are compared by content
+	char position[] = "POSITION";
+	b.Elements[0].SemanticName = position;
+	CHECK(SamePipeline(a, b));
+}
+
+TEST(PipelineStateCanonicalFormSeesEveryState)
+{
+	PipelineDescription a;
+	auto differs = [&](auto&& change)
+	{
+		PipelineDescription b;
+		change(b);
+		return !SamePipeline(a, b);
+	};
+
+	CHECK(differs([](PipelineDescription& b) { b.RootSignatureHash++; }));
+	CHECK(differs([](PipelineDescription& b) { b.VertexShader[10] ^= 1; }));
+	CHECK(differs([](PipelineDescription& b) { b.PixelShader.push_back(0); }));
+	//the same bytes in another stage are another pipeline
+	CHECK(differs([](PipelineDescription& b) { b.VertexShader.swap(b.PixelShader); }));
+	CHECK(differs([](PipelineDescription& b) { b.Elements[1].SemanticName = "TEXCOORD"; }));
+	CHECK(differs([](PipelineDescription& b) { b.Elements[1].AlignedByteOffset = 16; }));
+	CHECK(differs([](PipelineDescription& b) { b.Elements[1].Format = DXGI_FORMAT_R32_FLOAT; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.InputLayout.NumElements = 1; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.BlendState.RenderTarget[0].BlendEnable = TRUE; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.BlendState.RenderTarget[7].RenderTargetWriteMask = 0; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.RasterizerState.SlopeScaledDepthBias = 1.f; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.DepthStencilState.BackFace.StencilFunc = D3D12_COMPARISON_FUNC_LESS; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.RTVFormats[0] = DXGI_FORMAT_R32_FLOAT; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.NumRenderTargets = 2; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.DSVFormat = DXGI_FORMAT_UNKNOWN; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.SampleDesc.Count = 4; }));
+	CHECK(differs([](PipelineDescription& b) { b.Desc.SampleMask = 1; }));
+}
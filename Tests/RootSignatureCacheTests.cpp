@@ -0,0 +1,108 @@
+#include "Test.h"
+#include "RootSignatureCache.h"
+
+#include <utility>
+
+namespace
+{
+	//owns the arrays a root signature desc points into, so tests can build and tweak copies freely
+	struct RootSignatureLayout
+	{
+		D3D12_DESCRIPTOR_RANGE1 Ranges[2] = {};
+		D3D12_ROOT_PARAMETER1 Parameters[3] = {};
+		D3D12_STATIC_SAMPLER_DESC Sampler = {};
+		D3D12_ROOT_SIGNATURE_FLAGS Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+
+		//constant buffer for the vertex shader, two srv ranges and 4 root constants for the pixel shader
+		RootSignatureLayout()
+		{
+			Ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+			Ranges[0].NumDescriptors = 1;
+			Ranges[0].BaseShaderRegister = 0;
+			Ranges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+			Ranges[1] = Ranges[0];
+			Ranges[1].NumDescriptors = 2;
+			Ranges[1].BaseShaderRegister = 3;
+
+			Parameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+			Parameters[0].Descriptor.ShaderRegister = 0;
+			Parameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+			Parameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+			Parameters[1].DescriptorTable.NumDescriptorRanges = 2;
+			Parameters[1].DescriptorTable.pDescriptorRanges = Ranges;
+			Parameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+			Parameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+			Parameters[2].Constants.ShaderRegister = 1;
+			Parameters[2].Constants.Num32BitValues = 4;
+			Parameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+			Sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+			Sampler.AddressU = Sampler.AddressV = Sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+			Sampler.MaxLOD = D3D12_FLOAT32_MAX;
+			Sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+		}
+
+		D3D12_ROOT_SIGNATURE_DESC1 GetDesc()
+		{
+			D3D12_ROOT_SIGNATURE_DESC1 desc = {};
+			desc.NumParameters = _countof(Parameters);
+			desc.pParameters = Parameters;
+			desc.NumStaticSamplers = 1;
+			desc.pStaticSamplers = &Sampler;
+			desc.Flags = Flags;
+			return desc;
+		}
+	};
+
+	bool SameRootSignature(RootSignatureLayout& a, RootSignatureLayout& b)
+	{
+		std::vector<uint32_t> canonicalA = CanonicalizeRootSignature(a.GetDesc());
+		std::vector<uint32_t> canonicalB = CanonicalizeRootSignature(b.GetDesc());
+		if(canonicalA == canonicalB)
+		{
+			CHECK(HashRootSignature(canonicalA) == HashRootSignature(canonicalB));
+			return true;
+		}
+		//unequal layouts must not collide either, or the cache would fall back to comparing words on every lookup
+		CHECK(HashRootSignature(canonicalA) != HashRootSignature(canonicalB));
+		return false;
+	}
+}
+
+TEST(RootSignatureCanonicalFormIgnoresStorage)
+{
+	//equal layouts in separately allocated arrays
+	RootSignatureLayout a;
+	RootSignatureLayout b;
+	CHECK(SameRootSignature(a, b));
+
+	//appended ranges resolve to the explicit offsets they stand for
+	b.Ranges[0].OffsetInDescriptorsFromTableStart = 0;
+	b.Ranges[1].OffsetInDescriptorsFromTableStart = 1;
+	CHECK(SameRootSignature(a, b));
+}
+
+TEST(RootSignatureCanonicalFormSeesEveryField)
+{
+	RootSignatureLayout a;
+	auto differs = [&](auto&& change)
+	{
+		RootSignatureLayout b;
+		change(b);
+		return !SameRootSignature(a, b);
+	};
+
+	CHECK(differs([](RootSignatureLayout& b) { b.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE; }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Parameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL; }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Parameters[0].Descriptor.ShaderRegister = 1; }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Parameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV; }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Parameters[1].DescriptorTable.NumDescriptorRanges = 1; }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Ranges[1].BaseShaderRegister = 4; }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Ranges[1].Flags = D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE; }));
+	//an explicit offset that leaves a gap is not the appended layout
+	CHECK(differs([](RootSignatureLayout& b) { b.Ranges[1].OffsetInDescriptorsFromTableStart = 2; }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Parameters[2].Constants.Num32BitValues = 8; }));
+	CHECK(differs([](RootSignatureLayout& b) { std::swap(b.Parameters[1], b.Parameters[2]); }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Sampler.MipLODBias = 0.5f; }));
+	CHECK(differs([](RootSignatureLayout& b) { b.Sampler.ShaderRegister = 1; }));
+}
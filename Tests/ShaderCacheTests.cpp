@@ -0,0 +1,137 @@
+#include "Test.h"
+#include "ShaderCache.h"
+
+#include <fstream>
+
+namespace
+{
+	//fresh directory per test, removed again with everything the test wrote into it
+	struct TempDirectory
+	{
+		std::filesystem::path Path;
+
+		explicit TempDirectory(const char* name)
+		{
+			Path = std::filesystem::temp_directory_path() / name;
+			std::filesystem::remove_all(Path);
+			std::filesystem::create_directories(Path);
+		}
+
+		~TempDirectory()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(Path, error);
+		}
+	};
+
+	void WriteFile(const std::filesystem::path& path, const std::string& contents)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << contents;
+	}
+
+	const std::vector<std::wstring> Arguments = {L"-E", L"main", L"-T", L"ps_6_0", L"-DSAMPLES=8"};
+	const std::string CompilerVersion = "dxcompiler 1.7";
+}
+
+TEST(ShaderCacheHitReturnsStoredBytecode)
+{
+	TempDirectory directory("ShaderCacheHitTest");
+	std::filesystem::path source = directory.Path / "shader.hlsl";
+	WriteFile(directory.Path / "common.hlsli", "float4 Tint;\n");
+	WriteFile(source, "#include \"common.hlsli\"\nfloat4 main() : SV_Target { return Tint; }\n");
+
+	ShaderCache cache(directory.Path / "cache");
+	uint64_t key;
+	std::vector<std::filesystem::path> dependencies;
+	CHECK(cache.ComputeKey(source, Arguments, CompilerVersion, key, &dependencies));
+	CHECK(dependencies.size() == 1 && dependencies[0].filename() == "common.hlsli");
+
+	ShaderCacheEntry entry;
+	CHECK(!cache.Load(key, entry));
+
+	ShaderCacheEntry stored;
+	for(int i = 0; i < 1000; i++)
+	{
+		stored.Object.push_back(uint8_t(i * 13));
+	}
+	stored.Reflection = {1, 2, 3, 4, 5};
+	CHECK(cache.Store(key, stored));
+
+	//the same inputs give the same key on the next run and load back exactly what was stored
+	uint64_t sameKey;
+	CHECK(cache.ComputeKey(source, Arguments, CompilerVersion, sameKey));
+	CHECK(sameKey == key);
+	CHECK(cache.Load(sameKey, entry));
+	CHECK(entry.Object == stored.Object);
+	CHECK(entry.Reflection == stored.Reflection);
+}
+
+TEST(ShaderCacheMissesOnChangedDefine)
+{
+	TempDirectory directory("ShaderCacheDefineTest");
+	std::filesystem::path source = directory.Path / "shader.hlsl";
+	WriteFile(source, "float4 main() : SV_Target { return SAMPLES; }\n");
+
+	ShaderCache cache(directory.Path / "cache");
+	uint64_t key;
+	CHECK(cache.ComputeKey(source, Arguments, CompilerVersion, key));
+	CHECK(cache.Store(key, {{1, 2, 3}, {}}));
+
+	std::vector<std::wstring> changedArguments = Arguments;
+	changedArguments.back() = L"-DSAMPLES=16";
+	uint64_t changedKey;
+	CHECK(cache.ComputeKey(source, changedArguments, CompilerVersion, changedKey));
+	CHECK(changedKey != key);
+
+	//moving text between arguments must not produce the same key either
+	std::vector<std::wstring> splitArguments = Arguments;
+	splitArguments.back() = L"-DSAMPLES=";
+	splitArguments.push_back(L"8");
+	uint64_t splitKey;
+	CHECK(cache.ComputeKey(source, splitArguments, CompilerVersion, splitKey));
+	CHECK(splitKey != key);
+
+	uint64_t compilerKey;
+	CHECK(cache.ComputeKey(source, Arguments, "dxcompiler 1.8", compilerKey));
+	CHECK(compilerKey != key);
+
+	ShaderCacheEntry entry;
+	CHECK(!cache.Load(changedKey, entry));
+	CHECK(!cache.Load(splitKey, entry));
+	CHECK(!cache.Load(compilerKey, entry));
+	CHECK(cache.Load(key, entry));
+}
+
+TEST(ShaderCacheMissesOnChangedInclude)
+{
+	TempDirectory directory("ShaderCacheIncludeTest");
+	std::filesystem::path source = directory.Path / "shader.hlsl";
+	std::filesystem::create_directories(directory.Path / "include");
+	WriteFile(directory.Path / "include" / "lighting.hlsli", "#include \"constants.hlsli\"\nfloat3 Light;\n");
+	WriteFile(directory.Path / "include" / "constants.hlsli", "static const float Pi = 3.14159;\n");
+	WriteFile(source, "#include \"include/lighting.hlsli\"\nfloat4 main() : SV_Target { return Pi; }\n");
+
+	ShaderCache cache(directory.Path / "cache");
+	uint64_t key;
+	std::vector<std::filesystem::path> dependencies;
+	CHECK(cache.ComputeKey(source, Arguments, CompilerVersion, key, &dependencies));
+	CHECK(dependencies.size() == 2);
+	CHECK(cache.Store(key, {{1, 2, 3}, {}}));
+
+	//an edit two includes deep changes the key
+	WriteFile(directory.Path / "include" / "constants.hlsli", "static const float Pi = 3.1415926;\n");
+	uint64_t changedKey;
+	CHECK(cache.ComputeKey(source, Arguments, CompilerVersion, changedKey));
+	CHECK(changedKey != key);
+
+	ShaderCacheEntry entry;
+	CHECK(!cache.Load(changedKey, entry));
+
+	//reverting the edit finds the old entry again
+	WriteFile(directory.Path / "include" / "constants.hlsli", "static const float Pi = 3.14159;\n");
+	uint64_t revertedKey;
+	CHECK(cache.ComputeKey(source, Arguments, CompilerVersion, revertedKey));
+	CHECK(revertedKey == key);
+	CHECK(cache.Load(revertedKey, entry));
+}
@@ -0,0 +1,140 @@
+#include "Test.h"
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <deque>
+#include <random>
+
+TEST(StagingRingWrapsWhenTailIsTooSmall)
+{
+	StagingRing ring;
+	ring.Initialize(1000);
+	uint64_t offset;
+	CHECK(ring.Allocate(400, 1, offset) && offset == 0);
+	ring.Commit(1);
+	CHECK(ring.Allocate(400, 1, offset) && offset == 400);
+	ring.Commit(2);
+
+	//200 bytes are left at the end and the start still belongs to fence 1
+	CHECK(!ring.Allocate(300, 1, offset));
+	CHECK(ring.GetUsedBytes() == 800);
+
+	//the tail is skipped and counted against the allocation that wrapped
+	ring.Reclaim(1);
+	CHECK(ring.Allocate(300, 1, offset) && offset == 0);
+	CHECK(ring.GetUsedBytes() == 400 + 200 + 300);
+	ring.Commit(3);
+
+	ring.Reclaim(2);
+	CHECK(ring.GetUsedBytes() == 500);
+	CHECK(ring.Allocate(100, 1, offset) && offset == 300);
+	CHECK(!ring.Allocate(700, 1, offset));
+	ring.Commit(4);
+
+	//an empty ring starts over at the front
+	ring.Reclaim(4);
+	CHECK(ring.GetUsedBytes() == 0);
+	CHECK(ring.Allocate(1000, 1, offset) && offset == 0);
+	CHECK(!ring.Allocate(1001, 1, offset));
+}
+
+TEST(StagingRingAlignsOffsets)
+{
+	StagingRing ring;
+	ring.Initialize(1024);
+	uint64_t offset;
+	CHECK(ring.Allocate(10, 1, offset) && offset == 0);
+	CHECK(ring.Allocate(10, 256, offset) && offset == 256);
+	CHECK(ring.GetUsedBytes() == 266);
+	CHECK(ring.Allocate(100, 512, offset) && offset == 512);
+	CHECK(ring.GetUsedBytes() == 612);
+
+	//the next aligned offset is past the end, and the front is not free yet
+	CHECK(!ring.Allocate(8, 1024, offset));
+	CHECK(ring.GetUsedBytes() == 612);
+	ring.Commit(1);
+	ring.Reclaim(1);
+	CHECK(ring.Allocate(8, 1024, offset) && offset == 0);
+}
+
+TEST(StagingRingNeverOverwritesPendingBytes)
+{
+	constexpr uint64_t Capacity = 64 * 1024;
+	struct Range
+	{
+		uint64_t Offset;
+		uint64_t Size;
+		uint64_t FenceValue;
+	};
+
+	StagingRing ring;
+	ring.Initialize(Capacity);
+	std::deque<Range> live;
+	std::mt19937 random(49);
+	uint64_t completed = 0;
+	uint64_t previousOffset = 0;
+	uint32_t wraps = 0;
+	uint32_t failures = 0;
+
+	for(uint64_t fence = 1; fence <= 3000; fence++)
+	{
+		//the gpu runs 0 to 3 submits behind
+		uint64_t lag = random() % 4;
+		if(fence > lag + 1)
+		{
+			completed = std::max(completed, fence - 1 - lag);
+		}
+		ring.Reclaim(completed);
+		while(!live.empty() && live.front().FenceValue <= completed)
+		{
+			live.pop_front();
+		}
+
+		uint32_t allocations = random() % 8;
+		for(uint32_t a = 0; a < allocations; a++)
+		{
+			uint64_t size = 1 + random() % 8192;
+			uint64_t alignment = uint64_t(1) << (random() % 10);
+			uint64_t offset;
+			if(!ring.Allocate(size, alignment, offset))
+			{
+				CHECK(!live.empty());
+				failures++;
+				continue;
+			}
+
+			CHECK(offset % alignment == 0);
+			CHECK(offset + size <= Capacity);
+			for(const Range& range : live)
+			{
+				CHECK(offset >= range.Offset + range.Size || range.Offset >= offset + size);
+			}
+			wraps += offset < previousOffset;
+			previousOffset = offset;
+			live.push_back({offset, size, UINT64_MAX});
+		}
+
+		ring.Commit(fence);
+		for(Range& range : live)
+		{
+			if(range.FenceValue == UINT64_MAX)
+				range.FenceValue = fence;
+		}
+
+		uint64_t liveBytes = 0;
+		for(const Range& range : live)
+		{
+			liveBytes += range.Size;
+		}
+		//padding counts as used, so the ring never reports less than the live ranges
+		CHECK(ring.GetUsedBytes() >= liveBytes);
+		CHECK(ring.GetUsedBytes() <= Capacity);
+	}
+
+	//the load is sized so the ring both wraps a lot and runs full now and then
+	CHECK(wraps > 100);
+	CHECK(failures > 0);
+
+	ring.Reclaim(UINT64_MAX);
+	CHECK(ring.GetUsedBytes() == 0);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//tiny self registering test runner, every TEST adds itself to the list TestMain walks
+struct TestCase
+{
+	const char* Name;
+	void (*Function)();
+};
+
+std::vector<TestCase>& GetTests();
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, void (*function)())
+	{
+		GetTests().push_back({name, function});
+	}
+};
+
+class TestFailure : public std::runtime_error
+{
+public:
+	using std::runtime_error::runtime_error;
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name); \
+	static void name()
+
+//stops the current test, the runner reports the failed expression and moves on to the next one
+#define CHECK(condition) \
+	do \
+	{ \
+		if(!(condition)) \
+			throw TestFailure(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #condition); \
+	} while(false)
@@ -0,0 +1,38 @@
+#include "Test.h"
+
+#include <cstring>
+#include <iostream>
+
+std::vector<TestCase>& GetTests()
+{
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+//runs every test, or only the ones whose name contains the first argument
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	int run = 0;
+	int failed = 0;
+	for(const TestCase& test : GetTests())
+	{
+		if(filter && !strstr(test.Name, filter))
+			continue;
+
+		run++;
+		try
+		{
+			test.Function();
+			std::cout << "[pass] " << test.Name << std::endl;
+		}
+		catch(const std::exception& e)
+		{
+			failed++;
+			std::cout << "[FAIL] " << test.Name << ": " << e.what() << std::endl;
+		}
+	}
+
+	std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
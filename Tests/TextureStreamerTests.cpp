@@ -0,0 +1,264 @@
+#include "Test.h"
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t TextureSize = 64;
+	constexpr uint32_t MipCount = 4;
+
+	//records what the streamer asks for instead of touching a gpu, fences only complete when the test says so
+	class FakeUploadSink : public TextureUploadSink
+	{
+	public:
+		struct Copy
+		{
+			uint32_t TextureId;
+			uint32_t Mip;
+			uint64_t Offset;
+			uint64_t Size;
+			uint64_t FenceValue; //UINT64_MAX until submitted
+		};
+
+		std::vector<uint8_t> Staging;
+		std::vector<uint32_t> Created;
+		std::vector<Copy> Copies;
+		uint64_t SubmittedFenceValue = 0;
+		uint64_t CompletedFenceValue = 0;
+
+		uint8_t* MapStaging(uint64_t size) override
+		{
+			Staging.resize(size);
+			return Staging.data();
+		}
+
+		void CreateTexture(uint32_t textureId, const DecodedTexture& texture) override
+		{
+			Created.push_back(textureId);
+		}
+
+		void CopyMip(uint32_t textureId, uint32_t mip, const StreamedMip& layout, uint64_t stagingOffset, uint32_t rowPitch) override
+		{
+			uint64_t size = uint64_t(rowPitch) * layout.RowCount;
+			CHECK(stagingOffset + size <= Staging.size());
+			//the rows were just written, so they must not land on bytes a pending copy still reads
+			for(const Copy& copy : Copies)
+			{
+				if(copy.FenceValue > CompletedFenceValue)
+				{
+					CHECK(stagingOffset >= copy.Offset + copy.Size || copy.Offset >= stagingOffset + size);
+				}
+			}
+			for(uint32_t row = 0; row < layout.RowCount; row++)
+			{
+				CHECK(memcmp(&Staging[stagingOffset + uint64_t(row) * rowPitch], &layout.Data[size_t(row) * layout.RowSize], layout.RowSize) == 0);
+			}
+			Copies.push_back({textureId, mip, stagingOffset, size, UINT64_MAX});
+		}
+
+		uint64_t Submit() override
+		{
+			SubmittedFenceValue++;
+			for(Copy& copy : Copies)
+			{
+				if(copy.FenceValue == UINT64_MAX)
+					copy.FenceValue = SubmittedFenceValue;
+			}
+			return SubmittedFenceValue;
+		}
+
+		uint64_t GetCompletedFenceValue() override
+		{
+			return CompletedFenceValue;
+		}
+	};
+
+	//rgba8 mip chain with a pattern that differs per file and mip so misplaced rows show up
+	bool DecodeFake(const std::wstring& filename, DecodedTexture& out)
+	{
+		out.Width = TextureSize;
+		out.Height = TextureSize;
+		out.Format = 0;
+		out.Mips.resize(MipCount);
+		for(uint32_t mip = 0; mip < MipCount; mip++)
+		{
+			StreamedMip& level = out.Mips[mip];
+			level.Width = TextureSize >> mip;
+			level.Height = TextureSize >> mip;
+			level.RowSize = level.Width * 4;
+			level.RowCount = level.Height;
+			level.Data.resize(size_t(level.RowSize) * level.RowCount);
+			for(size_t i = 0; i < level.Data.size(); i++)
+			{
+				level.Data[i] = uint8_t(filename[0] * 31 + mip * 7 + i);
+			}
+		}
+		return true;
+	}
+
+	//rgba8 rows of the fake textures are at most 256 bytes, so each mip takes one 256 byte pitch per row
+	uint64_t StagedMipSize(uint32_t mip)
+	{
+		return 256ull * (TextureSize >> mip);
+	}
+
+	//decoding runs on the workers, pump until every request reached the sink
+	void WaitForCreated(TextureStreamer& streamer, FakeUploadSink& sink, size_t count)
+	{
+		for(int i = 0; i < 5000 && sink.Created.size() < count; i++)
+		{
+			streamer.Update();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		CHECK(sink.Created.size() == count);
+	}
+}
+
+TEST(TextureStreamerCopiesCoarsestMipFirst)
+{
+	FakeUploadSink sink;
+	TextureStreamer streamer(&sink, DecodeFake, 1024 * 1024, 2, 1024 * 1024);
+	uint32_t first = streamer.Request(L"a");
+	uint32_t second = streamer.Request(L"b");
+	WaitForCreated(streamer, sink, 2);
+	streamer.Update();
+
+	//nothing is resident until the fence of its copy completes
+	CHECK(sink.Copies.size() == 2 * MipCount);
+	CHECK(streamer.GetResidentMip(first) == MipCount);
+	CHECK(streamer.GetResidentMip(second) == MipCount);
+
+	for(uint32_t textureId : {first, second})
+	{
+		uint32_t expectedMip = MipCount;
+		for(const auto& copy : sink.Copies)
+		{
+			if(copy.TextureId != textureId)
+				continue;
+
+			CHECK(copy.Mip == --expectedMip);
+		}
+		CHECK(expectedMip == 0);
+	}
+
+	//completing the first submit makes exactly the mips recorded into it resident
+	sink.CompletedFenceValue = sink.Copies.front().FenceValue;
+	streamer.Update();
+	for(uint32_t textureId : {first, second})
+	{
+		uint32_t expectedResident = MipCount;
+		for(const auto& copy : sink.Copies)
+		{
+			if(copy.TextureId == textureId && copy.FenceValue <= sink.CompletedFenceValue)
+				expectedResident = std::min(expectedResident, copy.Mip);
+		}
+		CHECK(streamer.GetResidentMip(textureId) == expectedResident);
+	}
+
+	sink.CompletedFenceValue = sink.SubmittedFenceValue;
+	streamer.Update();
+	CHECK(streamer.IsComplete(first));
+	CHECK(streamer.IsComplete(second));
+	CHECK(streamer.IsIdle());
+}
+
+TEST(TextureStreamerStaysWithinUpdateBudget)
+{
+	const uint64_t budget = StagedMipSize(1) + StagedMipSize(2);
+	FakeUploadSink sink;
+	TextureStreamer streamer(&sink, DecodeFake, 1024 * 1024, 2, budget);
+	uint32_t textures[] = {streamer.Request(L"a"), streamer.Request(L"b"), streamer.Request(L"c")};
+	WaitForCreated(streamer, sink, 3);
+
+	for(int i = 0; i < 100 && !streamer.IsIdle(); i++)
+	{
+		sink.CompletedFenceValue = sink.SubmittedFenceValue;
+		streamer.Update();
+	}
+	for(uint32_t textureId : textures)
+	{
+		CHECK(streamer.IsComplete(textureId));
+	}
+	CHECK(sink.Copies.size() == 3 * MipCount);
+
+	//an update stops recording as soon as it reaches the budget, so only its last copy may cross it
+	for(uint64_t fenceValue = 1; fenceValue <= sink.SubmittedFenceValue; fenceValue++)
+	{
+		uint64_t bytes = 0;
+		uint64_t lastSize = 0;
+		for(const auto& copy : sink.Copies)
+		{
+			if(copy.FenceValue != fenceValue)
+				continue;
+
+			bytes += copy.Size;
+			lastSize = copy.Size;
+		}
+		CHECK(bytes > 0);
+		CHECK(bytes - lastSize < budget);
+	}
+}
+
+TEST(TextureStreamerWaitsForStagingSpace)
+{
+	//room for the three coarse mips but not for the full size one while they are in flight
+	const uint64_t capacity = StagedMipSize(1) + StagedMipSize(2) + StagedMipSize(3) + 4 * 1024;
+	FakeUploadSink sink;
+	TextureStreamer streamer(&sink, DecodeFake, capacity, 1, 1024 * 1024);
+	uint32_t textureId = streamer.Request(L"a");
+	WaitForCreated(streamer, sink, 1);
+	for(int i = 0; i < 4; i++)
+	{
+		streamer.Update();
+	}
+
+	CHECK(sink.Copies.size() == MipCount - 1);
+	CHECK(sink.Copies.back().Mip == 1);
+	CHECK(streamer.GetResidentMip(textureId) == MipCount);
+	CHECK(!streamer.IsComplete(textureId));
+
+	//once the gpu is done with the staged mips the last one reuses their space
+	sink.CompletedFenceValue = sink.SubmittedFenceValue;
+	streamer.Update();
+	CHECK(sink.Copies.size() == MipCount);
+	CHECK(sink.Copies.back().Mip == 0);
+	CHECK(streamer.GetResidentMip(textureId) == 1);
+
+	sink.CompletedFenceValue = sink.SubmittedFenceValue;
+	streamer.Update();
+	CHECK(streamer.IsComplete(textureId));
+}
+
+TEST(TextureStreamerFailsTexturesItCannotStream)
+{
+	//the full size mip of the fake textures does not fit the ring at all
+	FakeUploadSink sink;
+	TextureDecoder decoder = [](const std::wstring& filename, DecodedTexture& out)
+	{
+		return filename != L"broken" && DecodeFake(filename, out);
+	};
+	TextureStreamer streamer(&sink, decoder, StagedMipSize(1) + StagedMipSize(2) + StagedMipSize(3), 1, 1024 * 1024);
+	uint32_t broken = streamer.Request(L"broken");
+	uint32_t large = streamer.Request(L"large");
+	WaitForCreated(streamer, sink, 1);
+	//the failed decode may still be on its way back from the worker
+	for(int i = 0; i < 5000 && !streamer.IsIdle(); i++)
+	{
+		sink.CompletedFenceValue = sink.SubmittedFenceValue;
+		streamer.Update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK(streamer.IsIdle());
+
+	CHECK(streamer.IsFailed(broken));
+	CHECK(!streamer.GetStats(broken).FailureReason.empty());
+
+	//the coarse mips made it, the texture just stops short of full detail
+	CHECK(streamer.IsFailed(large));
+	CHECK(!streamer.IsComplete(large));
+	CHECK(streamer.GetResidentMip(large) == 1);
+	CHECK(sink.Copies.size() == MipCount - 1);
+	CHECK(!streamer.GetStats(large).FailureReason.empty());
+}